@@ -298,6 +298,18 @@ DBusConfigurationManager::setAgcState(const bool& enabled)
     DRing::setAgcState(enabled);
 }
 
+auto
+DBusConfigurationManager::isEchoCancelEnabled() -> decltype(DRing::isEchoCancelEnabled())
+{
+    return DRing::isEchoCancelEnabled();
+}
+
+void
+DBusConfigurationManager::setEchoCancelState(const bool& enabled)
+{
+    DRing::setEchoCancelState(enabled);
+}
+
 void
 DBusConfigurationManager::muteDtmf(const bool& mute)
 {
@@ -104,6 +104,8 @@ class DBusConfigurationManager :
         void setNoiseSuppressState(const bool& state);
         bool isAgcEnabled();
         void setAgcState(const bool& enabled);
+        bool isEchoCancelEnabled();
+        void setEchoCancelState(const bool& enabled);
         void muteDtmf(const bool& mute);
         bool isDtmfMuted();
         bool isCaptureMuted();
@@ -96,3 +96,15 @@ DBusVideoManager::setDecodingAccelerated(const bool& state)
 {
     DRing::setDecodingAccelerated(state);
 }
+
+auto
+DBusVideoManager::getEncodingAccelerated() -> decltype(DRing::getEncodingAccelerated())
+{
+    return DRing::getEncodingAccelerated();
+}
+
+void
+DBusVideoManager::setEncodingAccelerated(const bool& state)
+{
+    DRing::setEncodingAccelerated(state);
+}
@@ -62,6 +62,8 @@ class DBusVideoManager :
         bool hasCameraStarted();
         bool getDecodingAccelerated();
         void setDecodingAccelerated(const bool& state);
+        bool getEncodingAccelerated();
+        void setEncodingAccelerated(const bool& state);
 };
 
 #endif // __RING_DBUSVIDEOMANAGER_H__
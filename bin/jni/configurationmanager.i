@@ -113,6 +113,9 @@ void setNoiseSuppressState(bool state);
 bool isAgcEnabled();
 void setAgcState(bool enabled);
 
+bool isEchoCancelEnabled();
+void setEchoCancelState(bool enabled);
+
 void muteDtmf(bool mute);
 bool isDtmfMuted();
 
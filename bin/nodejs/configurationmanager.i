@@ -110,6 +110,9 @@ void setNoiseSuppressState(bool state);
 bool isAgcEnabled();
 void setAgcState(bool enabled);
 
+bool isEchoCancelEnabled();
+void setEchoCancelState(bool enabled);
+
 void muteDtmf(bool mute);
 bool isDtmfMuted();
 
@@ -256,6 +256,16 @@ RestConfigurationManager::populateResources()
     resources_.back()->set_method_handler("GET",
         std::bind(&RestConfigurationManager::setAgcState, this, std::placeholders::_1));
 
+    resources_.push_back(std::make_shared<restbed::Resource>());
+    resources_.back()->set_path("/isEchoCancelEnabled");
+    resources_.back()->set_method_handler("GET",
+        std::bind(&RestConfigurationManager::isEchoCancelEnabled, this, std::placeholders::_1));
+
+    resources_.push_back(std::make_shared<restbed::Resource>());
+    resources_.back()->set_path("/setEchoCancelState/{state: (true|false)}");
+    resources_.back()->set_method_handler("GET",
+        std::bind(&RestConfigurationManager::setEchoCancelState, this, std::placeholders::_1));
+
     resources_.push_back(std::make_shared<restbed::Resource>());
     resources_.back()->set_path("/muteDtmf/{state: (true|false)}");
     resources_.back()->set_method_handler("GET",
@@ -432,6 +442,8 @@ RestConfigurationManager::defaultRoute(const std::shared_ptr<restbed::Session> s
     body += "GET /setNoiseSuppressState/{state: (true|false)}\r\n";
     body += "GET /isAgcEnable\r\n";
     body += "GET /setAgcState/{state: (true|false)}\r\n";
+    body += "GET /isEchoCancelEnabled\r\n";
+    body += "GET /setEchoCancelState/{state: (true|false)}\r\n";
     body += "GET /muteDtmf/{state: (true|false)}\r\n";
     body += "GET /isDtmfMuted\r\n";
     body += "GET /isCaptureMuted\r\n";
@@ -1184,6 +1196,36 @@ RestConfigurationManager::setAgcState(const std::shared_ptr<restbed::Session> se
     session->close(restbed::OK);
 }
 
+void
+RestConfigurationManager::isEchoCancelEnabled(const std::shared_ptr<restbed::Session> session)
+{
+    RING_INFO("[%s] GET /isEchoCancelEnabled", session->get_origin().c_str());
+
+    bool status = DRing::isEchoCancelEnabled();
+    std::string body = (status ? "true" : "false");
+
+    const std::multimap<std::string, std::string> headers
+    {
+        {"Content-Type", "text/html"},
+        {"Content-Length", std::to_string(body.length())}
+    };
+
+    session->close(restbed::OK, body, headers);
+}
+
+void
+RestConfigurationManager::setEchoCancelState(const std::shared_ptr<restbed::Session> session)
+{
+    const auto request = session->get_request();
+    const std::string state = request->get_path_parameter("state");
+
+    RING_INFO("[%s] GET /setEchoCancelState/%s", session->get_origin().c_str(), state.c_str());
+
+    DRing::setEchoCancelState((state == "true" ? true : false));
+
+    session->close(restbed::OK);
+}
+
 void
 RestConfigurationManager::muteDtmf(const std::shared_ptr<restbed::Session> session)
 {
@@ -98,6 +98,8 @@ class RestConfigurationManager
         void setNoiseSuppressState(const std::shared_ptr<restbed::Session> session);
         void isAgcEnabled(const std::shared_ptr<restbed::Session> session);
         void setAgcState(const std::shared_ptr<restbed::Session> session);
+        void isEchoCancelEnabled(const std::shared_ptr<restbed::Session> session);
+        void setEchoCancelState(const std::shared_ptr<restbed::Session> session);
         void muteDtmf(const std::shared_ptr<restbed::Session> session);
         void isDtmfMuted(const std::shared_ptr<restbed::Session> session);
         void isCaptureMuted(const std::shared_ptr<restbed::Session> session);
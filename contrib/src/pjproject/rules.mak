@@ -33,10 +33,21 @@ endif
 ifdef HAVE_IOS
 PJPROJECT_OPTIONS += --with-ssl=$(PREFIX)
 endif
+ifdef HAVE_LINUX
+# one epoll set per ICE reactor shard rather than select()
+PJPROJECT_OPTIONS += --enable-epoll
+# sockets of one ICE reactor shard, select() stays at the default 64
+PJPROJECT_IOQUEUE_MAX_HANDLES := 1024
+endif
 
 PJPROJECT_EXTRA_CFLAGS = -g -DPJ_ENABLE_EXTRA_CHECK=1 -DPJ_ICE_MAX_CAND=256 -DPJ_ICE_MAX_CHECKS=150 -DPJ_ICE_COMP_BITS=2 -DPJ_ICE_MAX_STUN=3 -DPJSIP_MAX_PKT_LEN=8000 -DPJ_ICE_ST_MAX_CAND=32
 PJPROJECT_EXTRA_CXXFLAGS = -g -DPJ_ENABLE_EXTRA_CHECK=1 -DPJ_ICE_MAX_CAND=256 -DPJ_ICE_MAX_CHECKS=150 -DPJ_ICE_COMP_BITS=2 -DPJ_ICE_MAX_STUN=3 -DPJSIP_MAX_PKT_LEN=8000 -DPJ_ICE_ST_MAX_CAND=32 -std=gnu++11
 
+ifdef PJPROJECT_IOQUEUE_MAX_HANDLES
+PJPROJECT_EXTRA_CFLAGS += -DPJ_IOQUEUE_MAX_HANDLES=$(PJPROJECT_IOQUEUE_MAX_HANDLES)
+PJPROJECT_EXTRA_CXXFLAGS += -DPJ_IOQUEUE_MAX_HANDLES=$(PJPROJECT_IOQUEUE_MAX_HANDLES)
+endif
+
 ifdef HAVE_WIN64
 PJPROJECT_EXTRA_CFLAGS += -DPJ_WIN64=1
 endif
@@ -85,6 +96,10 @@ ifdef HAVE_IOS
 	cd $< && ARCH="-arch $(ARCH)" IPHONESDK=$(IOS_SDK) $(HOSTVARS) ./configure-iphone $(HOSTCONF) $(PJPROJECT_OPTIONS)
 else
 	cd $< && $(HOSTVARS) ./aconfigure $(HOSTCONF) $(PJPROJECT_OPTIONS)
+endif
+# installed with the headers, for the daemon to see the same bound
+ifdef PJPROJECT_IOQUEUE_MAX_HANDLES
+	echo "#define PJ_IOQUEUE_MAX_HANDLES $(PJPROJECT_IOQUEUE_MAX_HANDLES)" >> $</pjlib/include/pj/config_site.h
 endif
 	cd $< && CFLAGS="$(PJPROJECT_EXTRA_CFLAGS)" CXXFLAGS="$(PJPROJECT_EXTRA_CXXFLAGS)" $(MAKE) && $(MAKE) install
 	touch $@
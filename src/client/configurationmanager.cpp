@@ -649,6 +649,18 @@ setAgcState(bool enabled)
     ring::Manager::instance().setAGCState(enabled);
 }
 
+bool
+isEchoCancelEnabled()
+{
+    return ring::Manager::instance().isEchoCancelEnabled();
+}
+
+void
+setEchoCancelState(bool enabled)
+{
+    ring::Manager::instance().setEchoCancelState(enabled);
+}
+
 std::string
 getRecordPath()
 {
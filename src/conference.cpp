@@ -26,6 +26,7 @@
 #include "audio/audiolayer.h"
 #include "audio/ringbufferpool.h"
 #include "audio/audiorecord.h"
+#include "audio/audio_mixer.h"
 
 #ifdef RING_VIDEO
 #include "sip/sipcall.h"
@@ -44,6 +45,7 @@ Conference::Conference()
     : id_(Manager::instance().getNewCallID())
     , confState_(ACTIVE_ATTACHED)
     , participants_()
+    , audioMixer_(new AudioMixer(id_, Manager::instance().getRingBufferPool()))
 #ifdef RING_VIDEO
     , videoMixer_(nullptr)
 #endif
@@ -86,6 +88,7 @@ void Conference::add(const std::string &participant_id)
 void Conference::remove(const std::string &participant_id)
 {
     if (participants_.erase(participant_id)) {
+        audioMixer_->removeSource(participant_id);
 #ifdef RING_VIDEO
         if (auto call = Manager::instance().callFactory.getCall<SIPCall>(participant_id))
             call->getVideoRtp().exitConference();
@@ -97,16 +100,30 @@ void Conference::bindParticipant(const std::string &participant_id)
 {
     auto &rbPool = Manager::instance().getRingBufferPool();
 
-    for (const auto &item : participants_) {
-        if (participant_id != item)
-            rbPool.bindCallID(participant_id, item);
+    audioMixer_->addSource(participant_id);
+    audioMixer_->addSource(RingBufferPool::DEFAULT_ID);
+
+    for (const auto &item : participants_)
         rbPool.flush(item);
-    }
 
-    rbPool.bindCallID(participant_id, RingBufferPool::DEFAULT_ID);
     rbPool.flush(RingBufferPool::DEFAULT_ID);
 }
 
+void Conference::bindLocalParticipant()
+{
+    audioMixer_->addSource(RingBufferPool::DEFAULT_ID);
+}
+
+void Conference::unbindLocalParticipant()
+{
+    audioMixer_->removeSource(RingBufferPool::DEFAULT_ID);
+}
+
+void Conference::unbindParticipants()
+{
+    audioMixer_->removeAllSources();
+}
+
 std::string Conference::getStateStr() const
 {
     switch (confState_) {
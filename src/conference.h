@@ -32,6 +32,8 @@
 
 namespace ring {
 
+class AudioMixer;
+
 #ifdef RING_VIDEO
 namespace video {
 class VideoMixer;
@@ -89,6 +91,21 @@ class Conference : public Recordable {
          */
         void bindParticipant(const std::string &participant_id);
 
+        /**
+         * Mix the local participant (main audio buffer) in the conference
+         */
+        void bindLocalParticipant();
+
+        /**
+         * Stop mixing the local participant in the conference
+         */
+        void unbindLocalParticipant();
+
+        /**
+         * Unbind audio of all participants, including the local one
+         */
+        void unbindParticipants();
+
         /**
          * Get the participant list for this conference
          */
@@ -113,6 +130,7 @@ class Conference : public Recordable {
         std::string id_;
         ConferenceState confState_;
         ParticipantSet participants_;
+        std::unique_ptr<AudioMixer> audioMixer_;
 
 #ifdef RING_VIDEO
         std::shared_ptr<video::VideoMixer> videoMixer_;
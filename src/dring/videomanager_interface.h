@@ -83,6 +83,8 @@ void releaseFrame(void* frame);
 
 bool getDecodingAccelerated();
 void setDecodingAccelerated(bool state);
+bool getEncodingAccelerated();
+void setEncodingAccelerated(bool state);
 
 // Video signal type definitions
 struct VideoSignal {
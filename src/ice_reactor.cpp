@@ -0,0 +1,322 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "ice_reactor.h"
+#include "logger.h"
+#include "thread_pool.h"
+#include "sip/sip_utils.h"
+
+#include <pjlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <stdexcept>
+#include <thread>
+
+namespace ring {
+
+// longest wait in the ioqueue, bounds Lease::sync() and the shard stop
+static constexpr long MAX_POLL_MSEC {100};
+
+// most shards with idle cores
+static constexpr unsigned MAX_SHARDS {16};
+
+// sockets of one shard, the bound pjlib was built with: 1024 with epoll when
+// built from contrib (see contrib/src/pjproject/rules.mak), 64 otherwise
+static constexpr unsigned SHARD_HANDLES = PJ_IOQUEUE_MAX_HANDLES;
+
+class IceReactor::Shard {
+public:
+    explicit Shard(unsigned index);
+    ~Shard();
+
+    IceReactorStats getStats() const;
+    unsigned index() const { return index_; }
+
+    void sync();
+    bool isShardThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+    pj_ioqueue_t* ioqueue_ {nullptr};
+    pj_timer_heap_t* timerHeap_ {nullptr};
+    pj_caching_pool poolCache_ {};
+
+    // protected by the reactor mutex
+    unsigned transports_ {0};
+    unsigned handles_ {0};
+
+private:
+    NON_COPYABLE(Shard);
+    void loop();
+
+    const unsigned index_;
+    pj_pool_t* pool_ {nullptr};
+
+    std::atomic<uint64_t> events_ {0};
+    std::atomic<unsigned> eventsPerSecond_ {0};
+
+    std::mutex syncMutex_;
+    std::condition_variable syncCv_;
+    uint64_t iterations_ {0};
+    bool stop_ {false};
+
+    std::thread thread_;
+};
+
+IceReactor::Shard::Shard(unsigned index)
+    : index_(index)
+{
+    pj_caching_pool_init(&poolCache_, &pj_pool_factory_default_policy, 0);
+    pool_ = pj_pool_create(&poolCache_.factory, "IceReactor.pool", 512, 512, nullptr);
+    if (not pool_
+        or pj_timer_heap_create(pool_, 100, &timerHeap_) != PJ_SUCCESS
+        or pj_ioqueue_create(pool_, SHARD_HANDLES, &ioqueue_) != PJ_SUCCESS) {
+        if (timerHeap_)
+            pj_timer_heap_destroy(timerHeap_);
+        if (pool_)
+            pj_pool_release(pool_);
+        pj_caching_pool_destroy(&poolCache_);
+        throw std::runtime_error("Can't create ICE reactor shard");
+    }
+
+    thread_ = std::thread([this]{ loop(); });
+    RING_DBG("[reactor:%u] started", index_);
+}
+
+IceReactor::Shard::~Shard()
+{
+    {
+        std::lock_guard<std::mutex> lk(syncMutex_);
+        stop_ = true;
+    }
+    thread_.join();
+
+    RING_DBG("[reactor:%u] stopped after %llu events", index_,
+             static_cast<unsigned long long>(events_.load()));
+
+    pj_ioqueue_destroy(ioqueue_);
+    pj_timer_heap_destroy(timerHeap_);
+    pj_pool_release(pool_);
+    pj_caching_pool_destroy(&poolCache_);
+}
+
+void
+IceReactor::Shard::loop()
+{
+    sip_utils::register_thread();
+
+    auto second = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    uint64_t secondEvents = 0;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lk(syncMutex_);
+            if (stop_)
+                break;
+        }
+
+        pj_time_val timeout {0, 0};
+        pj_timer_heap_poll(timerHeap_, &timeout);
+        if (PJ_TIME_VAL_MSEC(timeout) > MAX_POLL_MSEC or PJ_TIME_VAL_MSEC(timeout) < 0)
+            timeout = {0, MAX_POLL_MSEC};
+
+        const auto n = pj_ioqueue_poll(ioqueue_, &timeout);
+        if (n > 0) {
+            events_ += n;
+        } else if (n < 0) {
+            // Kept as debug as some errors are "normal" in regular context
+            const auto err = pj_get_os_error();
+            RING_DBG("[reactor:%u] ioqueue error %d: %s", index_, err,
+                     sip_utils::sip_strerror(err).c_str());
+            std::this_thread::sleep_for(std::chrono::milliseconds(PJ_TIME_VAL_MSEC(timeout)));
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= second) {
+            const auto events = events_.load();
+            eventsPerSecond_ = events - secondEvents;
+            secondEvents = events;
+            second = now + std::chrono::seconds(1);
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(syncMutex_);
+            ++iterations_;
+        }
+        syncCv_.notify_all();
+    }
+}
+
+// callbacks running now are done when the current iteration is
+void
+IceReactor::Shard::sync()
+{
+    if (isShardThread())
+        return;
+    std::unique_lock<std::mutex> lk(syncMutex_);
+    const auto iteration = iterations_;
+    syncCv_.wait(lk, [&]{ return iterations_ > iteration or stop_; });
+}
+
+IceReactorStats
+IceReactor::Shard::getStats() const
+{
+    IceReactorStats stats;
+    stats.transports = transports_;
+    stats.handles = handles_;
+    stats.events = events_;
+    stats.eventsPerSecond = eventsPerSecond_;
+    return stats;
+}
+
+//==============================================================================
+
+IceReactor::Lease::Lease(std::shared_ptr<Shard> shard, unsigned handles)
+    : shard_(std::move(shard))
+    , handles_(handles)
+{}
+
+IceReactor::Lease&
+IceReactor::Lease::operator=(Lease&& o)
+{
+    if (this != &o) {
+        release();
+        shard_ = std::move(o.shard_);
+        handles_ = o.handles_;
+    }
+    return *this;
+}
+
+IceReactor::Lease::~Lease()
+{
+    release();
+}
+
+void
+IceReactor::Lease::release()
+{
+    if (not shard_)
+        return;
+
+    auto& reactor = IceReactor::instance();
+    {
+        std::lock_guard<std::mutex> lk(reactor.mutex_);
+        --shard_->transports_;
+        shard_->handles_ -= handles_;
+    }
+
+    // a transport may be released by a callback, if it was the last one of
+    // the shard its thread can't join itself
+    if (shard_->isShardThread())
+        ThreadPool::instance().run([shard = std::move(shard_)]{});
+    shard_.reset();
+}
+
+pj_ioqueue_t*
+IceReactor::Lease::ioqueue() const
+{
+    return shard_ ? shard_->ioqueue_ : nullptr;
+}
+
+pj_timer_heap_t*
+IceReactor::Lease::timerHeap() const
+{
+    return shard_ ? shard_->timerHeap_ : nullptr;
+}
+
+pj_pool_factory*
+IceReactor::Lease::poolFactory() const
+{
+    return shard_ ? &shard_->poolCache_.factory : nullptr;
+}
+
+void
+IceReactor::Lease::sync() const
+{
+    if (shard_)
+        shard_->sync();
+}
+
+//==============================================================================
+
+IceReactor&
+IceReactor::instance()
+{
+    static IceReactor reactor;
+    return reactor;
+}
+
+IceReactor::IceReactor()
+    : maxShards_(std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_SHARDS)))
+{}
+
+IceReactor::Lease
+IceReactor::acquire(unsigned handles)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    std::vector<std::shared_ptr<Shard>> shards;
+    for (const auto& s : shards_)
+        if (auto shard = s.lock())
+            shards.emplace_back(std::move(shard));
+
+    // with free cores use a new shard, then the least loaded one with room
+    std::shared_ptr<Shard> shard;
+    if (shards.size() >= maxShards_) {
+        for (const auto& s : shards) {
+            if (s->handles_ + handles > SHARD_HANDLES)
+                continue;
+            if (not shard or s->transports_ < shard->transports_)
+                shard = s;
+        }
+    }
+
+    if (not shard) {
+        unsigned index = 0;
+        while (index < shards_.size() and not shards_[index].expired())
+            ++index;
+        shard = std::make_shared<Shard>(index);
+        if (index < shards_.size())
+            shards_[index] = shard;
+        else
+            shards_.emplace_back(shard);
+        if (index >= maxShards_)
+            RING_WARN("[reactor:%u] all the shards are full", index);
+    }
+
+    ++shard->transports_;
+    shard->handles_ += handles;
+    const auto stats = shard->getStats();
+    RING_DBG("[reactor:%u] %u transports, %u handles, %u events/s", shard->index(),
+             stats.transports, stats.handles, stats.eventsPerSecond);
+    return Lease(std::move(shard), handles);
+}
+
+std::vector<IceReactorStats>
+IceReactor::getStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    std::vector<IceReactorStats> stats;
+    for (const auto& s : shards_)
+        if (auto shard = s.lock())
+            stats.emplace_back(shard->getStats());
+    return stats;
+}
+
+} // namespace ring
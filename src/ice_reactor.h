@@ -0,0 +1,98 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <pj/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ring {
+
+struct IceReactorStats {
+    unsigned transports {0};
+    unsigned handles {0};           // sockets reserved by the transports
+    uint64_t events {0};            // I/O events handled
+    unsigned eventsPerSecond {0};   // during the last second
+};
+
+/**
+ * Threads polling the sockets and timers of the ICE and TURN transports.
+ *
+ * Each shard is a pj_ioqueue (epoll when pjlib is built with it), a timer
+ * heap and a thread. A transport registers with the least loaded shard for
+ * its whole life. There is one shard per core, more only when their ioqueues
+ * are full. An ioqueue holds PJ_IOQUEUE_MAX_HANDLES sockets: with the 1024
+ * of the contrib build, a shard serves tens of calls; with the pjlib default
+ * of 64, only a few, and the thread count follows the number of calls again.
+ * Shards are created on demand and stopped with their last transport.
+ */
+class IceReactor {
+public:
+    class Shard;
+
+    // Registration of a transport with a shard, released on destruction
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&&) = default;
+        Lease& operator=(Lease&&);
+        ~Lease();
+
+        pj_ioqueue_t* ioqueue() const;
+        pj_timer_heap_t* timerHeap() const;
+        pj_pool_factory* poolFactory() const;
+
+        /**
+         * Wait for the events being handled by the shard to be done.
+         * To call once the transport sockets are unregistered and before
+         * freeing what the callbacks use.
+         */
+        void sync() const;
+
+    private:
+        friend class IceReactor;
+        Lease(std::shared_ptr<Shard> shard, unsigned handles);
+        void release();
+
+        std::shared_ptr<Shard> shard_;
+        unsigned handles_ {0};
+    };
+
+    static IceReactor& instance();
+
+    // handles: sockets the transport will register with the ioqueue
+    Lease acquire(unsigned handles);
+
+    std::vector<IceReactorStats> getStats() const;
+
+private:
+    IceReactor();
+    NON_COPYABLE(IceReactor);
+
+    const unsigned maxShards_;
+    mutable std::mutex mutex_;
+    std::vector<std::weak_ptr<Shard>> shards_;
+};
+
+} // namespace ring
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "generic_io.h"
+#include "packet_buffer.h"
 
 #include <memory>
 #include <functional>
@@ -33,6 +34,7 @@ namespace ring {
 
 class IceTransport;
 using IceRecvCb = std::function<ssize_t(unsigned char* buf, size_t len)>;
+using IceRecvPacketCb = std::function<void(PacketBuffer&& packet)>;
 
 class IceSocket
 {
@@ -49,6 +51,7 @@ class IceSocket
         ssize_t send(const unsigned char* buf, size_t len);
         ssize_t waitForData(unsigned int timeout);
         void setOnRecv(IceRecvCb cb);
+        void setOnRecvPacket(IceRecvPacketCb cb);
         uint16_t getTransportOverhead();
 };
 
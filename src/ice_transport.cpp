@@ -20,6 +20,8 @@
 
 #include "ice_transport.h"
 #include "ice_socket.h"
+#include "ice_reactor.h"
+#include "spsc_queue.h"
 #include "logger.h"
 #include "sip/sip_utils.h"
 #include "manager.h"
@@ -30,7 +32,6 @@
 
 #include <map>
 #include <atomic>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -42,11 +43,6 @@
 #include <thread>
 #include <cerrno>
 
-#define TRY(ret) do {                                        \
-        if ((ret) != PJ_SUCCESS)                             \
-            throw std::runtime_error(#ret " failed");        \
-    } while (0)
-
 namespace ring {
 
 static constexpr unsigned STUN_MAX_PACKET_SIZE {8192};
@@ -124,24 +120,25 @@ public:
     pj_ice_strans_cfg config_;
     std::string last_errmsg_;
 
-    struct Packet {
-        Packet(void *pkt, pj_size_t size)
-            : data {std::make_unique<char[]>(size)}, datalen {size} {
-            std::copy_n(reinterpret_cast<char*>(pkt), size, data.get());
-        }
-        std::unique_ptr<char[]> data;
-        size_t datalen;
-    };
-
+    // Datagrams received by a component. The reactor thread is the only
+    // producer, the queue is consumed by recv() or, when a callback is set,
+    // under the mutex.
     struct ComponentIO {
         std::mutex mutex;
         std::condition_variable cv;
-        std::deque<Packet> queue;
+        SpscQueue<PacketBuffer, 1024> queue;
         IceRecvCb cb;
+        IceRecvPacketCb packetCb;
+        std::atomic_bool hasCallback {false};
+        std::atomic<unsigned> waiters {0};  // in waitForData()
+        unsigned dropped {0};
     };
 
     std::vector<ComponentIO> compIO_;
 
+    // io.mutex must be locked
+    void flushQueue(ComponentIO& io);
+
     std::atomic_bool initiatorSession_ {true};
 
     /**
@@ -164,10 +161,8 @@ public:
 
     bool onlyIPv4Private_ {true};
 
-    // IO/Timer events are handled by following thread
-    std::thread thread_;
-    std::atomic_bool threadTerminateFlags_ {false};
-    void handleEvents(unsigned max_msec);
+    // IO/Timer events are handled by a shared thread
+    IceReactor::Lease reactor_;
 };
 
 //==============================================================================
@@ -257,7 +252,6 @@ IceTransport::Impl::Impl(const char* name, int component_count, bool master,
     , component_count_(component_count)
     , compIO_(component_count)
     , initiatorSession_(master)
-    , thread_()
 {
     if (options.upnpEnable)
         upnp_.reset(new upnp::Controller());
@@ -298,9 +292,10 @@ IceTransport::Impl::Impl(const char* name, int component_count, bool master,
     for (auto& server : options.turnServers)
         add_turn_server(*pool_, config_, server);
 
-    static constexpr auto IOQUEUE_MAX_HANDLES = std::min(PJ_IOQUEUE_MAX_HANDLES, 64);
-    TRY( pj_timer_heap_create(pool_.get(), 100, &config_.stun_cfg.timer_heap) );
-    TRY( pj_ioqueue_create(pool_.get(), IOQUEUE_MAX_HANDLES, &config_.stun_cfg.ioqueue) );
+    // a socket per STUN and TURN configuration in each component
+    reactor_ = IceReactor::instance().acquire(component_count * (config_.stun_tp_cnt + config_.turn_tp_cnt));
+    config_.stun_cfg.ioqueue = reactor_.ioqueue();
+    config_.stun_cfg.timer_heap = reactor_.timerHeap();
 
     pj_ice_strans* icest = nullptr;
     pj_status_t status = pj_ice_strans_create(name, &config_, component_count,
@@ -309,31 +304,16 @@ IceTransport::Impl::Impl(const char* name, int component_count, bool master,
     if (status != PJ_SUCCESS || icest == nullptr) {
         throw std::runtime_error("pj_ice_strans_create() failed");
     }
-
-    // Must be created after any potential failure
-    thread_ = std::thread([this]{
-            sip_utils::register_thread();
-            while (not threadTerminateFlags_) {
-                handleEvents(500); // limit polling to 500ms
-            }
-        });
 }
 
 IceTransport::Impl::~Impl()
 {
     sip_utils::register_thread();
 
-    threadTerminateFlags_ = true;
-    if (thread_.joinable())
-        thread_.join();
+    icest_.reset(); // must be done before releasing the reactor
 
-    icest_.reset(); // must be done before ioqueue/timer destruction
-
-    if (config_.stun_cfg.ioqueue)
-        pj_ioqueue_destroy(config_.stun_cfg.ioqueue);
-
-    if (config_.stun_cfg.timer_heap)
-        pj_timer_heap_destroy(config_.stun_cfg.timer_heap);
+    // callbacks may still be running on the reactor thread
+    reactor_.sync();
 }
 
 bool
@@ -374,49 +354,6 @@ IceTransport::Impl::_isFailed() const
     return false;
 }
 
-void
-IceTransport::Impl::handleEvents(unsigned max_msec)
-{
-    // By tests, never seen more than two events per 500ms
-    static constexpr auto MAX_NET_EVENTS = 2;
-
-    pj_time_val max_timeout = {0, 0};
-    pj_time_val timeout = {0, 0};
-    unsigned net_event_count = 0;
-
-    max_timeout.msec = max_msec;
-
-    timeout.sec = timeout.msec = 0;
-    pj_timer_heap_poll(config_.stun_cfg.timer_heap, &timeout);
-
-    // timeout limitation
-    if (timeout.msec >= 1000)
-        timeout.msec = 999;
-    if (PJ_TIME_VAL_GT(timeout, max_timeout))
-        timeout = max_timeout;
-
-    do {
-        auto n_events = pj_ioqueue_poll(config_.stun_cfg.ioqueue, &timeout);
-
-        // timeout
-        if (not n_events)
-            return;
-
-        // error
-        if (n_events < 0) {
-            const auto err = pj_get_os_error();
-            // Kept as debug as some errors are "normal" in regular context
-            last_errmsg_ = sip_utils::sip_strerror(err);
-            RING_DBG("[ice:%p] ioqueue error %d: %s", this, err, last_errmsg_.c_str());
-            std::this_thread::sleep_for(std::chrono::milliseconds(PJ_TIME_VAL_MSEC(timeout)));
-            return;
-        }
-
-        net_event_count += n_events;
-        timeout.sec = timeout.msec = 0;
-    } while (net_event_count < MAX_NET_EVENTS);
-}
-
 void
 IceTransport::Impl::onComplete(pj_ice_strans* ice_st, pj_ice_strans_op op, pj_status_t status)
 {
@@ -723,12 +660,32 @@ IceTransport::Impl::onReceiveData(unsigned comp_id, void *pkt, pj_size_t size)
     if (!size)
         return;
     auto& io = compIO_[comp_id-1];
-    std::lock_guard<std::mutex> lk(io.mutex);
-    if (io.cb) {
-        io.cb((uint8_t*)pkt, size);
-    } else {
-        io.queue.emplace_back(pkt, size);
-        io.cv.notify_one();
+
+    // the only copy of the datagram, pjnath reuses its buffer
+    auto packet = PacketBuffer::copyOf(pkt, size);
+    if (not io.queue.push(std::move(packet)) and io.dropped++ % 100 == 0)
+        RING_WARN("[ice:%p] rx: component %u queue full, %u packets dropped", this, comp_id, io.dropped);
+
+    // pairs with the fences of setOnRecv() and waitForData()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (io.hasCallback) {
+        std::lock_guard<std::mutex> lk(io.mutex);
+        flushQueue(io);
+    } else if (io.waiters) {
+        std::lock_guard<std::mutex> lk(io.mutex);
+        io.cv.notify_all();
+    }
+}
+
+void
+IceTransport::Impl::flushQueue(ComponentIO& io)
+{
+    PacketBuffer packet;
+    while (io.queue.pop(packet)) {
+        if (io.packetCb)
+            io.packetCb(std::move(packet));
+        else if (io.cb)
+            io.cb(packet.data(), packet.size());
     }
 }
 
@@ -1033,19 +990,15 @@ IceTransport::getCandidateFromSDP(const std::string& line, IceCandidate& cand)
 ssize_t
 IceTransport::recv(int comp_id, unsigned char* buf, size_t len)
 {
-    sip_utils::register_thread();
-    auto& io = pimpl_->compIO_[comp_id];
-    std::lock_guard<std::mutex> lk(io.mutex);
-
-    if (io.queue.empty())
-        return 0;
-
-    auto& packet = io.queue.front();
-    const auto count = std::min(len, packet.datalen);
-    std::copy_n(packet.data.get(), count, buf);
-    io.queue.pop_front();
+    return recvPacket(comp_id).copyTo(buf, len);
+}
 
-    return count;
+PacketBuffer
+IceTransport::recvPacket(int comp_id)
+{
+    PacketBuffer packet;
+    pimpl_->compIO_[comp_id].queue.pop(packet);
+    return packet;
 }
 
 void
@@ -1053,14 +1006,28 @@ IceTransport::setOnRecv(unsigned comp_id, IceRecvCb cb)
 {
     auto& io = pimpl_->compIO_[comp_id];
     std::lock_guard<std::mutex> lk(io.mutex);
-    io.cb = cb;
+    io.cb = std::move(cb);
+    io.packetCb = nullptr;
+    io.hasCallback = bool(io.cb);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Flush existing queue using the callback
+    if (io.hasCallback)
+        pimpl_->flushQueue(io);
+}
 
-    if (cb) {
-        // Flush existing queue using the callback
-        for (const auto& packet : io.queue)
-            io.cb((uint8_t*)packet.data.get(), packet.datalen);
-        io.queue.clear();
-    }
+void
+IceTransport::setOnRecvPacket(unsigned comp_id, IceRecvPacketCb cb)
+{
+    auto& io = pimpl_->compIO_[comp_id];
+    std::lock_guard<std::mutex> lk(io.mutex);
+    io.cb = nullptr;
+    io.packetCb = std::move(cb);
+    io.hasCallback = bool(io.packetCb);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (io.hasCallback)
+        pimpl_->flushQueue(io);
 }
 
 ssize_t
@@ -1118,13 +1085,16 @@ IceTransport::waitForData(int comp_id, unsigned int timeout, std::error_code& ec
     (void)ec; ///< \todo handle errors
     auto& io = pimpl_->compIO_[comp_id];
     std::unique_lock<std::mutex> lk(io.mutex);
-    if (!io.cv.wait_for(lk, std::chrono::milliseconds(timeout),
-                        [this, &io]{ return !io.queue.empty() or !isRunning(); })) {
+    ++io.waiters;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool ready = io.cv.wait_for(lk, std::chrono::milliseconds(timeout),
+                                      [this, &io]{ return !io.queue.empty() or !isRunning(); });
+    --io.waiters;
+    if (!ready)
         return 0;
-    }
     if (!isRunning())
         return -1; // acknowledged as an error
-    return io.queue.front().datalen;
+    return io.queue.front()->size();
 }
 
 //==============================================================================
@@ -1281,6 +1251,14 @@ IceSocket::setOnRecv(IceRecvCb cb)
     return ice_transport_->setOnRecv(compId_, cb);
 }
 
+void
+IceSocket::setOnRecvPacket(IceRecvPacketCb cb)
+{
+    if (!ice_transport_.get())
+        return;
+    return ice_transport_->setOnRecvPacket(compId_, std::move(cb));
+}
+
 uint16_t
 IceSocket::getTransportOverhead(){
     return (ice_transport_->getRemoteAddress(compId_).getFamily() == AF_INET) ? IPV4_HEADER_SIZE : IPV6_HEADER_SIZE;
@@ -160,8 +160,17 @@ public:
 
     void setOnRecv(unsigned comp_id, IceRecvCb cb);
 
+    /**
+     * Like setOnRecv, the received datagrams are given by reference
+     * instead of copied.
+     */
+    void setOnRecvPacket(unsigned comp_id, IceRecvPacketCb cb);
+
     ssize_t recv(int comp_id, unsigned char* buf, size_t len);
 
+    // Next received datagram, empty if none
+    PacketBuffer recvPacket(int comp_id);
+
     ssize_t send(int comp_id, const unsigned char* buf, size_t len);
 
     int waitForInitialization(unsigned timeout);
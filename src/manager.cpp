@@ -61,12 +61,17 @@ using random_device = dht::crypto::random_device;
 #include "audio/sound/tonelist.h"
 #include "audio/sound/dtmf.h"
 #include "audio/ringbufferpool.h"
+#include "audio/recording_service.h"
 
 #ifdef RING_VIDEO
 #include "client/videomanager.h"
 #include "video/video_scaler.h"
 #endif
 
+#ifdef RING_ACCEL
+#include "video/accel.h"
+#endif
+
 #include "conference.h"
 #include "ice_transport.h"
 
@@ -247,6 +252,11 @@ struct Manager::ManagerPimpl
 
     int getCurrentDeviceIndex(DeviceType type);
 
+    /**
+     * Replace the audio layer, audioLayerMutex_ must be held.
+     */
+    void resetAudioLayer(AudioLayer* layer);
+
     /**
      * Process remaining participant given a conference and the current call id.
      * Mainly called when a participant is detached or hagned up
@@ -339,6 +349,11 @@ struct Manager::ManagerPimpl
      */
     std::string path_;
 
+    /**
+     * Writes all recordings. Outlives the RingBufferPool and conferences.
+     */
+    std::unique_ptr<RecordingService> recordingService_;
+
     /**
      * Instance of the RingBufferPool for the whole application
      *
@@ -384,6 +399,7 @@ Manager::ManagerPimpl::ManagerPimpl(Manager& base)
     , waitingCalls_()
     , waitingCallsMutex_()
     , path_()
+    , recordingService_(new RecordingService)
     , ringbufferpool_(new RingBufferPool)
     , conferenceMap_()
     , ice_tf_()
@@ -445,6 +461,15 @@ Manager::ManagerPimpl::playATone(Tone::TONEID toneId)
     toneCtrl_.play(toneId);
 }
 
+void
+Manager::ManagerPimpl::resetAudioLayer(AudioLayer* layer)
+{
+    // the tone control must never see a destroyed layer
+    toneCtrl_.setAudioLayer(nullptr);
+    audiodriver_.reset(layer);
+    toneCtrl_.setAudioLayer(audiodriver_.get());
+}
+
 int
 Manager::ManagerPimpl::getCurrentDeviceIndex(DeviceType type)
 {
@@ -750,6 +775,12 @@ Manager::init(const std::string &config_file)
         }
     }
 
+#ifdef RING_ACCEL
+    // opening each hardware encoder takes a while, be done before the first call
+    if (getEncodingAccelerated())
+        ThreadPool::instance().run([]{ video::getHardwareEncoders(); });
+#endif
+
     registerAccounts();
 }
 
@@ -784,7 +815,7 @@ Manager::finish() noexcept
         {
             std::lock_guard<std::mutex> lock(pimpl_->audioLayerMutex_);
 
-            pimpl_->audiodriver_.reset();
+            pimpl_->resetAudioLayer(nullptr);
         }
 
         pimpl_->ice_tf_.reset();
@@ -1210,7 +1241,7 @@ Manager::removeConference(const std::string& conference_id)
     // We now need to bind the audio to the remain participant
 
     // Unbind main participant audio from conference
-    getRingBufferPool().unBindAll(RingBufferPool::DEFAULT_ID);
+    conf->unbindParticipants();
 
     ParticipantSet participants(conf->getParticipantList());
 
@@ -1389,11 +1420,11 @@ Manager::addMainParticipant(const std::string& conference_id)
 
         ParticipantSet participants(conf->getParticipantList());
 
-        for (const auto &item_p : participants) {
-            getRingBufferPool().bindCallID(item_p, RingBufferPool::DEFAULT_ID);
-            // Reset ringbuffer's readpointers
+        conf->bindLocalParticipant();
+
+        // Reset ringbuffer's readpointers
+        for (const auto &item_p : participants)
             getRingBufferPool().flush(item_p);
-        }
 
         getRingBufferPool().flush(RingBufferPool::DEFAULT_ID);
 
@@ -1523,9 +1554,9 @@ Manager::detachLocalParticipant()
         return false;
     }
 
-    getRingBufferPool().unBindAll(RingBufferPool::DEFAULT_ID);
-
     auto conf = iter->second;
+    conf->unbindLocalParticipant();
+
     switch (conf->getState()) {
         case Conference::ACTIVE_ATTACHED:
             conf->setState(Conference::ACTIVE_DETACHED);
@@ -1862,7 +1893,7 @@ Manager::playDtmf(char code)
     pimpl_->dtmfKey_->startTone(code);
 
     // copy the sound
-    if (pimpl_->dtmfKey_->generateDTMF(*pimpl_->dtmfBuf_.getChannel(0))) {
+    if (pimpl_->dtmfKey_->generateDTMF(pimpl_->dtmfBuf_.getChannel(0), pimpl_->dtmfBuf_.frames())) {
         // Put buffer to urgentRingBuffer
         // put the size in bytes...
         // so size * 1 channel (mono) * sizeof (bytes for the data)
@@ -2210,7 +2241,7 @@ Manager::playRingtone(const std::string& accountID)
         ringback();
 }
 
-AudioLoop*
+std::shared_ptr<AudioLoop>
 Manager::getTelephoneTone()
 {
     return pimpl_->toneCtrl_.getTelephoneTone();
@@ -2235,7 +2266,7 @@ Manager::setAudioPlugin(const std::string& audioPlugin)
     bool wasStarted = pimpl_->audiodriver_->isStarted();
 
     // Recreate audio driver with new settings
-    pimpl_->audiodriver_.reset(audioPreference.createAudioLayer());
+    pimpl_->resetAudioLayer(audioPreference.createAudioLayer());
 
     if (pimpl_->audiodriver_ and wasStarted)
         pimpl_->audiodriver_->startStream();
@@ -2264,7 +2295,7 @@ Manager::setAudioDevice(int index, DeviceType type)
     pimpl_->audiodriver_->updatePreference(audioPreference, index, type);
 
     // Recreate audio driver with new settings
-    pimpl_->audiodriver_.reset(audioPreference.createAudioLayer());
+    pimpl_->resetAudioLayer(audioPreference.createAudioLayer());
 
     if (pimpl_->audiodriver_ and wasStarted)
         pimpl_->audiodriver_->startStream();
@@ -2486,7 +2517,7 @@ Manager::setAudioManager(const std::string &api)
 
         bool wasStarted = pimpl_->audiodriver_->isStarted();
         audioPreference.setAudioApi(api);
-        pimpl_->audiodriver_.reset(audioPreference.createAudioLayer());
+        pimpl_->resetAudioLayer(audioPreference.createAudioLayer());
 
         if (pimpl_->audiodriver_ and wasStarted)
             pimpl_->audiodriver_->startStream();
@@ -2560,6 +2591,18 @@ Manager::setAGCState(bool state)
     audioPreference.setAGCState(state);
 }
 
+bool
+Manager::isEchoCancelEnabled() const
+{
+    return audioPreference.getEchoCancel();
+}
+
+void
+Manager::setEchoCancelState(bool state)
+{
+    audioPreference.setEchoCancel(state);
+}
+
 /**
  * Initialization: Main Thread
  */
@@ -2567,7 +2610,7 @@ void
 Manager::initAudioDriver()
 {
     std::lock_guard<std::mutex> lock(pimpl_->audioLayerMutex_);
-    pimpl_->audiodriver_.reset(audioPreference.createAudioLayer());
+    pimpl_->resetAudioLayer(audioPreference.createAudioLayer());
 }
 
 AudioFormat
@@ -3121,6 +3164,25 @@ Manager::setDecodingAccelerated(bool isAccelerated)
     saveConfig();
 #endif
 }
+
+bool
+Manager::getEncodingAccelerated() const
+{
+#ifdef RING_ACCEL
+    return videoPreferences.getEncodingAccelerated();
+#else
+    return false;
+#endif
+}
+
+void
+Manager::setEncodingAccelerated(bool isAccelerated)
+{
+#ifdef RING_ACCEL
+    videoPreferences.setEncodingAccelerated(isAccelerated);
+    saveConfig();
+#endif
+}
 #endif // RING_VIDEO
 
 RingBufferPool&
@@ -3129,6 +3191,12 @@ Manager::getRingBufferPool()
     return *pimpl_->ringbufferpool_;
 }
 
+RecordingService&
+Manager::getRecordingService()
+{
+    return *pimpl_->recordingService_;
+}
+
 bool
 Manager::hasAccount(const std::string& accountID)
 {
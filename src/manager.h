@@ -48,6 +48,7 @@ namespace video {
 class SinkClient;
 }
 class RingBufferPool;
+class RecordingService;
 class VideoManager;
 class Conference;
 class AudioLoop;
@@ -551,6 +552,13 @@ class Manager {
         bool isAGCEnabled() const;
         void setAGCState(bool enabled);
 
+        /**
+         * Echo cancellation of the captured audio, applied from the next
+         * audio layer restart.
+         */
+        bool isEchoCancelEnabled() const;
+        void setEchoCancelState(bool enabled);
+
         bool switchInput(const std::string& callid, const std::string& res);
 
         /**
@@ -678,9 +686,9 @@ class Manager {
 
         /**
          * Retrieve the current telephone tone
-         * @return AudioLoop*   The audio tone or 0 if no tone (init before calling this function)
+         * @return The audio tone or nullptr if no tone (init before calling this function)
          */
-        AudioLoop* getTelephoneTone();
+        std::shared_ptr<AudioLoop> getTelephoneTone();
 
         /**
          * Retrieve the current telephone file
@@ -743,6 +751,11 @@ class Manager {
          */
         RingBufferPool& getRingBufferPool();
 
+        /**
+         * Return the recording service shared by all calls and conferences
+         */
+        RecordingService& getRecordingService();
+
         /**
          * Tell if there is a current call processed
          * @return bool True if there is a current call
@@ -886,6 +899,10 @@ class Manager {
         bool getDecodingAccelerated() const;
 
         void setDecodingAccelerated(bool isAccelerated);
+
+        bool getEncodingAccelerated() const;
+
+        void setEncodingAccelerated(bool isAccelerated);
 #endif // RING_VIDEO
 
         std::atomic<unsigned> dhtLogLevel {0}; // default = disable
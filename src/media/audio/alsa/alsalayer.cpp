@@ -719,11 +719,11 @@ void AlsaLayer::capture()
         int outFrames = toGetFrames * (static_cast<double>(audioFormat_.sample_rate) / mainBufferFormat.sample_rate);
         AudioBuffer rsmpl_in(outFrames, mainBufferFormat);
         resampler_->resample(captureBuff_, rsmpl_in);
-        dcblocker_.process(rsmpl_in);
-        mainRingBuffer_->put(rsmpl_in);
+        const bool voice = processCapture(rsmpl_in);
+        mainRingBuffer_->put(rsmpl_in, voice);
     } else {
-        dcblocker_.process(captureBuff_);
-        mainRingBuffer_->put(captureBuff_);
+        const bool voice = processCapture(captureBuff_);
+        mainRingBuffer_->put(captureBuff_, voice);
     }
 }
 
@@ -0,0 +1,221 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "audio_mixer.h"
+#include "audio_simd.h"
+#include "ringbuffer.h"
+#include "ringbufferpool.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ring {
+
+static constexpr auto TICK_DURATION = std::chrono::milliseconds(20);
+static constexpr unsigned TICKS_PER_SECOND = 1000 / 20;
+
+// A source with more than this many ticks buffered is resynchronized,
+// as its clock drifts from ours.
+static constexpr size_t MAX_BUFFERED_TICKS = 3;
+
+struct AudioMixer::Source {
+    std::string id;
+    std::shared_ptr<RingBuffer> input;
+    std::shared_ptr<RingBuffer> output;
+    AudioBuffer frame;
+    bool voice {false};
+};
+
+AudioMixer::AudioMixer(const std::string& id, RingBufferPool& pool)
+    : id_(id)
+    , pool_(pool)
+    , nextTick_(std::chrono::steady_clock::now())
+    , loop_([]{ return true; },
+            std::bind(&AudioMixer::process, this),
+            []{})
+{
+    loop_.start();
+}
+
+AudioMixer::~AudioMixer()
+{
+    loop_.join();
+    removeAllSources();
+}
+
+std::string
+AudioMixer::outputId(const std::string& call_id) const
+{
+    return id_ + "/" + call_id;
+}
+
+void
+AudioMixer::addSource(const std::string& call_id)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    const auto it = std::find_if(sources_.cbegin(), sources_.cend(),
+                                 [&](const Source& s){ return s.id == call_id; });
+    if (it != sources_.cend()) {
+        // reader may have been unbound meanwhile (i.e. call on hold)
+        pool_.bindHalfDuplexOut(call_id, it->output->id);
+        return;
+    }
+
+    auto input = pool_.getRingBuffer(call_id);
+    if (not input) {
+        RING_ERR("[mixer:%s] No ringbuffer associated to call '%s'",
+                 id_.c_str(), call_id.c_str());
+        return;
+    }
+
+    Source src;
+    src.id = call_id;
+    src.input = std::move(input);
+    src.output = pool_.createRingBuffer(outputId(call_id));
+    src.input->createReadOffset(id_);
+    pool_.bindHalfDuplexOut(call_id, src.output->id);
+    sources_.emplace_back(std::move(src));
+
+    RING_DBG("[mixer:%s] Add source '%s' (%zu sources)",
+             id_.c_str(), call_id.c_str(), sources_.size());
+}
+
+void
+AudioMixer::removeSourceLocked(std::list<Source>::iterator it)
+{
+    pool_.unBindHalfDuplexOut(it->id, it->output->id);
+    it->input->removeReadOffset(id_);
+    RING_DBG("[mixer:%s] Remove source '%s'", id_.c_str(), it->id.c_str());
+    sources_.erase(it);
+}
+
+void
+AudioMixer::removeSource(const std::string& call_id)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    const auto it = std::find_if(sources_.begin(), sources_.end(),
+                                 [&](const Source& s){ return s.id == call_id; });
+    if (it != sources_.end())
+        removeSourceLocked(it);
+}
+
+void
+AudioMixer::removeAllSources()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    while (not sources_.empty())
+        removeSourceLocked(sources_.begin());
+}
+
+bool
+AudioMixer::hasSource(const std::string& call_id) const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    return std::any_of(sources_.cbegin(), sources_.cend(),
+                       [&](const Source& s){ return s.id == call_id; });
+}
+
+size_t
+AudioMixer::sourceCount() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return sources_.size();
+}
+
+void
+AudioMixer::process()
+{
+    std::this_thread::sleep_until(nextTick_);
+    const auto now = std::chrono::steady_clock::now();
+    nextTick_ += TICK_DURATION;
+    if (nextTick_ < now) // we were late, don't try to catch up
+        nextTick_ = now + TICK_DURATION;
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (sources_.empty())
+        return;
+
+    const auto format = pool_.getInternalAudioFormat();
+    const size_t frames = format.sample_rate / TICKS_PER_SECOND;
+    const unsigned channels = std::max(1U, format.nb_channels);
+    const auto& kernels = audioKernels();
+
+    bus_.resize(channels);
+    for (auto& chan : bus_)
+        chan.assign(frames, 0);
+
+    // Read every source once and sum it in the bus.
+    // Silent sources are consumed but not mixed.
+    unsigned voices = 0;
+    for (auto& src : sources_) {
+        const size_t avail = src.input->availableForGet(id_);
+        if (avail > MAX_BUFFERED_TICKS * frames)
+            src.input->discard(avail - frames, id_);
+
+        src.voice = src.input->voiceAvailable(id_);
+        if (not src.voice) {
+            src.input->discard(frames, id_);
+            continue;
+        }
+        ++voices;
+
+        src.frame.setFormat(format);
+        src.frame.resize(frames);
+        src.frame.reset();
+        src.input->get(src.frame, id_);
+
+        for (unsigned c = 0; c < channels; ++c)
+            kernels.accumulate(bus_[c].data(), src.frame.getChannel(c), frames);
+    }
+
+    // Each source gets everything but itself.
+    // All silent sources get the same bus, computed once.
+    output_.setFormat(format);
+    output_.resize(frames);
+    silentOutput_.setFormat(format);
+    silentOutput_.resize(frames);
+    bool silentOutputReady = false;
+    for (auto& src : sources_) {
+        if (src.voice) {
+            for (unsigned c = 0; c < channels; ++c)
+                kernels.mixMinus(bus_[c].data(), src.frame.getChannel(c),
+                                 output_.getChannel(c), frames);
+            src.output->put(output_, voices > 1);
+        } else {
+            if (not silentOutputReady) {
+                if (voices) {
+                    zero_.assign(frames, 0);
+                    for (unsigned c = 0; c < channels; ++c)
+                        kernels.mixMinus(bus_[c].data(), zero_.data(),
+                                         silentOutput_.getChannel(c), frames);
+                } else {
+                    silentOutput_.reset();
+                }
+                silentOutputReady = true;
+            }
+            src.output->put(silentOutput_, voices > 0);
+        }
+    }
+}
+
+} // namespace ring
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "audiobuffer.h"
+#include "noncopyable.h"
+#include "threadloop.h"
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ring {
+
+class RingBuffer;
+class RingBufferPool;
+
+/**
+ * Conference audio mixing engine.
+ *
+ * Every 20ms tick, each source ring buffer is read once and summed into a
+ * shared bus. The output of each source (what its owner hears) is the bus
+ * minus its own contribution, written in a dedicated ring buffer the owner
+ * is bound to. Cost is O(N) per tick instead of the O(N²) of binding every
+ * pair of participants in the RingBufferPool.
+ *
+ * Sources with no voice to read (see RingBuffer::voiceAvailable()) are
+ * skipped, and all get the same output.
+ *
+ * Sources are identified by their ring buffer ID (call ID, or
+ * RingBufferPool::DEFAULT_ID for the local participant).
+ */
+class AudioMixer {
+    public:
+        AudioMixer(const std::string& id, RingBufferPool& pool);
+        ~AudioMixer();
+
+        /**
+         * Mix audio from call_id ringbuffer and bind call_id reader
+         * to its own mixed output.
+         */
+        void addSource(const std::string& call_id);
+
+        /**
+         * Stop mixing call_id and release its output.
+         */
+        void removeSource(const std::string& call_id);
+
+        void removeAllSources();
+
+        bool hasSource(const std::string& call_id) const;
+
+        size_t sourceCount() const;
+
+    private:
+        NON_COPYABLE(AudioMixer);
+
+        struct Source;
+
+        std::string outputId(const std::string& call_id) const;
+        void removeSourceLocked(std::list<Source>::iterator it);
+        void process();
+
+        const std::string id_;
+        RingBufferPool& pool_;
+
+        mutable std::mutex mutex_ {};
+        std::list<Source> sources_;
+
+        /** Mixing bus, 32 bits to avoid overflow before saturation */
+        std::vector<std::vector<int32_t>> bus_;
+        AudioBuffer output_;
+        AudioBuffer silentOutput_;
+        std::vector<AudioSample> zero_;
+
+        std::chrono::steady_clock::time_point nextTick_;
+
+        ThreadLoop loop_; // as to be last member
+};
+
+} // namespace ring
@@ -39,12 +39,21 @@
 #include "audio/audiobuffer.h"
 #include "audio/ringbufferpool.h"
 #include "audio/resampler.h"
+#include "audio/jitter_buffer.h"
 #include "manager.h"
 #include "smartools.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
 
 namespace ring {
 
+// During silence, only one packet is sent every DTX_INTERVAL packets (400ms),
+// if the peer accepts discontinuous transmission
+static constexpr unsigned DTX_INTERVAL {20};
+
 class AudioSender {
     public:
         AudioSender(const std::string& id,
@@ -76,6 +85,8 @@ class AudioSender {
         const uint16_t seqVal_;
         bool muteState_ = false;
         uint16_t mtu_;
+        const bool dtx_;
+        unsigned silentPackets_ {0};
 
         using seconds = std::chrono::duration<double, std::ratio<1>>;
         const seconds secondsPerPacket_ {0.02}; // 20 ms
@@ -98,6 +109,10 @@ AudioSender::AudioSender(const std::string& id,
     seqVal_(seqVal),
     muteState_(muteState),
     mtu_(mtu),
+    // Opus receivers ask for it with usedtx=1 (RFC 7587 section 6.1),
+    // other codecs would need a negotiated comfort noise payload
+    dtx_(args.codec->systemCodecInfo.name == "opus"
+         and args.parameters.find("usedtx=1") != std::string::npos),
     loop_([&] { return setup(socketPair); },
           std::bind(&AudioSender::process, this),
           std::bind(&AudioSender::cleanup, this))
@@ -161,14 +176,23 @@ AudioSender::process()
     }
 
     // get data
+    const bool voice = not muteState_ and mainBuffer.voiceAvailable(id_);
     micData_.setFormat(mainBuffFormat);
     micData_.resize(samplesToGet);
     const auto samples = mainBuffer.getData(micData_, id_);
     if (samples != samplesToGet)
         return;
 
-    // down/upmix as needed
     auto accountAudioCodec = std::static_pointer_cast<AccountAudioCodecInfo>(args_.codec);
+
+    // discontinuous transmission: nothing to resample nor encode during silence
+    silentPackets_ = voice or not dtx_ ? 0 : silentPackets_ + 1;
+    if (silentPackets_ and silentPackets_ % DTX_INTERVAL != 1) {
+        audioEncoder_->skip_audio(accountAudioCodec->audioformat.sample_rate * secondsPerPacket_.count());
+        return;
+    }
+
+    // down/upmix as needed
     micData_.setChannelNum(accountAudioCodec->audioformat.nb_channels, true);
 
     if (mainBuffFormat.sample_rate != accountAudioCodec->audioformat.sample_rate) {
@@ -201,6 +225,14 @@ AudioSender::getLastSeqValue()
 }
 
 
+/**
+ * Audio receive path.
+ *
+ * The receive thread demuxes packets from the socket as soon as they come
+ * and queues them in a jitter buffer. The playout thread decodes them at
+ * their playout time, or conceals missing frames, and feeds the call
+ * ring buffer.
+ */
 class AudioReceiveThread
 {
     public:
@@ -212,16 +244,30 @@ class AudioReceiveThread
         void addIOContext(SocketPair &socketPair);
         void startLoop();
 
+        JitterBufferStats getJitterBufferStats() const;
+
     private:
         NON_COPYABLE(AudioReceiveThread);
 
         static constexpr auto SDP_FILENAME = "dummyFilename";
 
+        // longest wait of the playout thread, to notice stop requests
+        static constexpr auto PLAYOUT_MAX_WAIT = std::chrono::milliseconds(100);
+        // concealment repeats the last frame this many times, fading out, then plays silence
+        static constexpr unsigned CONCEAL_FADE_FRAMES = 3;
+        static constexpr auto STATS_LOG_PERIOD = std::chrono::seconds(30);
+
+        struct PacketDeleter {
+            void operator()(AVPacket* pkt) const { av_packet_free(&pkt); }
+        };
+        using PacketPtr = std::unique_ptr<AVPacket, PacketDeleter>;
+
         static int interruptCb(void *ctx);
         static int readFunction(void *opaque, uint8_t *buf, int buf_size);
 
         void openDecoder();
         bool decodeFrame();
+        bool setupDecoder();
 
         /*-----------------------------------------------------------------*/
         /* These variables should be used in thread (i.e. process()) only! */
@@ -240,12 +286,41 @@ class AudioReceiveThread
 
         uint16_t mtu_;
 
+        // decoder is shared by the receive (setup) and playout (decode) threads
+        std::mutex decoderMutex_;
+        std::atomic_bool decoderFailed_ {false};
+
+        mutable std::mutex jbMutex_;
+        std::condition_variable jbCv_;
+        JitterBuffer<PacketPtr> jitterBuffer_;
+
+        // media timing of the last queued packet, used to place packets
+        // without pts (receive thread only)
+        int64_t lastTs_ {AV_NOPTS_VALUE};
+        int64_t frameDurationUs_ {DTX_INTERVAL * 1000};
+
+        /*---------------------------------------------------*/
+        /* These variables should be used in playout() only! */
+        /*---------------------------------------------------*/
+        AudioBuffer concealBuff_;
+        unsigned concealed_ {0};
+        std::chrono::steady_clock::time_point lastStatsLog_ {};
+
+        void playPacket(AVPacket& packet);
+        void conceal();
+        void playout();
+
         ThreadLoop loop_;
         bool setup();
         void process();
         void cleanup();
+
+        ThreadLoop playoutLoop_;
 };
 
+constexpr std::chrono::milliseconds AudioReceiveThread::PLAYOUT_MAX_WAIT;
+constexpr std::chrono::seconds AudioReceiveThread::STATS_LOG_PERIOD;
+
 AudioReceiveThread::AudioReceiveThread(const std::string& id,
                                        const AudioFormat& format,
                                        const std::string& sdp,
@@ -259,16 +334,29 @@ AudioReceiveThread::AudioReceiveThread(const std::string& id,
     , loop_(std::bind(&AudioReceiveThread::setup, this),
             std::bind(&AudioReceiveThread::process, this),
             std::bind(&AudioReceiveThread::cleanup, this))
+    , playoutLoop_([]{ return true; },
+                   std::bind(&AudioReceiveThread::playout, this),
+                   []{})
 {}
 
 AudioReceiveThread::~AudioReceiveThread()
 {
     loop_.join();
+    playoutLoop_.stop();
+    jbCv_.notify_all();
+    playoutLoop_.join();
 }
 
 
 bool
 AudioReceiveThread::setup()
+{
+    std::lock_guard<std::mutex> lk(decoderMutex_);
+    return setupDecoder();
+}
+
+bool
+AudioReceiveThread::setupDecoder()
 {
     audioDecoder_.reset(new MediaDecoder());
     audioDecoder_->setInterruptCallback(interruptCb, this);
@@ -293,31 +381,58 @@ AudioReceiveThread::setup()
 void
 AudioReceiveThread::process()
 {
-    AudioFormat mainBuffFormat = Manager::instance().getRingBufferPool().getInternalAudioFormat();
-    AudioFrame decodedFrame;
+    if (decoderFailed_) {
+        RING_WARN("decoding failure, trying to reset decoder...");
+        std::lock_guard<std::mutex> lk(decoderMutex_);
+        decoderFailed_ = false;
+        if (not setupDecoder()) {
+            RING_ERR("fatal error, rx thread re-setup failed");
+            loop_.stop();
+            return;
+        }
+        // queued packets were timed against the old decoder
+        std::lock_guard<std::mutex> jbLock(jbMutex_);
+        jitterBuffer_.reset();
+        lastTs_ = AV_NOPTS_VALUE;
+    }
 
-    switch (audioDecoder_->decode(decodedFrame)) {
+    PacketPtr packet {av_packet_alloc()};
+    if (not packet) {
+        RING_ERR("fatal error, could not allocate packet");
+        loop_.stop();
+        return;
+    }
 
-        case MediaDecoder::Status::FrameFinished:
-            audioDecoder_->writeToRingBuffer(decodedFrame, *ringbuffer_,
-                                             mainBuffFormat);
-            // Refresh the remote audio codec in the callback SmartInfo
-            Smartools::getInstance().setRemoteAudioCodec(audioDecoder_->getDecoderName());
-            return;
+    // demuxer is only used by this thread
+    switch (audioDecoder_->readPacket(*packet)) {
 
-        case MediaDecoder::Status::DecodeError:
-            RING_WARN("decoding failure, trying to reset decoder...");
-            if (not setup()) {
-                RING_ERR("fatal error, rx thread re-setup failed");
-                loop_.stop();
-                break;
-            }
-            if (not audioDecoder_->setupFromAudioData(format_)) {
-                RING_ERR("fatal error, a-decoder setup failed");
-                loop_.stop();
-                break;
+        case MediaDecoder::Status::FrameFinished:
+        {
+            const auto arrival = std::chrono::steady_clock::now();
+            const auto timeBase = audioDecoder_->getTimeBase();
+            int64_t ts;
+            if (packet->pts != AV_NOPTS_VALUE) {
+                ts = av_rescale(packet->pts, 1000000LL * timeBase.numerator(),
+                                timeBase.denominator());
+                if (lastTs_ != AV_NOPTS_VALUE and ts > lastTs_)
+                    frameDurationUs_ = ts - lastTs_;
+            } else if (lastTs_ != AV_NOPTS_VALUE) {
+                // no media timing, follow the previous packet: arrival time
+                // carries the network jitter the buffer is meant to absorb
+                if (packet->duration > 0)
+                    frameDurationUs_ = av_rescale(packet->duration, 1000000LL * timeBase.numerator(),
+                                                  timeBase.denominator());
+                ts = lastTs_ + frameDurationUs_;
+            } else {
+                // nothing to follow yet, schedule on arrival
+                ts = std::chrono::duration_cast<std::chrono::microseconds>(arrival.time_since_epoch()).count();
             }
-            break;
+            lastTs_ = ts;
+            std::lock_guard<std::mutex> lk(jbMutex_);
+            jitterBuffer_.put(ts, std::move(packet), arrival);
+            jbCv_.notify_one();
+            return;
+        }
 
         case MediaDecoder::Status::ReadError:
             RING_ERR("fatal error, read failed");
@@ -334,10 +449,117 @@ AudioReceiveThread::process()
 void
 AudioReceiveThread::cleanup()
 {
+    std::lock_guard<std::mutex> lk(decoderMutex_);
     audioDecoder_.reset();
     demuxContext_.reset();
 }
 
+void
+AudioReceiveThread::playout()
+{
+    using clock = std::chrono::steady_clock;
+
+    PacketPtr packet;
+    JitterBuffer<PacketPtr>::Result result;
+    {
+        std::unique_lock<std::mutex> lk(jbMutex_);
+        const auto wakeup = std::min(jitterBuffer_.nextDeadline(), clock::now() + PLAYOUT_MAX_WAIT);
+        jbCv_.wait_until(lk, wakeup);
+        if (not playoutLoop_.isRunning())
+            return;
+        const auto now = clock::now();
+        result = jitterBuffer_.get(now, packet);
+
+        if (now - lastStatsLog_ > STATS_LOG_PERIOD) {
+            lastStatsLog_ = now;
+            const auto stats = jitterBuffer_.getStats();
+            RING_DBG() << "[call:" << id_ << "] jitter buffer: "
+                       << stats.received << " received, " << stats.late << " late, "
+                       << stats.concealed << " concealed, " << stats.expanded << " expanded, "
+                       << stats.compressed << " compressed, jitter " << stats.jitter.count()
+                       << "us, delay " << stats.playoutDelay.count()
+                       << "us (target " << stats.targetDelay.count() << "us)";
+        }
+    }
+
+    // decode out of the jitter buffer lock, not to delay the receive thread
+    switch (result) {
+        case JitterBuffer<PacketPtr>::Result::Play:
+        {
+            std::lock_guard<std::mutex> lk(decoderMutex_);
+            playPacket(*packet);
+            break;
+        }
+        case JitterBuffer<PacketPtr>::Result::Conceal:
+        {
+            std::lock_guard<std::mutex> lk(decoderMutex_);
+            conceal();
+            break;
+        }
+        case JitterBuffer<PacketPtr>::Result::Wait:
+        default:
+            break;
+    }
+}
+
+void
+AudioReceiveThread::playPacket(AVPacket& packet)
+{
+    if (not audioDecoder_ or decoderFailed_) {
+        av_packet_unref(&packet);
+        return;
+    }
+
+    AudioFormat mainBuffFormat = Manager::instance().getRingBufferPool().getInternalAudioFormat();
+    AudioFrame decodedFrame;
+
+    switch (audioDecoder_->decode(decodedFrame, packet)) {
+
+        case MediaDecoder::Status::FrameFinished:
+            concealBuff_ = audioDecoder_->writeToRingBuffer(decodedFrame, *ringbuffer_,
+                                                            mainBuffFormat);
+            concealed_ = 0;
+            // Refresh the remote audio codec in the callback SmartInfo
+            Smartools::getInstance().setRemoteAudioCodec(audioDecoder_->getDecoderName());
+            break;
+
+        case MediaDecoder::Status::DecodeError:
+            // decoder is reset by the receive thread
+            decoderFailed_ = true;
+            conceal();
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Codec independent concealment: repeat the last frame while fading it out
+void
+AudioReceiveThread::conceal()
+{
+    if (not ringbuffer_ or not concealBuff_.frames())
+        return;
+
+    bool voice = true;
+    if (concealed_ < CONCEAL_FADE_FRAMES) {
+        concealBuff_.applyGain(0.5);
+        ++concealed_;
+    } else {
+        // also what we get when the peer uses DTX
+        concealBuff_.reset();
+        voice = false;
+    }
+    ringbuffer_->put(concealBuff_, voice);
+}
+
+JitterBufferStats
+AudioReceiveThread::getJitterBufferStats() const
+{
+    std::lock_guard<std::mutex> lk(jbMutex_);
+    return jitterBuffer_.getStats();
+}
+
 int
 AudioReceiveThread::readFunction(void* opaque, uint8_t* buf, int buf_size)
 {
@@ -369,6 +591,7 @@ void
 AudioReceiveThread::startLoop()
 {
     loop_.start();
+    playoutLoop_.start();
 }
 
 AudioRtpSession::AudioRtpSession(const std::string& id)
@@ -499,4 +722,11 @@ AudioRtpSession::setMuted(bool isMuted)
     }
 }
 
+JitterBufferStats
+AudioRtpSession::getJitterBufferStats()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return receiveThread_ ? receiveThread_->getJitterBufferStats() : JitterBufferStats {};
+}
+
 } // namespace ring
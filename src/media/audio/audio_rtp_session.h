@@ -25,6 +25,7 @@
 #include "threadloop.h"
 #include "media/rtp_session.h"
 #include "media/audio/audiobuffer.h"
+#include "media/audio/jitter_buffer.h"
 
 #include <string>
 #include <memory>
@@ -47,6 +48,11 @@ class AudioRtpSession : public RtpSession {
         void stop() override;
         void setMuted(bool isMuted);
 
+        /**
+         * Counters of the receive jitter buffer, zeroed if not receiving.
+         */
+        JitterBufferStats getJitterBufferStats();
+
     private:
         void startSender();
         void startReceiver();
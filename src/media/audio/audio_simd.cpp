@@ -0,0 +1,558 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "audio_simd.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RING_AUDIO_SSE2 1
+#include <emmintrin.h>
+// AVX2 kernels are built with a function target attribute, no global flag needed
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RING_AUDIO_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RING_AUDIO_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ring {
+
+static constexpr float S16_TO_FLOAT = .000030517578125f; // 1/32768
+static constexpr float FLOAT_TO_S16 = 32768.f;
+
+static inline AudioSample
+saturate(int32_t v)
+{
+    return std::min<int32_t>(std::max<int32_t>(v, std::numeric_limits<AudioSample>::min()),
+                             std::numeric_limits<AudioSample>::max());
+}
+
+//
+// Scalar kernels, also used for the tail of vector loops
+//
+
+namespace scalar {
+
+static void
+mix(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = saturate(dst[i] + src[i]);
+}
+
+static void
+applyGain(AudioSample* data, size_t n, float gain)
+{
+    for (size_t i = 0; i < n; ++i)
+        data[i] = saturate(data[i] * gain);
+}
+
+static void
+toFloat(const AudioSample* in, float* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = in[i] * S16_TO_FLOAT;
+}
+
+static void
+fromFloat(const float* in, AudioSample* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = saturate(std::max(-1.f, std::min(in[i], 1.f)) * FLOAT_TO_S16);
+}
+
+static void
+interleave2(const AudioSample* left, const AudioSample* right, AudioSample* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        *out++ = left[i];
+        *out++ = right[i];
+    }
+}
+
+static void
+accumulate(int32_t* bus, const AudioSample* in, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        bus[i] += in[i];
+}
+
+static void
+mixMinus(const int32_t* bus, const AudioSample* own, AudioSample* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = saturate(bus[i] - own[i]);
+}
+
+static float
+dot(const float* a, const float* b, size_t n)
+{
+    float sum = 0.f;
+    for (size_t i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+static const AudioKernels kernels {
+    "scalar", mix, applyGain, toFloat, fromFloat, interleave2, accumulate, mixMinus, dot
+};
+
+} // namespace scalar
+
+#ifdef RING_AUDIO_SSE2
+namespace sse2 {
+
+static inline __m128i
+load(const void* p)
+{
+    return _mm_loadu_si128(static_cast<const __m128i*>(p));
+}
+
+static inline void
+store(void* p, __m128i v)
+{
+    _mm_storeu_si128(static_cast<__m128i*>(p), v);
+}
+
+// sign extend the low and high halves of 8 int16
+static inline __m128i widenLo(__m128i v) { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+static inline __m128i widenHi(__m128i v) { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+
+static void
+mix(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        store(dst + i, _mm_adds_epi16(load(dst + i), load(src + i)));
+    scalar::mix(dst + i, src + i, n - i);
+}
+
+static void
+applyGain(AudioSample* data, size_t n, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = load(data + i);
+        const __m128i lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(widenLo(v)), g));
+        const __m128i hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(widenHi(v)), g));
+        store(data + i, _mm_packs_epi32(lo, hi));
+    }
+    scalar::applyGain(data + i, n - i, gain);
+}
+
+static void
+toFloat(const AudioSample* in, float* out, size_t n)
+{
+    const __m128 k = _mm_set1_ps(S16_TO_FLOAT);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = load(in + i);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(widenLo(v)), k));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(widenHi(v)), k));
+    }
+    scalar::toFloat(in + i, out + i, n - i);
+}
+
+static inline __m128i
+convert(__m128 v)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+    v = _mm_max_ps(_mm_min_ps(v, one), _mm_sub_ps(_mm_setzero_ps(), one));
+    return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(FLOAT_TO_S16)));
+}
+
+static void
+fromFloat(const float* in, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        store(out + i, _mm_packs_epi32(convert(_mm_loadu_ps(in + i)),
+                                       convert(_mm_loadu_ps(in + i + 4))));
+    scalar::fromFloat(in + i, out + i, n - i);
+}
+
+static void
+interleave2(const AudioSample* left, const AudioSample* right, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i l = load(left + i);
+        const __m128i r = load(right + i);
+        store(out + 2 * i, _mm_unpacklo_epi16(l, r));
+        store(out + 2 * i + 8, _mm_unpackhi_epi16(l, r));
+    }
+    scalar::interleave2(left + i, right + i, out + 2 * i, n - i);
+}
+
+static void
+accumulate(int32_t* bus, const AudioSample* in, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = load(in + i);
+        store(bus + i, _mm_add_epi32(load(bus + i), widenLo(v)));
+        store(bus + i + 4, _mm_add_epi32(load(bus + i + 4), widenHi(v)));
+    }
+    scalar::accumulate(bus + i, in + i, n - i);
+}
+
+static void
+mixMinus(const int32_t* bus, const AudioSample* own, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = load(own + i);
+        store(out + i, _mm_packs_epi32(_mm_sub_epi32(load(bus + i), widenLo(v)),
+                                       _mm_sub_epi32(load(bus + i + 4), widenHi(v))));
+    }
+    scalar::mixMinus(bus + i, own + i, out + i, n - i);
+}
+
+static inline float
+sum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static float
+dot(const float* a, const float* b, size_t n)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    return sum(_mm_add_ps(acc0, acc1)) + scalar::dot(a + i, b + i, n - i);
+}
+
+static const AudioKernels kernels {
+    "sse2", mix, applyGain, toFloat, fromFloat, interleave2, accumulate, mixMinus, dot
+};
+
+} // namespace sse2
+#endif // RING_AUDIO_SSE2
+
+#ifdef RING_AUDIO_AVX2
+namespace avx2 {
+
+#define RING_AVX2 __attribute__((target("avx2")))
+
+RING_AVX2 static inline __m256i
+load(const void* p)
+{
+    return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+}
+
+RING_AVX2 static inline void
+store(void* p, __m256i v)
+{
+    _mm256_storeu_si256(static_cast<__m256i*>(p), v);
+}
+
+// sign extend 8 int16 to int32
+RING_AVX2 static inline __m256i
+widen(const AudioSample* p)
+{
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// saturating pack of 2x8 int32, in order (packs works per 128-bit lane)
+RING_AVX2 static inline __m256i
+pack(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+}
+
+RING_AVX2 static void
+mix(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        store(dst + i, _mm256_adds_epi16(load(dst + i), load(src + i)));
+    sse2::mix(dst + i, src + i, n - i);
+}
+
+RING_AVX2 static void
+applyGain(AudioSample* data, size_t n, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i lo = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(widen(data + i)), g));
+        const __m256i hi = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(widen(data + i + 8)), g));
+        store(data + i, pack(lo, hi));
+    }
+    sse2::applyGain(data + i, n - i, gain);
+}
+
+RING_AVX2 static void
+toFloat(const AudioSample* in, float* out, size_t n)
+{
+    const __m256 k = _mm256_set1_ps(S16_TO_FLOAT);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(widen(in + i)), k));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(widen(in + i + 8)), k));
+    }
+    sse2::toFloat(in + i, out + i, n - i);
+}
+
+RING_AVX2 static inline __m256i
+convert(__m256 v)
+{
+    v = _mm256_max_ps(_mm256_min_ps(v, _mm256_set1_ps(1.f)), _mm256_set1_ps(-1.f));
+    return _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(FLOAT_TO_S16)));
+}
+
+RING_AVX2 static void
+fromFloat(const float* in, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        store(out + i, pack(convert(_mm256_loadu_ps(in + i)),
+                            convert(_mm256_loadu_ps(in + i + 8))));
+    sse2::fromFloat(in + i, out + i, n - i);
+}
+
+RING_AVX2 static void
+interleave2(const AudioSample* left, const AudioSample* right, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i l = load(left + i);
+        const __m256i r = load(right + i);
+        const __m256i lo = _mm256_unpacklo_epi16(l, r);
+        const __m256i hi = _mm256_unpackhi_epi16(l, r);
+        store(out + 2 * i, _mm256_permute2x128_si256(lo, hi, 0x20));
+        store(out + 2 * i + 16, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    sse2::interleave2(left + i, right + i, out + 2 * i, n - i);
+}
+
+RING_AVX2 static void
+accumulate(int32_t* bus, const AudioSample* in, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        store(bus + i, _mm256_add_epi32(load(bus + i), widen(in + i)));
+        store(bus + i + 8, _mm256_add_epi32(load(bus + i + 8), widen(in + i + 8)));
+    }
+    sse2::accumulate(bus + i, in + i, n - i);
+}
+
+RING_AVX2 static void
+mixMinus(const int32_t* bus, const AudioSample* own, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        store(out + i, pack(_mm256_sub_epi32(load(bus + i), widen(own + i)),
+                            _mm256_sub_epi32(load(bus + i + 8), widen(own + i + 8))));
+    sse2::mixMinus(bus + i, own + i, out + i, n - i);
+}
+
+RING_AVX2 static float
+dot(const float* a, const float* b, size_t n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    const __m128 v = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    return sse2::sum(v) + sse2::dot(a + i, b + i, n - i);
+}
+
+#undef RING_AVX2
+
+static const AudioKernels kernels {
+    "avx2", mix, applyGain, toFloat, fromFloat, interleave2, accumulate, mixMinus, dot
+};
+
+static bool
+supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+} // namespace avx2
+#endif // RING_AUDIO_AVX2
+
+#ifdef RING_AUDIO_NEON
+namespace neon {
+
+static void
+mix(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    scalar::mix(dst + i, src + i, n - i);
+}
+
+static inline int16x4_t
+scale(int16x4_t v, float32x4_t k)
+{
+    return vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(v)), k)));
+}
+
+static void
+applyGain(AudioSample* data, size_t n, float gain)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(data + i);
+        vst1q_s16(data + i, vcombine_s16(scale(vget_low_s16(v), g),
+                                         scale(vget_high_s16(v), g)));
+    }
+    scalar::applyGain(data + i, n - i, gain);
+}
+
+static void
+toFloat(const AudioSample* in, float* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), S16_TO_FLOAT));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), S16_TO_FLOAT));
+    }
+    scalar::toFloat(in + i, out + i, n - i);
+}
+
+static inline int16x4_t
+convert(float32x4_t v)
+{
+    v = vmaxq_f32(vminq_f32(v, vdupq_n_f32(1.f)), vdupq_n_f32(-1.f));
+    return vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(v, FLOAT_TO_S16)));
+}
+
+static void
+fromFloat(const float* in, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(out + i, vcombine_s16(convert(vld1q_f32(in + i)),
+                                        convert(vld1q_f32(in + i + 4))));
+    scalar::fromFloat(in + i, out + i, n - i);
+}
+
+static void
+interleave2(const AudioSample* left, const AudioSample* right, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = vld1q_s16(left + i);
+        v.val[1] = vld1q_s16(right + i);
+        vst2q_s16(out + 2 * i, v);
+    }
+    scalar::interleave2(left + i, right + i, out + 2 * i, n - i);
+}
+
+static void
+accumulate(int32_t* bus, const AudioSample* in, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        vst1q_s32(bus + i, vaddw_s16(vld1q_s32(bus + i), vget_low_s16(v)));
+        vst1q_s32(bus + i + 4, vaddw_s16(vld1q_s32(bus + i + 4), vget_high_s16(v)));
+    }
+    scalar::accumulate(bus + i, in + i, n - i);
+}
+
+static void
+mixMinus(const int32_t* bus, const AudioSample* own, AudioSample* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(own + i);
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vsubw_s16(vld1q_s32(bus + i), vget_low_s16(v))),
+                                        vqmovn_s32(vsubw_s16(vld1q_s32(bus + i + 4), vget_high_s16(v)))));
+    }
+    scalar::mixMinus(bus + i, own + i, out + i, n - i);
+}
+
+static float
+dot(const float* a, const float* b, size_t n)
+{
+    float32x4_t acc0 = vdupq_n_f32(0.f);
+    float32x4_t acc1 = vdupq_n_f32(0.f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    const float32x4_t acc = vaddq_f32(acc0, acc1);
+    const float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0) + scalar::dot(a + i, b + i, n - i);
+}
+
+static const AudioKernels kernels {
+    "neon", mix, applyGain, toFloat, fromFloat, interleave2, accumulate, mixMinus, dot
+};
+
+} // namespace neon
+#endif // RING_AUDIO_NEON
+
+std::vector<const AudioKernels*>
+availableAudioKernels()
+{
+    std::vector<const AudioKernels*> ret {&scalar::kernels};
+#ifdef RING_AUDIO_SSE2
+    ret.push_back(&sse2::kernels);
+#endif
+#ifdef RING_AUDIO_AVX2
+    if (avx2::supported())
+        ret.push_back(&avx2::kernels);
+#endif
+#ifdef RING_AUDIO_NEON
+    ret.push_back(&neon::kernels);
+#endif
+    return ret;
+}
+
+const AudioKernels&
+audioKernels()
+{
+    static const AudioKernels& kernels = [] () -> const AudioKernels& {
+        const auto& k = *availableAudioKernels().back();
+        RING_DBG("Using %s audio kernels", k.name);
+        return k;
+    }();
+    return kernels;
+}
+
+} // namespace ring
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ring_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ring {
+
+/**
+ * Per-sample audio kernels, one table per instruction set.
+ *
+ * All kernels accept any length and alignment; AudioBuffer channels being
+ * 32-byte aligned only makes them faster. Conversions to 16 bits saturate.
+ */
+struct AudioKernels {
+    const char* name;
+
+    /** dst[i] = saturate(dst[i] + src[i]) */
+    void (*mix)(AudioSample* dst, const AudioSample* src, size_t n);
+
+    /** data[i] = saturate(data[i] * gain), rounded toward zero */
+    void (*applyGain)(AudioSample* data, size_t n, float gain);
+
+    /** out[i] = in[i] / 32768 */
+    void (*toFloat)(const AudioSample* in, float* out, size_t n);
+
+    /** out[i] = saturate(clamp(in[i], -1, 1) * 32768), rounded toward zero */
+    void (*fromFloat)(const float* in, AudioSample* out, size_t n);
+
+    /** out[2i] = left[i], out[2i+1] = right[i] */
+    void (*interleave2)(const AudioSample* left, const AudioSample* right,
+                        AudioSample* out, size_t n);
+
+    /** bus[i] += in[i], used by mixers to sum without overflow */
+    void (*accumulate)(int32_t* bus, const AudioSample* in, size_t n);
+
+    /** out[i] = saturate(bus[i] - own[i]) */
+    void (*mixMinus)(const int32_t* bus, const AudioSample* own,
+                     AudioSample* out, size_t n);
+
+    /** sum of a[i] * b[i], used by FIR filters */
+    float (*dot)(const float* a, const float* b, size_t n);
+};
+
+/**
+ * Fastest kernels supported by the running CPU, detected once.
+ */
+const AudioKernels& audioKernels();
+
+/**
+ * Every kernel table usable on the running CPU, scalar first.
+ * Meant for tests and benchmarks.
+ */
+std::vector<const AudioKernels*> availableAudioKernels();
+
+} // namespace ring
@@ -19,10 +19,19 @@
  */
 
 #include "audiobuffer.h"
+#include "audio_simd.h"
 #include "logger.h"
 #include <string.h>
 #include <cstring> // memset
+#include <cstdlib>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 namespace ring {
 
@@ -31,38 +40,236 @@ std::ostream& operator <<(std::ostream& stream, const AudioFormat& f) {
     return stream;
 }
 
+namespace {
+
+constexpr size_t ALIGNMENT = 32;
+constexpr size_t ALIGNED_SAMPLES = ALIGNMENT / sizeof(AudioSample);
+
+// Pooled blocks sizes are powers of two between 1KiB and 1MiB
+constexpr unsigned MIN_SIZE_CLASS = 10;
+constexpr unsigned MAX_SIZE_CLASS = 20;
+constexpr size_t MAX_CACHED_BLOCKS = 16; // per size class and thread
+
+std::atomic<uint64_t> heapAllocations_ {0};
+
+inline size_t
+alignedStride(size_t frames)
+{
+    return (frames + ALIGNED_SAMPLES - 1) / ALIGNED_SAMPLES * ALIGNED_SAMPLES;
+}
+
+void*
+alignedAlloc(size_t size)
+{
+    ++heapAllocations_;
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size, ALIGNMENT);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, ALIGNMENT, size))
+        ptr = nullptr;
+#endif
+    if (not ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void
+alignedFree(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+unsigned
+sizeClass(size_t bytes)
+{
+    unsigned c = MIN_SIZE_CLASS;
+    while ((size_t(1) << c) < bytes)
+        ++c;
+    return c;
+}
+
+/**
+ * Per-thread cache of released AudioBuffer storage blocks.
+ * Blocks released from another thread than the one which allocated them
+ * simply join the releasing thread cache.
+ */
+class FramePool {
+public:
+    FramePool() {
+        for (auto& blocks : free_)
+            blocks.reserve(MAX_CACHED_BLOCKS);
+    }
+
+    ~FramePool() {
+        destroyed() = true;
+        for (auto& blocks : free_)
+            for (auto ptr : blocks)
+                alignedFree(ptr);
+    }
+
+    /**
+     * Get a block of at least 'bytes' bytes.
+     * @param allocated actual block size
+     */
+    void* acquire(size_t bytes, size_t& allocated) {
+        const auto c = sizeClass(bytes);
+        if (c > MAX_SIZE_CLASS) {
+            allocated = bytes;
+            return alignedAlloc(bytes);
+        }
+        allocated = size_t(1) << c;
+        auto& blocks = free_[c - MIN_SIZE_CLASS];
+        if (blocks.empty())
+            return alignedAlloc(allocated);
+        auto ptr = blocks.back();
+        blocks.pop_back();
+        return ptr;
+    }
+
+    void release(void* ptr, size_t bytes) {
+        const auto c = sizeClass(bytes);
+        if (c <= MAX_SIZE_CLASS and (size_t(1) << c) == bytes) {
+            auto& blocks = free_[c - MIN_SIZE_CLASS];
+            if (blocks.size() < MAX_CACHED_BLOCKS) {
+                blocks.push_back(ptr);
+                return;
+            }
+        }
+        alignedFree(ptr);
+    }
+
+    static FramePool* local() {
+        // Storage can be released by thread_local objects destroyed after the pool
+        if (destroyed())
+            return nullptr;
+        static thread_local FramePool pool;
+        return &pool;
+    }
+
+private:
+    static bool& destroyed() {
+        static thread_local bool destroyed {false};
+        return destroyed;
+    }
+
+    std::array<std::vector<void*>, MAX_SIZE_CLASS - MIN_SIZE_CLASS + 1> free_;
+};
+
+} // namespace
+
+uint64_t
+AudioBuffer::heapAllocations()
+{
+    return heapAllocations_.load();
+}
+
 AudioBuffer::AudioBuffer(size_t sample_num, AudioFormat format)
-    :  sampleRate_(format.sample_rate),
-       samples_(std::max(1U, format.nb_channels),
-                std::vector<AudioSample>(sample_num, 0))
+    :  sampleRate_(format.sample_rate)
 {
+    reserve(std::max(1U, format.nb_channels), sample_num);
+    channels_ = std::max(1U, format.nb_channels);
+    frames_ = sample_num;
+    reset();
 }
 
 AudioBuffer::AudioBuffer(const AudioSample* in, size_t sample_num, AudioFormat format)
-    :  sampleRate_(format.sample_rate),
-       samples_((std::max(1U, format.nb_channels)), std::vector<AudioSample>(sample_num, 0))
+    : AudioBuffer(sample_num, format)
 {
     deinterleave(in, sample_num, format.nb_channels);
 }
 
 AudioBuffer::AudioBuffer(const AudioBuffer& other, bool copy_content /* = false */)
-    :  sampleRate_(other.sampleRate_),
-       samples_(copy_content ? other.samples_ :
-                std::vector<std::vector<AudioSample> >(other.samples_.size(), std::vector<AudioSample>(other.frames())))
-{}
+    : AudioBuffer(other.frames_, other.getFormat())
+{
+    // strides differ once other was shrunk by resize()
+    if (copy_content)
+        for (unsigned c = 0; c < channels_; ++c)
+            std::copy_n(other.getChannel(c), frames_, getChannel(c));
+}
+
+AudioBuffer::AudioBuffer(AudioBuffer&& other) noexcept
+    : sampleRate_(other.sampleRate_)
+    , channels_(other.channels_)
+    , frames_(other.frames_)
+    , stride_(other.stride_)
+    , data_(other.data_)
+    , capacity_(other.capacity_)
+{
+    other.frames_ = 0;
+    other.stride_ = 0;
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+}
+
+AudioBuffer::~AudioBuffer()
+{
+    release();
+}
 
 AudioBuffer& AudioBuffer::operator=(const AudioBuffer& other) {
-    samples_ = other.samples_;
+    if (this == &other)
+        return *this;
+    frames_ = 0;
+    reserve(other.channels_, other.frames_);
+    channels_ = other.channels_;
+    frames_ = other.frames_;
     sampleRate_ = other.sampleRate_;
+    for (unsigned c = 0; c < channels_; ++c)
+        std::copy_n(other.getChannel(c), frames_, getChannel(c));
     return *this;
 }
 
 AudioBuffer& AudioBuffer::operator=(AudioBuffer&& other) {
-    samples_ = std::move( other.samples_ );
-    sampleRate_ = other.sampleRate_;
+    std::swap(sampleRate_, other.sampleRate_);
+    std::swap(channels_, other.channels_);
+    std::swap(frames_, other.frames_);
+    std::swap(stride_, other.stride_);
+    std::swap(data_, other.data_);
+    std::swap(capacity_, other.capacity_);
     return *this;
 }
 
+void AudioBuffer::release()
+{
+    if (not data_)
+        return;
+    if (auto pool = FramePool::local())
+        pool->release(data_, capacity_ * sizeof(AudioSample));
+    else
+        alignedFree(data_);
+    data_ = nullptr;
+    capacity_ = 0;
+}
+
+void AudioBuffer::reserve(unsigned channels, size_t frames)
+{
+    const size_t stride = std::max(stride_, alignedStride(frames));
+    if (data_ and stride == stride_ and channels * stride <= capacity_)
+        return;
+
+    // keep at least one aligned block to never get a null data_
+    const size_t needed = std::max<size_t>(channels * stride, ALIGNED_SAMPLES);
+    size_t allocated = 0;
+    AudioSample* data;
+    if (auto pool = FramePool::local())
+        data = static_cast<AudioSample*>(pool->acquire(needed * sizeof(AudioSample), allocated));
+    else
+        data = static_cast<AudioSample*>(alignedAlloc(allocated = needed * sizeof(AudioSample)));
+
+    for (unsigned c = 0, n = std::min(channels, channels_); c < n; ++c)
+        std::copy_n(data_ + c * stride_, frames_, data + c * stride);
+
+    release();
+    data_ = data;
+    capacity_ = allocated / sizeof(AudioSample);
+    stride_ = stride;
+}
+
 int AudioBuffer::getSampleRate() const
 {
     return sampleRate_;
@@ -75,38 +282,41 @@ void AudioBuffer::setSampleRate(int sr)
 
 void AudioBuffer::setChannelNum(unsigned n, bool mix /* = false */)
 {
-    const unsigned c = samples_.size();
+    const unsigned c = channels_;
     if (n == c)
         return;
 
     n = std::max(1U, n);
 
     if (!mix or c == 0) {
-        if (n < c)
-            samples_.resize(n);
-        else
-            samples_.resize(n, std::vector<AudioSample>(frames(), 0));
+        if (n > c) {
+            reserve(n, frames_);
+            std::fill_n(data_ + c * stride_, (n - c) * stride_, 0);
+        }
+        channels_ = n;
         return;
     }
 
     // 2ch->1ch
     if (n == 1) {
-        std::vector<AudioSample>& chan1 = samples_[0];
-        std::vector<AudioSample>& chan2 = samples_[1];
+        AudioSample* chan1 = getChannel(0);
+        const AudioSample* chan2 = getChannel(1);
         for (unsigned i = 0, f = frames(); i < f; i++)
             chan1[i] = chan1[i] / 2 + chan2[i] / 2;
-        samples_.resize(1);
+        channels_ = 1;
         return;
     }
 
-    // 1ch->Nch
-    if (c == 1) {
-        samples_.resize(n, samples_[0]);
-        return;
-    }
+    if (c != 1)
+        RING_WARN("Unsupported channel mixing: %dch->%dch", c, n);
 
-    RING_WARN("Unsupported channel mixing: %dch->%dch", c, n);
-    samples_.resize(n, samples_[0]);
+    // 1ch->Nch, new channels are a copy of the first one
+    if (n > c) {
+        reserve(n, frames_);
+        for (unsigned i = c; i < n; ++i)
+            std::copy_n(data_, frames_, data_ + i * stride_);
+    }
+    channels_ = n;
 }
 
 void AudioBuffer::setFormat(AudioFormat format)
@@ -121,19 +331,43 @@ void AudioBuffer::resize(size_t sample_num)
         return;
 
     // will add zero padding if buffer is growing
-    for (auto &s : samples_)
-        s.resize(sample_num, 0);
+    reserve(channels_, sample_num);
+    if (sample_num > frames_)
+        for (unsigned c = 0; c < channels_; ++c)
+            std::fill(data_ + c * stride_ + frames_, data_ + c * stride_ + sample_num, 0);
+    frames_ = sample_num;
+}
+
+void AudioBuffer::reset()
+{
+    for (unsigned c = 0; c < channels_; ++c)
+        std::fill_n(data_ + c * stride_, frames_, 0);
+}
+
+AudioSample* AudioBuffer::getChannel(unsigned chan /* = 0 */)
+{
+    if (chan < channels_)
+        return data_ + chan * stride_;
+
+    RING_ERR("Audio channel %u out of range", chan);
+    return nullptr;
 }
 
-std::vector<AudioSample> * AudioBuffer::getChannel(unsigned chan /* = 0 */)
+const AudioSample* AudioBuffer::getChannel(unsigned chan /* = 0 */) const
 {
-    if (chan < samples_.size())
-        return &samples_[chan];
+    if (chan < channels_)
+        return data_ + chan * stride_;
 
     RING_ERR("Audio channel %u out of range", chan);
     return nullptr;
 }
 
+AudioBufferView AudioBuffer::view(size_t pos, size_t frame_num) const
+{
+    pos = std::min(pos, frames_);
+    return {data_ + pos, stride_, channels_, std::min(frame_num, frames_ - pos), sampleRate_};
+}
+
 void AudioBuffer::applyGain(double gain)
 {
     if (gain == 1.0) return;
@@ -142,25 +376,32 @@ void AudioBuffer::applyGain(double gain)
     if (g != gain)
         RING_DBG("Normalizing %f to [-1.0, 1.0]", gain);
 
-    for (auto &channel : samples_)
-        for (auto &sample : channel)
-            sample *= g;
+    const auto& kernels = audioKernels();
+    for (unsigned c = 0; c < channels_; ++c)
+        kernels.applyGain(getChannel(c), frames_, g);
 }
 
 size_t AudioBuffer::channelToFloat(float* out, const int& channel) const
 {
+    audioKernels().toFloat(getChannel(channel), out, frames());
 
-    for (int i=0, f=frames(); i < f; i++)
-        *out++ = (float) samples_[channel][i] * .000030517578125f;
-
-    return frames() * samples_.size();
+    return frames() * channels_;
 }
 
 size_t AudioBuffer::interleave(AudioSample* out) const
 {
+    if (channels_ == 1) {
+        std::copy_n(data_, frames_, out);
+        return frames_;
+    }
+    if (channels_ == 2) {
+        audioKernels().interleave2(data_, data_ + stride_, out, frames_);
+        return frames_ * 2;
+    }
+
     for (unsigned i=0, f=frames(), c=channels(); i < f; ++i)
         for (unsigned j = 0; j < c; ++j)
-            *out++ = samples_[j][i];
+            *out++ = data_[j * stride_ + i];
 
     return frames() * channels();
 }
@@ -187,11 +428,28 @@ std::vector<AudioSample> AudioBuffer::interleave() const
 
 size_t AudioBuffer::interleaveFloat(float* out) const
 {
+    const auto& kernels = audioKernels();
+    if (channels_ == 1) {
+        kernels.toFloat(data_, out, frames_);
+        return frames_;
+    }
+    if (channels_ == 2) {
+        // interleave by blocks on the stack, then convert
+        constexpr size_t BLOCK = 256;
+        AudioSample tmp[2 * BLOCK];
+        for (size_t i = 0; i < frames_; i += BLOCK) {
+            const size_t n = std::min(BLOCK, frames_ - i);
+            kernels.interleave2(data_ + i, data_ + stride_ + i, tmp, n);
+            kernels.toFloat(tmp, out + 2 * i, 2 * n);
+        }
+        return frames_ * 2;
+    }
+
     for (unsigned i=0, f=frames(), c=channels(); i < f; i++)
         for (unsigned j = 0; j < c; j++)
-            *out++ = (float) samples_[j][i] * .000030517578125f;
+            *out++ = (float) data_[j * stride_ + i] * .000030517578125f;
 
-    return frames() * samples_.size();
+    return frames() * channels_;
 }
 
 void AudioBuffer::deinterleave(const AudioSample* in, size_t frame_num, unsigned nb_channels)
@@ -205,7 +463,7 @@ void AudioBuffer::deinterleave(const AudioSample* in, size_t frame_num, unsigned
 
     for (unsigned i=0, f=frames(), c=channels(); i < f; i++)
         for (unsigned j = 0; j < c; j++)
-            samples_[j][i] = *in++;
+            data_[j * stride_ + i] = *in++;
 }
 
 void AudioBuffer::deinterleave(const std::vector<AudioSample>& in, AudioFormat format)
@@ -223,28 +481,29 @@ void AudioBuffer::convertFloatPlanarToSigned16(uint8_t** extended_data, size_t f
     setChannelNum(nb_channels);
     resize(frame_num);
 
-    for (unsigned j = 0, c = channels(); j < c; j++){
-        float* inputChannel = (float*)extended_data[j];
-        for (unsigned i=0, f=frames(); i < f; i++){
-            float inputChannelVal = *inputChannel++;
-            // avoid saturation: limit val between -1 and 1
-            inputChannelVal = std::max(-1.0f, std::min(inputChannelVal, 1.0f));
-            samples_[j][i] = (int16_t) (inputChannelVal * 32768.0f);
-        }
-    }
+    const auto& kernels = audioKernels();
+    for (unsigned j = 0, c = channels(); j < c; j++)
+        kernels.fromFloat(reinterpret_cast<const float*>(extended_data[j]), getChannel(j), frames());
 }
 
 size_t AudioBuffer::mix(const AudioBuffer& other, bool up /* = true */)
 {
-    const bool upmix = up && (other.samples_.size() < samples_.size());
-    const size_t samp_num = std::min(frames(), other.frames());
-    const unsigned chan_num = upmix ? samples_.size() : std::min(samples_.size(), other.samples_.size());
+    return mix(other.view(), up);
+}
+
+size_t AudioBuffer::mix(const AudioBufferView& in, bool up /* = true */, size_t pos_out /* = 0 */)
+{
+    if (pos_out >= frames_ or in.channels() == 0)
+        return 0;
 
-    for (unsigned i = 0; i < chan_num; i++) {
-        unsigned src_chan = upmix ? std::min<unsigned>(i, other.samples_.size() - 1) : i;
+    const bool upmix = up && (in.channels() < channels_);
+    const size_t samp_num = std::min(frames_ - pos_out, in.frames());
+    const unsigned chan_num = upmix ? channels_ : std::min(channels_, in.channels());
 
-        for (unsigned j = 0; j < samp_num; j++)
-            samples_[i][j] += other.samples_[src_chan][j];
+    const auto& kernels = audioKernels();
+    for (unsigned i = 0; i < chan_num; i++) {
+        unsigned src_chan = upmix ? std::min<unsigned>(i, in.channels() - 1) : i;
+        kernels.mix(getChannel(i) + pos_out, in.getChannel(src_chan), samp_num);
     }
 
     return samp_num;
@@ -259,20 +518,28 @@ size_t AudioBuffer::copy(AudioBuffer& in, int sample_num /* = -1 */, size_t pos_
 
     if (to_copy <= 0) return 0;
 
-    const bool upmix = up && (in.samples_.size() < samples_.size());
-    const size_t chan_num = upmix ? samples_.size() : std::min(in.samples_.size(), samples_.size());
+    return copy(in.view(pos_in, to_copy), pos_out, up);
+}
+
+size_t AudioBuffer::copy(const AudioBufferView& in, size_t pos_out /* = 0 */, bool up /* = true */)
+{
+    if (in.frames() == 0 or in.channels() == 0)
+        return 0;
+
+    const bool upmix = up && (in.channels() < channels_);
+    const size_t chan_num = upmix ? channels_ : std::min(in.channels(), channels_);
 
-    if ((pos_out + to_copy) > frames())
-        resize(pos_out + to_copy);
+    if ((pos_out + in.frames()) > frames())
+        resize(pos_out + in.frames());
 
-    sampleRate_ = in.sampleRate_;
+    sampleRate_ = in.getSampleRate();
 
     for (unsigned i = 0; i < chan_num; i++) {
-        size_t src_chan = upmix ? std::min<size_t>(i, in.samples_.size() - 1U) : i;
-        std::copy(in.samples_[src_chan].begin() + pos_in, in.samples_[src_chan].begin() + pos_in + to_copy, samples_[i].begin() + pos_out);
+        unsigned src_chan = upmix ? std::min<unsigned>(i, in.channels() - 1) : i;
+        std::copy_n(in.getChannel(src_chan), in.frames(), getChannel(i) + pos_out);
     }
 
-    return to_copy;
+    return in.frames();
 }
 
 size_t AudioBuffer::copy(AudioSample* in, size_t sample_num, size_t pos_out /* = 0 */)
@@ -282,9 +549,8 @@ size_t AudioBuffer::copy(AudioSample* in, size_t sample_num, size_t pos_out /* =
     if ((pos_out + sample_num) > frames())
         resize(pos_out + sample_num);
 
-    const size_t chan_num = samples_.size();
-    for (unsigned i = 0; i < chan_num; i++)
-        std::copy(in, in + sample_num, samples_[i].begin() + pos_out);
+    for (unsigned i = 0; i < channels_; i++)
+        std::copy(in, in + sample_num, getChannel(i) + pos_out);
 
     return sample_num;
 }
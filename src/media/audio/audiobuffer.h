@@ -29,6 +29,8 @@
 #include <vector>
 #include <string>
 #include <cstddef> // for size_t
+#include <cstdint>
+#include <limits>
 
 #include "ring_types.h"
 
@@ -83,6 +85,51 @@ struct AudioFormat {
 
 std::ostream& operator <<(std::ostream& stream, const AudioFormat& f);
 
+/**
+ * Read-only view on a range of frames of an AudioBuffer, to read its
+ * samples without copying them.
+ * A view is valid until the buffer is resized, its channel number changes
+ * or it is destroyed.
+ */
+class AudioBufferView {
+    public:
+        AudioBufferView() = default;
+
+        inline unsigned channels() const {
+            return channels_;
+        }
+
+        inline size_t frames() const {
+            return frames_;
+        }
+
+        inline int getSampleRate() const {
+            return sampleRate_;
+        }
+
+        /**
+         * Return the frames() samples of a given channel number,
+         * or nullptr if chan is out of range.
+         */
+        inline const AudioSample* getChannel(unsigned chan) const {
+            return chan < channels_ ? data_ + chan * stride_ : nullptr;
+        }
+
+    private:
+        friend class AudioBuffer;
+
+        AudioBufferView(const AudioSample* data, size_t stride, unsigned channels,
+                        size_t frames, int sampleRate)
+            : data_(data), stride_(stride), channels_(channels)
+            , frames_(frames), sampleRate_(sampleRate) {}
+
+        const AudioSample* data_ {nullptr};
+        size_t stride_ {0};
+        unsigned channels_ {0};
+        size_t frames_ {0};
+        int sampleRate_ {0};
+};
+
 class AudioBuffer {
     public:
         /**
@@ -109,7 +156,9 @@ class AudioBuffer {
         /**
          * Move constructor
          */
-        AudioBuffer(AudioBuffer&& other) : sampleRate_(other.sampleRate_), samples_( std::move(other.samples_) ) {};
+        AudioBuffer(AudioBuffer&& other) noexcept;
+
+        ~AudioBuffer();
 
         /**
          * Copy operator
@@ -148,7 +197,7 @@ class AudioBuffer {
          * Returns the number of channels in this buffer.
          */
         inline unsigned channels() const {
-            return samples_.size();
+            return channels_;
         }
 
         /**
@@ -171,17 +220,14 @@ class AudioBuffer {
         void setFormat(AudioFormat format);
 
         inline AudioFormat getFormat() const {
-            return AudioFormat(sampleRate_, samples_.size());
+            return AudioFormat(sampleRate_, channels_);
         }
 
         /**
          * Returns the number of (multichannel) frames in this buffer.
          */
         inline size_t frames() const {
-            if (not samples_.empty())
-                return samples_[0].size();
-            else
-                return 0;
+            return frames_;
         }
 
         /**
@@ -201,32 +247,32 @@ class AudioBuffer {
 
         /**
          * Resize the buffer to 0. All samples are lost but the number of channels and sample rate are kept.
+         * Storage is kept for later use.
          */
         void clear() {
-            for(auto& c : samples_)
-                c.clear();
+            frames_ = 0;
         }
 
         /**
          * Set all samples in this buffer to 0. Buffer size is not changed.
          */
-        void reset() {
-            for(auto& c : samples_)
-                std::fill(c.begin(), c.end(), 0);
-        }
+        void reset();
 
         /**
-         * Return the data (audio samples) for a given channel number.
-         * Channel data can be modified but size of individual channel vectors should not be changed by the user.
+         * Return the frames() samples of a given channel number,
+         * or nullptr if chan is out of range.
+         * Pointers are 32-byte aligned and stay valid until the buffer
+         * is resized or its channel number changes.
          */
-        std::vector<AudioSample> *getChannel(unsigned chan);
+        AudioSample* getChannel(unsigned chan);
+        const AudioSample* getChannel(unsigned chan) const;
 
         /**
-         * Return a pointer to the raw data in this buffer.
+         * View on frames [pos, pos + frame_num) of this buffer, clamped to
+         * its size.
          */
-        inline std::vector<std::vector<AudioSample> > &getData() {
-            return samples_;
-        }
+        AudioBufferView view(size_t pos = 0,
+                             size_t frame_num = std::numeric_limits<size_t>::max()) const;
 
         /**
          * Returns pointers to non-interleaved raw data.
@@ -234,10 +280,9 @@ class AudioBuffer {
          * limited in time.
          */
         inline const std::vector<AudioSample*> getDataRaw() {
-            const unsigned chans = samples_.size();
-            std::vector<AudioSample*> raw_data(chans, nullptr);
-            for(unsigned i=0; i<chans; i++)
-                raw_data[i] = samples_[i].data();
+            std::vector<AudioSample*> raw_data(channels_, nullptr);
+            for(unsigned i=0; i<channels_; i++)
+                raw_data[i] = data_ + i * stride_;
             return raw_data;
         }
 
@@ -327,6 +372,15 @@ class AudioBuffer {
          */
         size_t mix(const AudioBuffer& other, bool upmix = true);
 
+        /**
+         * Mix the samples of in within this buffer, from sample pos_out.
+         * Same channel handling as mix(const AudioBuffer&, bool), samples
+         * beyond the end of this buffer are ignored.
+         *
+         * @returns Number of samples modified.
+         */
+        size_t mix(const AudioBufferView& in, bool upmix = true, size_t pos_out = 0);
+
         /**
          * Copy sample_num samples from in (from sample sample pos_in) to this buffer (at sample sample pos_out).
          * If sample_num is -1 (the default), the entire in buffer is copied.
@@ -335,6 +389,13 @@ class AudioBuffer {
          */
         size_t copy(AudioBuffer& in, int sample_num = -1, size_t pos_in = 0, size_t pos_out = 0, bool upmix = true);
 
+        /**
+         * Copy the samples of in to this buffer (at sample pos_out).
+         *
+         * Buffer sample number is increased if required to hold the new requested samples.
+         */
+        size_t copy(const AudioBufferView& in, size_t pos_out = 0, bool upmix = true);
+
         /**
          * Copy sample_num samples from in to this buffer (at sample pos_out).
          * Input data is treated as mono and samples are duplicated in the case of a multichannel buffer.
@@ -343,11 +404,29 @@ class AudioBuffer {
          */
         size_t copy(AudioSample* in, size_t sample_num, size_t pos_out = 0);
 
+        /**
+         * Number of storage blocks obtained from the system allocator
+         * since startup, for all AudioBuffers. Blocks are recycled through
+         * a per-thread pool, so this stays constant in steady state.
+         */
+        static uint64_t heapAllocations();
+
     private:
-        int sampleRate_;
+        /**
+         * Make room for the given geometry, keeping current samples.
+         */
+        void reserve(unsigned channels, size_t frames);
+        void release();
 
-        // buffers holding data for each channels
-        std::vector<std::vector<AudioSample> > samples_;
+        int sampleRate_;
+        unsigned channels_ {0};
+        size_t frames_ {0};
+
+        // Channels are stored contiguously, stride_ samples apart
+        // (multiple of 32 bytes to keep each channel aligned)
+        size_t stride_ {0};
+        AudioSample* data_ {nullptr};
+        size_t capacity_ {0};
 };
 
 } // namespace ring
@@ -19,6 +19,10 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "audiolayer.h"
 #include "audio/dcblocker.h"
 #include "logger.h"
@@ -26,13 +30,24 @@
 #include "audio/ringbufferpool.h"
 #include "audio/resampler.h"
 #include "tonecontrol.h"
+#if HAVE_SPEEXDSP
+#include "dsp.h"
+#endif
 #include "client/ring_signal.h"
 
 #include <ctime>
 #include <algorithm>
+#include <cmath>
+#include <thread>
 
 namespace ring {
 
+// Playback kept ready beyond one callback
+static constexpr auto FEED_MARGIN = std::chrono::milliseconds(10);
+// The feeder is woken by the callback, this only bounds a lost wakeup
+static constexpr auto FEED_TIMEOUT = std::chrono::milliseconds(100);
+static constexpr auto CAPTURE_STATS_PERIOD = std::chrono::seconds(30);
+
 AudioLayer::AudioLayer(const AudioPreference &pref)
     : isCaptureMuted_(pref.getCaptureMuted())
     , isPlaybackMuted_(pref.getPlaybackMuted())
@@ -41,25 +56,69 @@ AudioLayer::AudioLayer(const AudioPreference &pref)
     , audioFormat_(Manager::instance().getRingBufferPool().getInternalAudioFormat())
     , audioInputFormat_(Manager::instance().getRingBufferPool().getInternalAudioFormat())
     , urgentRingBuffer_("urgentRingBuffer_id", SIZEBUF, audioFormat_)
+    , mainRingBuffer_("mainRingBuffer_id", SIZEBUF, audioFormat_)
     , resampler_(new Resampler{audioFormat_.sample_rate})
     , inputResampler_(new Resampler{audioInputFormat_.sample_rate})
     , lastNotificationTime_()
+    , playbackResampler_(new Resampler{audioFormat_.sample_rate})
+    , feedLoop_([]{ return true; },
+                std::bind(&AudioLayer::feedPlayback, this),
+                []{})
 {
-    urgentRingBuffer_.createReadOffset(RingBufferPool::DEFAULT_ID);
+    urgentReader_ = urgentRingBuffer_.createReadOffset(RingBufferPool::DEFAULT_ID);
+    mainReader_ = mainRingBuffer_.createReadOffset(RingBufferPool::DEFAULT_ID);
+
+#if HAVE_SPEEXDSP
+    SpeexEchoCanceller* echo = nullptr;
+    if (pref.getEchoCancel()) {
+        echo = new SpeexEchoCanceller;
+        capturePipeline_.addStage(std::unique_ptr<CaptureStage>(echo));
+    }
+    if (echo or pref.getNoiseReduce() or pref.isAGCEnabled())
+        capturePipeline_.addStage(std::unique_ptr<CaptureStage>(
+            new SpeexPreprocessor(pref.getNoiseReduce(), pref.isAGCEnabled(), echo)));
+#else
+    if (pref.getEchoCancel() or pref.getNoiseReduce() or pref.isAGCEnabled())
+        RING_WARN("Built without speexdsp: no echo cancellation, noise reduction nor AGC");
+#endif
+    capturePipeline_.addStage(std::unique_ptr<CaptureStage>(new VoiceActivityDetector));
+    capturePipeline_.setFarEndFormat(audioFormat_);
+
+    feedLoop_.start();
 }
 
 AudioLayer::~AudioLayer()
-{}
+{
+    feedLoop_.stop();
+    feedCv_.notify_one();
+    feedLoop_.join();
+}
 
 void AudioLayer::hardwareFormatAvailable(AudioFormat playback)
 {
+    // mutex_ keeps the feeder and putUrgent() out, the callback is kept out
+    // of the buffers until they are reallocated
     std::lock_guard<std::mutex> lock(mutex_);
     RING_DBG("Hardware audio format available : %s", playback.toString().c_str());
     audioFormat_ = Manager::instance().hardwareAudioFormatChanged(playback);
+    formatChanging_ = true;
+    waitPlaybackPass();
     urgentRingBuffer_.setFormat(audioFormat_);
+    mainRingBuffer_.setFormat(audioFormat_);
+    formatChanging_ = false;
+    capturePipeline_.setFarEndFormat(audioFormat_);
     resampler_->setFormat(audioFormat_);
 }
 
+// A callback reading the buffers or the tone leaves them before we return
+void AudioLayer::waitPlaybackPass()
+{
+    const unsigned passes = playbackPasses_;
+    if (passes & 1)
+        while (playbackPasses_ == passes)
+            std::this_thread::yield();
+}
+
 void AudioLayer::hardwareInputFormatAvailable(AudioFormat capture)
 {
     RING_DBG("Hardware input audio format available : %s", capture.toString().c_str());
@@ -76,6 +135,7 @@ void AudioLayer::flushMain()
     std::lock_guard<std::mutex> lock(mutex_);
     // should pass call id
     Manager::instance().getRingBufferPool().flushAllBuffers();
+    mainRingBuffer_.flushAll();
 }
 
 void AudioLayer::flushUrgent()
@@ -90,6 +150,17 @@ void AudioLayer::putUrgent(AudioBuffer& buffer)
     urgentRingBuffer_.put(buffer);
 }
 
+void AudioLayer::setTone(std::shared_ptr<AudioLoop> tone)
+{
+    std::lock_guard<std::mutex> lock(toneMutex_);
+    playbackTone_ = tone.get();
+
+    // A callback that loaded the previous tone may still be using it
+    waitPlaybackPass();
+
+    tone_ = std::move(tone);
+}
+
 // Notify (with a beep) an incoming call when there is already a call in progress
 void AudioLayer::notifyIncomingCall()
 {
@@ -150,69 +221,131 @@ const AudioBuffer& AudioLayer::getToRing(AudioFormat format, size_t writableSamp
 
 const AudioBuffer& AudioLayer::getToPlay(AudioFormat format, size_t writableSamples)
 {
+    fillPlayback(format, writableSamples);
+    // what is played is the echo reference of the capture
+    capturePipeline_.putFarEnd(playbackBuffer_);
+    return playbackBuffer_;
+}
+
+void AudioLayer::fillPlayback(AudioFormat format, size_t writableSamples)
+{
+    playbackRequest_.store(writableSamples, std::memory_order_relaxed);
+    playbackBuffer_.setFormat(format);
     playbackBuffer_.resize(0);
-    playbackResampleBuffer_.resize(0);
 
-    notifyIncomingCall();
+    // playbackPasses_ is odd while the buffers and the tone are in use,
+    // see waitPlaybackPass(). Silence while they are reallocated.
+    ++playbackPasses_;
+    if (not formatChanging_)
+        readPlayback(writableSamples);
+    ++playbackPasses_;
+
+    // The feeder refills what was read. notify_one() doesn't take
+    // feedMutex_, a wakeup lost to the feeder going to wait is recovered
+    // by the next callback.
+    feedRequested_ = true;
+    feedCv_.notify_one();
+}
 
-    size_t urgentSamples = std::min(urgentRingBuffer_.availableForGet(RingBufferPool::DEFAULT_ID), writableSamples);
+void AudioLayer::readPlayback(size_t writableSamples)
+{
+    size_t urgentSamples = std::min(urgentRingBuffer_.availableForGet(urgentReader_), writableSamples);
 
     if (urgentSamples) {
-        playbackBuffer_.setFormat(format);
         playbackBuffer_.resize(urgentSamples);
-        urgentRingBuffer_.get(playbackBuffer_, RingBufferPool::DEFAULT_ID); // retrive only the first sample_spec->channels channels
+        urgentRingBuffer_.get(playbackBuffer_, urgentReader_); // retrive only the first sample_spec->channels channels
         playbackBuffer_.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
         // Consume the regular one as well (same amount of samples)
-        Manager::instance().getRingBufferPool().discard(urgentSamples, RingBufferPool::DEFAULT_ID);
-        return playbackBuffer_;
+        mainRingBuffer_.discard(urgentSamples, mainReader_);
+        return;
     }
 
-    // FIXME: not thread safe! we only lock the mutex when we get the
-    // pointer, we have no guarantee that it will stay safe to use
-    if (AudioLoop* toneToPlay = Manager::instance().getTelephoneTone()) {
-        playbackBuffer_.setFormat(format);
+    if (AudioLoop* toneToPlay = playbackTone_) {
         playbackBuffer_.resize(writableSamples);
         toneToPlay->getNext(playbackBuffer_, playbackGain_); // retrive only n_channels
-        return playbackBuffer_;
+        return;
     }
 
-    flushUrgent(); // flush remaining samples in _urgentRingBuffer
+    urgentRingBuffer_.flush(urgentReader_); // flush remaining samples in _urgentRingBuffer
 
-    size_t availSamples = Manager::instance().getRingBufferPool().availableForGet(RingBufferPool::DEFAULT_ID);
-    if (not availSamples)
-        return playbackBuffer_;
+    const size_t mainSamples = std::min(mainRingBuffer_.availableForGet(mainReader_), writableSamples);
+    if (not mainSamples)
+        return;
 
-    // how many samples we want to read from the buffer
-    size_t readableSamples = writableSamples;
+    playbackBuffer_.resize(mainSamples);
+    mainRingBuffer_.get(playbackBuffer_, mainReader_);
+    playbackBuffer_.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
+}
 
-    AudioFormat mainBufferAudioFormat = Manager::instance().getRingBufferPool().getInternalAudioFormat();
+bool AudioLayer::processCapture(AudioBuffer& buffer)
+{
+    dcblocker_.process(buffer);
+    capturePipeline_.process(buffer);
+    return capturePipeline_.voiceActivity();
+}
 
-    bool resample = audioFormat_.sample_rate != mainBufferAudioFormat.sample_rate;
-    double resampleFactor = 1.;
-    if (resample) {
-        resampleFactor = (double) audioFormat_.sample_rate / mainBufferAudioFormat.sample_rate;
-        readableSamples = (double) readableSamples / resampleFactor;
+void AudioLayer::feedPlayback()
+{
+    {
+        std::unique_lock<std::mutex> lk(feedMutex_);
+        feedCv_.wait_for(lk, FEED_TIMEOUT, [this]{
+            return feedRequested_.load() or feedLoop_.isStopping();
+        });
+        feedRequested_ = false;
     }
+    if (feedLoop_.isStopping())
+        return;
+    const auto now = std::chrono::steady_clock::now();
 
-    readableSamples = std::min(readableSamples, availSamples);
-    size_t nResampled = (double) readableSamples * resampleFactor;
+    // Layers reading the RingBufferPool themselves never call getToPlay()
+    const size_t request = playbackRequest_.load(std::memory_order_relaxed);
+    if (not request or not isStarted())
+        return;
 
-    playbackBuffer_.setFormat(mainBufferAudioFormat);
-    playbackBuffer_.resize(readableSamples);
-    Manager::instance().getRingBufferPool().getData(playbackBuffer_, RingBufferPool::DEFAULT_ID);
-    playbackBuffer_.setChannelNum(format.nb_channels, true);
+    notifyIncomingCall();
 
-    if (resample) {
-        playbackResampleBuffer_.setFormat(format);
-        playbackResampleBuffer_.resize(nResampled);
-        resampler_->resample(playbackBuffer_, playbackResampleBuffer_);
-        playbackResampleBuffer_.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
-        return playbackResampleBuffer_;
+    if (now - lastCaptureStatsLog_ > CAPTURE_STATS_PERIOD) {
+        lastCaptureStatsLog_ = now;
+        for (const auto& stage : capturePipeline_.getStats())
+            if (stage.blocks)
+                RING_DBG("Capture %s: %.1f us per block, worst %.1f us",
+                         stage.name.c_str(),
+                         stage.cpuTime.count() / 1000. / stage.blocks,
+                         stage.maxTime.count() / 1000.);
+    }
+
+    // hardwareFormatAvailable() reallocates mainRingBuffer_ under mutex_.
+    // The callback never takes it, it reads mainRingBuffer_ wait-free.
+    std::lock_guard<std::mutex> lock(mutex_);
+    const AudioFormat format = audioFormat_;
+    auto& pool = Manager::instance().getRingBufferPool();
+    const AudioFormat mainBufferAudioFormat = pool.getInternalAudioFormat();
+
+    // Keep a callback worth of samples ready, plus a margin
+    const size_t margin = format.sample_rate * FEED_MARGIN.count() / 1000;
+    const size_t target = std::min(request + margin, SIZEBUF / 2);
+    const size_t queued = mainRingBuffer_.availableForGet(mainReader_);
+    if (queued >= target)
+        return;
+
+    const double resampleFactor = (double) format.sample_rate / mainBufferAudioFormat.sample_rate;
+    const size_t readableSamples = std::min<size_t>(std::ceil((target - queued) / resampleFactor),
+                                                    pool.availableForGet(RingBufferPool::DEFAULT_ID));
+    if (not readableSamples)
+        return;
+
+    feedBuffer_.setFormat(mainBufferAudioFormat);
+    feedBuffer_.resize(readableSamples);
+    pool.getData(feedBuffer_, RingBufferPool::DEFAULT_ID);
+    feedBuffer_.setChannelNum(format.nb_channels, true);
+
+    if (format.sample_rate != mainBufferAudioFormat.sample_rate) {
+        feedResampleBuffer_.setFormat(format);
+        playbackResampler_->resample(feedBuffer_, feedResampleBuffer_);
+        mainRingBuffer_.put(feedResampleBuffer_);
     } else {
-        playbackBuffer_.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
-        return playbackBuffer_;
+        mainRingBuffer_.put(feedBuffer_);
     }
 }
 
-
 } // namespace ring
@@ -26,10 +26,14 @@
 
 
 #include "ringbuffer.h"
+#include "lockfreeringbuffer.h"
 #include "dcblocker.h"
+#include "capture_pipeline.h"
 #include "noncopyable.h"
+#include "threadloop.h"
 
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <atomic>
@@ -54,6 +58,7 @@
 namespace ring {
 
 class AudioPreference;
+class AudioLoop;
 class Resampler;
 
 enum class DeviceType {
@@ -123,6 +128,12 @@ class AudioLayer {
          */
         void putUrgent(AudioBuffer& buffer);
 
+        /**
+         * Set the tone played instead of the main stream, or none.
+         * Returns once the playback callback no longer uses the previous tone.
+         */
+        void setTone(std::shared_ptr<AudioLoop> tone);
+
         /**
          * Flush main buffer
          */
@@ -213,6 +224,13 @@ class AudioLayer {
          */
         void notifyIncomingCall();
 
+        /**
+         * CPU time spent in each capture processing stage
+         */
+        std::vector<CaptureStageStats> getCaptureStats() const {
+            return capturePipeline_.getStats();
+        }
+
         virtual void updatePreference(AudioPreference &pref, int index, DeviceType type) = 0;
 
     protected:
@@ -228,10 +246,23 @@ class AudioLayer {
 
         void devicesChanged();
 
+        /**
+         * Get the next playback samples, from the urgent buffer, the tone or
+         * the main buffer. Meant for the audio driver callback: never locks,
+         * nor allocates once the buffer has grown to the callback size.
+         */
         const AudioBuffer& getToPlay(AudioFormat format, size_t writableSamples);
 
         const AudioBuffer& getToRing(AudioFormat format, size_t writableSamples);
 
+        /**
+         * Process captured samples in place (DC removal, echo cancellation,
+         * noise suppression...), before they are put in the main buffer.
+         * The buffer may come out shorter, up to 10ms are held back.
+         * @return voice activity, to be given to RingBuffer::put()
+         */
+        bool processCapture(AudioBuffer& buffer);
+
         /**
          * True if capture is not to be used
          */
@@ -261,7 +292,6 @@ class AudioLayer {
          * Buffers for audio processing
          */
         AudioBuffer playbackBuffer_;
-        AudioBuffer playbackResampleBuffer_;
         AudioBuffer ringtoneBuffer_;
         AudioBuffer ringtoneResampleBuffer_;
 
@@ -282,9 +312,20 @@ class AudioLayer {
         AudioFormat audioInputFormat_;
 
         /**
-         * Urgent ring buffer used for ringtones
+         * Urgent ring buffer used for ringtones.
+         * Wait-free as it is read from the audio driver callback.
+         */
+        LockFreeRingBuffer urgentRingBuffer_;
+        LockFreeRingBuffer::ReaderId urgentReader_;
+
+        /**
+         * Main stream, in the hardware format.
+         * Filled from the RingBufferPool by the playback feeder thread,
+         * under mutex_ since a format change reallocates it. The callback
+         * reads it without lock, and outside of format changes.
          */
-        RingBuffer urgentRingBuffer_;
+        LockFreeRingBuffer mainRingBuffer_;
+        LockFreeRingBuffer::ReaderId mainReader_;
 
         /**
          * Lock for the entire audio layer
@@ -296,6 +337,11 @@ class AudioLayer {
          */
         DcBlocker dcblocker_ {};
 
+        /**
+         * Capture processing stages, built from the preferences
+         */
+        CapturePipeline capturePipeline_ {};
+
         /**
          * Manage sampling rate conversion
          */
@@ -307,11 +353,46 @@ class AudioLayer {
         std::unique_ptr<Resampler> inputResampler_;
 
     private:
+        void fillPlayback(AudioFormat format, size_t writableSamples);
+        void readPlayback(size_t writableSamples);
+        void waitPlaybackPass();
+
+        /**
+         * Move the main stream from the RingBufferPool to mainRingBuffer_,
+         * converted to the hardware format. Runs in the feeder thread.
+         */
+        void feedPlayback();
 
         /**
          * Time of the last incoming call notification
          */
         std::chrono::system_clock::time_point lastNotificationTime_;
+
+        /**
+         * Tone node. The callback only loads playbackTone_; tone_ keeps the
+         * tone alive and is replaced once the callback is done with it.
+         */
+        std::mutex toneMutex_ {};
+        std::shared_ptr<AudioLoop> tone_;
+        std::atomic<AudioLoop*> playbackTone_ {nullptr};
+
+        std::atomic<unsigned> playbackPasses_ {0}; // odd while the callback reads the buffers or the tone
+        std::atomic<bool> formatChanging_ {false}; // the callback plays silence meanwhile
+
+        /**
+         * Feeder state. The callback only sets playbackRequest_ and wakes
+         * the feeder up.
+         */
+        std::unique_ptr<Resampler> playbackResampler_;
+        AudioBuffer feedBuffer_;
+        AudioBuffer feedResampleBuffer_;
+        std::mutex feedMutex_ {};
+        std::condition_variable feedCv_ {};
+        std::atomic<bool> feedRequested_ {false}; // set by the callback
+        std::atomic<size_t> playbackRequest_ {0}; // last getToPlay() size, in frames
+        std::chrono::steady_clock::time_point lastCaptureStatsLog_;
+
+        ThreadLoop feedLoop_; // as to be last member
 };
 
 } // namespace ring
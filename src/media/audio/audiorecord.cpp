@@ -24,9 +24,11 @@
 #endif
 
 #include "audiorecord.h"
+#include "recording_service.h"
 #include "logger.h"
 #include "fileutils.h"
 #include "manager.h"
+#include "string_utils.h"
 
 #ifndef RING_UWP
 #include <sndfile.hh>
@@ -81,10 +83,15 @@ createFilename()
 }
 
 AudioRecord::AudioRecord()
+    : AudioRecord(Manager::instance().getRingBufferPool(),
+                  Manager::instance().getRecordingService())
+{}
+
+AudioRecord::AudioRecord(RingBufferPool& rbp, RecordingService& service)
     : sndFormat_(AudioFormat::MONO())
     , filename_(createFilename())
     , savePath_()
-    , recorder_(this, Manager::instance().getRingBufferPool())
+    , recorder_(this, rbp, service)
 {
     RING_DBG("Generate filename for this call %s ", filename_.c_str());
 }
@@ -99,7 +106,8 @@ void AudioRecord::setSndFormat(AudioFormat format)
     sndFormat_ = format;
 }
 
-void AudioRecord::setRecordingOptions(AudioFormat format, const std::string &path)
+void AudioRecord::setRecordingOptions(AudioFormat format, const std::string &path,
+                                      const std::string &fileFormat)
 {
     std::string filePath;
 
@@ -111,7 +119,15 @@ void AudioRecord::setRecordingOptions(AudioFormat format, const std::string &pat
     }
 
     sndFormat_ = format;
+    fileIndex_ = 0;
     savePath_ = (*filePath.rbegin() == DIR_SEPARATOR_CH) ? filePath : filePath + DIR_SEPARATOR_STR;
+
+    if (fileFormat == "wav" or fileFormat == "flac" or fileFormat == "ogg") {
+        fileFormat_ = fileFormat;
+    } else {
+        RING_WARN("Unknown recording format '%s', using wav", fileFormat.c_str());
+        fileFormat_ = "wav";
+    }
 }
 
 static bool
@@ -131,11 +147,12 @@ sanitize(std::string s)
 void AudioRecord::initFilename(const std::string &peerNumber)
 {
     RING_DBG("Initialize audio record for peer  : %s", peerNumber.c_str());
+    fileIndex_ = 0;
     // if savePath_ don't contains filename
-    if (savePath_.find(".wav") == std::string::npos) {
+    if (savePath_.find("." + fileFormat_) == std::string::npos) {
         filename_ = createFilename();
         filename_.append("-" + sanitize(peerNumber) + "-" PACKAGE);
-        filename_.append(".wav");
+        filename_.append("." + fileFormat_);
     } else {
         filename_ = "";
     }
@@ -152,19 +169,30 @@ AudioRecord::openFile()
 #ifndef RING_UWP
     fileHandle_.reset(); // do it before calling fileExists()
 
+    int format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    if (fileFormat_ == "flac")
+        format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+    else if (fileFormat_ == "ogg")
+        format = SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+
+    // libsndfile can't open compressed files for writing, continue in a new one
+    if (fileFormat_ != "wav")
+        while (fileExists())
+            nextFile();
+
     const bool doAppend = fileExists();
     const int access = doAppend ? SFM_RDWR : SFM_WRITE;
 
     RING_DBG("Opening file %s with format %s", getFilename().c_str(), sndFormat_.toString().c_str());
     fileHandle_.reset(new SndfileHandle (getFilename().c_str(),
                                          access,
-                                         SF_FORMAT_WAV | SF_FORMAT_PCM_16,
+                                         format,
                                          sndFormat_.nb_channels,
                                          sndFormat_.sample_rate));
 
     // check overloaded boolean operator
     if (!*fileHandle_) {
-        RING_WARN("Could not open WAV file!");
+        RING_WARN("Could not open %s file!", fileFormat_.c_str());
         fileHandle_.reset();
         return false;
     }
@@ -178,10 +206,23 @@ AudioRecord::openFile()
 #endif
 }
 
+// name.ext -> name-1.ext -> name-2.ext...
+void
+AudioRecord::nextFile()
+{
+    auto& name = filename_.empty() ? savePath_ : filename_;
+    const auto ext = name.rfind('.');
+    auto base = name.substr(0, ext);
+    if (fileIndex_)
+        base.resize(base.size() - ring::to_string(fileIndex_).size() - 1);
+    name = base + "-" + ring::to_string(++fileIndex_) + name.substr(ext);
+}
+
 void
 AudioRecord::closeFile()
 {
-    stopRecording(); // needed as recData accesses to fileHandle_
+    recorder_.stop(); // write pending data, recData won't be called after this
+    stopRecording();
     fileHandle_.reset();
 }
 
@@ -222,19 +263,15 @@ AudioRecord::stopRecording() const noexcept
 }
 
 void
-AudioRecord::recData(AudioBuffer& buffer)
+AudioRecord::recData(const AudioSample* data, size_t frames)
 {
 #ifndef RING_UWP
-    if (not recordingEnabled_)
+    if (not fileHandle_)
         return;
 
-    auto interleaved = buffer.interleave();
-    const int nSamples = interleaved.size();
-    if (fileHandle_->write(interleaved.data(), nSamples) != nSamples) {
+    const sf_count_t nSamples = frames * sndFormat_.nb_channels;
+    if (fileHandle_->write(data, nSamples) != nSamples)
         RING_WARN("Could not record data!");
-    } else {
-        fileHandle_->writeSync();
-    }
 #endif
 }
 
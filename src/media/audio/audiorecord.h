@@ -37,10 +37,21 @@ namespace ring {
 class AudioRecord {
     public:
         AudioRecord();
+
+        /**
+         * Record from rbp with service instead of the Manager ones
+         */
+        AudioRecord(RingBufferPool& rbp, RecordingService& service);
+
         ~AudioRecord();
 
         void setSndFormat(AudioFormat format);
-        void setRecordingOptions(AudioFormat format, const std::string &path);
+
+        /**
+         * @param fileFormat "wav", "flac" or "ogg" (Vorbis)
+         */
+        void setRecordingOptions(AudioFormat format, const std::string &path,
+                                 const std::string &fileFormat = "wav");
 
         /**
          * Init recording file path
@@ -92,11 +103,12 @@ class AudioRecord {
         void stopRecording() const noexcept;
 
         /**
-         * Record a chunk of data in an openend file
-         * @param buffer  The data chunk to be recorded
-         * @param nSamples Number of samples (number of bytes) to be recorded
+         * Record a chunk of data in an openend file.
+         * Called by the recording service I/O thread.
+         * @param data   Interleaved samples, in the format given to setSndFormat()
+         * @param frames Number of frames to be recorded
          */
-        void recData(AudioBuffer& buffer);
+        void recData(const AudioSample* data, size_t frames);
 
         std::string getRecorderID() const {
             return recorder_.getRecorderID();
@@ -120,6 +132,11 @@ class AudioRecord {
          */
         void closeWavFile();
 
+        /**
+         * Switch to the next numbered file name, name-1.ext, name-2.ext...
+         */
+        void nextFile();
+
         /**
          * Pointer to the recorded file
          */
@@ -145,6 +162,16 @@ class AudioRecord {
          */
         std::string savePath_;
 
+        /**
+         * File extension, giving the file format
+         */
+        std::string fileFormat_ {"wav"};
+
+        /**
+         * Number appended to the file name, 0 for none
+         */
+        unsigned fileIndex_ {0};
+
         /**
          * Audio recording thread
          */
@@ -21,28 +21,18 @@
 
 #include "audiorecorder.h"
 
-#include "audiorecord.h"
+#include "recording_service.h"
 #include "ringbufferpool.h"
-#include "audiobuffer.h"
 
-#include <chrono>
-#include <thread>
 #include <sstream>
-#include <algorithm> // std::min
 
 namespace ring {
 
-static constexpr std::size_t BUFFER_LENGTH {10000};
-static constexpr auto SLEEP_TIME = std::chrono::milliseconds(20);
-
-AudioRecorder::AudioRecorder(AudioRecord* arec, RingBufferPool& rbp)
+AudioRecorder::AudioRecorder(AudioRecord* arec, RingBufferPool& rbp, RecordingService& service)
     : ringBufferPool_(rbp)
-    , buffer_(new AudioBuffer(BUFFER_LENGTH, AudioFormat::NONE()))
+    , service_(service)
     , arecord_(arec)
-    , thread_(
-        [this] { return true; },
-        [this] { process(); },
-        [] {})
+    , buffer_(0, AudioFormat::NONE())
 {
     std::string id("processd_");
 
@@ -57,7 +47,7 @@ AudioRecorder::AudioRecorder(AudioRecord* arec, RingBufferPool& rbp)
 
 AudioRecorder::~AudioRecorder()
 {
-    thread_.join();
+    stop();
 }
 
 unsigned
@@ -70,23 +60,30 @@ AudioRecorder::nextProcessID() noexcept
 void
 AudioRecorder::start()
 {
-    if (thread_.isRunning())
+    if (started_)
         return;
-    buffer_->setFormat(ringBufferPool_.getInternalAudioFormat());
-    thread_.start();
+    started_ = true;
+
+    format_ = ringBufferPool_.getInternalAudioFormat();
+    buffer_.setFormat(format_);
+    const size_t chunkFrames = format_.sample_rate * RecordingService::CHUNK_DURATION.count() / 1000;
+    for (auto& chunk : chunks_) {
+        chunk.samples.resize(chunkFrames * format_.nb_channels);
+        chunk.frames = 0;
+    }
+    fill_ = 0;
+    writing_ = false;
+    dropped_ = 0;
+    service_.add(*this);
 }
 
 void
-AudioRecorder::process()
+AudioRecorder::stop()
 {
-    auto availableSamples = ringBufferPool_.availableForGet(recorderId_);
-    buffer_->resize(std::min(availableSamples, BUFFER_LENGTH));
-    ringBufferPool_.getData(*buffer_, recorderId_);
-
-    if (availableSamples > 0)
-        arecord_->recData(*buffer_);
-
-    std::this_thread::sleep_for(SLEEP_TIME);
+    if (not started_)
+        return;
+    service_.remove(*this);
+    started_ = false;
 }
 
 } // namespace ring
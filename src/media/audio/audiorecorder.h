@@ -21,21 +21,27 @@
 
 #pragma once
 
-#include "threadloop.h"
+#include "audiobuffer.h"
 #include "noncopyable.h"
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <memory>
+#include <vector>
 
 namespace ring {
 
 class RingBufferPool;
+class RecordingService;
 class AudioRecord;
-class AudioBuffer;
 
+/**
+ * Reads a recording from the RingBufferPool and hands it to its AudioRecord.
+ * The work is done by the shared RecordingService threads.
+ */
 class AudioRecorder {
 public:
-    AudioRecorder(AudioRecord* arec, RingBufferPool& rbp);
+    AudioRecorder(AudioRecord* arec, RingBufferPool& rbp, RecordingService& service);
     ~AudioRecorder();
 
     std::string getRecorderID() const {
@@ -47,16 +53,35 @@ public:
      */
     void start();
 
+    /**
+     * Write pending data and stop reading. Blocks until written.
+     */
+    void stop();
+
 private:
     NON_COPYABLE(AudioRecorder);
+    friend class RecordingService;
     static unsigned nextProcessID() noexcept;
-    void process();
+
+    /** Preallocated interleaved samples */
+    struct Chunk {
+        std::vector<AudioSample> samples;
+        size_t frames {0};
+    };
 
     std::string recorderId_;
     RingBufferPool& ringBufferPool_;
-    std::unique_ptr<AudioBuffer> buffer_;
+    RecordingService& service_;
     AudioRecord* arecord_;
-    ThreadLoop thread_;
+    bool started_ {false};
+
+    // used by the service threads only
+    AudioFormat format_ {AudioFormat::NONE()};
+    AudioBuffer buffer_;
+    std::array<Chunk, 2> chunks_;
+    unsigned fill_ {0};     // chunk being filled, the other one may be written
+    bool writing_ {false};  // other chunk queued or being written
+    uint64_t dropped_ {0};
 };
 
 } // namespace ring
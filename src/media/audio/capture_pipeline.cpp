@@ -0,0 +1,354 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "capture_pipeline.h"
+#include "resampler.h"
+#include "logger.h"
+#include "ring_types.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ring {
+
+constexpr std::chrono::milliseconds CapturePipeline::BLOCK_DURATION;
+
+// Far end kept ahead of the near end, at most
+static constexpr std::chrono::milliseconds MAX_FAR_END_DELAY {200};
+
+// Longest echo path delay estimated
+static constexpr unsigned MAX_ECHO_DELAY_BLOCKS = MAX_FAR_END_DELAY / CapturePipeline::BLOCK_DURATION;
+// Reference given this much before the estimated echo, for echo coming
+// a little earlier than estimated to still be cancelled
+static constexpr unsigned ECHO_DELAY_MARGIN_BLOCKS {2};
+
+//
+// VoiceActivityDetector
+//
+
+// About -50dBFS, quieter is never voice
+static constexpr double MIN_VOICE_POWER {100. * 100.};
+// Voice is 6dB above the noise floor
+static constexpr double NOISE_FLOOR_FACTOR {4.};
+// Noise floor rise per block, about 3dB/s
+static constexpr double NOISE_FLOOR_RISE {1.007};
+// Blocks still reported as voice after the last active one
+static constexpr unsigned HANGOVER_BLOCKS {20};
+
+void
+VoiceActivityDetector::setFormat(AudioFormat, size_t)
+{
+    noiseFloor_ = 0;
+    hangover_ = 0;
+}
+
+void
+VoiceActivityDetector::process(CaptureBlock& block)
+{
+    const auto& data = block.data;
+    const size_t samples = data.frames() * data.channels();
+    if (not samples)
+        return;
+
+    double power = 0;
+    for (unsigned c = 0; c < data.channels(); ++c) {
+        const AudioSample* s = data.getChannel(c);
+        for (size_t i = 0, n = data.frames(); i < n; ++i)
+            power += static_cast<double>(s[i]) * s[i];
+    }
+    power /= samples;
+
+    // the floor follows drops immediately and rises slowly
+    if (noiseFloor_ == 0 or power < noiseFloor_)
+        noiseFloor_ = power;
+    else
+        noiseFloor_ *= NOISE_FLOOR_RISE;
+
+    if (power > MIN_VOICE_POWER and power > NOISE_FLOOR_FACTOR * noiseFloor_)
+        hangover_ = HANGOVER_BLOCKS;
+    else if (hangover_)
+        --hangover_;
+    block.voice = hangover_ != 0;
+}
+
+//
+// EchoDelayEstimator
+//
+
+// Weight of a new block in the averages, about half a second of memory
+static constexpr double DELAY_SMOOTHING {0.02};
+// Correlation peak over the mean correlation to trust a lag
+static constexpr double DELAY_PEAK_FACTOR {2.};
+// Blocks a new lag must correlate best before it is used
+static constexpr unsigned DELAY_CONFIRM_BLOCKS {50};
+
+static double
+meanPower(const AudioSample* s, size_t n)
+{
+    double power = 0;
+    for (size_t i = 0; i < n; ++i)
+        power += static_cast<double>(s[i]) * s[i];
+    return n ? power / n : 0;
+}
+
+EchoDelayEstimator::EchoDelayEstimator(unsigned maxLag)
+    : far_(maxLag + 1)
+    , scores_(maxLag + 1)
+{}
+
+void
+EchoDelayEstimator::reset()
+{
+    std::fill(far_.begin(), far_.end(), 0);
+    std::fill(scores_.begin(), scores_.end(), 0);
+    pos_ = 0;
+    updates_ = 0;
+    farIdle_ = 0;
+    delay_ = 0;
+    candidate_ = 0;
+    candidateBlocks_ = 0;
+}
+
+bool
+EchoDelayEstimator::update(double nearPower, double farPower)
+{
+    const double nearLog = std::log10(nearPower + 1.);
+    const double farLog = std::log10(farPower + 1.);
+    if (not updates_) {
+        nearMean_ = nearLog;
+        farMean_ = farLog;
+    }
+    nearMean_ += DELAY_SMOOTHING * (nearLog - nearMean_);
+    farMean_ += DELAY_SMOOTHING * (farLog - farMean_);
+    farIdle_ = farPower > MIN_VOICE_POWER ? 0 : farIdle_ + 1;
+
+    const size_t size = far_.size();
+    pos_ = (pos_ + 1) % size;
+    far_[pos_] = farLog - farMean_;
+
+    // no echo to look for when nothing was played for the whole window
+    if (++updates_ < size or farIdle_ >= size)
+        return false;
+
+    const double near = nearLog - nearMean_;
+    unsigned best = 0;
+    double total = 0;
+    for (unsigned lag = 0; lag < scores_.size(); ++lag) {
+        auto& score = scores_[lag];
+        score += DELAY_SMOOTHING * (near * far_[(pos_ + size - lag) % size] - score);
+        total += std::abs(score);
+        if (score > scores_[best])
+            best = lag;
+    }
+
+    if (scores_[best] <= DELAY_PEAK_FACTOR * total / scores_.size()) {
+        candidateBlocks_ = 0;
+        return false;
+    }
+    if (best != candidate_) {
+        candidate_ = best;
+        candidateBlocks_ = 0;
+    }
+    if (++candidateBlocks_ < DELAY_CONFIRM_BLOCKS or best == delay_)
+        return false;
+    delay_ = best;
+    return true;
+}
+
+//
+// CapturePipeline
+//
+
+CapturePipeline::CapturePipeline()
+    : farEndRingBuffer_("farEnd", SIZEBUF, AudioFormat::MONO())
+    , farEndResampler_(new Resampler{AudioFormat::MONO()})
+    , delayEstimator_(MAX_ECHO_DELAY_BLOCKS)
+{
+    farEndReader_ = farEndRingBuffer_.createReadOffset("capture");
+}
+
+CapturePipeline::~CapturePipeline() = default;
+
+void
+CapturePipeline::addStage(std::unique_ptr<CaptureStage> stage)
+{
+    std::unique_ptr<Stage> s(new Stage);
+    s->stage = std::move(stage);
+    needsFarEnd_ |= s->stage->needsFarEnd();
+    if (blockFrames_)
+        s->stage->setFormat(format_, blockFrames_);
+    stages_.emplace_back(std::move(s));
+}
+
+void
+CapturePipeline::setFormat(AudioFormat format)
+{
+    RING_DBG("Capture processing format: %s", format.toString().c_str());
+    format_ = format;
+    blockFrames_ = format.sample_rate * BLOCK_DURATION.count() / 1000;
+
+    pending_.setFormat(format);
+    pending_.resize(0);
+    work_.setFormat(format);
+    block_.setFormat(format);
+    block_.resize(blockFrames_);
+
+    const AudioFormat farEndFormat {format.sample_rate, 1};
+    farEnd_.setFormat(farEndFormat);
+    farEnd_.resize(0);
+    farEndBlock_.setFormat(farEndFormat);
+    farEndBlock_.resize(blockFrames_);
+    farEndHistory_.setFormat(farEndFormat);
+    farEndHistory_.resize((MAX_ECHO_DELAY_BLOCKS + 1) * blockFrames_);
+    farEndHistory_.reset();
+    farEndHistoryPos_ = 0;
+    delayEstimator_.reset();
+    echoDelay_.store(0, std::memory_order_relaxed);
+
+    for (auto& s : stages_)
+        s->stage->setFormat(format, blockFrames_);
+}
+
+void
+CapturePipeline::process(AudioBuffer& buf)
+{
+    if (stages_.empty())
+        return;
+    if (buf.getFormat() != format_)
+        setFormat(buf.getFormat());
+    if (not blockFrames_)
+        return;
+
+    // held samples first, then the new ones
+    const size_t total = pending_.frames() + buf.frames();
+    const size_t blocks = total / blockFrames_;
+    work_.resize(0);
+    work_.copy(pending_);
+    work_.copy(buf, -1, 0, pending_.frames());
+    buf.resize(blocks * blockFrames_);
+
+    using clock = std::chrono::steady_clock;
+    bool voice = false;
+    for (size_t b = 0; b < blocks; ++b) {
+        block_.copy(work_, blockFrames_, b * blockFrames_, 0);
+        CaptureBlock block {block_, pullFarEnd(block_), true};
+
+        for (auto& s : stages_) {
+            const auto start = clock::now();
+            s->stage->process(block);
+            const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+            s->blocks.fetch_add(1, std::memory_order_relaxed);
+            s->cpuTime.fetch_add(ns, std::memory_order_relaxed);
+            if (ns > s->maxTime.load(std::memory_order_relaxed))
+                s->maxTime.store(ns, std::memory_order_relaxed);
+        }
+
+        voice |= block.voice;
+        buf.copy(block_, blockFrames_, 0, b * blockFrames_);
+    }
+    // voice in any block of buf, unchanged when all its samples are held back
+    if (blocks)
+        voice_.store(voice, std::memory_order_relaxed);
+
+    pending_.resize(0);
+    pending_.copy(work_, total - blocks * blockFrames_, blocks * blockFrames_, 0);
+}
+
+void
+CapturePipeline::putFarEnd(const AudioBuffer& played)
+{
+    if (not needsFarEnd_ or not played.frames())
+        return;
+    farEndRingBuffer_.put(played); // first channel only
+    farEndActive_.store(true, std::memory_order_relaxed);
+}
+
+void
+CapturePipeline::setFarEndFormat(AudioFormat format)
+{
+    farEndRingBuffer_.setFormat({format.sample_rate, 1});
+}
+
+// Far end block matching the echo in the next near end block
+const AudioBufferView*
+CapturePipeline::pullFarEnd(const AudioBuffer& nearEnd)
+{
+    if (not farEndActive_.load(std::memory_order_relaxed))
+        return nullptr;
+
+    if (const size_t avail = farEndRingBuffer_.availableForGet(farEndReader_)) {
+        farEndIn_.setFormat(farEndRingBuffer_.getFormat());
+        farEndIn_.resize(avail);
+        farEndRingBuffer_.get(farEndIn_, farEndReader_);
+        if (farEndIn_.getSampleRate() != static_cast<int>(format_.sample_rate)) {
+            farEndResampled_.setFormat(farEnd_.getFormat());
+            farEndResampler_->resample(farEndIn_, farEndResampled_);
+            farEnd_.copy(farEndResampled_, -1, 0, farEnd_.frames());
+        } else {
+            farEnd_.copy(farEndIn_, -1, 0, farEnd_.frames());
+        }
+    }
+
+    // drop what is too old to still be heard
+    const size_t maxFrames = format_.sample_rate * MAX_FAR_END_DELAY.count() / 1000 + blockFrames_;
+    size_t frames = farEnd_.frames();
+    if (frames > maxFrames) {
+        farEnd_.copy(farEnd_, maxFrames, frames - maxFrames, 0);
+        farEnd_.resize(frames = maxFrames);
+    }
+
+    // silence if nothing was played
+    farEndBlock_.reset();
+    const size_t used = farEndBlock_.copy(farEnd_, blockFrames_, 0, 0);
+    farEnd_.copy(farEnd_, frames - used, used, 0);
+    farEnd_.resize(frames - used);
+
+    const size_t historyBlocks = MAX_ECHO_DELAY_BLOCKS + 1;
+    farEndHistoryPos_ = (farEndHistoryPos_ + 1) % historyBlocks;
+    farEndHistory_.copy(farEndBlock_.view(), farEndHistoryPos_ * blockFrames_);
+
+    if (delayEstimator_.update(meanPower(nearEnd.getChannel(0), blockFrames_),
+                               meanPower(farEndBlock_.getChannel(0), blockFrames_))) {
+        const auto delay = delayEstimator_.delay();
+        RING_DBG("Echo delay estimated to %u ms", unsigned(delay * BLOCK_DURATION.count()));
+        echoDelay_.store(delay, std::memory_order_relaxed);
+        for (auto& s : stages_)
+            s->stage->farEndRealigned();
+    }
+
+    const unsigned lag = echoDelay_.load(std::memory_order_relaxed);
+    const size_t back = lag > ECHO_DELAY_MARGIN_BLOCKS ? lag - ECHO_DELAY_MARGIN_BLOCKS : 0;
+    const size_t pos = (farEndHistoryPos_ + historyBlocks - back) % historyBlocks;
+    farEndView_ = farEndHistory_.view(pos * blockFrames_, blockFrames_);
+    return &farEndView_;
+}
+
+std::vector<CaptureStageStats>
+CapturePipeline::getStats() const
+{
+    std::vector<CaptureStageStats> stats;
+    stats.reserve(stages_.size());
+    for (const auto& s : stages_)
+        stats.push_back({s->stage->name(),
+                         s->blocks.load(std::memory_order_relaxed),
+                         std::chrono::nanoseconds(s->cpuTime.load(std::memory_order_relaxed)),
+                         std::chrono::nanoseconds(s->maxTime.load(std::memory_order_relaxed))});
+    return stats;
+}
+
+} // namespace ring
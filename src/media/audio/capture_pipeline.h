@@ -0,0 +1,236 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "audiobuffer.h"
+#include "lockfreeringbuffer.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ring {
+
+class Resampler;
+
+/**
+ * One block of captured audio going through the pipeline.
+ */
+struct CaptureBlock {
+    AudioBuffer& data;              // near end, processed in place
+    const AudioBufferView* farEnd;  // played samples aligned on the echo (mono, same rate), or nullptr
+    bool voice;                     // voice activity, set by the VAD stage
+};
+
+/**
+ * Capture processing stage: echo cancellation, noise suppression...
+ * Stages are called on the capture thread only, one block at a time.
+ */
+class CaptureStage {
+    public:
+        virtual ~CaptureStage() = default;
+
+        virtual const char* name() const = 0;
+
+        /**
+         * True if the stage uses CaptureBlock::farEnd
+         */
+        virtual bool needsFarEnd() const { return false; }
+
+        /**
+         * Called before the first block and when the capture format changes.
+         * Blocks are always 'frames' long.
+         */
+        virtual void setFormat(AudioFormat format, size_t frames) = 0;
+
+        /**
+         * Called when CaptureBlock::farEnd is realigned on a new echo delay
+         * estimate. State adapted to the previous alignment is stale.
+         */
+        virtual void farEndRealigned() {}
+
+        virtual void process(CaptureBlock& block) = 0;
+};
+
+struct CaptureStageStats {
+    std::string name;
+    uint64_t blocks;
+    std::chrono::nanoseconds cpuTime; // total
+    std::chrono::nanoseconds maxTime; // worst block
+};
+
+/**
+ * Energy based voice activity detector.
+ * Voice is a block well above the tracked noise floor; the decision is held
+ * a little to not cut the end of words.
+ */
+class VoiceActivityDetector : public CaptureStage {
+    public:
+        const char* name() const override { return "vad"; }
+        void setFormat(AudioFormat format, size_t frames) override;
+        void process(CaptureBlock& block) override;
+
+    private:
+        double noiseFloor_ {0};
+        unsigned hangover_ {0};
+};
+
+/**
+ * Echo path delay estimator.
+ * Correlates the log power of near end blocks with the one of the far end
+ * blocks played up to maxLag blocks before. The estimate only moves once
+ * another lag has clearly correlated best for a while.
+ */
+class EchoDelayEstimator {
+    public:
+        explicit EchoDelayEstimator(unsigned maxLag);
+
+        void reset();
+
+        /**
+         * Feed the power of the next near end block and of the far end
+         * block played with it.
+         * @return true if the estimated delay changed
+         */
+        bool update(double nearPower, double farPower);
+
+        /**
+         * Delay of the echo after the far end, in blocks.
+         */
+        unsigned delay() const {
+            return delay_;
+        }
+
+    private:
+        std::vector<double> far_;    // centered far end log power, by block
+        std::vector<double> scores_; // correlation, by lag
+        size_t pos_ {0};
+        uint64_t updates_ {0};
+        unsigned farIdle_ {0};
+        double nearMean_ {0};
+        double farMean_ {0};
+        unsigned delay_ {0};
+        unsigned candidate_ {0};
+        unsigned candidateBlocks_ {0};
+};
+
+/**
+ * Capture processing pipeline.
+ *
+ * Captured samples are cut in 10ms blocks, processed in place by each stage
+ * in order. An incomplete block is held until the next capture, so the
+ * added latency is below one block. The far end reference for echo
+ * cancellation is fed from the playback path, and delayed by the estimated
+ * echo path delay.
+ */
+class CapturePipeline {
+    public:
+        static constexpr std::chrono::milliseconds BLOCK_DURATION {10};
+
+        CapturePipeline();
+        ~CapturePipeline();
+
+        /**
+         * Append a stage. Stages must be added before processing starts.
+         */
+        void addStage(std::unique_ptr<CaptureStage> stage);
+
+        bool empty() const {
+            return stages_.empty();
+        }
+
+        /**
+         * Process captured samples. On return, buf holds the processed
+         * samples of every complete block (possibly none).
+         */
+        void process(AudioBuffer& buf);
+
+        /**
+         * Record played samples as the echo reference. Wait-free, meant for
+         * the playback callback.
+         */
+        void putFarEnd(const AudioBuffer& played);
+
+        /**
+         * Format of the buffers given to putFarEnd().
+         * Must not be called concurrently with putFarEnd() or process().
+         */
+        void setFarEndFormat(AudioFormat format);
+
+        /**
+         * Voice activity of the last processed block.
+         */
+        bool voiceActivity() const {
+            return voice_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Estimated delay of the echo after the far end.
+         */
+        std::chrono::milliseconds echoDelay() const {
+            return echoDelay_.load(std::memory_order_relaxed) * BLOCK_DURATION;
+        }
+
+        std::vector<CaptureStageStats> getStats() const;
+
+    private:
+        NON_COPYABLE(CapturePipeline);
+
+        struct Stage {
+            std::unique_ptr<CaptureStage> stage;
+            std::atomic<uint64_t> blocks {0};
+            std::atomic<uint64_t> cpuTime {0};
+            std::atomic<uint64_t> maxTime {0};
+        };
+
+        void setFormat(AudioFormat format);
+        const AudioBufferView* pullFarEnd(const AudioBuffer& nearEnd);
+
+        std::vector<std::unique_ptr<Stage>> stages_;
+        bool needsFarEnd_ {false};
+        AudioFormat format_ {AudioFormat::NONE()};
+        size_t blockFrames_ {0};
+
+        AudioBuffer pending_; // incomplete block
+        AudioBuffer work_;
+        AudioBuffer block_;
+        std::atomic_bool voice_ {true};
+
+        // far end, in the playback format until pulled on the capture thread
+        LockFreeRingBuffer farEndRingBuffer_;
+        LockFreeRingBuffer::ReaderId farEndReader_;
+        std::atomic_bool farEndActive_ {false};
+        std::unique_ptr<Resampler> farEndResampler_;
+        AudioBuffer farEndIn_;
+        AudioBuffer farEndResampled_;
+        AudioBuffer farEnd_;      // resampled, not yet used
+        AudioBuffer farEndBlock_;
+
+        // last played blocks, the reference is taken back by the echo delay
+        AudioBuffer farEndHistory_;
+        size_t farEndHistoryPos_ {0};
+        AudioBufferView farEndView_;
+        EchoDelayEstimator delayEstimator_;
+        std::atomic<unsigned> echoDelay_ {0}; // blocks
+};
+
+} // namespace ring
@@ -390,7 +390,7 @@ CoreLayer::write(AudioUnitRenderActionFlags* ioActionFlags,
     auto resample = currentOutFormat.sample_rate != mainBufferFormat.sample_rate;
 
     auto normalFramesToGet = bufferPool.availableForGet(RingBufferPool::DEFAULT_ID);
-    auto urgentFramesToGet = urgentRingBuffer_.availableForGet(RingBufferPool::DEFAULT_ID);
+    auto urgentFramesToGet = urgentRingBuffer_.availableForGet(urgentReader_);
 
     double resampleFactor;
     decltype(normalFramesToGet) readableSamples;
@@ -409,7 +409,7 @@ CoreLayer::write(AudioUnitRenderActionFlags* ioActionFlags,
 
         playbackBuff_.setFormat(currentOutFormat);
         playbackBuff_.resize(readableUrgentSamples);
-        urgentRingBuffer_.get(playbackBuff_, RingBufferPool::DEFAULT_ID);
+        urgentRingBuffer_.get(playbackBuff_, urgentReader_);
         playbackBuff_.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
 
         for (unsigned i = 0; i < currentOutFormat.nb_channels; ++i) {
@@ -495,7 +495,7 @@ CoreLayer::read(AudioUnitRenderActionFlags* ioActionFlags,
     for (unsigned i = 0; i < inChannelsPerFrame_; ++i) {
         auto data = reinterpret_cast<Float32*>(captureBuff_->mBuffers[i].mData);
         for (unsigned j = 0; j < inNumberFrames; ++j) {
-            (*inBuff.getChannel(i))[j] = static_cast<AudioSample>(data[j] * 32768);
+            inBuff.getChannel(i)[j] = static_cast<AudioSample>(data[j] * 32768);
         }
     }
 
@@ -504,11 +504,11 @@ CoreLayer::read(AudioUnitRenderActionFlags* ioActionFlags,
         UInt32 outSamples = inNumberFrames * (mainBufferFormat.sample_rate / static_cast<double>(audioInputFormat_.sample_rate));
         auto out = AudioBuffer {outSamples, mainBufferFormat};
         inputResampler_->resample(inBuff, out);
-        dcblocker_.process(out);
-        mainRingBuffer_->put(out);
+        const bool voice = processCapture(out);
+        mainRingBuffer_->put(out, voice);
     } else {
-        dcblocker_.process(inBuff);
-        mainRingBuffer_->put(inBuff);
+        const bool voice = processCapture(inBuff);
+        mainRingBuffer_->put(inBuff, voice);
     }
 }
 
@@ -349,7 +349,7 @@ CoreLayer::read(AudioUnitRenderActionFlags* ioActionFlags,
     for (int i = 0; i < inChannelsPerFrame_; ++i) {
         auto data = reinterpret_cast<Float32*>(captureBuff_->mBuffers[i].mData);
         for (int j = 0; j < inNumberFrames; ++j) {
-            (*inBuff.getChannel(i))[j] = static_cast<AudioSample>(data[j] / .000030517578125f);
+            inBuff.getChannel(i)[j] = static_cast<AudioSample>(data[j] / .000030517578125f);
         }
     }
 
@@ -361,11 +361,11 @@ CoreLayer::read(AudioUnitRenderActionFlags* ioActionFlags,
         UInt32 outSamples = inNumberFrames / (static_cast<double>(audioInputFormat_.sample_rate) / mainBufferFormat.sample_rate);
         auto out = AudioBuffer {outSamples, mainBufferFormat};
         inputResampler_->resample(inBuff, out);
-        dcblocker_.process(out);
-        mainRingBuffer_->put(out);
+        const bool voice = processCapture(out);
+        mainRingBuffer_->put(out, voice);
     } else {
-        dcblocker_.process(inBuff);
-        mainRingBuffer_->put(inBuff);
+        const bool voice = processCapture(inBuff);
+        mainRingBuffer_->put(inBuff, voice);
     }
 }
 
@@ -22,73 +22,114 @@
 #include "dsp.h"
 #include "audiobuffer.h"
 
+#include <algorithm>
+
 namespace ring {
 
+//
+// SpeexEchoCanceller
+//
+
 void
-DSP::speexStateDeleter(SpeexPreprocessState *state)
+SpeexEchoCanceller::stateDeleter(SpeexEchoState* state)
 {
-    speex_preprocess_state_destroy(state);
+    speex_echo_state_destroy(state);
 }
 
-DSP::DSP(int smplPerFrame, int channels, int samplingRate) :
-    smplPerFrame_(smplPerFrame),
-    dspStates_()
+SpeexEchoCanceller::SpeexEchoCanceller(std::chrono::milliseconds tail)
+    : tail_(tail)
+{}
+
+void
+SpeexEchoCanceller::setFormat(AudioFormat format, size_t frames)
 {
-    for (int c = 0; c < channels; ++c)
-        dspStates_.push_back(
-                {speex_preprocess_state_init(smplPerFrame_, samplingRate),
-                 speexStateDeleter});
+    const int filterLength = format.sample_rate * tail_.count() / 1000;
+    int rate = format.sample_rate;
+
+    states_.clear();
+    for (unsigned c = 0; c < format.nb_channels; ++c) {
+        states_.emplace_back(speex_echo_state_init(frames, filterLength), stateDeleter);
+        speex_echo_ctl(states_.back().get(), SPEEX_ECHO_SET_SAMPLING_RATE, &rate);
+    }
+    out_.resize(frames);
 }
 
-void DSP::enableAGC()
+// the filter modeled the echo path against the previous reference
+void
+SpeexEchoCanceller::farEndRealigned()
 {
-    // automatic gain control, range [1-32768]
-    for (const auto &state : dspStates_) {
-        int enable = 1;
-        speex_preprocess_ctl(state.get(), SPEEX_PREPROCESS_SET_AGC, &enable);
-        int target = 16000;
-        speex_preprocess_ctl(state.get(), SPEEX_PREPROCESS_SET_AGC_TARGET, &target);
-    }
+    for (auto& state : states_)
+        speex_echo_state_reset(state.get());
 }
 
-void DSP::disableAGC()
+void
+SpeexEchoCanceller::process(CaptureBlock& block)
 {
-    for (const auto &state : dspStates_) {
-        int enable = 0;
-        speex_preprocess_ctl(state.get(), SPEEX_PREPROCESS_SET_AGC, &enable);
+    // nothing played: nothing to cancel
+    if (not block.farEnd)
+        return;
+
+    const AudioSample* played = block.farEnd->getChannel(0);
+    for (unsigned c = 0; c < block.data.channels() and c < states_.size(); ++c) {
+        AudioSample* rec = block.data.getChannel(c);
+        speex_echo_cancellation(states_[c].get(), rec, played, out_.data());
+        std::copy_n(out_.data(), block.data.frames(), rec);
     }
 }
 
-void DSP::enableDenoise()
+SpeexEchoState*
+SpeexEchoCanceller::getState(unsigned channel) const
 {
-    for (const auto &state : dspStates_) {
-        int enable = 1;
-        speex_preprocess_ctl(state.get(), SPEEX_PREPROCESS_SET_DENOISE, &enable);
-    }
+    return channel < states_.size() ? states_[channel].get() : nullptr;
 }
 
-void DSP::disableDenoise()
+//
+// SpeexPreprocessor
+//
+
+void
+SpeexPreprocessor::stateDeleter(SpeexPreprocessState* state)
 {
-    for (const auto &state : dspStates_) {
-        int enable = 0;
-        speex_preprocess_ctl(state.get(), SPEEX_PREPROCESS_SET_DENOISE, &enable);
-    }
+    speex_preprocess_state_destroy(state);
 }
 
-void DSP::process(AudioBuffer& buff, int samples)
+SpeexPreprocessor::SpeexPreprocessor(bool denoise, bool agc, const SpeexEchoCanceller* echo)
+    : denoise_(denoise)
+    , agc_(agc)
+    , echo_(echo)
+{}
+
+void
+SpeexPreprocessor::setFormat(AudioFormat format, size_t frames)
 {
-    if (samples != smplPerFrame_) {
-        RING_WARN("Unexpected amount of samples");
-        return;
-    }
+    states_.clear();
+    for (unsigned c = 0; c < format.nb_channels; ++c) {
+        states_.emplace_back(speex_preprocess_state_init(frames, format.sample_rate), stateDeleter);
+        auto state = states_.back().get();
 
-    auto &channelData = buff.getData();
-    size_t index = 0;
-    for (auto &c : channelData) {
-        if (index < dspStates_.size() and dspStates_[index].get())
-            speex_preprocess_run(dspStates_[index].get(), c.data());
-        ++index;
+        int enable = denoise_;
+        speex_preprocess_ctl(state, SPEEX_PREPROCESS_SET_DENOISE, &enable);
+
+        // automatic gain control, range [1-32768]
+        enable = agc_;
+        speex_preprocess_ctl(state, SPEEX_PREPROCESS_SET_AGC, &enable);
+        if (agc_) {
+            int target = 16000;
+            speex_preprocess_ctl(state, SPEEX_PREPROCESS_SET_AGC_TARGET, &target);
+        }
+
+        // the echo canceller stage is set up first
+        if (echo_)
+            if (auto echoState = echo_->getState(c))
+                speex_preprocess_ctl(state, SPEEX_PREPROCESS_SET_ECHO_STATE, echoState);
     }
 }
 
+void
+SpeexPreprocessor::process(CaptureBlock& block)
+{
+    for (unsigned c = 0; c < block.data.channels() and c < states_.size(); ++c)
+        speex_preprocess_run(states_[c].get(), block.data.getChannel(c));
+}
+
 } // namespace ring
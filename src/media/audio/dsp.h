@@ -21,33 +21,69 @@
 #ifndef DSP_H_
 #define DSP_H_
 
-#include <cstdint>
+#include "capture_pipeline.h"
+#include "noncopyable.h"
+
+#include <speex/speex_echo.h>
 #include <speex/speex_preprocess.h>
-#include <vector>
+
+#include <chrono>
 #include <memory>
-#include "noncopyable.h"
+#include <vector>
 
 namespace ring {
 
-class AudioBuffer;
+/**
+ * Acoustic echo canceller (speexdsp MDF filter), one state per capture
+ * channel, all using the mono far end reference.
+ */
+class SpeexEchoCanceller : public CaptureStage {
+    public:
+        /**
+         * @param tail longest echo path cancelled
+         */
+        SpeexEchoCanceller(std::chrono::milliseconds tail = std::chrono::milliseconds(200));
+
+        const char* name() const override { return "aec"; }
+        bool needsFarEnd() const override { return true; }
+        void setFormat(AudioFormat format, size_t frames) override;
+        void farEndRealigned() override;
+        void process(CaptureBlock& block) override;
+
+        SpeexEchoState* getState(unsigned channel) const;
+
+    private:
+        NON_COPYABLE(SpeexEchoCanceller);
+        static void stateDeleter(SpeexEchoState* state);
+        using StatePtr = std::unique_ptr<SpeexEchoState, decltype(&stateDeleter)>;
+
+        const std::chrono::milliseconds tail_;
+        std::vector<StatePtr> states_;
+        std::vector<AudioSample> out_;
+};
 
-class DSP {
+/**
+ * Noise suppression and automatic gain control (speexdsp preprocessor),
+ * one state per channel. Also suppresses the residual echo when given the
+ * echo canceller preceding it in the pipeline.
+ */
+class SpeexPreprocessor : public CaptureStage {
     public:
-        DSP(int smplPerFrame, int channels, int samplingRate);
-        void enableAGC();
-        void disableAGC();
-        void enableDenoise();
-        void disableDenoise();
-        void process(AudioBuffer& buf, int samples);
+        SpeexPreprocessor(bool denoise, bool agc, const SpeexEchoCanceller* echo = nullptr);
+
+        const char* name() const override { return "preprocess"; }
+        void setFormat(AudioFormat format, size_t frames) override;
+        void process(CaptureBlock& block) override;
 
     private:
-        NON_COPYABLE(DSP);
-        static void speexStateDeleter(SpeexPreprocessState *state);
-        typedef std::unique_ptr<SpeexPreprocessState, decltype(&speexStateDeleter)> SpeexStatePtr;
+        NON_COPYABLE(SpeexPreprocessor);
+        static void stateDeleter(SpeexPreprocessState* state);
+        using StatePtr = std::unique_ptr<SpeexPreprocessState, decltype(&stateDeleter)>;
 
-        int smplPerFrame_;
-        // one state per channel
-        std::vector<SpeexStatePtr> dspStates_;
+        const bool denoise_;
+        const bool agc_;
+        const SpeexEchoCanceller* echo_;
+        std::vector<StatePtr> states_;
 };
 
 } // namespace ring
@@ -76,7 +76,7 @@ void JackLayer::fillWithUrgent(AudioBuffer &buffer, size_t samplesToGet)
     // Urgent data (dtmf, incoming call signal) come first.
     samplesToGet = std::min(samplesToGet, hardwareBufferSize_);
     buffer.resize(samplesToGet);
-    urgentRingBuffer_.get(buffer, RingBufferPool::DEFAULT_ID);
+    urgentRingBuffer_.get(buffer, urgentReader_);
     buffer.applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
 
     // Consume the regular one as well (same amount of samples)
@@ -103,7 +103,7 @@ void JackLayer::fillWithVoice(AudioBuffer &buffer, size_t samplesAvail)
 void JackLayer::fillWithToneOrRingtone(AudioBuffer &buffer)
 {
     buffer.resize(hardwareBufferSize_);
-    AudioLoop *tone = Manager::instance().getTelephoneTone();
+    auto tone = Manager::instance().getTelephoneTone();
     AudioLoop *file_tone = Manager::instance().getTelephoneFile();
 
     // In case of a dtmf, the pointers will be set to nullptr once the dtmf length is
@@ -123,7 +123,7 @@ JackLayer::playback()
     notifyIncomingCall();
 
     const size_t samplesToGet = Manager::instance().getRingBufferPool().availableForGet(RingBufferPool::DEFAULT_ID);
-    const size_t urgentSamplesToGet = urgentRingBuffer_.availableForGet(RingBufferPool::DEFAULT_ID);
+    const size_t urgentSamplesToGet = urgentRingBuffer_.availableForGet(urgentReader_);
 
     if (urgentSamplesToGet > 0) {
         fillWithUrgent(playbackBuffer_, urgentSamplesToGet);
@@ -154,19 +154,19 @@ JackLayer::capture()
         int outSamples = captureBuffer_.frames() * (static_cast<double>(audioFormat_.sample_rate) / mainBufferFormat.sample_rate);
         AudioBuffer out(outSamples, mainBufferFormat);
         resampler_->resample(captureBuffer_, out);
-        dcblocker_.process(out);
-        mainRingBuffer_->put(out);
+        const bool voice = processCapture(out);
+        mainRingBuffer_->put(out, voice);
     } else {
-        dcblocker_.process(captureBuffer_);
-        mainRingBuffer_->put(captureBuffer_);
+        const bool voice = processCapture(captureBuffer_);
+        mainRingBuffer_->put(captureBuffer_, voice);
     }
 }
 
 static void
-convertToFloat(const std::vector<AudioSample> &src, std::vector<float> &dest)
+convertToFloat(const AudioSample* src, size_t n, std::vector<float> &dest)
 {
     static const float INV_SHORT_MAX = 1 / (float) SHRT_MAX;
-    if (dest.size() != src.size()) {
+    if (dest.size() != n) {
         RING_ERR("MISMATCH");
         return;
     }
@@ -175,13 +175,13 @@ convertToFloat(const std::vector<AudioSample> &src, std::vector<float> &dest)
 }
 
 static void
-convertFromFloat(std::vector<float> &src, std::vector<AudioSample> &dest)
+convertFromFloat(std::vector<float> &src, AudioSample* dest, size_t n)
 {
-    if (dest.size() != src.size()) {
+    if (n != src.size()) {
         RING_ERR("MISMATCH");
         return;
     }
-    for (size_t i = 0; i < dest.size(); ++i)
+    for (size_t i = 0; i < n; ++i)
         dest[i] = src[i] * SHRT_MAX;
 }
 
@@ -190,7 +190,7 @@ JackLayer::write(AudioBuffer &buffer, std::vector<float> &floatBuffer)
 {
     for (unsigned i = 0; i < out_ringbuffers_.size(); ++i) {
         const unsigned inChannel = std::min(i, buffer.channels() - 1);
-        convertToFloat(*buffer.getChannel(inChannel), floatBuffer);
+        convertToFloat(buffer.getChannel(inChannel), buffer.frames(), floatBuffer);
 
         // write to output
         const size_t to_ringbuffer = jack_ringbuffer_write_space(out_ringbuffers_[i]);
@@ -230,7 +230,7 @@ JackLayer::read(AudioBuffer &buffer)
          * inefficient, but makes things simpler. */
         // FIXME: this is braindead, we should write blocks of samples at a time
         // convert a vector of samples from 1 channel to a float vector
-        convertFromFloat(captureFloatBuffer_, *buffer.getChannel(i));
+        convertFromFloat(captureFloatBuffer_, buffer.getChannel(i), buffer.frames());
     }
 }
 
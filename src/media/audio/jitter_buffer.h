@@ -0,0 +1,272 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+
+namespace ring {
+
+struct JitterBufferStats {
+    uint64_t received {0};   // packets queued
+    uint64_t late {0};       // packets arrived after their playout time, dropped
+    uint64_t duplicates {0}; // packets received twice, dropped
+    uint64_t concealed {0};  // frames missing at playout time
+    uint64_t expanded {0};   // frames inserted to grow the playout delay
+    uint64_t compressed {0}; // frames dropped to shrink the playout delay
+    uint64_t rebuffers {0};  // playout restarts after a long gap
+    std::chrono::microseconds jitter {0};      // RFC 3550 interarrival jitter
+    std::chrono::microseconds targetDelay {0}; // delay wanted from observed jitter
+    std::chrono::microseconds playoutDelay {0};// delay currently applied
+};
+
+/**
+ * Adaptive jitter buffer for one media stream.
+ *
+ * Packets are queued in timestamp order with their arrival time. Each
+ * packet has a playout deadline: its media time, mapped to the local clock
+ * using the fastest transit observed before playout started, plus a playout
+ * delay. The playout delay follows a target derived from the interarrival
+ * jitter, by whole frames: a concealment frame is inserted to grow it, a
+ * packet is dropped to shrink it.
+ *
+ * Timestamps are media times in microseconds. Not thread-safe.
+ */
+template <typename Packet>
+class JitterBuffer {
+    public:
+        using clock = std::chrono::steady_clock;
+        using duration = std::chrono::microseconds;
+
+        enum class Result {
+            Wait,    // nothing to play yet
+            Play,    // a packet is due
+            Conceal  // a frame is due but missing, conceal it
+        };
+
+        JitterBuffer(duration minDelay = std::chrono::milliseconds(20),
+                     duration maxDelay = std::chrono::milliseconds(400))
+            : minDelay_(minDelay.count())
+            , maxDelay_(maxDelay.count())
+            , target_(minDelay_)
+            , playoutDelay_(minDelay_)
+        {}
+
+        /**
+         * Queue a packet received at 'arrival'.
+         * @return false if the packet was dropped (late or duplicate)
+         */
+        bool put(int64_t ts, Packet&& packet, clock::time_point arrival) {
+            const int64_t transit = toUs(arrival) - ts;
+            if (hasTransit_) {
+                const double d = std::abs(transit - lastTransit_);
+                jitter_ += (d - jitter_) / 16.;
+            }
+            lastTransit_ = transit;
+            hasTransit_ = true;
+            updateTarget();
+
+            if (started_) {
+                if (ts < nextTs_) {
+                    ++stats_.late;
+                    // our clock may be ahead of the sender one: delay the schedule
+                    offset_ += frameDuration_ / 2;
+                    return false;
+                }
+            } else if (queue_.empty() or transit < offset_) {
+                offset_ = transit;
+            }
+
+            const auto it = queue_.emplace(ts, std::move(packet));
+            if (not it.second) {
+                ++stats_.duplicates;
+                return false;
+            }
+            learnFrameDuration(it.first);
+            ++stats_.received;
+
+            // never queue more than the maximum delay
+            while (queue_.size() > 1 and span() > maxDelay_ + frameDuration_) {
+                queue_.erase(queue_.begin());
+                ++stats_.compressed;
+                if (started_)
+                    nextTs_ = queue_.begin()->first;
+            }
+            return true;
+        }
+
+        /**
+         * Get what must be played at 'now'.
+         * On Result::Play, 'packet' is moved from the queue.
+         */
+        Result get(clock::time_point now, Packet& packet) {
+            const int64_t nowUs = toUs(now);
+            if (not started_) {
+                if (queue_.empty() or nowUs < deadline(queue_.begin()->first))
+                    return Result::Wait;
+                started_ = true;
+                nextTs_ = queue_.begin()->first;
+                missing_ = 0;
+            }
+
+            if (nowUs < deadline(nextTs_))
+                return Result::Wait;
+
+            // grow the playout delay by playing a concealment frame
+            if (target_ > playoutDelay_ + frameDuration_ / 2) {
+                playoutDelay_ += frameDuration_;
+                ++stats_.expanded;
+                return Result::Conceal;
+            }
+
+            auto it = queue_.begin();
+            if (it != queue_.end() and it->first <= nextTs_ + frameDuration_ / 2) {
+                // shrink the playout delay, or catch up with a faster sender clock
+                const bool tooLong = span() > playoutDelay_ + 2 * frameDuration_;
+                if ((target_ + frameDuration_ < playoutDelay_ or tooLong)
+                    and std::next(it) != queue_.end()) {
+                    if (tooLong)
+                        offset_ -= frameDuration_;
+                    else
+                        playoutDelay_ -= frameDuration_;
+                    queue_.erase(it);
+                    it = queue_.begin();
+                    ++stats_.compressed;
+                }
+                packet = std::move(it->second);
+                nextTs_ = it->first + frameDuration_;
+                queue_.erase(it);
+                missing_ = 0;
+                return Result::Play;
+            }
+
+            // Stop concealing after a long gap (DTX, hold...) and restart
+            // from the next packet, with a fresh clock mapping.
+            if (queue_.empty() and ++missing_ * frameDuration_ > maxDelay_) {
+                started_ = false;
+                hasTransit_ = false;
+                ++stats_.rebuffers;
+                return Result::Wait;
+            }
+
+            nextTs_ += frameDuration_;
+            ++stats_.concealed;
+            return Result::Conceal;
+        }
+
+        /**
+         * Time at which get() may return something else than Wait,
+         * or clock::time_point::max() if the buffer is empty and idle.
+         */
+        clock::time_point nextDeadline() const {
+            if (started_)
+                return fromUs(deadline(nextTs_));
+            if (queue_.empty())
+                return clock::time_point::max();
+            return fromUs(deadline(queue_.begin()->first));
+        }
+
+        void reset() {
+            queue_.clear();
+            started_ = false;
+            hasTransit_ = false;
+        }
+
+        bool empty() const {
+            return queue_.empty();
+        }
+
+        JitterBufferStats getStats() const {
+            auto stats = stats_;
+            stats.jitter = duration(static_cast<int64_t>(jitter_));
+            stats.targetDelay = duration(target_);
+            stats.playoutDelay = duration(playoutDelay_);
+            return stats;
+        }
+
+    private:
+        static constexpr int64_t DEFAULT_FRAME_DURATION {20000};
+        // playout delay wanted, in number of times the jitter
+        static constexpr unsigned JITTER_FACTOR {4};
+
+        static int64_t toUs(clock::time_point t) {
+            return std::chrono::duration_cast<duration>(t.time_since_epoch()).count();
+        }
+
+        static clock::time_point fromUs(int64_t us) {
+            return clock::time_point(std::chrono::duration_cast<clock::duration>(duration(us)));
+        }
+
+        int64_t deadline(int64_t ts) const {
+            return ts + offset_ + playoutDelay_;
+        }
+
+        int64_t span() const {
+            return queue_.rbegin()->first + frameDuration_ - queue_.begin()->first;
+        }
+
+        // Grow quickly when jitter rises, shrink slowly
+        void updateTarget() {
+            const int64_t wanted = std::max(minDelay_,
+                std::min(maxDelay_, static_cast<int64_t>(JITTER_FACTOR * jitter_)));
+            if (wanted > target_)
+                target_ = wanted;
+            else
+                target_ -= (target_ - wanted) / 64;
+        }
+
+        // Frame duration is the smallest gap seen between packets
+        void learnFrameDuration(typename std::map<int64_t, Packet>::iterator it) {
+            auto update = [this](int64_t d) {
+                if (d > 0 and (not frameDurationKnown_ or d < frameDuration_)) {
+                    frameDuration_ = d;
+                    frameDurationKnown_ = true;
+                }
+            };
+            if (it != queue_.begin())
+                update(it->first - std::prev(it)->first);
+            if (std::next(it) != queue_.end())
+                update(std::next(it)->first - it->first);
+        }
+
+        const int64_t minDelay_;
+        const int64_t maxDelay_;
+
+        std::map<int64_t, Packet> queue_;
+        int64_t frameDuration_ {DEFAULT_FRAME_DURATION};
+        bool frameDurationKnown_ {false};
+
+        double jitter_ {0};
+        int64_t lastTransit_ {0};
+        bool hasTransit_ {false};
+        int64_t target_;
+        int64_t playoutDelay_;
+
+        bool started_ {false};
+        int64_t offset_ {0};  // local time - media time
+        int64_t nextTs_ {0};
+        int64_t missing_ {0};
+
+        JitterBufferStats stats_;
+};
+
+} // namespace ring
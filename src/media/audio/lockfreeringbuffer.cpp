@@ -0,0 +1,280 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "lockfreeringbuffer.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace ring {
+
+// same minimum as RingBuffer
+static const size_t MIN_BUFFER_SIZE = 1024;
+
+constexpr LockFreeRingBuffer::ReaderId LockFreeRingBuffer::INVALID_READER;
+constexpr size_t LockFreeRingBuffer::MAX_READERS;
+
+LockFreeRingBuffer::LockFreeRingBuffer(const std::string& rbuf_id, size_t size,
+                                       AudioFormat format /* = MONO */)
+    : id(rbuf_id)
+    , buffer_(std::max(size, MIN_BUFFER_SIZE), format)
+{}
+
+void*
+LockFreeRingBuffer::operator new(size_t size)
+{
+    constexpr size_t alignment = alignof(LockFreeRingBuffer);
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size, alignment);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size))
+        ptr = nullptr;
+#endif
+    if (not ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void
+LockFreeRingBuffer::operator delete(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void
+LockFreeRingBuffer::setFormat(AudioFormat format)
+{
+    const auto frames = buffer_.frames();
+    buffer_.setFormat(format);
+    buffer_.resize(frames);
+    buffer_.reset();
+    flushAll();
+}
+
+LockFreeRingBuffer::ReaderId
+LockFreeRingBuffer::createReadOffset(const std::string& call_id)
+{
+    std::lock_guard<std::mutex> l(readersLock_);
+
+    const auto it = readerIds_.find(call_id);
+    if (it != readerIds_.cend())
+        return it->second;
+
+    for (ReaderId i = 0; i < (ReaderId)MAX_READERS; ++i) {
+        auto& r = readers_[i];
+        if (r.active.load(std::memory_order_relaxed))
+            continue;
+        r.pos.store(writePos_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        r.active.store(true, std::memory_order_release);
+        readerIds_.emplace(call_id, i);
+        return i;
+    }
+
+    RING_ERR("LockFreeRingBuffer '%s': no reader slot left for '%s'",
+             id.c_str(), call_id.c_str());
+    return INVALID_READER;
+}
+
+void
+LockFreeRingBuffer::removeReadOffset(const std::string& call_id)
+{
+    std::lock_guard<std::mutex> l(readersLock_);
+
+    const auto it = readerIds_.find(call_id);
+    if (it == readerIds_.cend())
+        return;
+
+    readers_[it->second].active.store(false, std::memory_order_release);
+    readerIds_.erase(it);
+}
+
+LockFreeRingBuffer::ReaderId
+LockFreeRingBuffer::getReader(const std::string& call_id) const
+{
+    std::lock_guard<std::mutex> l(readersLock_);
+
+    const auto it = readerIds_.find(call_id);
+    return it != readerIds_.cend() ? it->second : INVALID_READER;
+}
+
+size_t
+LockFreeRingBuffer::readOffsetCount() const
+{
+    std::lock_guard<std::mutex> l(readersLock_);
+    return readerIds_.size();
+}
+
+//
+// For the writer only:
+//
+
+void
+LockFreeRingBuffer::put(const AudioBuffer& buf)
+{
+    const size_t buffer_size = buffer_.frames();
+    const unsigned in_chans = buf.channels();
+    if (buffer_size == 0 or in_chans == 0)
+        return;
+
+    size_t toCopy = buf.frames();
+    size_t in_pos = 0;
+    uint64_t w = writePos_.load(std::memory_order_relaxed);
+
+    // Only the last buffer_size frames can be kept
+    if (toCopy > buffer_size) {
+        in_pos = toCopy - buffer_size;
+        w += in_pos;
+        toCopy = buffer_size;
+    }
+
+    size_t pos = w % buffer_size;
+    const uint64_t end = w + toCopy;
+
+    // readers of the slots we are about to overwrite must see it
+    writeEnd_.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    while (toCopy) {
+        const size_t block = std::min(toCopy, buffer_size - pos);
+        // Upmix: missing input channels are taken from the last one
+        for (unsigned c = 0, n = buffer_.channels(); c < n; ++c) {
+            const auto* src = buf.getChannel(std::min(c, in_chans - 1)) + in_pos;
+            std::memcpy(buffer_.getChannel(c) + pos, src, block * sizeof(AudioSample));
+        }
+        in_pos += block;
+        pos = (pos + block) % buffer_size;
+        toCopy -= block;
+    }
+
+    writePos_.store(end, std::memory_order_release);
+}
+
+//
+// For the readers only:
+//
+
+size_t
+LockFreeRingBuffer::availableForGet(ReaderId reader) const
+{
+    if (not isValid(reader))
+        return 0;
+    const uint64_t w = writePos_.load(std::memory_order_acquire);
+    const uint64_t r = readers_[reader].pos.load(std::memory_order_acquire);
+    return std::min<uint64_t>(w - std::min(w, r), buffer_.frames());
+}
+
+size_t
+LockFreeRingBuffer::get(AudioBuffer& buf, ReaderId reader)
+{
+    if (not isValid(reader))
+        return 0;
+
+    const size_t buffer_size = buffer_.frames();
+    if (buffer_size == 0)
+        return 0;
+
+    auto& cursor = readers_[reader].pos;
+    const uint64_t w = writePos_.load(std::memory_order_acquire);
+    uint64_t r = std::min(cursor.load(std::memory_order_acquire), w);
+
+    // skip the frames already overwritten, or being overwritten
+    const uint64_t oldest = writeEnd_.load(std::memory_order_acquire);
+    if (oldest - r > buffer_size) {
+        const uint64_t skipped = std::min(oldest - buffer_size, w) - r;
+        overruns_.fetch_add(skipped, std::memory_order_relaxed);
+        r += skipped;
+    }
+
+    const size_t copied = std::min<uint64_t>(w - r, buf.frames());
+    if (copied == 0)
+        return 0;
+
+    const unsigned in_chans = buffer_.channels();
+    size_t toCopy = copied;
+    size_t dest = 0;
+    size_t pos = r % buffer_size;
+
+    while (toCopy) {
+        const size_t block = std::min(toCopy, buffer_size - pos);
+        for (unsigned c = 0, n = buf.channels(); c < n; ++c) {
+            const auto* src = buffer_.getChannel(std::min(c, in_chans - 1)) + pos;
+            std::memcpy(buf.getChannel(c) + dest, src, block * sizeof(AudioSample));
+        }
+        dest += block;
+        pos = (pos + block) % buffer_size;
+        toCopy -= block;
+    }
+
+    // Frames overwritten by the producer while we were reading are dropped,
+    // including those of a put() still copying
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t end = writeEnd_.load(std::memory_order_relaxed);
+    if (end > r + buffer_size) {
+        const size_t lost = std::min<uint64_t>(end - r - buffer_size, copied);
+        for (unsigned c = 0, n = buf.channels(); c < n; ++c)
+            std::fill_n(buf.getChannel(c), lost, 0);
+        overruns_.fetch_add(lost, std::memory_order_relaxed);
+    }
+
+    cursor.store(r + copied, std::memory_order_release);
+    return copied;
+}
+
+size_t
+LockFreeRingBuffer::discard(size_t toDiscard, ReaderId reader)
+{
+    if (not isValid(reader))
+        return 0;
+
+    auto& cursor = readers_[reader].pos;
+    const uint64_t w = writePos_.load(std::memory_order_acquire);
+    const uint64_t r = std::min(cursor.load(std::memory_order_acquire), w);
+    toDiscard = std::min<uint64_t>(toDiscard, w - r);
+    cursor.store(r + toDiscard, std::memory_order_release);
+    return toDiscard;
+}
+
+void
+LockFreeRingBuffer::flush(ReaderId reader)
+{
+    if (isValid(reader))
+        readers_[reader].pos.store(writePos_.load(std::memory_order_acquire),
+                                   std::memory_order_release);
+}
+
+void
+LockFreeRingBuffer::flushAll()
+{
+    const uint64_t w = writePos_.load(std::memory_order_acquire);
+    for (auto& r : readers_)
+        r.pos.store(w, std::memory_order_release);
+}
+
+} // namespace ring
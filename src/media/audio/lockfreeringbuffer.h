@@ -0,0 +1,175 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "audiobuffer.h"
+#include "noncopyable.h"
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+namespace ring {
+
+/**
+ * A wait-free single producer / multiple readers ring buffer for
+ * multichannel audio samples.
+ *
+ * Unlike RingBuffer, put() and get() never take a lock nor allocate:
+ * the write position is an atomic frame counter and every reader owns an
+ * atomic cursor. Readers are registered by name once with createReadOffset()
+ * (control path, may lock) which returns an integer handle used for all
+ * the real-time operations.
+ *
+ * The producer never waits for readers: a reader lagging more than the
+ * buffer capacity loses the oldest frames, as RingBuffer does.
+ *
+ * Threading contract:
+ *  - put() is called by a single thread at a time.
+ *  - get(), discard(), flush() and availableForGet() for a given handle
+ *    are called by a single thread at a time (different handles can be
+ *    served concurrently).
+ *  - setFormat() reallocates the storage and must not run concurrently
+ *    with any other operation.
+ */
+class LockFreeRingBuffer {
+    public:
+        using ReaderId = int;
+        static constexpr ReaderId INVALID_READER = -1;
+        static constexpr size_t MAX_READERS = 32;
+
+        LockFreeRingBuffer(const std::string& id, size_t size,
+                           AudioFormat format = AudioFormat::MONO());
+
+        // Cache line aligned storage, that the C++14 operator new doesn't
+        // provide for over-aligned types (and so neither does make_shared)
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr);
+
+        inline AudioFormat getFormat() const {
+            return buffer_.getFormat();
+        }
+
+        void setFormat(AudioFormat format);
+
+        /**
+         * Register a reader named call_id.
+         * If call_id is already registered its handle is returned.
+         * @return reader handle or INVALID_READER if no slot is left
+         */
+        ReaderId createReadOffset(const std::string& call_id);
+
+        /**
+         * Unregister the reader named call_id.
+         */
+        void removeReadOffset(const std::string& call_id);
+
+        /**
+         * Return the handle of an already registered reader,
+         * or INVALID_READER.
+         */
+        ReaderId getReader(const std::string& call_id) const;
+
+        size_t readOffsetCount() const;
+
+        /**
+         * Write the whole content of buf. Never blocks.
+         */
+        void put(const AudioBuffer& buf);
+
+        /**
+         * Number of frames available for the given reader.
+         */
+        size_t availableForGet(ReaderId reader) const;
+
+        /**
+         * Copy at most buf.frames() frames into buf.
+         * Frames overwritten by the producer during the copy are replaced
+         * by silence.
+         * @return number of frames copied
+         */
+        size_t get(AudioBuffer& buf, ReaderId reader);
+
+        /**
+         * Skip at most toDiscard frames for the given reader.
+         * @return number of frames discarded
+         */
+        size_t discard(size_t toDiscard, ReaderId reader);
+
+        /**
+         * Move the reader cursor to the current write position.
+         */
+        void flush(ReaderId reader);
+
+        /**
+         * Flush all readers. When called concurrently with a get() on the
+         * same reader, the flush may be overridden by the reader progress.
+         */
+        void flushAll();
+
+        /**
+         * Total number of frames lost by readers because the producer
+         * overtook them.
+         */
+        uint64_t overrunCount() const {
+            return overruns_.load(std::memory_order_relaxed);
+        }
+
+        const std::string id;
+
+    private:
+        NON_COPYABLE(LockFreeRingBuffer);
+
+        // One cache line each to avoid false sharing between readers
+        struct alignas(64) Reader {
+            std::atomic<bool> active {false};
+            std::atomic<uint64_t> pos {0};
+        };
+        static_assert(sizeof(Reader) == 64, "Reader must fill exactly one cache line");
+
+        bool isValid(ReaderId reader) const {
+            return reader >= 0 and reader < (ReaderId)MAX_READERS
+                and readers_[reader].active.load(std::memory_order_acquire);
+        }
+
+        /** Number of frames ever written */
+        alignas(64) std::atomic<uint64_t> writePos_ {0};
+
+        /**
+         * End of the put() in progress, published before its copy (seqlock):
+         * frames before writeEnd_ - size may have been overwritten.
+         */
+        std::atomic<uint64_t> writeEnd_ {0};
+
+        std::array<Reader, MAX_READERS> readers_;
+
+        std::atomic<uint64_t> overruns_ {0};
+
+        /** Data */
+        AudioBuffer buffer_;
+
+        /** Protects the name to handle mapping (control path only) */
+        mutable std::mutex readersLock_;
+        std::map<std::string, ReaderId> readerIds_;
+};
+
+} // namespace ring
@@ -457,11 +457,11 @@ void OpenSLLayer::audioCaptureFillBuffer(AudioBuffer &buffer)
         int outSamples = buffer.frames() * (static_cast<double>(audioFormat_.sample_rate) / mainBufferFormat.sample_rate);
         AudioBuffer out(outSamples, mainBufferFormat);
         resampler_->resample(buffer, out);
-        dcblocker_.process(out);
-        mainRingBuffer_->put(out);
+        const bool voice = processCapture(out);
+        mainRingBuffer_->put(out, voice);
     } else {
-        dcblocker_.process(buffer);
-        mainRingBuffer_->put(buffer);
+        const bool voice = processCapture(buffer);
+        mainRingBuffer_->put(buffer, voice);
     }
 }
 
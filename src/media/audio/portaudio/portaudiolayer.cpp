@@ -275,14 +275,14 @@ PortAudioLayer::PortAudioLayerImpl::paOutputCallback(PortAudioLayer& parent,
     auto layer_format = parent.audioFormat_;
     auto resample = layer_format.sample_rate != mainbuffer_format.sample_rate;
 
-    auto urgentFramesToGet = parent.urgentRingBuffer_.availableForGet(RingBufferPool::DEFAULT_ID);
+    auto urgentFramesToGet = parent.urgentRingBuffer_.availableForGet(parent.urgentReader_);
     if (urgentFramesToGet > 0) {
         RING_WARN("Getting urgent frames");
         auto totSample = std::min(framesPerBuffer, (unsigned long)urgentFramesToGet);
 
         playbackBuff_.setFormat(layer_format);
         playbackBuff_.resize(totSample);
-        parent.urgentRingBuffer_.get(playbackBuff_, RingBufferPool::DEFAULT_ID);
+        parent.urgentRingBuffer_.get(playbackBuff_, parent.urgentReader_);
 
         playbackBuff_.applyGain(parent.isPlaybackMuted_ ? 0.0 : parent.playbackGain_);
         playbackBuff_.interleave(outputBuffer);
@@ -368,11 +368,11 @@ PortAudioLayer::PortAudioLayerImpl::paInputCallback(PortAudioLayer& parent,
         auto outSamples = framesPerBuffer / sample_factor;
         AudioBuffer out(outSamples, mainBufferFormat);
         parent.inputResampler_->resample(inBuff, out);
-        parent.dcblocker_.process(out);
-        mainRingBuffer_->put(out);
+        const bool voice = parent.processCapture(out);
+        mainRingBuffer_->put(out, voice);
     } else {
-        parent.dcblocker_.process(inBuff);
-        mainRingBuffer_->put(inBuff);
+        const bool voice = parent.processCapture(inBuff);
+        mainRingBuffer_->put(inBuff, voice);
     }
     return paContinue;
 }
@@ -481,9 +481,9 @@ void PulseLayer::readFromMic()
         out = &micBuffer_;
     }
 
-    dcblocker_.process(*out);
+    const bool voice = processCapture(*out);
     out->applyGain(isPlaybackMuted_ ? 0.0 : playbackGain_);
-    mainRingBuffer_->put(*out);
+    mainRingBuffer_->put(*out, voice);
 
     if (pa_stream_drop(record_->stream()) < 0)
         RING_ERR("Capture stream drop failed: %s" , pa_strerror(pa_context_errno(context_)));
@@ -0,0 +1,227 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "recording_service.h"
+#include "audiorecorder.h"
+#include "audiorecord.h"
+#include "ringbufferpool.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ring {
+
+constexpr std::chrono::milliseconds RecordingService::CHUNK_DURATION;
+
+static constexpr auto TICK_DURATION = std::chrono::milliseconds(20);
+
+RecordingService::RecordingService()
+    : nextTick_(std::chrono::steady_clock::now())
+    , ioLoop_([]{ return true; },
+              [this]{ write(); },
+              []{})
+    , loop_([]{ return true; },
+            [this]{ collect(); },
+            []{})
+{
+    ioLoop_.start();
+    loop_.start();
+}
+
+RecordingService::~RecordingService()
+{
+    loop_.stop();
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (not recorders_.empty())
+            RING_WARN("Recording service stopped with %zu recordings", recorders_.size());
+    }
+    cv_.notify_all();
+    loop_.join();
+
+    ioLoop_.stop();
+    {
+        std::lock_guard<std::mutex> lk(ioMutex_);
+    }
+    ioCv_.notify_all();
+    ioLoop_.join();
+}
+
+void
+RecordingService::add(AudioRecorder& rec)
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        recorders_.emplace_back(&rec);
+    }
+    cv_.notify_all();
+    RING_DBG("[recorder:%s] Start recording", rec.recorderId_.c_str());
+}
+
+void
+RecordingService::remove(AudioRecorder& rec)
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        const auto it = std::find(recorders_.begin(), recorders_.end(), &rec);
+        if (it == recorders_.end())
+            return;
+        recorders_.erase(it);
+        collect(rec);
+    }
+
+    // write the chunk being filled once the other one is done
+    std::unique_lock<std::mutex> lk(ioMutex_);
+    ioCv_.wait(lk, [&]{ return not rec.writing_; });
+    if (rec.chunks_[rec.fill_].frames) {
+        rec.writing_ = true;
+        queue_.push_back({&rec, rec.fill_});
+        ioCv_.notify_all();
+        ioCv_.wait(lk, [&]{ return not rec.writing_; });
+    }
+
+    if (rec.dropped_)
+        RING_WARN("[recorder:%s] Stop recording, %llu frames dropped", rec.recorderId_.c_str(),
+                  static_cast<unsigned long long>(rec.dropped_));
+    else
+        RING_DBG("[recorder:%s] Stop recording", rec.recorderId_.c_str());
+}
+
+size_t
+RecordingService::recordingCount() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return recorders_.size();
+}
+
+RecordingStats
+RecordingService::getStats() const
+{
+    std::lock_guard<std::mutex> lk(ioMutex_);
+    return stats_;
+}
+
+void
+RecordingService::collect()
+{
+    {
+        // idle without recordings
+        std::unique_lock<std::mutex> lk(mutex_);
+        cv_.wait(lk, [this]{ return not recorders_.empty() or loop_.isStopping(); });
+        if (loop_.isStopping())
+            return;
+    }
+
+    std::this_thread::sleep_until(nextTick_);
+    const auto now = std::chrono::steady_clock::now();
+    nextTick_ += TICK_DURATION;
+    if (nextTick_ < now) // we were late, don't try to catch up
+        nextTick_ = now + TICK_DURATION;
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto rec : recorders_)
+        collect(*rec);
+}
+
+// Move what is available for rec in its chunks
+void
+RecordingService::collect(AudioRecorder& rec)
+{
+    auto& pool = rec.ringBufferPool_;
+    size_t avail = pool.availableForGet(rec.recorderId_);
+
+    // paused: drop, but write what we have
+    if (not rec.arecord_->isRecording()) {
+        if (avail)
+            pool.discard(avail, rec.recorderId_);
+        if (rec.chunks_[rec.fill_].frames)
+            queueChunk(rec);
+        return;
+    }
+
+    const unsigned channels = rec.format_.nb_channels;
+    while (avail) {
+        auto& chunk = rec.chunks_[rec.fill_];
+        const size_t space = chunk.samples.size() / channels - chunk.frames;
+        if (not space) {
+            if (queueChunk(rec))
+                continue;
+            // both chunks are busy, the disk can't keep up
+            pool.discard(avail, rec.recorderId_);
+            rec.dropped_ += avail;
+            std::lock_guard<std::mutex> lk(ioMutex_);
+            stats_.droppedFrames += avail;
+            break;
+        }
+
+        const size_t frames = std::min(avail, space);
+        rec.buffer_.resize(frames);
+        if (not pool.getData(rec.buffer_, rec.recorderId_))
+            break;
+        rec.buffer_.setChannelNum(channels, true);
+        rec.buffer_.interleave(chunk.samples.data() + chunk.frames * channels);
+        chunk.frames += frames;
+        avail -= frames;
+    }
+
+    auto& chunk = rec.chunks_[rec.fill_];
+    if (chunk.frames * channels == chunk.samples.size())
+        queueChunk(rec);
+}
+
+// Hand the chunk being filled to the I/O thread, if the other one is free
+bool
+RecordingService::queueChunk(AudioRecorder& rec)
+{
+    std::lock_guard<std::mutex> lk(ioMutex_);
+    if (rec.writing_)
+        return false;
+    rec.writing_ = true;
+    queue_.push_back({&rec, rec.fill_});
+    rec.fill_ ^= 1;
+    ioCv_.notify_all();
+    return true;
+}
+
+void
+RecordingService::write()
+{
+    std::unique_lock<std::mutex> lk(ioMutex_);
+    ioCv_.wait(lk, [this]{ return not queue_.empty() or ioLoop_.isStopping(); });
+    if (queue_.empty())
+        return;
+    const auto job = queue_.front();
+    queue_.pop_front();
+    auto& chunk = job.rec->chunks_[job.chunk];
+    lk.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    job.rec->arecord_->recData(chunk.samples.data(), chunk.frames);
+    const auto time = std::chrono::steady_clock::now() - start;
+
+    lk.lock();
+    ++stats_.chunks;
+    stats_.writtenFrames += chunk.frames;
+    stats_.maxWriteTime = std::max<std::chrono::nanoseconds>(stats_.maxWriteTime, time);
+    chunk.frames = 0;
+    job.rec->writing_ = false;
+    ioCv_.notify_all();
+}
+
+} // namespace ring
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+#include "threadloop.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ring {
+
+class AudioRecorder;
+
+struct RecordingStats {
+    uint64_t chunks {0};         // chunks written
+    uint64_t writtenFrames {0};
+    uint64_t droppedFrames {0};  // lost because the disk was too slow
+    std::chrono::nanoseconds maxWriteTime {0};
+};
+
+/**
+ * Recording service shared by every call and conference.
+ *
+ * One collector thread reads all recordings from the RingBufferPool every
+ * 20ms into preallocated chunks, and one I/O thread writes full chunks.
+ * Each recording has two chunks: one is filled while the other is written.
+ * When both are full, new samples are dropped and counted rather than
+ * blocking, so a slow disk never stalls the audio.
+ */
+class RecordingService {
+    public:
+        static constexpr std::chrono::milliseconds CHUNK_DURATION {1000};
+
+        RecordingService();
+        ~RecordingService();
+
+        void add(AudioRecorder& rec);
+
+        /**
+         * Write what rec has collected and forget it.
+         * Blocks until rec is no longer used by the service threads.
+         */
+        void remove(AudioRecorder& rec);
+
+        size_t recordingCount() const;
+
+        RecordingStats getStats() const;
+
+    private:
+        NON_COPYABLE(RecordingService);
+
+        struct Job {
+            AudioRecorder* rec;
+            unsigned chunk;
+        };
+
+        void collect();
+        void collect(AudioRecorder& rec);
+        bool queueChunk(AudioRecorder& rec);
+        void write();
+
+        mutable std::mutex mutex_ {};   // recorders_ and chunks being filled
+        std::condition_variable cv_ {};
+        std::vector<AudioRecorder*> recorders_;
+        std::chrono::steady_clock::time_point nextTick_;
+
+        mutable std::mutex ioMutex_ {}; // queue_, chunks being written and stats
+        std::condition_variable ioCv_ {};
+        std::deque<Job> queue_;
+        RecordingStats stats_;
+
+        ThreadLoop ioLoop_;
+        ThreadLoop loop_; // as to be last member
+};
+
+} // namespace ring
@@ -20,11 +20,17 @@
  */
 
 #include "resampler.h"
+#include "audio_simd.h"
 #include "logger.h"
 #include "ring_types.h"
 
 #include <samplerate.h>
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+
 namespace ring {
 
 class SrcState {
@@ -49,14 +55,123 @@ class SrcState {
         SRC_STATE *state_ {nullptr};
 };
 
-Resampler::Resampler(AudioFormat format, bool quality) : floatBufferIn_(),
-    floatBufferOut_(), scratchBuffer_(), samples_(0), format_(format), high_quality_(quality), src_state_()
+/**
+ * Kaiser windowed sinc low-pass, split in 'up' phases of 'taps'
+ * coefficients. out_rate / in_rate = up / down.
+ * Coefficients of each phase are stored in reverse order, so that an
+ * output sample is a dot product with the input samples in order.
+ */
+struct FilterBank {
+    unsigned up;
+    unsigned down;
+    unsigned taps;
+    std::vector<float> coefs;
+
+    const float* phase(unsigned p) const {
+        return coefs.data() + p * taps;
+    }
+};
+
+// Bigger banks (unusual ratios like 44100/44056) go through libsamplerate
+static constexpr unsigned MAX_PHASES {1024};
+
+static unsigned
+gcd(unsigned a, unsigned b)
+{
+    while (b) {
+        const unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static double
+besselI0(double x)
+{
+    double sum = 1., term = 1.;
+    for (unsigned k = 1; k < 32; ++k) {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static std::shared_ptr<const FilterBank>
+makeFilterBank(unsigned up, unsigned down, bool quality)
+{
+    // ~60dB stopband for calls, ~90dB for files
+    const unsigned baseTaps = quality ? 48 : 16;
+    const double beta = quality ? 9. : 6.;
+    const double rolloff = quality ? .95 : .9;
+
+    auto bank = std::make_shared<FilterBank>();
+    bank->up = up;
+    bank->down = down;
+    // when decimating, the cutoff is lower: keep the same transition width
+    bank->taps = std::max<unsigned>(baseTaps, (baseTaps * down + up - 1) / up);
+    // round to the SIMD width
+    bank->taps = (bank->taps + 7) & ~7u;
+
+    const unsigned len = bank->taps * up;
+    const double cutoff = rolloff * .5 / std::max(up, down); // in cycles per upsampled sample
+    const double center = (len - 1) / 2.;
+    const double norm = besselI0(beta);
+    static constexpr double PI = 3.141592653589793238462643383279502884;
+
+    std::vector<double> h(len);
+    double sum = 0.;
+    for (unsigned i = 0; i < len; ++i) {
+        const double x = i - center;
+        const double sinc = x == 0. ? 1. : std::sin(2. * PI * cutoff * x) / (2. * PI * cutoff * x);
+        const double r = x / (len / 2.);
+        const double window = besselI0(beta * std::sqrt(std::max(0., 1. - r * r))) / norm;
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+
+    // unity gain: each input sample contributes to 'up' outputs on average
+    bank->coefs.resize(len);
+    for (unsigned p = 0; p < up; ++p)
+        for (unsigned t = 0; t < bank->taps; ++t)
+            bank->coefs[p * bank->taps + bank->taps - 1 - t] = h[p + t * up] * up / sum;
+    return bank;
+}
+
+/**
+ * Filter banks only depend on the ratio: compute them once for the
+ * whole process, they are small and few ratios are in use.
+ */
+static std::shared_ptr<const FilterBank>
+getFilterBank(unsigned inRate, unsigned outRate, bool quality)
+{
+    const unsigned d = gcd(inRate, outRate);
+    const unsigned up = outRate / d;
+    const unsigned down = inRate / d;
+    if (up > MAX_PHASES)
+        return {};
+
+    static std::mutex mutex;
+    static std::map<std::tuple<unsigned, unsigned, bool>, std::shared_ptr<const FilterBank>> banks;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    auto& bank = banks[std::make_tuple(up, down, quality)];
+    if (not bank) {
+        bank = makeFilterBank(up, down, quality);
+        RING_DBG("Resampler: new filter bank for %u -> %u Hz, %u phases of %u taps",
+                 inRate, outRate, bank->up, bank->taps);
+    }
+    return bank;
+}
+
+Resampler::Resampler(AudioFormat format, bool quality) : format_(format), high_quality_(quality)
 {
     setFormat(format, quality);
 }
 
-Resampler::Resampler(unsigned sample_rate, unsigned channels, bool quality) : floatBufferIn_(),
-    floatBufferOut_(), scratchBuffer_(), samples_(0), format_(sample_rate, channels), high_quality_(quality), src_state_()
+Resampler::Resampler(unsigned sample_rate, unsigned channels, bool quality)
+    : format_(sample_rate, channels), high_quality_(quality)
 {
     setFormat(format_, quality);
 }
@@ -67,37 +182,94 @@ void
 Resampler::setFormat(AudioFormat format, bool quality)
 {
     format_ = format;
-    samples_ = (format.nb_channels * format.sample_rate * 20) / 1000; // start with 20 ms buffers
-    floatBufferIn_.resize(samples_);
-    floatBufferOut_.resize(samples_);
-    scratchBuffer_.resize(samples_);
-
-    src_state_.reset(new SrcState(format.nb_channels, quality));
+    high_quality_ = quality;
+    filter_.reset();
+    filterIn_ = filterOut_ = 0;
+    src_state_.reset();
 }
 
 void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
 {
-    const double inputFreq = dataIn.getSampleRate();
-    const double outputFreq = dataOut.getSampleRate();
-    const double sampleFactor = outputFreq / inputFreq;
+    const unsigned inputFreq = dataIn.getSampleRate();
+    const unsigned outputFreq = dataOut.getSampleRate();
 
-    if (sampleFactor == 1.0)
+    if (inputFreq == outputFreq)
         return;
 
-    const size_t nbFrames = dataIn.frames();
     const size_t nbChans = dataIn.channels();
 
-    if (nbChans != format_.nb_channels) {
-        // change channel num if needed
-        src_state_.reset(new SrcState(nbChans, high_quality_));
-        format_.nb_channels = nbChans;
-        RING_DBG("SRC channel number changed.");
-    }
     if (nbChans != dataOut.channels()) {
         RING_DBG("Output buffer had the wrong number of channels (in: %zu, out: %u).", nbChans, dataOut.channels());
         dataOut.setChannelNum(nbChans);
     }
 
+    if (inputFreq != filterIn_ or outputFreq != filterOut_ or nbChans != filterChannels_)
+        resetFilter(inputFreq, outputFreq, nbChans);
+
+    if (filter_)
+        resampleFilter(dataIn, dataOut);
+    else
+        resampleSrc(dataIn, dataOut);
+}
+
+void
+Resampler::resetFilter(unsigned inRate, unsigned outRate, unsigned channels)
+{
+    filterIn_ = inRate;
+    filterOut_ = outRate;
+    filterChannels_ = channels;
+    filter_ = getFilterBank(inRate, outRate, high_quality_);
+    phase_ = 0;
+    history_.clear();
+    if (filter_)
+        history_.resize(channels, std::vector<float>(filter_->taps - 1, 0.f));
+    else
+        RING_DBG("Resampler: no filter bank for %u -> %u Hz, using libsamplerate", inRate, outRate);
+}
+
+void
+Resampler::resampleFilter(const AudioBuffer& dataIn, AudioBuffer& dataOut)
+{
+    const auto& kernels = audioKernels();
+    const FilterBank& bank = *filter_;
+    const size_t keep = bank.taps - 1;
+    const size_t inFrames = dataIn.frames();
+    const uint64_t end = static_cast<uint64_t>(inFrames) * bank.up;
+
+    // outputs at phase_, phase_ + down, ... before the end of this input
+    const size_t outFrames = phase_ < end ? (end - phase_ + bank.down - 1) / bank.down : 0;
+    dataOut.resize(outFrames);
+    work_.resize(keep + inFrames);
+    floatBufferOut_.resize(outFrames);
+
+    for (unsigned c = 0; c < history_.size(); ++c) {
+        // previous input tail, then this input
+        auto& history = history_[c];
+        std::copy(history.begin(), history.end(), work_.begin());
+        kernels.toFloat(dataIn.getChannel(c), work_.data() + keep, inFrames);
+
+        uint64_t t = phase_;
+        for (size_t k = 0; k < outFrames; ++k, t += bank.down)
+            floatBufferOut_[k] = kernels.dot(bank.phase(t % bank.up), work_.data() + t / bank.up, bank.taps);
+        kernels.fromFloat(floatBufferOut_.data(), dataOut.getChannel(c), outFrames);
+
+        std::copy(work_.end() - keep, work_.end(), history.begin());
+    }
+    phase_ += outFrames * bank.down - end;
+}
+
+void
+Resampler::resampleSrc(const AudioBuffer& dataIn, AudioBuffer& dataOut)
+{
+    const double sampleFactor = static_cast<double>(dataOut.getSampleRate()) / dataIn.getSampleRate();
+    const size_t nbFrames = dataIn.frames();
+    const size_t nbChans = dataIn.channels();
+
+    if (not src_state_ or nbChans != format_.nb_channels) {
+        src_state_.reset(new SrcState(nbChans, high_quality_));
+        format_.nb_channels = nbChans;
+    }
+
     size_t inSamples = nbChans * nbFrames;
     size_t outSamples = inSamples * sampleFactor;
 
@@ -117,9 +289,6 @@ void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
     dataIn.interleaveFloat(floatBufferIn_.data());
 
     src_state_->process(&src_data);
-    /*
-    TODO: one-shot deinterleave and float-to-short conversion
-    */
     src_float_to_short_array(floatBufferOut_.data(), scratchBuffer_.data(), outSamples);
     dataOut.deinterleave(scratchBuffer_.data(), src_data.output_frames, nbChans);
 }
@@ -33,6 +33,7 @@
 namespace ring {
 
 struct SrcState;
+struct FilterBank;
 
 class Resampler {
     public:
@@ -65,12 +66,27 @@ class Resampler {
     private:
         NON_COPYABLE(Resampler);
 
-        /* temporary buffers */
+        void resetFilter(unsigned inRate, unsigned outRate, unsigned channels);
+        void resampleFilter(const AudioBuffer& dataIn, AudioBuffer& dataOut);
+        void resampleSrc(const AudioBuffer& dataIn, AudioBuffer& dataOut);
+
+        /*
+         * Polyphase filter, used for rational ratios between usual rates.
+         * Filter banks are shared by all resamplers using the same ratio.
+         */
+        std::shared_ptr<const FilterBank> filter_;
+        unsigned filterIn_ {0};
+        unsigned filterOut_ {0};
+        unsigned filterChannels_ {0}; // also set on the libsamplerate path
+        std::vector<std::vector<float>> history_; // last input samples, per channel
+        std::vector<float> work_;
+        uint64_t phase_ {0}; // position of the next output, in upsampled samples
+
+        /* libsamplerate fallback for other ratios, temporary buffers */
         std::vector<float> floatBufferIn_;
         std::vector<float> floatBufferOut_;
         std::vector<AudioSample> scratchBuffer_;
 
-        size_t samples_; // size in samples of temporary buffers
         AudioFormat format_; // number of channels and max output frequency
         bool high_quality_;
 
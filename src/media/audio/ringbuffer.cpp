@@ -156,7 +156,7 @@ bool RingBuffer::hasNoReadOffsets() const
 //
 
 // This one puts some data inside the ring buffer.
-void RingBuffer::put(AudioBuffer& buf)
+void RingBuffer::put(AudioBuffer& buf, bool voice)
 {
     std::lock_guard<std::mutex> l(lock_);
     const size_t sample_num = buf.frames();
@@ -189,6 +189,9 @@ void RingBuffer::put(AudioBuffer& buf)
     }
 
     endPos_ = pos;
+    putCount_ += sample_num;
+    if (voice)
+        voiceEnd_ = putCount_;
     not_empty_.notify_all();
 }
 
@@ -203,7 +206,25 @@ RingBuffer::availableForGet(const std::string &call_id) const
     return getLength(call_id);
 }
 
+bool
+RingBuffer::voiceAvailable(const std::string &call_id) const
+{
+    std::lock_guard<std::mutex> l(lock_);
+    // voice is tracked per put, not per sample
+    return voiceEnd_ > putCount_ - getLength(call_id);
+}
+
 size_t RingBuffer::get(AudioBuffer& buf, const std::string &call_id)
+{
+    return read(buf, call_id, false);
+}
+
+size_t RingBuffer::mix(AudioBuffer& buf, const std::string &call_id)
+{
+    return read(buf, call_id, true);
+}
+
+size_t RingBuffer::read(AudioBuffer& buf, const std::string &call_id, bool mixing)
 {
     std::lock_guard<std::mutex> l(lock_);
 
@@ -235,7 +256,10 @@ size_t RingBuffer::get(AudioBuffer& buf, const std::string &call_id)
         if (block > buffer_size - startPos)
             block = buffer_size - startPos;
 
-        buf.copy(buffer_, block, startPos, dest);
+        if (mixing)
+            buf.mix(buffer_.view(startPos, block), true, dest);
+        else
+            buf.copy(buffer_.view(startPos, block), dest);
 
         dest += block;
         startPos = (startPos + block) % buffer_size;
@@ -82,9 +82,9 @@ class RingBuffer {
         /**
          * Write data in the ring buffer
          * @param buffer Data to copied
-         * @param toCopy Number of bytes to copy
+         * @param voice False if buffer holds no voice (silence, background noise)
          */
-         void put(AudioBuffer& buf);
+         void put(AudioBuffer& buf, bool voice = true);
 
         /**
          * To get how much samples are available in the buffer to read in
@@ -92,6 +92,12 @@ class RingBuffer {
          */
         size_t availableForGet(const std::string &call_id) const;
 
+        /**
+         * True if some of the samples available to call_id were put as voice.
+         * Readers may skip processing (mixing, encoding) of silent data.
+         */
+        bool voiceAvailable(const std::string &call_id) const;
+
         /**
          * Get data in the ring buffer
          * @param buffer Data to copied
@@ -100,6 +106,13 @@ class RingBuffer {
          */
          size_t get(AudioBuffer& buf, const std::string &call_id);
 
+        /**
+         * Mix data of the ring buffer within buf, read in place.
+         * Consumes up to buf.frames() samples, like get().
+         * @return size_t Number of samples mixed
+         */
+        size_t mix(AudioBuffer& buf, const std::string &call_id);
+
         /**
          * Discard data from the buffer
          * @param toDiscard Number of samples to discard
@@ -164,6 +177,11 @@ class RingBuffer {
          */
         bool hasThisReadOffset(const std::string &call_id) const;
 
+        /**
+         * Copy or mix the next samples of call_id into buf.
+         */
+        size_t read(AudioBuffer& buf, const std::string &call_id, bool mixing);
+
         /**
          * Discard data from all read offsets to make place for new data.
          */
@@ -172,6 +190,12 @@ class RingBuffer {
         /** Offset on the last data */
         size_t endPos_;
 
+        /** Samples put since creation */
+        uint64_t putCount_ {0};
+
+        /** Value of putCount_ after the last voice put */
+        uint64_t voiceEnd_ {0};
+
         /** Data */
         AudioBuffer buffer_;
 
@@ -21,6 +21,7 @@
 
 #include "ringbufferpool.h"
 #include "ringbuffer.h"
+#include "lockfreeringbuffer.h"
 #include "ring_types.h" // for SIZEBUF
 #include "logger.h"
 
@@ -117,6 +118,39 @@ RingBufferPool::createRingBuffer(const std::string& id)
     return rbuf;
 }
 
+std::shared_ptr<LockFreeRingBuffer>
+RingBufferPool::getLockFreeRingBuffer(const std::string& id)
+{
+    std::lock_guard<std::recursive_mutex> lk(stateLock_);
+
+    const auto& it = lockFreeRingBufferMap_.find(id);
+    if (it != lockFreeRingBufferMap_.cend()) {
+        if (const auto& sptr = it->second.lock())
+            return sptr;
+        lockFreeRingBufferMap_.erase(it);
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<LockFreeRingBuffer>
+RingBufferPool::createLockFreeRingBuffer(const std::string& id, AudioFormat format)
+{
+    std::lock_guard<std::recursive_mutex> lk(stateLock_);
+
+    auto rbuf = getLockFreeRingBuffer(id);
+    if (rbuf) {
+        RING_DBG("Lock-free ringbuffer already exists for id '%s'", id.c_str());
+        return rbuf;
+    }
+
+    // not make_shared, that ignores LockFreeRingBuffer::operator new
+    rbuf = std::shared_ptr<LockFreeRingBuffer>(new LockFreeRingBuffer(id, SIZEBUF, format));
+    RING_DBG("Lock-free ringbuffer created with id '%s'", id.c_str());
+    lockFreeRingBufferMap_.emplace(id, rbuf);
+    return rbuf;
+}
+
 const RingBufferPool::ReadBindings*
 RingBufferPool::getReadBindings(const std::string& call_id) const
 {
@@ -272,13 +306,12 @@ RingBufferPool::getData(AudioBuffer& buffer, const std::string& call_id)
     buffer.setFormat(internalAudioFormat_);
 
     size_t size = 0;
-    AudioBuffer mixBuffer(buffer);
 
+    // mixed in place from each ring buffer storage
     for (const auto& rbuf : *bindings) {
         // XXX: is it normal to only return the last positive size?
-        size = rbuf->get(mixBuffer, call_id);
-        if (size > 0)
-            buffer.mix(mixBuffer);
+        if (auto mixed = rbuf->mix(buffer, call_id))
+            size = mixed;
     }
 
     return size;
@@ -337,12 +370,8 @@ RingBufferPool::getAvailableData(AudioBuffer& buffer, const std::string& call_id
     buffer.reset();
     buffer.setFormat(internalAudioFormat_);
 
-    AudioBuffer mixBuffer(buffer);
-
-    for (const auto &rbuf : *bindings) {
-        if (rbuf->get(mixBuffer, call_id) > 0)
-            buffer.mix(mixBuffer);
-    }
+    for (const auto &rbuf : *bindings)
+        rbuf->mix(buffer, call_id);
 
     return availableSamples;
 }
@@ -372,6 +401,21 @@ RingBufferPool::availableForGet(const std::string& call_id) const
     return availableSamples != std::numeric_limits<size_t>::max() ? availableSamples : 0;
 }
 
+bool
+RingBufferPool::voiceAvailable(const std::string& call_id) const
+{
+    std::lock_guard<std::recursive_mutex> lk(stateLock_);
+
+    const auto bindings = getReadBindings(call_id);
+    if (not bindings)
+        return false;
+
+    return std::any_of(bindings->cbegin(), bindings->cend(),
+                       [&](const std::shared_ptr<RingBuffer>& rbuf) {
+                           return rbuf->voiceAvailable(call_id);
+                       });
+}
+
 size_t
 RingBufferPool::discard(size_t toDiscard, const std::string& call_id)
 {
@@ -414,6 +458,15 @@ RingBufferPool::flushAllBuffers()
             item = ringBufferMap_.erase(item);
         }
     }
+
+    for (auto item = lockFreeRingBufferMap_.begin(); item != lockFreeRingBufferMap_.end(); ) {
+        if (const auto rb = item->second.lock()) {
+            rb->flushAll();
+            ++item;
+        } else {
+            item = lockFreeRingBufferMap_.erase(item);
+        }
+    }
 }
 
 } // namespace ring
@@ -34,6 +34,7 @@
 namespace ring {
 
 class RingBuffer;
+class LockFreeRingBuffer;
 
 class RingBufferPool {
 
@@ -95,6 +96,11 @@ class RingBufferPool {
 
         size_t availableForGet(const std::string& call_id) const;
 
+        /**
+         * True if any ring buffer bound to call_id has voice to be read.
+         */
+        bool voiceAvailable(const std::string& call_id) const;
+
         size_t discard(size_t toDiscard, const std::string& call_id);
 
         void flush(const std::string& call_id);
@@ -121,6 +127,21 @@ class RingBufferPool {
          */
         std::shared_ptr<RingBuffer> getRingBuffer(const std::string& id) const;
 
+        /**
+         * Create a new wait-free ringbuffer, to be used when either the
+         * producer or a reader runs in a real-time audio callback.
+         * As for createRingBuffer, only a weak reference is kept.
+         * Readers are registered directly on the returned object.
+         */
+        std::shared_ptr<LockFreeRingBuffer> createLockFreeRingBuffer(const std::string& id,
+                                                                     AudioFormat format);
+
+        /**
+         * Obtain a shared pointer on a LockFreeRingBuffer given by its ID,
+         * empty if none exists.
+         */
+        std::shared_ptr<LockFreeRingBuffer> getLockFreeRingBuffer(const std::string& id);
+
     private:
         NON_COPYABLE(RingBufferPool);
 
@@ -144,6 +165,9 @@ class RingBufferPool {
         // A cache of created RingBuffers listed by IDs.
         std::map<std::string, std::weak_ptr<RingBuffer> > ringBufferMap_ {};
 
+        // A cache of created LockFreeRingBuffers listed by IDs.
+        std::map<std::string, std::weak_ptr<LockFreeRingBuffer> > lockFreeRingBufferMap_ {};
+
         // A map of which RingBuffers a call has some ReadOffsets
         std::map<std::string, ReadBindings> readBindingsMap_ {};
 
@@ -35,20 +35,18 @@ void DTMF::startTone(char code)
     newTone_ = code;
 }
 
-using std::vector;
-
-bool DTMF::generateDTMF(vector<AudioSample> &buffer)
+bool DTMF::generateDTMF(AudioSample* buffer, size_t n)
 {
     try {
         if (currentTone_ != 0) {
             // Currently generating a DTMF tone
             if (currentTone_ == newTone_) {
                 // Continue generating the same tone
-                dtmfgenerator_.getNextSamples(buffer);
+                dtmfgenerator_.getNextSamples(buffer, n);
                 return true;
             } else if (newTone_ != 0) {
                 // New tone requested
-                dtmfgenerator_.getSamples(buffer, newTone_);
+                dtmfgenerator_.getSamples(buffer, n, newTone_);
                 currentTone_ = newTone_;
                 return true;
             } else {
@@ -60,7 +58,7 @@ bool DTMF::generateDTMF(vector<AudioSample> &buffer)
             // Not generating any DTMF tone
             if (newTone_) {
                 // Requested to generate a DTMF tone
-                dtmfgenerator_.getSamples(buffer, newTone_);
+                dtmfgenerator_.getSamples(buffer, n, newTone_);
                 currentTone_ = newTone_;
                 return true;
             } else
@@ -50,9 +50,10 @@ class DTMF {
 
         /**
          * Copy the sound inside the sampling* buffer
-         * @param buffer : a vector of AudioSample
+         * @param buffer : a buffer of AudioSample
+         * @param n : number of samples to generate
          */
-        bool generateDTMF(std::vector<AudioSample> &buffer);
+        bool generateDTMF(AudioSample* buffer, size_t n);
 
     private:
         char currentTone_;
@@ -71,12 +71,10 @@ DTMFGenerator::~DTMFGenerator()
         delete [] toneBuffers_[i];
 }
 
-using std::vector;
-
 /*
  * Get n samples of the signal of code code
  */
-void DTMFGenerator::getSamples(vector<AudioSample> &buffer, unsigned char code)
+void DTMFGenerator::getSamples(AudioSample* buffer, size_t n, unsigned char code)
 {
     code = toupper(code);
 
@@ -101,8 +99,6 @@ void DTMFGenerator::getSamples(vector<AudioSample> &buffer, unsigned char code)
     }
 
     size_t i;
-    const size_t n = buffer.size();
-
     for (i = 0; i < n; ++i)
         buffer[i] = state.sample[i % sampleRate_];
 
@@ -113,14 +109,12 @@ void DTMFGenerator::getSamples(vector<AudioSample> &buffer, unsigned char code)
  * Get next n samples (continues where previous call to
  * genSample or genNextSamples stopped
  */
-void DTMFGenerator::getNextSamples(vector<AudioSample> &buffer)
+void DTMFGenerator::getNextSamples(AudioSample* buffer, size_t n)
 {
     if (state.sample == 0)
         throw DTMFException("DTMF generator not initialized");
 
     size_t i;
-    const size_t n = buffer.size();
-
     for (i = 0; i < n; i++)
         buffer[i] = state.sample[(state.offset + i) % sampleRate_];
 
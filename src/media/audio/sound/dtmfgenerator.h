@@ -92,17 +92,19 @@ class DTMFGenerator {
 
         /*
          * Get n samples of the signal of code code
-         * @param buffer a AudioSample vector
+         * @param buffer a AudioSample buffer
+         * @param n      number of samples to get
          * @param code   dtmf code to get sound
          */
-        void getSamples(std::vector<AudioSample> &buffer, unsigned char code);
+        void getSamples(AudioSample* buffer, size_t n, unsigned char code);
 
         /*
          * Get next n samples (continues where previous call to
          * genSample or genNextSamples stopped
-         * @param buffer a AudioSample vector
+         * @param buffer a AudioSample buffer
+         * @param n      number of samples to get
          */
-        void getNextSamples(std::vector<AudioSample> &buffer);
+        void getNextSamples(AudioSample* buffer, size_t n);
 
     private:
 
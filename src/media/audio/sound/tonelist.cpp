@@ -103,7 +103,7 @@ void
 TelephoneTone::setCurrentTone(Tone::TONEID toneId)
 {
     if (toneId != Tone::TONE_NULL && currentTone_ != toneId)
-        tones_[toneId].reset();
+        tones_[toneId]->reset();
 
     currentTone_ = toneId;
 }
@@ -114,22 +114,23 @@ TelephoneTone::setSampleRate(unsigned int sampleRate)
     buildTones(sampleRate);
 }
 
-Tone*
+std::shared_ptr<Tone>
 TelephoneTone::getCurrentTone()
 {
     if (currentTone_ < Tone::TONE_DIALTONE or currentTone_ >= Tone::TONE_NULL)
         return nullptr;
 
-    return &tones_[currentTone_];
+    return tones_[currentTone_];
 }
 
 void
 TelephoneTone::buildTones(unsigned int sampleRate)
 {
-    tones_[Tone::TONE_DIALTONE] = Tone(toneZone[countryId_][Tone::TONE_DIALTONE], sampleRate);
-    tones_[Tone::TONE_BUSY] = Tone(toneZone[countryId_][Tone::TONE_BUSY], sampleRate);
-    tones_[Tone::TONE_RINGTONE] = Tone(toneZone[countryId_][Tone::TONE_RINGTONE], sampleRate);
-    tones_[Tone::TONE_CONGESTION] = Tone(toneZone[countryId_][Tone::TONE_CONGESTION], sampleRate);
+    // new tones, the previous ones may still be playing
+    tones_[Tone::TONE_DIALTONE] = std::make_shared<Tone>(toneZone[countryId_][Tone::TONE_DIALTONE], sampleRate);
+    tones_[Tone::TONE_BUSY] = std::make_shared<Tone>(toneZone[countryId_][Tone::TONE_BUSY], sampleRate);
+    tones_[Tone::TONE_RINGTONE] = std::make_shared<Tone>(toneZone[countryId_][Tone::TONE_RINGTONE], sampleRate);
+    tones_[Tone::TONE_CONGESTION] = std::make_shared<Tone>(toneZone[countryId_][Tone::TONE_CONGESTION], sampleRate);
 }
 
 } // namespace ring
@@ -23,6 +23,7 @@
 #endif
 
 #include "audio/tonecontrol.h"
+#include "audio/audiolayer.h"
 #include "sound/tonelist.h"
 #include "client/ring_signal.h"
 #include "dring/callmanager_interface.h" // for CallSignal
@@ -40,6 +41,16 @@ ToneControl::ToneControl(const Preferences& preferences)
 ToneControl::~ToneControl()
 {}
 
+void
+ToneControl::setAudioLayer(AudioLayer* layer)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (audioLayer_)
+        audioLayer_->setTone(nullptr);
+    audioLayer_ = layer;
+    publishTone();
+}
+
 void
 ToneControl::setSampleRate(unsigned rate)
 {
@@ -49,9 +60,18 @@ ToneControl::setSampleRate(unsigned rate)
         telephoneTone_.reset(new TelephoneTone(prefs_.getZoneToneChoice(), rate));
     else
         telephoneTone_->setSampleRate(rate);
+    publishTone();
 }
 
-AudioLoop*
+// The audio callback never reads ToneControl: it plays what we give it
+void
+ToneControl::publishTone()
+{
+    if (audioLayer_)
+        audioLayer_->setTone(telephoneTone_ ? telephoneTone_->getCurrentTone() : nullptr);
+}
+
+std::shared_ptr<AudioLoop>
 ToneControl::getTelephoneTone()
 {
     std::lock_guard<std::mutex> lk(mutex_);
@@ -104,6 +124,7 @@ ToneControl::stop()
 
     if (telephoneTone_)
         telephoneTone_->setCurrentTone(Tone::TONE_NULL);
+    publishTone();
 
     if (audioFile_) {
         emitSignal<DRing::CallSignal::RecordPlaybackStopped>(audioFile_->getFilePath());
@@ -118,6 +139,7 @@ ToneControl::play(Tone::TONEID toneId)
 
     if (telephoneTone_)
         telephoneTone_->setCurrentTone(toneId);
+    publishTone();
 }
 
 void
@@ -24,6 +24,7 @@
 #include "audio/sound/tone.h"  // for Tone::TONEID declaration
 #include "audio/sound/audiofile.h"
 
+#include <memory>
 #include <mutex>
 
 namespace ring {
@@ -35,6 +36,7 @@ namespace ring {
  * complexes interactions occuring in a multi-call context.
  */
 
+class AudioLayer;
 class TelephoneTone;
 
 class ToneControl {
@@ -43,8 +45,14 @@ class ToneControl {
         ToneControl(const Preferences& preferences);
         ~ToneControl();
 
+        /**
+         * Audio layer the current tone is published to, or nullptr.
+         * The layer must be unset before being destroyed.
+         */
+        void setAudioLayer(AudioLayer* layer);
+
         void setSampleRate(unsigned rate);
-        AudioLoop* getTelephoneTone();
+        std::shared_ptr<AudioLoop> getTelephoneTone();
         AudioLoop* getTelephoneFile(void);
         bool setAudioFile(const std::string& file);
         void stopAudioFile();
@@ -53,12 +61,15 @@ class ToneControl {
         void seek(double value);
 
     private:
+        void publishTone();
+
         const Preferences& prefs_;
 
         std::mutex mutex_; // protect access to following members
         unsigned sampleRate_;
         std::unique_ptr<TelephoneTone> telephoneTone_;
         std::unique_ptr<AudioFile> audioFile_;
+        AudioLayer* audioLayer_ {nullptr};
 };
 
 } // namespace ring
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "congestion_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ring {
+
+// Time taken in account between two reports, at most
+static constexpr std::chrono::seconds MAX_REPORT_INTERVAL {2};
+
+// Closer than this to the capacity, increase additively
+static constexpr double NEAR_CAPACITY {0.9};
+
+CongestionController::CongestionController(unsigned bitrate, unsigned minBitrate, unsigned maxBitrate)
+{
+    reset(bitrate, minBitrate, maxBitrate);
+}
+
+void
+CongestionController::reset(unsigned bitrate, unsigned minBitrate, unsigned maxBitrate)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    minBitrate_ = std::min(minBitrate, maxBitrate);
+    maxBitrate_ = maxBitrate;
+    bitrate_ = std::max(minBitrate_, std::min(bitrate, maxBitrate_));
+    capacity_ = 0;
+    state_ = State::INCREASE;
+    loss_ = 0;
+    rtt_ = minRtt_ = std::chrono::microseconds(-1);
+    queuingDelay_ = std::chrono::microseconds(0);
+    lastReport_ = {};
+    reports_ = 0;
+    decreases_ = 0;
+}
+
+void
+CongestionController::setParams(const Params& params)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    params_ = params;
+}
+
+CongestionController::State
+CongestionController::delayState(std::chrono::microseconds rtt, clock::time_point now)
+{
+    if (rtt.count() < 0)
+        return State::INCREASE;
+
+    // the smallest RTT is the empty queue one, forget it after a while for
+    // route changes
+    if (minRtt_.count() < 0 or rtt <= minRtt_ or now - minRttTime_ > params_.minRttWindow) {
+        minRtt_ = rtt;
+        minRttTime_ = now;
+    }
+
+    const auto previous = queuingDelay_;
+    queuingDelay_ = rtt - minRtt_;
+    if (queuingDelay_ > params_.overuseDelay and queuingDelay_ >= previous)
+        return State::DECREASE;
+    if (queuingDelay_ < params_.normalDelay)
+        return State::INCREASE;
+    return State::HOLD;
+}
+
+unsigned
+CongestionController::onReceiverReport(double loss, std::chrono::microseconds rtt, clock::time_point now)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    const double elapsed = reports_ ?
+        std::min<std::chrono::duration<double>>(now - lastReport_, MAX_REPORT_INTERVAL).count() : 1.;
+    lastReport_ = now;
+    ++reports_;
+    loss_ = loss;
+    rtt_ = rtt;
+
+    // delay based
+    auto state = delayState(rtt, now);
+    double bitrate = bitrate_;
+    if (state == State::DECREASE)
+        bitrate = bitrate_ * params_.decreaseFactor;
+
+    // loss based
+    if (loss > params_.highLoss) {
+        bitrate = std::min(bitrate, bitrate_ * (1 - 0.5 * loss));
+        state = State::DECREASE;
+    } else if (loss > params_.lowLoss and state == State::INCREASE) {
+        state = State::HOLD;
+    }
+
+    if (state == State::DECREASE) {
+        // the link could carry about what we were sending
+        capacity_ = capacity_ ? 0.5 * (capacity_ + bitrate_) : bitrate_;
+        ++decreases_;
+    } else if (state == State::INCREASE) {
+        if (capacity_ and bitrate_ > NEAR_CAPACITY * capacity_)
+            bitrate = bitrate_ * (1 + params_.additiveIncrease * elapsed);
+        else
+            bitrate = bitrate_ * std::pow(params_.increaseFactor, elapsed);
+        // the link may have improved
+        if (capacity_ and bitrate > capacity_ / NEAR_CAPACITY)
+            capacity_ = 0;
+    }
+
+    state_ = state;
+    bitrate_ = std::max<double>(minBitrate_, std::min<double>(bitrate, maxBitrate_));
+    return std::lround(bitrate_);
+}
+
+unsigned
+CongestionController::getBitrate() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return std::lround(bitrate_);
+}
+
+CongestionController::Stats
+CongestionController::getStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return {static_cast<unsigned>(std::lround(bitrate_)), state_, loss_, rtt_, minRtt_,
+            queuingDelay_, static_cast<unsigned>(std::lround(capacity_)), reports_, decreases_};
+}
+
+} // namespace ring
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+namespace ring {
+
+/**
+ * Sender side bitrate estimation from RTCP receiver reports.
+ *
+ * Two estimators run on each report, the lowest wins:
+ * - delay based: the round trip time above the smallest one seen is the
+ *   queuing delay. When it grows past a threshold the link is overused and
+ *   the bitrate is decreased before packets are lost.
+ * - loss based: high loss decreases the bitrate in proportion, low loss
+ *   allows an increase.
+ *
+ * The increase is multiplicative far from the bitrate of the last overuse,
+ * then additive when getting close to it.
+ *
+ * Bitrates are in kbit/s.
+ */
+class CongestionController {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        enum class State { HOLD, INCREASE, DECREASE };
+
+        struct Params {
+            double lowLoss {0.02};      // below: increase allowed
+            double highLoss {0.10};     // above: decrease
+            std::chrono::milliseconds overuseDelay {60};  // queuing delay
+            std::chrono::milliseconds normalDelay {20};
+            double decreaseFactor {0.85};                  // on overuse
+            double increaseFactor {1.08};                  // per second, far from capacity
+            double additiveIncrease {0.03};                // per second, near capacity
+            std::chrono::seconds minRttWindow {30};        // smallest RTT forgotten after
+        };
+
+        struct Stats {
+            unsigned bitrate;
+            State state;
+            double loss;                          // last fraction lost
+            std::chrono::microseconds rtt;        // last one, negative if unknown
+            std::chrono::microseconds minRtt;
+            std::chrono::microseconds queuingDelay;
+            unsigned capacity;                    // bitrate at the last overuse, 0 if none
+            unsigned reports;
+            unsigned decreases;
+        };
+
+        CongestionController(unsigned bitrate, unsigned minBitrate, unsigned maxBitrate);
+
+        // Start again from bitrate, forgetting what was learned
+        void reset(unsigned bitrate, unsigned minBitrate, unsigned maxBitrate);
+        void setParams(const Params& params);
+
+        /**
+         * Take a receiver report in account.
+         * rtt is negative when it can't be computed.
+         * Returns the new bitrate.
+         */
+        unsigned onReceiverReport(double loss, std::chrono::microseconds rtt,
+                                  clock::time_point now = clock::now());
+
+        unsigned getBitrate() const;
+        Stats getStats() const;
+
+    private:
+        State delayState(std::chrono::microseconds rtt, clock::time_point now);
+
+        mutable std::mutex mutex_;
+        Params params_;
+        unsigned minBitrate_;
+        unsigned maxBitrate_;
+        double bitrate_;
+        double capacity_ {0};
+        State state_ {State::INCREASE};
+        double loss_ {0};
+        std::chrono::microseconds rtt_ {-1};
+        std::chrono::microseconds minRtt_ {-1};
+        std::chrono::microseconds queuingDelay_ {0};
+        clock::time_point minRttTime_ {};
+        clock::time_point lastReport_ {};
+        unsigned reports_ {0};
+        unsigned decreases_ {0};
+};
+
+} // namespace ring
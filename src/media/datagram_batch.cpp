@@ -0,0 +1,239 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "datagram_batch.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+#define RING_MMSG 1
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // linux/udp.h, kernel 4.18
+#endif
+#endif
+
+namespace ring {
+
+constexpr unsigned DatagramBatch::DEFAULT_CAPACITY;
+constexpr unsigned DatagramBatch::MAX_CAPACITY;
+constexpr size_t DatagramBatch::MAX_DATAGRAM_SIZE;
+
+#ifdef RING_MMSG
+// limits of one UDP GSO buffer
+static constexpr unsigned MAX_SEGMENTS {64};
+static constexpr size_t MAX_SEGMENTED_SIZE {60000};
+#endif
+
+DatagramBatch::DatagramBatch(unsigned capacity, size_t maxSize)
+    : capacity_(std::max(1u, std::min(capacity, MAX_CAPACITY)))
+    , maxSize_(maxSize)
+    , buffer_(capacity_ * maxSize_)
+    , lengths_(capacity_)
+{}
+
+void
+DatagramBatch::compact()
+{
+    if (not head_)
+        return;
+    if (count_) {
+        std::memmove(slot(0), slot(head_), count_ * maxSize_);
+        std::copy_n(lengths_.begin() + head_, count_, lengths_.begin());
+    }
+    head_ = 0;
+}
+
+void
+DatagramBatch::drop(unsigned n)
+{
+    n = std::min(n, count_);
+    head_ += n;
+    count_ -= n;
+    if (not count_)
+        head_ = 0;
+}
+
+int
+DatagramBatch::receive(int fd)
+{
+    compact();
+    const unsigned room = capacity_ - count_;
+    if (not room) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+#ifdef RING_MMSG
+    std::array<mmsghdr, MAX_CAPACITY> msgs;
+    std::array<iovec, MAX_CAPACITY> iovs;
+    for (unsigned i = 0; i < room; ++i) {
+        iovs[i].iov_base = slot(count_ + i);
+        iovs[i].iov_len = maxSize_;
+        std::memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    ++stats_.syscalls;
+    const int n = recvmmsg(fd, msgs.data(), room, MSG_DONTWAIT, nullptr);
+    if (n <= 0)
+        return -1;
+    for (int i = 0; i < n; ++i)
+        lengths_[count_ + i] = msgs[i].msg_len;
+#else
+    int n = 0;
+    while (static_cast<unsigned>(n) < room) {
+        ++stats_.syscalls;
+        const auto len = recvfrom(fd, reinterpret_cast<char*>(slot(count_ + n)), maxSize_, 0,
+                                  nullptr, nullptr);
+        if (len < 0)
+            break;
+        lengths_[count_ + n++] = len;
+    }
+    if (not n)
+        return -1;
+#endif
+
+    count_ += n;
+    stats_.datagrams += n;
+    return n;
+}
+
+int
+DatagramBatch::pop(void* buf, size_t len)
+{
+    if (empty())
+        return 0;
+    len = std::min(len, lengths_[head_]);
+    std::memcpy(buf, slot(head_), len);
+    drop(1);
+    return len;
+}
+
+bool
+DatagramBatch::push(const void* buf, size_t len)
+{
+    if (len > maxSize_)
+        return false;
+    if (head_ + count_ == capacity_)
+        compact();
+    if (full())
+        return false;
+    const auto i = head_ + count_++;
+    std::memcpy(slot(i), buf, len);
+    lengths_[i] = len;
+    return true;
+}
+
+int
+DatagramBatch::send(int fd, const sockaddr* dest, socklen_t destLen)
+{
+    if (empty())
+        return 0;
+
+#ifdef RING_MMSG
+    union Control {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        cmsghdr align;
+    };
+    std::array<mmsghdr, MAX_CAPACITY> msgs;
+    std::array<iovec, MAX_CAPACITY> iovs;
+    std::array<unsigned, MAX_CAPACITY> segments;
+    std::array<Control, MAX_CAPACITY> controls;
+
+    // one message per run of datagrams of the same size, the last one may be shorter
+    unsigned nmsgs = 0;
+    for (unsigned i = 0; i < count_;) {
+        const auto size = length(i);
+        unsigned run = 1;
+        if (segmentation_)
+            while (i + run < count_ and run < MAX_SEGMENTS
+                   and (run + 1) * size <= MAX_SEGMENTED_SIZE
+                   and length(i + run - 1) == size and length(i + run) <= size)
+                ++run;
+
+        auto& msg = msgs[nmsgs];
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_hdr.msg_name = const_cast<sockaddr*>(dest);
+        msg.msg_hdr.msg_namelen = destLen;
+        msg.msg_hdr.msg_iov = &iovs[i];
+        msg.msg_hdr.msg_iovlen = run;
+        for (unsigned j = 0; j < run; ++j) {
+            iovs[i + j].iov_base = const_cast<uint8_t*>(data(i + j));
+            iovs[i + j].iov_len = length(i + j);
+        }
+        if (run > 1) {
+            msg.msg_hdr.msg_control = controls[nmsgs].buf;
+            msg.msg_hdr.msg_controllen = sizeof(controls[nmsgs].buf);
+            auto cm = CMSG_FIRSTHDR(&msg.msg_hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const uint16_t segmentSize = size;
+            std::memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+        }
+        segments[nmsgs++] = run;
+        i += run;
+    }
+
+    ++stats_.syscalls;
+    const int n = sendmmsg(fd, msgs.data(), nmsgs, MSG_DONTWAIT);
+    if (n < 0) {
+        // kernel or device without UDP GSO: send them one by one from now on
+        if (segmentation_ and segments[0] > 1
+            and (errno == EIO or errno == EINVAL or errno == ENOPROTOOPT)) {
+            segmentation_ = false;
+            return send(fd, dest, destLen);
+        }
+        return -1;
+    }
+
+    unsigned sent = 0;
+    for (int i = 0; i < n; ++i) {
+        sent += segments[i];
+        if (segments[i] > 1)
+            stats_.segmented += segments[i];
+    }
+#else
+    unsigned sent = 0;
+    while (sent < count_) {
+        ++stats_.syscalls;
+        if (sendto(fd, reinterpret_cast<const char*>(data(sent)), length(sent), 0,
+                   dest, destLen) < 0)
+            break;
+        ++sent;
+    }
+    if (not sent)
+        return -1;
+#endif
+
+    drop(sent);
+    stats_.datagrams += sent;
+    return sent;
+}
+
+} // namespace ring
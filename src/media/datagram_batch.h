@@ -0,0 +1,114 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socklen_t = int;
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ring {
+
+struct DatagramBatchStats {
+    uint64_t datagrams {0};
+    uint64_t syscalls {0};
+    uint64_t segmented {0};     // datagrams sent in an UDP GSO send
+};
+
+/**
+ * Datagrams of one UDP socket, received or sent with one system call.
+ *
+ * On Linux the whole batch goes through recvmmsg/sendmmsg, and runs of
+ * datagrams of the same size (the RTP packets of a video frame) are sent as
+ * one UDP GSO buffer when the kernel supports it. Elsewhere datagrams are
+ * read and written one by one with the same interface.
+ *
+ * Sockets must be non blocking. Not thread safe.
+ */
+class DatagramBatch {
+public:
+    static constexpr unsigned DEFAULT_CAPACITY {32};
+    static constexpr unsigned MAX_CAPACITY {64};
+    static constexpr size_t MAX_DATAGRAM_SIZE {2048};
+
+    explicit DatagramBatch(unsigned capacity = DEFAULT_CAPACITY,
+                           size_t maxSize = MAX_DATAGRAM_SIZE);
+
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == capacity_; }
+    unsigned size() const { return count_; }
+
+    // i-th datagram of the batch
+    const uint8_t* data(unsigned i) const { return slot(head_ + i); }
+    uint8_t* data(unsigned i) { return slot(head_ + i); }
+    size_t length(unsigned i) const { return lengths_[head_ + i]; }
+
+    // for datagrams changed in place, at most maxSize() bytes
+    void setLength(unsigned i, size_t len) { lengths_[head_ + i] = len; }
+    size_t maxSize() const { return maxSize_; }
+
+    /**
+     * Append the datagrams waiting on fd, as many as there is room for.
+     * Return their number, or -1 with errno set (EAGAIN if none).
+     */
+    int receive(int fd);
+
+    // Copy out and remove the first datagram, truncated to len like recv()
+    int pop(void* buf, size_t len);
+
+    // Append a datagram to send, false if the batch is full or it is too large
+    bool push(const void* buf, size_t len);
+
+    /**
+     * Send the datagrams to dest, the ones not sent remain first in the batch.
+     * Return the number sent, or -1 with errno set if none was.
+     */
+    int send(int fd, const sockaddr* dest, socklen_t destLen);
+
+    void clear() { head_ = count_ = 0; }
+    void dropLast() { if (count_) --count_; }
+
+    DatagramBatchStats getStats() const { return stats_; }
+
+private:
+    uint8_t* slot(unsigned i) { return buffer_.data() + i * maxSize_; }
+    const uint8_t* slot(unsigned i) const { return buffer_.data() + i * maxSize_; }
+
+    // move the datagrams to the first slots
+    void compact();
+    void drop(unsigned n);
+
+    const unsigned capacity_;
+    const size_t maxSize_;
+    std::vector<uint8_t> buffer_;
+    std::vector<size_t> lengths_;
+    unsigned head_ {0};
+    unsigned count_ {0};
+    bool segmentation_ {true};
+    DatagramBatchStats stats_;
+};
+
+} // namespace ring
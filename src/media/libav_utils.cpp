@@ -171,6 +171,7 @@ int libav_pixel_format(int fmt)
         case video::VIDEO_PIXFMT_YUYV422: return AV_PIX_FMT_YUYV422;
         case video::VIDEO_PIXFMT_YUV420P: return AV_PIX_FMT_YUV420P;
         case video::VIDEO_PIXFMT_NV21: return AV_PIX_FMT_NV21;
+        case video::VIDEO_PIXFMT_NV12: return AV_PIX_FMT_NV12;
     }
     return fmt;
 }
@@ -27,6 +27,11 @@
 #include <cstdlib>
 #include <cstring> // std::memset
 #include <ciso646> // fix windows compiler bug
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 namespace ring {
 
@@ -45,6 +50,110 @@ MediaFrame::reset() noexcept
 
 #ifdef RING_VIDEO
 
+//=== FRAME POOL ===============================================================
+
+// Geometries kept, the least recently used pool is released past that
+static constexpr std::size_t MAX_FRAME_POOLS {8};
+static constexpr int FRAME_ALIGN {32};
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+using PoolBufferSize = size_t;
+#else
+using PoolBufferSize = int;
+#endif
+
+static std::atomic<uint64_t> poolGets {0};
+static std::atomic<uint64_t> poolMisses {0};
+
+static AVBufferRef*
+poolAlloc(PoolBufferSize size)
+{
+    ++poolMisses;
+    return av_buffer_alloc(size);
+}
+
+class FramePools {
+    public:
+        // Attach a pooled buffer to frame, geometry is already set
+        bool get(AVFrame* frame) {
+            const auto key = std::make_tuple(frame->format, frame->width, frame->height);
+            AVBufferRef* buf = nullptr;
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                auto it = std::find_if(pools_.begin(), pools_.end(),
+                                       [&](const Pool& p){ return p.key == key; });
+                if (it == pools_.end()) {
+                    const auto size = av_image_get_buffer_size((AVPixelFormat)frame->format,
+                                                               frame->width, frame->height,
+                                                               FRAME_ALIGN);
+                    if (size <= 0)
+                        return false;
+                    if (pools_.size() >= MAX_FRAME_POOLS)
+                        pools_.erase(std::min_element(pools_.begin(), pools_.end(),
+                                                      [](const Pool& a, const Pool& b){ return a.lastUse < b.lastUse; }));
+                    pools_.emplace_back(key, av_buffer_pool_init(size, poolAlloc));
+                    it = pools_.end() - 1;
+                    if (not it->pool) {
+                        pools_.erase(it);
+                        return false;
+                    }
+                }
+                it->lastUse = ++useCount_;
+                buf = av_buffer_pool_get(it->pool.get());
+            }
+            if (not buf)
+                return false;
+            ++poolGets;
+
+            frame->buf[0] = buf;
+            av_image_fill_arrays(frame->data, frame->linesize, buf->data,
+                                 (AVPixelFormat)frame->format, frame->width, frame->height,
+                                 FRAME_ALIGN);
+            frame->extended_data = frame->data;
+            return true;
+        }
+
+        std::size_t size() {
+            std::lock_guard<std::mutex> lk(mutex_);
+            return pools_.size();
+        }
+
+    private:
+        using Key = std::tuple<int, int, int>; // format, width, height
+
+        struct Pool {
+            Pool(const Key& k, AVBufferPool* p)
+                : key(k), pool(p, [](AVBufferPool* p){ av_buffer_pool_uninit(&p); }) {}
+            Key key;
+            // buffers still in use stay valid after uninit
+            std::unique_ptr<AVBufferPool, void(*)(AVBufferPool*)> pool;
+            uint64_t lastUse {0};
+        };
+
+        std::mutex mutex_;
+        std::vector<Pool> pools_;
+        uint64_t useCount_ {0};
+};
+
+static FramePools&
+framePools()
+{
+    static FramePools pools;
+    return pools;
+}
+
+VideoFramePoolStats
+videoFramePoolStats()
+{
+    VideoFramePoolStats stats;
+    stats.misses = poolMisses.load();
+    stats.hits = poolGets.load() - std::min(stats.misses, poolGets.load());
+    stats.pools = framePools().size();
+    return stats;
+}
+
+//=== VIDEO FRAME ==============================================================
+
 VideoFrame::~VideoFrame()
 {
     if (releaseBufferCb_)
@@ -100,10 +209,12 @@ VideoFrame::reserve(int format, int width, int height)
     auto libav_frame = frame_.get();
 
     if (allocated_) {
-        // nothing to do if same properties
+        // nothing to do if same properties and nobody else uses the buffer
         if (width == libav_frame->width
             and height == libav_frame->height
-            and libav_format == libav_frame->format)
+            and libav_format == libav_frame->format
+            and av_frame_is_writable(libav_frame))
+            return;
 #if USE_OLD_AVU
         avpicture_free((AVPicture *) libav_frame);
 #else
@@ -112,7 +223,7 @@ VideoFrame::reserve(int format, int width, int height)
     }
 
     setGeometry(format, width, height);
-    if (av_frame_get_buffer(libav_frame, 32))
+    if (not framePools().get(libav_frame))
         throw std::bad_alloc();
     allocated_ = true;
     releaseBufferCb_ = {};
@@ -179,7 +290,11 @@ yuv422_clear_to_black(VideoFrame& frame)
     if (not desc)
         return;
 
-    if (not libav_utils::is_yuv_planar(*desc)) {
+    if (libav_frame->format == AV_PIX_FMT_NV12) {
+        // luma plane, then interleaved U/V
+        std::memset(libav_frame->data[0], 0, libav_frame->linesize[0] * libav_frame->height);
+        std::memset(libav_frame->data[1], 128, libav_frame->linesize[1] * ((libav_frame->height + 1) / 2));
+    } else if (not libav_utils::is_yuv_planar(*desc)) {
         // not planar
         auto stride = libav_frame->linesize[0];
         if (libav_frame->width % 2) {
@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <functional>
+#include <cstdint>
 
 class AVFrame;
 
@@ -99,6 +100,18 @@ class VideoFrame: public MediaFrame {
 std::size_t videoFrameSize(int format, int width, int height);
 void yuv422_clear_to_black(VideoFrame& frame);
 
+/* Pixel buffers allocated by VideoFrame::reserve come from a pool per
+ * geometry, they go back to it when the last frame referencing them is
+ * reset or destroyed.
+ */
+struct VideoFramePoolStats {
+    uint64_t hits {0};      // buffers reused
+    uint64_t misses {0};    // buffers allocated
+    std::size_t pools {0};  // geometries in use
+};
+
+VideoFramePoolStats videoFramePoolStats();
+
 #endif // RING_VIDEO
 
 } // namespace ring
@@ -274,11 +274,12 @@ struct MediaDescription {
     std::string receiving_sdp {};
     unsigned bitrate {};
     unsigned rtp_clockrate {8000};
+    bool rtcpPli {false}; // accepts RTCP picture loss indications
 
     /** Audio parameters */
     unsigned frame_size {};
 
-    /** Video parameters */
+    /** Codec parameters (fmtp) */
     std::string parameters {};
 
     /** Crypto parameters */
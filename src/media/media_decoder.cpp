@@ -36,7 +36,9 @@
 #include "string_utils.h"
 #include "logger.h"
 
+#include <cmath>
 #include <iostream>
+#include <sstream>
 #include <unistd.h>
 #include <thread> // hardware_concurrency
 #include <chrono>
@@ -51,6 +53,77 @@ const constexpr auto jitterBufferMaxDelay_ = std::chrono::milliseconds(50);
 // maximum number of times accelerated decoding can fail in a row before falling back to software
 const constexpr unsigned MAX_ACCEL_FAILURES { 5 };
 
+constexpr unsigned DecodeTimeHistogram::BUCKETS;
+
+void
+DecodeTimeHistogram::add(std::chrono::microseconds time)
+{
+    unsigned bucket = 0;
+    for (auto bound = std::chrono::microseconds(1000); bucket < BUCKETS - 1 and time >= bound; bound *= 2)
+        ++bucket;
+    ++buckets_[bucket];
+    ++count_;
+    total_ += time;
+    max_ = std::max(max_, time);
+}
+
+DecodeTimeHistogram
+DecodeTimeHistogram::since(const DecodeTimeHistogram& earlier) const
+{
+    DecodeTimeHistogram diff;
+    for (unsigned i = 0; i < BUCKETS; ++i)
+        diff.buckets_[i] = buckets_[i] - earlier.buckets_[i];
+    diff.count_ = count_ - earlier.count_;
+    diff.total_ = total_ - earlier.total_;
+    diff.max_ = max_; // not known for the interval
+    return diff;
+}
+
+std::chrono::microseconds
+DecodeTimeHistogram::percentile(double p) const
+{
+    if (not count_)
+        return {};
+    const auto target = std::max<uint64_t>(1, std::ceil(p * count_));
+    uint64_t seen = 0;
+    std::chrono::microseconds lower {0};
+    auto upper = std::chrono::microseconds(1000);
+    for (unsigned i = 0; i < BUCKETS; ++i, lower = upper, upper *= 2) {
+        if (i == BUCKETS - 1)
+            upper = std::max(max_, lower); // unbounded
+        if (seen + buckets_[i] < target) {
+            seen += buckets_[i];
+            continue;
+        }
+        // calls assumed evenly spread in the bucket
+        const auto value = lower + (upper - lower) * static_cast<int64_t>(target - seen)
+                                         / static_cast<int64_t>(buckets_[i]);
+        return std::min(value, max_);
+    }
+    return max_;
+}
+
+bool
+needsFrameThreads(const DecodeTimeHistogram& recent, std::chrono::microseconds frameTime,
+                  unsigned cores)
+{
+    // frame threads need cores to spare
+    return cores >= 4 and recent.count() and recent.percentile(0.9) > frameTime;
+}
+
+std::string
+DecodeTimeHistogram::toString() const
+{
+    std::ostringstream ss;
+    unsigned bound = 1;
+    for (unsigned i = 0; i < BUCKETS - 1; ++i, bound *= 2)
+        ss << "<" << bound << "ms:" << buckets_[i] << " ";
+    ss << ">=" << bound / 2 << "ms:" << buckets_[BUCKETS - 1];
+    if (count_)
+        ss << " mean:" << total_.count() / count_ << "us max:" << max_.count() << "us";
+    return ss.str();
+}
+
 MediaDecoder::MediaDecoder() :
     inputCtx_(avformat_alloc_context()),
     startTime_(AV_NOPTS_VALUE)
@@ -158,14 +231,16 @@ MediaDecoder::setupStream(AVMediaType mediaType)
     int ret = 0;
     std::string streamType = av_get_media_type_string(mediaType);
 
+    // reopened after accel failure or threading change
+    const bool reopen = decoderCtx_ != nullptr;
     avcodec_free_context(&decoderCtx_);
 
     // Increase analyze time to solve synchronization issues between callers.
     static const unsigned MAX_ANALYZE_DURATION = 30;
     inputCtx_->max_analyze_duration = MAX_ANALYZE_DURATION * AV_TIME_BASE;
 
-    // If fallback from accel, don't check for stream info, it's already done
-    if (!fallback_) {
+    // If reopening, don't check for stream info, it's already done
+    if (!reopen) {
         RING_DBG() << "Finding " << streamType << " stream info";
         if ((ret = avformat_find_stream_info(inputCtx_, nullptr)) < 0) {
             // Always fail here
@@ -200,7 +275,10 @@ MediaDecoder::setupStream(AVMediaType mediaType)
     }
     avcodec_parameters_to_context(decoderCtx_, avStream_->codecpar);
 
-    decoderCtx_->thread_count = std::max(1u, std::min(8u, std::thread::hardware_concurrency()/2));
+    if (mediaType == AVMEDIA_TYPE_VIDEO)
+        setupThreading();
+    else
+        decoderCtx_->thread_count = std::max(1u, std::min(8u, std::thread::hardware_concurrency()/2));
     if (mediaType == AVMEDIA_TYPE_AUDIO) {
         decoderCtx_->channels = std::stoi(av_dict_get(options_, "nb_channels", nullptr, 0)->value);
         decoderCtx_->sample_rate = std::stoi(av_dict_get(options_, "sample_rate", nullptr, 0)->value);
@@ -233,6 +311,27 @@ MediaDecoder::setupStream(AVMediaType mediaType)
     return 0;
 }
 
+void
+MediaDecoder::setupThreading()
+{
+    const unsigned cores = std::thread::hardware_concurrency();
+    switch (threading_) {
+        case Threading::SLICE:
+            // frames are output as soon as decoded, which also disables frame threads
+            decoderCtx_->thread_type = FF_THREAD_SLICE;
+            decoderCtx_->thread_count = std::max(1u, std::min(16u, cores));
+            decoderCtx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            break;
+        case Threading::FRAME:
+            decoderCtx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            decoderCtx_->thread_count = std::max(2u, std::min(8u, cores/2));
+            break;
+        case Threading::AUTO:
+            decoderCtx_->thread_count = std::max(1u, std::min(8u, cores/2));
+            break;
+    }
+}
+
 #ifdef RING_VIDEO
 int MediaDecoder::setupFromVideoData()
 {
@@ -262,11 +361,14 @@ MediaDecoder::decode(VideoFrame& result)
 
     auto frame = result.pointer();
     int frameFinished = 0;
+    const auto start = std::chrono::steady_clock::now();
     ret = avcodec_send_packet(decoderCtx_, &inpacket);
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
         return ret == AVERROR_EOF ? Status::Success : Status::DecodeError;
     }
     ret = avcodec_receive_frame(decoderCtx_, frame);
+    decodeTimes_.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start));
     if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
         return Status::DecodeError;
     }
@@ -285,7 +387,6 @@ MediaDecoder::decode(VideoFrame& result)
                 if (accelFailures_ >= MAX_ACCEL_FAILURES) {
                     RING_ERR("Hardware decoding failure");
                     accelFailures_ = 0; // reset error count for next time
-                    fallback_ = true;
                     return Status::RestartRequired;
                 }
             }
@@ -309,12 +410,19 @@ MediaDecoder::decode(VideoFrame& result)
 MediaDecoder::Status
 MediaDecoder::decode(const AudioFrame& decodedFrame)
 {
-    const auto frame = decodedFrame.pointer();
-
     AVPacket inpacket;
     av_init_packet(&inpacket);
 
-   int ret = av_read_frame(inputCtx_, &inpacket);
+    const auto status = readPacket(inpacket);
+    if (status != Status::FrameFinished)
+        return status;
+    return decode(decodedFrame, inpacket);
+}
+
+MediaDecoder::Status
+MediaDecoder::readPacket(AVPacket& packet)
+{
+    int ret = av_read_frame(inputCtx_, &packet);
     if (ret == AVERROR(EAGAIN)) {
         return Status::Success;
     } else if (ret == AVERROR_EOF) {
@@ -325,15 +433,24 @@ MediaDecoder::decode(const AudioFrame& decodedFrame)
     }
 
     // is this a packet from the audio stream?
-    if (inpacket.stream_index != streamIndex_) {
-        av_packet_unref(&inpacket);
+    if (packet.stream_index != streamIndex_) {
+        av_packet_unref(&packet);
         return Status::Success;
     }
 
+    return Status::FrameFinished;
+}
+
+MediaDecoder::Status
+MediaDecoder::decode(const AudioFrame& decodedFrame, AVPacket& inpacket)
+{
+    const auto frame = decodedFrame.pointer();
+
     int frameFinished = 0;
-        ret = avcodec_send_packet(decoderCtx_, &inpacket);
-        if (ret < 0 && ret != AVERROR(EAGAIN))
-            return ret == AVERROR_EOF ? Status::Success : Status::DecodeError;
+    int ret = avcodec_send_packet(decoderCtx_, &inpacket);
+    av_packet_unref(&inpacket);
+    if (ret < 0 && ret != AVERROR(EAGAIN))
+        return ret == AVERROR_EOF ? Status::Success : Status::DecodeError;
 
     ret = avcodec_receive_frame(decoderCtx_, frame);
     if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
@@ -342,7 +459,6 @@ MediaDecoder::decode(const AudioFrame& decodedFrame)
         frameFinished = 1;
 
     if (frameFinished) {
-        av_packet_unref(&inpacket);
         if (emulateRate_ and frame->pts != AV_NOPTS_VALUE) {
             auto frame_time = getTimeBase()*(frame->pts - avStream_->start_time);
             auto target = startTime_ + static_cast<std::int64_t>(frame_time.real() * 1e6);
@@ -432,7 +548,7 @@ MediaDecoder::getTimeBase() const
 int MediaDecoder::getPixelFormat() const
 { return libav_utils::ring_pixel_format(decoderCtx_->pix_fmt); }
 
-void
+const AudioBuffer&
 MediaDecoder::writeToRingBuffer(const AudioFrame& decodedFrame,
                                 RingBuffer& rb, const AudioFormat outFormat)
 {
@@ -460,9 +576,11 @@ MediaDecoder::writeToRingBuffer(const AudioFrame& decodedFrame,
         resamplingBuff_.resize(libav_frame->nb_samples);
         resampler_->resample(decBuff_, resamplingBuff_);
         rb.put(resamplingBuff_);
-    } else {
-        rb.put(decBuff_);
+        return resamplingBuff_;
     }
+
+    rb.put(decBuff_);
+    return decBuff_;
 }
 
 int
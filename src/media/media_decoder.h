@@ -35,6 +35,7 @@
 #include "rational.h"
 #include "noncopyable.h"
 
+#include <array>
 #include <map>
 #include <string>
 #include <memory>
@@ -45,6 +46,7 @@ class AVStream;
 class AVDictionary;
 class AVFormatContext;
 class AVCodec;
+struct AVPacket;
 enum AVMediaType;
 
 namespace ring {
@@ -56,8 +58,49 @@ class Resampler;
 class MediaIOHandle;
 struct DeviceParams;
 
+/**
+ * Histogram of the time taken by each decode call, in power of two buckets
+ * from 1ms.
+ */
+class DecodeTimeHistogram {
+    public:
+        static constexpr unsigned BUCKETS {8}; // <1ms, <2ms ... <64ms, more
+
+        void add(std::chrono::microseconds time);
+
+        // What was added since earlier, a previous copy of this histogram
+        DecodeTimeHistogram since(const DecodeTimeHistogram& earlier) const;
+
+        // Time of the p-th fraction of the calls, interpolated within its
+        // bucket and at most the longest call
+        std::chrono::microseconds percentile(double p) const;
+
+        uint64_t count() const { return count_; }
+        std::chrono::microseconds max() const { return max_; }
+        std::string toString() const;
+
+    private:
+        std::array<uint64_t, BUCKETS> buckets_ {};
+        uint64_t count_ {0};
+        std::chrono::microseconds total_ {0};
+        std::chrono::microseconds max_ {0};
+};
+
+// Whether decode times show slice threads can't keep up with frames of
+// frameTime, so that frame threads are worth their added latency
+bool needsFrameThreads(const DecodeTimeHistogram& recent,
+                       std::chrono::microseconds frameTime, unsigned cores);
+
 class MediaDecoder {
     public:
+        /**
+         * How video is decoded in parallel.
+         * SLICE: the slices of each frame, without any added delay.
+         * FRAME: consecutive frames, one frame of delay per thread.
+         * AUTO: as chosen by libav.
+         */
+        enum class Threading { AUTO, SLICE, FRAME };
+
         enum class Status {
             Success,
             FrameFinished,
@@ -83,16 +126,39 @@ class MediaDecoder {
 
         int setupFromAudioData(const AudioFormat format);
         Status decode(const AudioFrame&);
-        void writeToRingBuffer(const AudioFrame&, RingBuffer&, const AudioFormat);
+
+        /**
+         * Demux the next audio packet, without decoding it.
+         * Returns FrameFinished when packet holds a packet to be decoded
+         * with decode(const AudioFrame&, AVPacket&).
+         */
+        Status readPacket(AVPacket& packet);
+        Status decode(const AudioFrame&, AVPacket& packet);
+
+        /**
+         * Convert and resample the frame to outFormat, then put it in rb.
+         * Returns the buffer written, valid until next call.
+         */
+        const AudioBuffer& writeToRingBuffer(const AudioFrame&, RingBuffer&, const AudioFormat);
 
         int getWidth() const;
         int getHeight() const;
         std::string getDecoderName() const;
 
         rational<double> getFps() const;
+        rational<unsigned> getTimeBase() const;
         int getPixelFormat() const;
 
         void setOptions(const std::map<std::string, std::string>& options);
+
+        /**
+         * Taken in account by the next setupFromVideoData(), which can be
+         * called again to switch an open decoder.
+         */
+        void setThreading(Threading threading) { threading_ = threading; }
+        Threading getThreading() const { return threading_; }
+
+        const DecodeTimeHistogram& getDecodeTimes() const { return decodeTimes_; }
 #ifdef RING_ACCEL
         void enableAccel(bool enableAccel);
 #endif
@@ -100,8 +166,6 @@ class MediaDecoder {
     private:
         NON_COPYABLE(MediaDecoder);
 
-        rational<unsigned> getTimeBase() const;
-
         AVCodec *inputDecoder_ = nullptr;
         AVCodecContext *decoderCtx_ = nullptr;
         AVFormatContext *inputCtx_ = nullptr;
@@ -117,8 +181,10 @@ class MediaDecoder {
         void extract(const std::map<std::string, std::string>& map, const std::string& key);
         int correctPixFmt(int input_pix_fmt);
         int setupStream(AVMediaType mediaType);
+        void setupThreading();
 
-        bool fallback_ = false;
+        Threading threading_ = Threading::AUTO;
+        DecodeTimeHistogram decodeTimes_;
 
 #ifdef RING_ACCEL
         bool enableAccel_ = true;
@@ -29,6 +29,10 @@
 #include "string_utils.h"
 #include "logger.h"
 
+#ifdef RING_VIDEO
+#include "manager.h"
+#endif
+
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -144,6 +148,48 @@ MediaEncoder::openOutput(const std::string& filename,
     outputCtx_->filename[sizeof(outputCtx_->filename) - 1] = '\0';
 #endif
 
+    bool opened = false;
+#ifdef RING_ACCEL
+    if (args.codec->systemCodecInfo.mediaType == MEDIA_VIDEO)
+        opened = openHardwareEncoder(args);
+#endif
+    if (not opened)
+        openSoftwareEncoder(args);
+
+    // add video stream to outputformat context
+    stream_ = avformat_new_stream(outputCtx_, 0);
+    if (!stream_)
+        throw MediaEncoderException("Could not allocate stream");
+
+#ifndef _WIN32
+    avcodec_parameters_from_context(stream_->codecpar, encoderCtx_);
+#else
+    stream_->codec = encoderCtx_;
+#endif
+#ifdef RING_VIDEO
+    if (args.codec->systemCodecInfo.mediaType == MEDIA_VIDEO) {
+        // allocate buffers for both scaled (pre-encoder) and encoded frames
+        const int width = encoderCtx_->width;
+        const int height = encoderCtx_->height;
+        auto pixelFormat = encoderCtx_->pix_fmt;
+#ifdef RING_ACCEL
+        if (not accel_.name.empty())
+            pixelFormat = accel_.swFormat; // scaled, then uploaded
+#endif
+        const int format = libav_utils::ring_pixel_format((int)pixelFormat);
+        scaledFrameBufferSize_ = videoFrameSize(format, width, height);
+        if (scaledFrameBufferSize_ <= AV_INPUT_BUFFER_MIN_SIZE)
+            throw MediaEncoderException("buffer too small");
+
+        scaledFrameBuffer_.reserve(scaledFrameBufferSize_);
+        scaledFrame_.setFromMemory(scaledFrameBuffer_.data(), format, width, height);
+    }
+#endif // RING_VIDEO
+}
+
+void
+MediaEncoder::openSoftwareEncoder(const MediaDescription& args)
+{
     /* find the video encoder */
     if (args.codec->systemCodecInfo.avcodecId == AV_CODEC_ID_H263)
         // For H263 encoding, we force the use of AV_CODEC_ID_H263P (H263-1998)
@@ -175,6 +221,16 @@ MediaEncoder::openOutput(const std::string& filename,
         av_opt_set(encoderCtx_->priv_data, "crf", av_dict_get(options_, "crf", NULL, 0)->value, 0);
         encoderCtx_->rc_buffer_size = bufSize;
         encoderCtx_->rc_max_rate = maxBitrate;
+#ifdef RING_VIDEO
+        // a column of intra blocks sweeps the picture each second instead of
+        // keyframes, losses are repaired without bitrate peaks
+        if (Manager::instance().videoPreferences.getIntraRefresh()
+            and av_opt_set_int(encoderCtx_->priv_data, "intra-refresh", 1, 0) >= 0) {
+            encoderCtx_->gop_size = std::max(1, static_cast<int>(device_.framerate.real()));
+            intraRefresh_ = true;
+            RING_DBG("H264 encoder uses periodic intra refresh");
+        }
+#endif
     } else if (args.codec->systemCodecInfo.avcodecId == AV_CODEC_ID_VP8) {
         // For VP8 :
         // 1- if quality is set use it
@@ -219,32 +275,49 @@ MediaEncoder::openOutput(const std::string& filename,
     ret = avcodec_open2(encoderCtx_, outputEncoder_, NULL);
     if (ret)
         throw MediaEncoderException("Could not open encoder");
+}
 
-    // add video stream to outputformat context
-    stream_ = avformat_new_stream(outputCtx_, 0);
-    if (!stream_)
-        throw MediaEncoderException("Could not allocate stream");
+#ifdef RING_ACCEL
+bool
+MediaEncoder::openHardwareEncoder(const MediaDescription& args)
+{
+    if (not Manager::instance().getEncodingAccelerated())
+        return false;
+
+    const auto codecId = static_cast<AVCodecID>(args.codec->systemCodecInfo.avcodecId);
+    for (const auto& accel : video::getHardwareEncoders()) {
+        if (accel.codecId != codecId)
+            continue;
+        outputEncoder_ = avcodec_find_encoder_by_name(accel.encoder.c_str());
+        if (not outputEncoder_)
+            continue;
+
+        prepareEncoderContext(true);
+        // no CRF: constrained VBR at the negotiated bitrate
+        auto maxBitrate = 1000 * atoi(av_dict_get(options_, "max_rate", NULL, 0)->value);
+        encoderCtx_->bit_rate = encoderCtx_->rc_max_rate = maxBitrate;
+        encoderCtx_->rc_buffer_size = 2 * maxBitrate;
+        if (codecId == AV_CODEC_ID_H264) {
+            extractProfileLevelID(args.parameters, encoderCtx_);
+            // VAAPI has no plain baseline, constrained baseline is decoded by everybody
+            if (encoderCtx_->profile == FF_PROFILE_H264_BASELINE)
+                encoderCtx_->profile = FF_PROFILE_H264_CONSTRAINED_BASELINE;
+        }
 
-#ifndef _WIN32
-    avcodec_parameters_from_context(stream_->codecpar, encoderCtx_);
-#else
-    stream_->codec = encoderCtx_;
-#endif
-#ifdef RING_VIDEO
-    if (args.codec->systemCodecInfo.mediaType == MEDIA_VIDEO) {
-        // allocate buffers for both scaled (pre-encoder) and encoded frames
-        const int width = encoderCtx_->width;
-        const int height = encoderCtx_->height;
-        const int format = libav_utils::ring_pixel_format((int)encoderCtx_->pix_fmt);
-        scaledFrameBufferSize_ = videoFrameSize(format, width, height);
-        if (scaledFrameBufferSize_ <= AV_INPUT_BUFFER_MIN_SIZE)
-            throw MediaEncoderException("buffer too small");
+        if (video::setupHardwareEncoding(accel, encoderCtx_) >= 0
+            and avcodec_open2(encoderCtx_, outputEncoder_, NULL) == 0) {
+            RING_DBG("Using '%s' hardware encoder", accel.encoder.c_str());
+            accel_ = accel;
+            return true;
+        }
 
-        scaledFrameBuffer_.reserve(scaledFrameBufferSize_);
-        scaledFrame_.setFromMemory(scaledFrameBuffer_.data(), format, width, height);
+        RING_WARN("Could not open '%s' hardware encoder, falling back to software encoding",
+                  accel.encoder.c_str());
+        avcodec_free_context(&encoderCtx_);
     }
-#endif // RING_VIDEO
+    return false;
 }
+#endif // RING_ACCEL
 
 void MediaEncoder::setInterruptCallback(int (*cb)(void*), void *opaque)
 {
@@ -285,11 +358,47 @@ MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
     /* Prepare a frame suitable to our encoder frame format,
      * keeping also the input aspect ratio.
      */
-    yuv422_clear_to_black(scaledFrame_); // to fill blank space left by the "keep aspect"
-
-    scaler_.scale_with_aspect(input, scaledFrame_);
+    if (const auto bitrate = pendingBitrate_.exchange(0)) {
+        // same VBV settings as openOutput, libx264 reconfigures itself
+        const auto maxBitrate = 1000 * bitrate;
+        encoderCtx_->rc_max_rate = maxBitrate;
+        encoderCtx_->rc_buffer_size = 2 * maxBitrate;
+    }
 
     auto frame = scaledFrame_.pointer();
+#ifdef RING_ACCEL
+    const bool hardwareInput = not accel_.name.empty()
+        and video::isHardwareFrame(accel_, encoderCtx_, input);
+#else
+    const bool hardwareInput = false;
+#endif
+
+    // inputs scaled upstream (see ScalingCache) are encoded as they are
+    const auto in = input.pointer();
+    const bool scaledInput = not hardwareInput and in->width == frame->width
+        and in->height == frame->height and in->format == frame->format;
+    if (scaledInput) {
+        inputFrame_.reset();
+        if (av_frame_ref(inputFrame_.pointer(), in) < 0)
+            return -1;
+        frame = inputFrame_.pointer();
+    } else if (not hardwareInput) {
+        yuv422_clear_to_black(scaledFrame_); // to fill blank space left by the "keep aspect"
+        scaler_.scale_with_aspect(input, scaledFrame_);
+    }
+
+#ifdef RING_ACCEL
+    if (not accel_.name.empty()) {
+        // frames already on our device are only referenced
+        const auto& source = hardwareInput ? input : scaledInput ? inputFrame_ : scaledFrame_;
+        if (video::uploadFrameData(accel_, encoderCtx_, source, hardwareFrame_) < 0) {
+            RING_ERR("Could not upload frame to the hardware encoder");
+            return -1;
+        }
+        frame = hardwareFrame_.pointer();
+    }
+#endif
+
     frame->pts = frame_number;
 
     if (is_keyframe) {
@@ -317,20 +426,10 @@ MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
             return -1;
 
         if (pkt.size) {
-            if (pkt.pts != AV_NOPTS_VALUE)
-                pkt.pts = av_rescale_q(pkt.pts, encoderCtx_->time_base,
-                                       stream_->time_base);
-            if (pkt.dts != AV_NOPTS_VALUE)
-                pkt.dts = av_rescale_q(pkt.dts, encoderCtx_->time_base,
-                                       stream_->time_base);
-
-            pkt.stream_index = stream_->index;
-
-            // write the compressed frame
-            ret = av_write_frame(outputCtx_, &pkt);
-            if (ret < 0) {
-                RING_ERR("av_write_frame failed: %s", libav_utils::getError(ret).c_str());
-            } else
+            if (packetCallback_)
+                packetCallback_(pkt);
+            ret = send(pkt);
+            if (ret >= 0)
                 break;
         }
     }
@@ -339,8 +438,47 @@ MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
 
     return ret;
 }
+
+void
+MediaEncoder::setPacketCallback(std::function<void(AVPacket&)> cb)
+{
+    packetCallback_ = std::move(cb);
+}
+
+bool
+MediaEncoder::setBitrate(unsigned bitrate)
+{
+    // other encoders only read their rate control settings when opened
+    if (not encoderCtx_ or encoderCtx_->codec_id != AV_CODEC_ID_H264 or not bitrate)
+        return false;
+#ifdef RING_ACCEL
+    if (not accel_.name.empty())
+        return false;
+#endif
+    pendingBitrate_ = bitrate;
+    return true;
+}
 #endif // RING_VIDEO
 
+int
+MediaEncoder::send(AVPacket& pkt)
+{
+    if (pkt.pts != AV_NOPTS_VALUE)
+        pkt.pts = av_rescale_q(pkt.pts, encoderCtx_->time_base,
+                               stream_->time_base);
+    if (pkt.dts != AV_NOPTS_VALUE)
+        pkt.dts = av_rescale_q(pkt.dts, encoderCtx_->time_base,
+                               stream_->time_base);
+
+    pkt.stream_index = stream_->index;
+
+    // write the compressed frame
+    auto ret = av_write_frame(outputCtx_, &pkt);
+    if (ret < 0)
+        RING_ERR("av_write_frame failed: %s", libav_utils::getError(ret).c_str());
+    return ret;
+}
+
 int MediaEncoder::encode_audio(const AudioBuffer &buffer)
 {
     const int needed_bytes = av_samples_get_buffer_size(NULL, buffer.channels(),
@@ -351,19 +489,28 @@ int MediaEncoder::encode_audio(const AudioBuffer &buffer)
         return -1;
     }
 
-    std::vector<AudioSample> samples (needed_bytes / sizeof(AudioSample));
-    AudioSample* sample_data = samples.data();
-
-    AudioSample *offset_ptr = sample_data;
-    int nb_frames = buffer.frames();
-
-    if (not is_muted) {
-        //only fill buffer with samples if not muted
-        buffer.interleave(sample_data);
+    const AudioSample* sample_data;
+    if (buffer.channels() == 1 and not is_muted) {
+        // a mono channel is already laid out as the encoder expects it
+        sample_data = buffer.getChannel(0);
     } else {
-        //otherwise filll buffer with zero
-        buffer.fillWithZero(sample_data);
+        // only grows, no allocation once the largest frame has been seen
+        const size_t needed_samples = needed_bytes / sizeof(AudioSample);
+        if (audioSamples_.size() < needed_samples)
+            audioSamples_.resize(needed_samples);
+
+        if (not is_muted) {
+            //only fill buffer with samples if not muted
+            buffer.interleave(audioSamples_.data());
+        } else {
+            //otherwise filll buffer with zero
+            buffer.fillWithZero(audioSamples_.data());
+        }
+        sample_data = audioSamples_.data();
     }
+
+    const AudioSample *offset_ptr = sample_data;
+    int nb_frames = buffer.frames();
     const auto layout = buffer.channels() == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
     const auto sample_rate = buffer.getSampleRate();
 
@@ -446,6 +593,12 @@ int MediaEncoder::encode_audio(const AudioBuffer &buffer)
     return 0;
 }
 
+void
+MediaEncoder::skip_audio(size_t frames)
+{
+    sent_samples += frames;
+}
+
 int MediaEncoder::flush()
 {
     AVPacket pkt;
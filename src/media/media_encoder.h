@@ -28,16 +28,24 @@
 #include "video/video_scaler.h"
 #endif
 
+#ifdef RING_ACCEL
+#include "video/accel.h"
+#endif
+
 #include "noncopyable.h"
+#include "ring_types.h"
 #include "media_buffer.h"
 #include "media_device.h"
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 struct AVCodecContext;
+struct AVPacket;
 struct AVStream;
 struct AVFormatContext;
 struct AVDictionary;
@@ -69,9 +77,33 @@ public:
 
 #ifdef RING_VIDEO
     int encode(VideoFrame &input, bool is_keyframe, int64_t frame_number);
+
+    /**
+     * Called with each encoded packet before it is sent, timestamps are in
+     * the encoder time base.
+     */
+    void setPacketCallback(std::function<void(AVPacket&)> cb);
+
+    /**
+     * Change the maximum bitrate (kbit/s) from the next frame, without
+     * opening the encoder again. Returns false if the codec can't.
+     */
+    bool setBitrate(unsigned bitrate);
 #endif // RING_VIDEO
 
+    /**
+     * Send a packet given by encode's packet callback of an encoder opened
+     * with the same parameters, instead of encoding.
+     */
+    int send(AVPacket& packet);
+
     int encode_audio(const AudioBuffer &input);
+
+    /**
+     * Advance the audio timestamp by 'frames' without sending anything,
+     * for discontinuous transmission during silence.
+     */
+    void skip_audio(size_t frames);
     int flush();
     std::string print_sdp();
 
@@ -80,6 +112,10 @@ public:
      */
     int getWidth() const { return device_.width; }
     int getHeight() const { return device_.height; }
+#ifdef RING_VIDEO
+    // libav pixel format frames are scaled to before encoding
+    int getPixelFormat() const { return scaledFrame_.pointer()->format; }
+#endif
 
     void setMuted(bool isMuted);
     void setInitSeqVal(uint16_t seqVal);
@@ -88,10 +124,14 @@ public:
 
     bool useCodec(const AccountCodecInfo* codec) const noexcept;
 
+    // Losses are repaired by the encoder, keyframes are only needed to start
+    bool useIntraRefresh() const noexcept { return intraRefresh_; }
+
 private:
     NON_COPYABLE(MediaEncoder);
     void setOptions(const MediaDescription& args);
     void setScaleDest(void *data, int width, int height, int pix_fmt);
+    void openSoftwareEncoder(const MediaDescription& args);
     void prepareEncoderContext(bool is_video);
     void forcePresetX264();
     void extractProfileLevelID(const std::string &parameters, AVCodecContext *ctx);
@@ -105,12 +145,23 @@ private:
 #ifdef RING_VIDEO
     video::VideoScaler scaler_;
     VideoFrame scaledFrame_;
+    VideoFrame inputFrame_; // references inputs already at the encoder size
+    std::function<void(AVPacket&)> packetCallback_;
+    std::atomic<unsigned> pendingBitrate_ {0};
 #endif // RING_VIDEO
 
+#ifdef RING_ACCEL
+    bool openHardwareEncoder(const MediaDescription& args);
+    video::HardwareEncoder accel_ {}; // empty name if encoding in software
+    VideoFrame hardwareFrame_;
+#endif
+
     std::vector<uint8_t> scaledFrameBuffer_;
     int scaledFrameBufferSize_ = 0;
+    std::vector<AudioSample> audioSamples_; // interleaved multichannel or muted samples, reused between frames
     int streamIndex_ = -1;
     bool is_muted = false;
+    bool intraRefresh_ = false;
 
 protected:
     AVDictionary *options_ = nullptr;
@@ -29,9 +29,10 @@ namespace ring {
 Recordable::Recordable()
     : recAudio_(new AudioRecord)
 {
-    auto record_path = Manager::instance().audioPreference.getRecordPath();
+    const auto& pref = Manager::instance().audioPreference;
+    auto record_path = pref.getRecordPath();
     RING_DBG("Set recording options: %s", record_path.c_str());
-    recAudio_->setRecordingOptions(AudioFormat::MONO(), record_path);
+    recAudio_->setRecordingOptions(AudioFormat::MONO(), record_path, pref.getRecordFormat());
 }
 
 Recordable::~Recordable()
@@ -24,6 +24,7 @@
 #include "libav_deps.h" // THEN THIS ONE AFTER
 
 #include "socket_pair.h"
+#include "srtp_aead.h"
 #include "ice_socket.h"
 #include "libav_utils.h"
 #include "logger.h"
@@ -67,6 +68,11 @@ static constexpr auto UDP_HEADER_SIZE = 8;
 static constexpr auto SRTP_OVERHEAD = 10;
 static constexpr uint32_t RTCP_RR_FRACTION_MASK = 0xFF000000;
 
+// payload-specific feedback (RFC 4585) and its formats for keyframe requests
+static constexpr uint8_t RTCP_PSFB = 206;
+static constexpr uint8_t RTCP_PSFB_PLI = 1;
+static constexpr uint8_t RTCP_PSFB_FIR = 4; // RFC 5104
+
 enum class DataType : unsigned { RTP=1<<0, RTCP=1<<1 };
 
 class SRTPProtoContext {
@@ -76,15 +82,24 @@ public:
         ring_secure_memzero(&srtp_out, sizeof(srtp_out));
         ring_secure_memzero(&srtp_in, sizeof(srtp_in));
         if (out_suite && out_key) {
-            // XXX: see srtp_open from libavformat/srtpproto.c
-            if (ff_srtp_set_crypto(&srtp_out, out_suite, out_key) < 0) {
+            if (SrtpAead::isSupported(out_suite)) {
+                aead_out.reset(new SrtpAead(out_suite, out_key));
+            } else if (ff_srtp_set_crypto(&srtp_out, out_suite, out_key) < 0) {
+                // XXX: see srtp_open from libavformat/srtpproto.c
                 srtp_close();
                 throw std::runtime_error("Could not set crypto on output");
             }
         }
 
         if (in_suite && in_key) {
-            if (ff_srtp_set_crypto(&srtp_in, in_suite, in_key) < 0) {
+            if (SrtpAead::isSupported(in_suite)) {
+                try {
+                    aead_in.reset(new SrtpAead(in_suite, in_key));
+                } catch (const std::exception&) {
+                    srtp_close();
+                    throw;
+                }
+            } else if (ff_srtp_set_crypto(&srtp_in, in_suite, in_key) < 0) {
                 srtp_close();
                 throw std::runtime_error("Could not set crypto on input");
             }
@@ -95,8 +110,15 @@ public:
         srtp_close();
     }
 
+    // bytes added to the RTP packets we send
+    unsigned overhead() const {
+        return aead_out ? SrtpAead::TAG_SIZE : SRTP_OVERHEAD;
+    }
+
     SRTPContext srtp_out {};
     SRTPContext srtp_in {};
+    std::unique_ptr<SrtpAead> aead_out;
+    std::unique_ptr<SrtpAead> aead_in;
     uint8_t encryptbuf[RTP_MAX_PACKET_LENGTH];
 
 private:
@@ -171,28 +193,45 @@ SocketPair::SocketPair(std::unique_ptr<IceSocket> rtp_sock,
     : rtp_sock_(std::move(rtp_sock))
     , rtcp_sock_(std::move(rtcp_sock))
 {
-    auto queueRtpPacket = [this](uint8_t* buf, size_t len) {
+    // packets are kept by reference until read
+    auto queueRtpPacket = [this](PacketBuffer&& packet) {
+        if (not rtpDataBuff_.push(std::move(packet)))
+            RING_WARN("SocketPair: RTP queue full, packet dropped");
         std::lock_guard<std::mutex> l(dataBuffMutex_);
-        rtpDataBuff_.emplace_back(buf, buf+len);
         cv_.notify_one();
-        return len;
     };
 
-    auto queueRtcpPacket = [this](uint8_t* buf, size_t len) {
+    auto queueRtcpPacket = [this](PacketBuffer&& packet) {
+        if (not rtcpDataBuff_.push(std::move(packet)))
+            RING_WARN("SocketPair: RTCP queue full, packet dropped");
         std::lock_guard<std::mutex> l(dataBuffMutex_);
-        rtcpDataBuff_.emplace_back(buf, buf+len);
         cv_.notify_one();
-        return len;
     };
 
-    rtp_sock_->setOnRecv(queueRtpPacket);
-    rtcp_sock_->setOnRecv(queueRtcpPacket);
+    rtp_sock_->setOnRecvPacket(queueRtpPacket);
+    rtcp_sock_->setOnRecvPacket(queueRtcpPacket);
 }
 
 SocketPair::~SocketPair()
 {
     interrupt();
     closeSockets();
+
+    if (rtpHandle_ >= 0) {
+        const auto recv = rtpRecvBatch_.getStats();
+        const auto send = rtpSendBatch_.getStats();
+        RING_DBG("SocketPair: received %llu RTP packets in %llu calls, sent %llu in %llu calls",
+                 static_cast<unsigned long long>(recv.datagrams),
+                 static_cast<unsigned long long>(recv.syscalls),
+                 static_cast<unsigned long long>(send.datagrams),
+                 static_cast<unsigned long long>(send.syscalls));
+    } else {
+        const auto stats = PacketBuffer::getStats();
+        RING_DBG("SocketPair: packet buffers: %llu received, %llu copied out, %u in use, %llu slabs",
+                 static_cast<unsigned long long>(stats.packets),
+                 static_cast<unsigned long long>(stats.copiesOut), stats.inUse,
+                 static_cast<unsigned long long>(stats.slabs));
+    }
 }
 
 void
@@ -205,16 +244,65 @@ SocketPair::saveRtcpPacket(uint8_t* buf, size_t len)
     if(header->pt != 201) //201 = RR PT
         return;
 
+    RtcpReceiverReport report;
+    report.header = *header;
+
     std::lock_guard<std::mutex> lock(rtcpInfo_mutex_);
 
+    // RTT = now - time the SR was sent - delay before the RR was sent
+    const auto lsr = ntohl(header->lsr);
+    if (lsr) {
+        for (const auto& sr : senderReports_) {
+            if (sr.ntp == lsr) {
+                const auto dlsr = std::chrono::microseconds(
+                    (static_cast<uint64_t>(ntohl(header->dlsr)) * 1000000) >> 16);
+                const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - sr.time) - dlsr;
+                if (rtt.count() >= 0)
+                    report.rtt = rtt;
+                break;
+            }
+        }
+    }
+
     if (listRtcpHeader_.size() >= MAX_LIST_SIZE) {
         listRtcpHeader_.pop_front();
     }
 
-    listRtcpHeader_.push_back(*header);
+    listRtcpHeader_.push_back(report);
+}
+
+void
+SocketPair::saveSenderReport(const uint8_t* buf, size_t len)
+{
+    if (len < 16 or buf[1] != 200) // 200 = SR PT
+        return;
+
+    // middle of the 64 bits NTP timestamp at offset 8
+    const uint32_t ntp = (uint32_t(buf[10]) << 24) | (uint32_t(buf[11]) << 16)
+                       | (uint32_t(buf[12]) << 8) | buf[13];
+    std::lock_guard<std::mutex> lock(rtcpInfo_mutex_);
+    lastSenderReport_ = (lastSenderReport_ + 1) % senderReports_.size();
+    senderReports_[lastSenderReport_] = {ntp, std::chrono::steady_clock::now()};
+}
+
+// Count the keyframe requests of the compound packet
+void
+SocketPair::saveRtcpFeedback(const uint8_t* buf, size_t len)
+{
+    while (len >= 4) {
+        const size_t size = 4 * ((size_t(buf[2]) << 8 | buf[3]) + 1);
+        if (size > len)
+            break;
+        const auto fmt = buf[0] & 0x1f;
+        if (buf[1] == RTCP_PSFB and (fmt == RTCP_PSFB_PLI or fmt == RTCP_PSFB_FIR))
+            ++pictureLossIndications_;
+        buf += size;
+        len -= size;
+    }
 }
 
-std::vector<rtcpRRHeader>
+std::vector<RtcpReceiverReport>
 SocketPair::getRtcpInfo()
 {
     decltype(listRtcpHeader_) l;
@@ -238,8 +326,8 @@ void
 SocketPair::interrupt()
 {
     interrupted_ = true;
-    if (rtp_sock_) rtp_sock_->setOnRecv(nullptr);
-    if (rtcp_sock_) rtcp_sock_->setOnRecv(nullptr);
+    if (rtp_sock_) rtp_sock_->setOnRecvPacket(nullptr);
+    if (rtcp_sock_) rtcp_sock_->setOnRecvPacket(nullptr);
     cv_.notify_all();
 }
 
@@ -294,7 +382,7 @@ SocketPair::createIOContext(const uint16_t mtu)
         ip_header_size = 40;
     else
         ip_header_size = 20;
-    return new MediaIOHandle( mtu - (srtpContext_ ? SRTP_OVERHEAD : 0) - UDP_HEADER_SIZE - ip_header_size,
+    return new MediaIOHandle( mtu - (srtpContext_ ? srtpContext_->overhead() : 0) - UDP_HEADER_SIZE - ip_header_size,
                               true,
                              [](void* sp, uint8_t* buf, int len){ return static_cast<SocketPair*>(sp)->readCallback(buf, len); },
                              [](void* sp, uint8_t* buf, int len){ return static_cast<SocketPair*>(sp)->writeCallback(buf, len); },
@@ -306,6 +394,10 @@ SocketPair::waitForData()
 {
     // System sockets
     if (rtpHandle_ >= 0) {
+        // received by the last batch
+        if (not rtpRecvBatch_.empty())
+            return static_cast<int>(DataType::RTP);
+
         int ret;
         do {
             if (interrupted_) {
@@ -347,25 +439,17 @@ SocketPair::waitForData()
 int
 SocketPair::readRtpData(void* buf, int buf_size)
 {
-    // handle system socket
+    // handle system socket, all the waiting packets are read at once
     if (rtpHandle_ >= 0) {
-        struct sockaddr_storage from;
-        socklen_t from_len = sizeof(from);
-        return recvfrom(rtpHandle_, static_cast<char*>(buf), buf_size, 0,
-                        reinterpret_cast<struct sockaddr*>(&from), &from_len);
+        if (rtpRecvBatch_.empty() and rtpRecvBatch_.receive(rtpHandle_) < 0)
+            return -1;
+        return rtpRecvBatch_.pop(buf, buf_size);
     }
 
     // handle ICE
-    std::unique_lock<std::mutex> lk(dataBuffMutex_);
-    if (not rtpDataBuff_.empty()) {
-        auto pkt = rtpDataBuff_.front();
-        rtpDataBuff_.pop_front();
-        lk.unlock(); // to not block our ICE callbacks
-        int pkt_size = pkt.size();
-        int len = std::min(pkt_size, buf_size);
-        std::copy_n(pkt.begin(), len, static_cast<char*>(buf));
-        return len;
-    }
+    PacketBuffer packet;
+    if (rtpDataBuff_.pop(packet))
+        return packet.copyTo(buf, buf_size);
 
     return 0;
 }
@@ -382,16 +466,9 @@ SocketPair::readRtcpData(void* buf, int buf_size)
     }
 
     // handle ICE
-    std::unique_lock<std::mutex> lk(dataBuffMutex_);
-    if (not rtcpDataBuff_.empty()) {
-        auto pkt = rtcpDataBuff_.front();
-        rtcpDataBuff_.pop_front();
-        lk.unlock();
-        int pkt_size = pkt.size();
-        int len = std::min(pkt_size, buf_size);
-        std::copy_n(pkt.begin(), len, static_cast<char*>(buf));
-        return len;
-    }
+    PacketBuffer packet;
+    if (rtcpDataBuff_.pop(packet))
+        return packet.copyTo(buf, buf_size);
 
     return 0;
 }
@@ -399,44 +476,58 @@ SocketPair::readRtcpData(void* buf, int buf_size)
 int
 SocketPair::readCallback(uint8_t* buf, int buf_size)
 {
-    auto datatype = waitForData();
-    if (datatype < 0)
-        return datatype;
-
-    int len = 0;
-    bool fromRTCP = false;
-
-    // Priority to RTCP as its less invasive in bandwidth
-    if (datatype & static_cast<int>(DataType::RTCP)) {
-        len = readRtcpData(buf, buf_size);
-        saveRtcpPacket(buf, len);
-        fromRTCP = true;
-    }
+    while (true) {
+        auto datatype = waitForData();
+        if (datatype < 0)
+            return datatype;
+
+        int len = 0;
+        bool fromRTCP = false;
+
+        // Priority to RTCP as its less invasive in bandwidth
+        if (datatype & static_cast<int>(DataType::RTCP)) {
+            len = readRtcpData(buf, buf_size);
+            saveRtcpPacket(buf, len);
+            if (len > 0)
+                saveRtcpFeedback(buf, len);
+            fromRTCP = true;
+        }
 
-    // No RTCP... try RTP
-    if (!len and (datatype & static_cast<int>(DataType::RTP))) {
-        len = readRtpData(buf, buf_size);
-        fromRTCP = false;
-    }
+        // No RTCP... try RTP
+        if (!len and (datatype & static_cast<int>(DataType::RTP))) {
+            len = readRtpData(buf, buf_size);
+            fromRTCP = false;
+        }
 
-    if (len <= 0)
-        return len;
+        if (len <= 0)
+            return len;
 
-    // SRTP decrypt
-    if (not fromRTCP and srtpContext_ and srtpContext_->srtp_in.aes) {
-        auto err = ff_srtp_decrypt(&srtpContext_->srtp_in, buf, &len);
-        if (err < 0)
-            RING_WARN("decrypt error %d", err);
-    }
+        if (not fromRTCP and len >= 12)
+            remoteSsrc_ = AV_RB32(buf + 8);
 
-    if (len != 0)
-        return len;
-    else
-        return AVERROR_EOF;
+        // SRTP decrypt
+        if (not fromRTCP and srtpContext_ and srtpContext_->aead_in) {
+            // forged or corrupted packets are dropped
+            len = srtpContext_->aead_in->unprotect(buf, len);
+            if (len < 0) {
+                RING_WARN("SRTP authentication failed, packet dropped");
+                continue;
+            }
+        } else if (not fromRTCP and srtpContext_ and srtpContext_->srtp_in.aes) {
+            auto err = ff_srtp_decrypt(&srtpContext_->srtp_in, buf, &len);
+            if (err < 0)
+                RING_WARN("decrypt error %d", err);
+        }
+
+        if (len != 0)
+            return len;
+        else
+            return AVERROR_EOF;
+    }
 }
 
 int
-SocketPair::writeData(uint8_t* buf, int buf_size)
+SocketPair::writeData(uint8_t* buf, int buf_size, SrtpAead* srtp)
 {
     bool isRTCP = RTP_PT_IS_RTCP(buf[1]);
 
@@ -453,12 +544,33 @@ SocketPair::writeData(uint8_t* buf, int buf_size)
             dest_addr = &rtpDestAddr_;
         }
 
+        if (noWrite_)
+            return buf_size;
+
+        if (not isRTCP) {
+            std::lock_guard<std::mutex> lk(sendBatchMutex_);
+            if (sendBatches_) {
+                if (rtpSendBatch_.full())
+                    flushSendBatch();
+                if (rtpSendBatch_.push(buf, buf_size)) {
+                    // encrypted in place in the batch
+                    if (srtp and not protectLast(rtpSendBatch_, *srtp))
+                        return -1;
+                    return buf_size;
+                }
+            }
+        }
+
+        if (srtp) {
+            if ((buf_size = protect(buf, buf_size, *srtp)) < 0)
+                return buf_size;
+            buf = srtpContext_->encryptbuf;
+        }
+
         auto ret = ff_network_wait_fd(fd);
         if (ret < 0)
             return ret;
 
-        if (noWrite_)
-            return buf_size;
         return ::sendto(fd, reinterpret_cast<const char*>(buf), buf_size, 0,
                         *dest_addr, dest_addr->getLength());
     }
@@ -466,6 +578,12 @@ SocketPair::writeData(uint8_t* buf, int buf_size)
     if (noWrite_)
         return buf_size;
 
+    if (srtp) {
+        if ((buf_size = protect(buf, buf_size, *srtp)) < 0)
+            return buf_size;
+        buf = srtpContext_->encryptbuf;
+    }
+
     // IceSocket
     if (isRTCP)
         return rtcp_sock_->send(buf, buf_size);
@@ -479,8 +597,16 @@ SocketPair::writeCallback(uint8_t* buf, int buf_size)
     int ret;
     bool isRTCP = RTP_PT_IS_RTCP(buf[1]);
 
-    // Encrypt?
-    if (not isRTCP and srtpContext_ and srtpContext_->srtp_out.aes) {
+    if (not isRTCP and buf_size >= 12)
+        localSsrc_ = AV_RB32(buf + 8);
+    else if (isRTCP and buf_size >= 8 and not localSsrc_)
+        localSsrc_ = AV_RB32(buf + 4); // receive only, SSRC of our reports
+
+    // Encrypt? AEAD suites encrypt in place once the packet is queued
+    SrtpAead* aead = nullptr;
+    if (not isRTCP and srtpContext_ and srtpContext_->aead_out) {
+        aead = srtpContext_->aead_out.get();
+    } else if (not isRTCP and srtpContext_ and srtpContext_->srtp_out.aes) {
         buf_size = ff_srtp_encrypt(&srtpContext_->srtp_out, buf,
                                    buf_size, srtpContext_->encryptbuf,
                                    sizeof(srtpContext_->encryptbuf));
@@ -492,6 +618,9 @@ SocketPair::writeCallback(uint8_t* buf, int buf_size)
         buf = srtpContext_->encryptbuf;
     }
 
+    if (isRTCP)
+        saveSenderReport(buf, buf_size);
+
     // check if we're sending an RR, if so, detect packet loss
     // buf_size gives length of buffer, not just header
     if (isRTCP && static_cast<unsigned>(buf_size) >= sizeof(rtcpRRHeader)) {
@@ -502,12 +631,102 @@ SocketPair::writeCallback(uint8_t* buf, int buf_size)
     do {
         if (interrupted_)
             return -EINTR;
-        ret = writeData(buf, buf_size);
+        ret = writeData(buf, buf_size, aead);
     } while (ret < 0 and errno == EAGAIN);
 
     return ret < 0 ? -errno : ret;
 }
 
+// Encrypt in the encryption buffer
+int
+SocketPair::protect(const uint8_t* buf, int buf_size, SrtpAead& srtp)
+{
+    if (buf_size + SrtpAead::TAG_SIZE > sizeof(srtpContext_->encryptbuf)) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    std::copy_n(buf, buf_size, srtpContext_->encryptbuf);
+    const auto len = srtp.protect(srtpContext_->encryptbuf, buf_size);
+    if (len < 0) {
+        RING_WARN("SRTP encrypt error");
+        errno = EINVAL;
+    }
+    return len;
+}
+
+// Encrypt the last packet of the batch, dropped on error
+bool
+SocketPair::protectLast(DatagramBatch& batch, SrtpAead& srtp)
+{
+    const auto i = batch.size() - 1;
+    int len = -1;
+    if (batch.length(i) + SrtpAead::TAG_SIZE <= batch.maxSize())
+        len = srtp.protect(batch.data(i), batch.length(i));
+    if (len < 0) {
+        RING_WARN("SRTP encrypt error");
+        batch.dropLast();
+        errno = EINVAL;
+        return false;
+    }
+    batch.setLength(i, len);
+    return true;
+}
+
+// Called with sendBatchMutex_ locked
+void
+SocketPair::flushSendBatch()
+{
+    while (not rtpSendBatch_.empty() and not interrupted_) {
+        if (rtpSendBatch_.send(rtpHandle_, rtpDestAddr_, rtpDestAddr_.getLength()) >= 0)
+            continue;
+        if (errno != EAGAIN and errno != EWOULDBLOCK) {
+            RING_WARN("SocketPair: could not send %u RTP packets: %s",
+                      rtpSendBatch_.size(), strerror(errno));
+            break;
+        }
+        if (ff_network_wait_fd(rtpHandle_) < 0)
+            break;
+    }
+    rtpSendBatch_.clear();
+}
+
+SocketPair::SendBatch::SendBatch(SocketPair& socketPair)
+    : socketPair_(socketPair)
+{
+    std::lock_guard<std::mutex> lk(socketPair_.sendBatchMutex_);
+    ++socketPair_.sendBatches_;
+}
+
+SocketPair::SendBatch::~SendBatch()
+{
+    std::lock_guard<std::mutex> lk(socketPair_.sendBatchMutex_);
+    if (not --socketPair_.sendBatches_)
+        socketPair_.flushSendBatch();
+}
+
+void
+SocketPair::sendPictureLossIndication()
+{
+    const uint32_t mediaSsrc = remoteSsrc_;
+    if (not mediaSsrc)
+        return; // nothing received yet
+
+    uint8_t buf[12];
+    buf[0] = 0x80 | RTCP_PSFB_PLI; // version 2
+    buf[1] = RTCP_PSFB;
+    AV_WB16(buf + 2, 2);           // length in words, minus one
+    AV_WB32(buf + 4, localSsrc_);
+    AV_WB32(buf + 8, mediaSsrc);
+    if (not interrupted_ and writeData(buf, sizeof(buf)) < 0)
+        RING_WARN("Could not send picture loss indication");
+}
+
+unsigned
+SocketPair::getPictureLossIndications()
+{
+    return pictureLossIndications_.exchange(0);
+}
+
 bool
 SocketPair::rtcpPacketLossDetected() const
 {
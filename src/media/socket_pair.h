@@ -27,6 +27,9 @@
 
 #include "ip_utils.h"
 #include "media_io_handle.h"
+#include "datagram_batch.h"
+#include "packet_buffer.h"
+#include "spsc_queue.h"
 
 #ifndef _WIN32
 #include <sys/socket.h>
@@ -38,6 +41,8 @@
 using socklen_t = int;
 #endif
 
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <mutex>
 #include <memory>
@@ -51,6 +56,7 @@ namespace ring {
 
 class IceSocket;
 class SRTPProtoContext;
+class SrtpAead;
 
 typedef struct {
 #ifdef WORDS_BIGENDIAN
@@ -70,10 +76,32 @@ typedef struct {
     uint32_t fraction_lost; /* 8 bits of fraction, 24 bits of total packets lost */
     uint32_t last_seq;  /*last sequence number */
     uint32_t jitter;    /*jitter */
+    uint32_t lsr;       /* middle 32 bits of the NTP timestamp of the last SR */
+    uint32_t dlsr;      /* delay since the last SR, in 1/65536 seconds */
 } rtcpRRHeader;
 
+struct RtcpReceiverReport {
+    rtcpRRHeader header;
+    std::chrono::microseconds rtt {-1}; // from LSR/DLSR, negative if unknown
+};
+
 class SocketPair {
     public:
+        /**
+         * RTP packets written while it exists are sent together on its
+         * destruction, for instance the packets of one video frame.
+         * Only the system sockets send in batches.
+         */
+        class SendBatch {
+            public:
+                explicit SendBatch(SocketPair& socketPair);
+                ~SendBatch();
+
+            private:
+                NON_COPYABLE(SendBatch);
+                SocketPair& socketPair_;
+        };
+
         SocketPair(const char* uri, int localPort);
         SocketPair(std::unique_ptr<IceSocket> rtp_sock,
                    std::unique_ptr<IceSocket> rtcp_sock);
@@ -93,6 +121,8 @@ class SocketPair {
            SRTP_AES128_CM_HMAC_SHA1_80
            AES_CM_128_HMAC_SHA1_32
            SRTP_AES128_CM_HMAC_SHA1_3
+           AEAD_AES_128_GCM
+           AEAD_AES_256_GCM
 
            Example (unsecure) usage:
            createSRTP("AES_CM_128_HMAC_SHA1_80",
@@ -106,9 +136,15 @@ class SocketPair {
                         const char* in_suite, const char* in_params);
 
         void stopSendOp(bool state = true);
-        std::vector<rtcpRRHeader> getRtcpInfo();
+        std::vector<RtcpReceiverReport> getRtcpInfo();
         bool rtcpPacketLossDetected() const;
 
+        // Ask the sender of the stream we receive for a keyframe (RFC 4585 PLI)
+        void sendPictureLossIndication();
+
+        // Picture loss indications and full intra requests received since last call
+        unsigned getPictureLossIndications();
+
     private:
         NON_COPYABLE(SocketPair);
 
@@ -118,30 +154,55 @@ class SocketPair {
         int waitForData();
         int readRtpData(void* buf, int buf_size);
         int readRtcpData(void* buf, int buf_size);
-        int writeData(uint8_t* buf, int buf_size);
+        int writeData(uint8_t* buf, int buf_size, SrtpAead* srtp = nullptr);
+        int protect(const uint8_t* buf, int buf_size, SrtpAead& srtp);
+        bool protectLast(DatagramBatch& batch, SrtpAead& srtp);
         void saveRtcpPacket(uint8_t* buf, size_t len);
+        void saveSenderReport(const uint8_t* buf, size_t len);
+        void saveRtcpFeedback(const uint8_t* buf, size_t len);
+        void flushSendBatch();
 
         std::mutex dataBuffMutex_;
         std::condition_variable cv_;
-        std::list<std::vector<uint8_t>> rtpDataBuff_;
-        std::list<std::vector<uint8_t>> rtcpDataBuff_;
+        // filled by the ICE callbacks
+        SpscQueue<PacketBuffer, 1024> rtpDataBuff_;
+        SpscQueue<PacketBuffer, 256> rtcpDataBuff_;
 
         std::unique_ptr<IceSocket> rtp_sock_;
         std::unique_ptr<IceSocket> rtcp_sock_;
 
         int rtpHandle_ {-1};
         int rtcpHandle_ {-1};
+
+        // RTP datagrams of the system sockets
+        DatagramBatch rtpRecvBatch_;
+        std::mutex sendBatchMutex_;
+        DatagramBatch rtpSendBatch_;
+        unsigned sendBatches_ {0};
+
         IpAddr rtpDestAddr_;
         IpAddr rtcpDestAddr_;
         std::atomic_bool interrupted_ {false};
         std::atomic_bool noWrite_ {false};
         std::unique_ptr<SRTPProtoContext> srtpContext_;
 
-        std::list<rtcpRRHeader> listRtcpHeader_;
+        std::list<RtcpReceiverReport> listRtcpHeader_;
         std::mutex rtcpInfo_mutex_;
         static constexpr unsigned MAX_LIST_SIZE {20};
 
+        // NTP middle 32 bits and send time of the last SRs, for round trip times
+        struct SenderReport {
+            uint32_t ntp {0};
+            std::chrono::steady_clock::time_point time {};
+        };
+        std::array<SenderReport, 8> senderReports_ {};
+        unsigned lastSenderReport_ {0};
+
         mutable std::atomic_bool rtcpPacketLoss_ {false};
+
+        std::atomic<uint32_t> localSsrc_ {0};   // of the stream we send
+        std::atomic<uint32_t> remoteSsrc_ {0};  // of the stream we receive
+        std::atomic<unsigned> pictureLossIndications_ {0};
 };
 
 
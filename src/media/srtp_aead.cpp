@@ -0,0 +1,279 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "srtp_aead.h"
+#include "base64.h"
+#include "security/memory.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace ring {
+
+constexpr std::size_t SrtpAead::TAG_SIZE;
+
+static constexpr std::size_t RTP_HEADER_SIZE {12};
+static constexpr std::size_t MASTER_SALT_SIZE {12};
+static constexpr uint64_t REPLAY_WINDOW_SIZE {64};
+
+// SRTP key derivation labels (RFC 3711 section 4.3.1)
+static constexpr uint8_t LABEL_RTP_ENCRYPTION {0x00};
+static constexpr uint8_t LABEL_RTP_SALT {0x02};
+
+struct SuiteDefinition {
+    const char* name;
+    std::size_t keySize;
+    gnutls_cipher_algorithm_t kdf;
+    gnutls_cipher_algorithm_t aead;
+};
+
+static const SuiteDefinition SUITES[] = {
+    {"AEAD_AES_128_GCM", 16, GNUTLS_CIPHER_AES_128_CBC, GNUTLS_CIPHER_AES_128_GCM},
+    {"AEAD_AES_256_GCM", 32, GNUTLS_CIPHER_AES_256_CBC, GNUTLS_CIPHER_AES_256_GCM},
+};
+
+static const SuiteDefinition*
+findSuite(const std::string& name)
+{
+    for (const auto& suite : SUITES)
+        if (name == suite.name)
+            return &suite;
+    return nullptr;
+}
+
+/**
+ * AES counter mode key derivation of RFC 3711 section 4.3, with a key
+ * derivation rate of zero. The 96 bits master salt of RFC 7714 is padded
+ * to 112 bits.
+ * A block encrypted alone in CBC mode with a zero IV is the AES block
+ * cipher, that GnuTLS doesn't expose otherwise.
+ */
+static bool
+deriveKey(gnutls_cipher_algorithm_t algo, const std::vector<uint8_t>& masterKey,
+          const uint8_t* masterSalt, uint8_t label, uint8_t* out, std::size_t outlen)
+{
+    gnutls_cipher_hd_t aes;
+    uint8_t iv[16] = {};
+    gnutls_datum_t key {const_cast<uint8_t*>(masterKey.data()), static_cast<unsigned>(masterKey.size())};
+    gnutls_datum_t ivDatum {iv, sizeof(iv)};
+    if (gnutls_cipher_init(&aes, algo, &key, &ivDatum) < 0)
+        return false;
+
+    uint8_t input[16] = {};
+    std::memcpy(input, masterSalt, MASTER_SALT_SIZE);
+    input[14 - 7] ^= label;
+
+    bool ok = true;
+    for (std::size_t pos = 0, i = 0; ok and pos < outlen; pos += 16, ++i) {
+        uint8_t keystream[16];
+        input[14] = i >> 8;
+        input[15] = i;
+        gnutls_cipher_set_iv(aes, iv, sizeof(iv));
+        ok = gnutls_cipher_encrypt2(aes, input, sizeof(input), keystream, sizeof(keystream)) >= 0;
+        std::memcpy(out + pos, keystream, std::min<std::size_t>(16, outlen - pos));
+        ring_secure_memzero(keystream, sizeof(keystream));
+    }
+    gnutls_cipher_deinit(aes);
+    return ok;
+}
+
+// Size of the RTP header with its CSRCs and extension, 0 if invalid
+static std::size_t
+headerSize(const uint8_t* buf, std::size_t len)
+{
+    if (len < RTP_HEADER_SIZE or (buf[0] >> 6) != 2)
+        return 0;
+    std::size_t size = RTP_HEADER_SIZE + 4 * (buf[0] & 0x0f);
+    if (buf[0] & 0x10) {
+        if (len < size + 4)
+            return 0;
+        size += 4 * (1 + ((buf[size + 2] << 8) | buf[size + 3]));
+    }
+    return size <= len ? size : 0;
+}
+
+bool
+SrtpAead::isSupported(const std::string& suite)
+{
+    return findSuite(suite) != nullptr;
+}
+
+SrtpAead::SrtpAead(const std::string& suiteName, const std::string& params)
+{
+    const auto suite = findSuite(suiteName);
+    if (not suite)
+        throw std::runtime_error("SRTP crypto suite " + suiteName + " not supported");
+
+    auto master = base64::decode(params);
+    if (master.size() != suite->keySize + MASTER_SALT_SIZE) {
+        ring_secure_memzero(master.data(), master.size());
+        throw std::runtime_error("Incorrect amount of SRTP params");
+    }
+    std::vector<uint8_t> masterKey(master.begin(), master.begin() + suite->keySize);
+    const auto masterSalt = master.data() + suite->keySize;
+
+    std::vector<uint8_t> sessionKey(suite->keySize);
+    bool ok = deriveKey(suite->kdf, masterKey, masterSalt, LABEL_RTP_ENCRYPTION,
+                        sessionKey.data(), sessionKey.size())
+          and deriveKey(suite->kdf, masterKey, masterSalt, LABEL_RTP_SALT,
+                        salt_.data(), salt_.size());
+    ring_secure_memzero(master.data(), master.size());
+    ring_secure_memzero(masterKey.data(), masterKey.size());
+
+    ok = ok and initCipher(suite->aead, sessionKey);
+    ring_secure_memzero(sessionKey.data(), sessionKey.size());
+    if (not ok)
+        throw std::runtime_error("Could not set SRTP crypto");
+}
+
+SrtpAead::SrtpAead(const std::string& suiteName, const std::vector<uint8_t>& sessionKey,
+                   const std::array<uint8_t, 12>& sessionSalt)
+    : salt_(sessionSalt)
+{
+    const auto suite = findSuite(suiteName);
+    if (not suite)
+        throw std::runtime_error("SRTP crypto suite " + suiteName + " not supported");
+    if (sessionKey.size() != suite->keySize)
+        throw std::runtime_error("Incorrect SRTP session key size");
+    if (not initCipher(suite->aead, sessionKey))
+        throw std::runtime_error("Could not set SRTP crypto");
+}
+
+bool
+SrtpAead::initCipher(gnutls_cipher_algorithm_t aead, const std::vector<uint8_t>& sessionKey)
+{
+    gnutls_datum_t key {const_cast<uint8_t*>(sessionKey.data()), static_cast<unsigned>(sessionKey.size())};
+    return gnutls_aead_cipher_init(&cipher_, aead, &key) >= 0;
+}
+
+SrtpAead::~SrtpAead()
+{
+    gnutls_aead_cipher_deinit(cipher_);
+    ring_secure_memzero(salt_.data(), salt_.size());
+}
+
+void
+SrtpAead::makeIv(uint8_t* iv, uint32_t ssrc, uint32_t roc, uint16_t seq) const
+{
+    // 00 00 || SSRC || ROC || SEQ, xor salt
+    iv[0] = iv[1] = 0;
+    iv[2] = ssrc >> 24; iv[3] = ssrc >> 16; iv[4] = ssrc >> 8; iv[5] = ssrc;
+    iv[6] = roc >> 24;  iv[7] = roc >> 16;  iv[8] = roc >> 8;  iv[9] = roc;
+    iv[10] = seq >> 8;  iv[11] = seq;
+    for (std::size_t i = 0; i < salt_.size(); ++i)
+        iv[i] ^= salt_[i];
+}
+
+uint32_t
+SrtpAead::estimateRoc(uint16_t seq) const
+{
+    if (not seqInitialized_)
+        return roc_;
+    if (seqLargest_ < 32768)
+        return seq - seqLargest_ > 32768 ? roc_ - 1 : roc_;
+    return seqLargest_ - 32768 > seq ? roc_ + 1 : roc_;
+}
+
+void
+SrtpAead::updateRoc(uint16_t seq, uint32_t roc)
+{
+    if (not seqInitialized_ or roc == roc_ + 1) {
+        seqInitialized_ = true;
+        seqLargest_ = seq;
+        roc_ = roc;
+    } else if (roc == roc_ and seq > seqLargest_) {
+        seqLargest_ = seq;
+    }
+}
+
+bool
+SrtpAead::isReplayed(uint64_t index) const
+{
+    if (not seqInitialized_)
+        return false;
+    const uint64_t largest = (uint64_t(roc_) << 16) | seqLargest_;
+    if (index > largest)
+        return false;
+    const auto delta = largest - index;
+    return delta >= REPLAY_WINDOW_SIZE or ((replayWindow_ >> delta) & 1);
+}
+
+void
+SrtpAead::updateReplayWindow(uint64_t index)
+{
+    const uint64_t largest = (uint64_t(roc_) << 16) | seqLargest_;
+    if (not seqInitialized_) {
+        replayWindow_ = 1;
+    } else if (index > largest) {
+        const auto shift = index - largest;
+        replayWindow_ = (shift < REPLAY_WINDOW_SIZE ? replayWindow_ << shift : 0) | 1;
+    } else {
+        replayWindow_ |= uint64_t(1) << (largest - index);
+    }
+}
+
+int
+SrtpAead::protect(uint8_t* buf, std::size_t len)
+{
+    const auto header = headerSize(buf, len);
+    if (not header)
+        return -1;
+
+    const uint16_t seq = (buf[2] << 8) | buf[3];
+    const uint32_t ssrc = (uint32_t(buf[8]) << 24) | (buf[9] << 16) | (buf[10] << 8) | buf[11];
+    const auto roc = estimateRoc(seq);
+    updateRoc(seq, roc);
+
+    uint8_t iv[12];
+    makeIv(iv, ssrc, roc, seq);
+    std::size_t outlen = len - header + TAG_SIZE;
+    if (gnutls_aead_cipher_encrypt(cipher_, iv, sizeof(iv), buf, header, TAG_SIZE,
+                                   buf + header, len - header, buf + header, &outlen) < 0)
+        return -1;
+    return header + outlen;
+}
+
+int
+SrtpAead::unprotect(uint8_t* buf, std::size_t len)
+{
+    const auto header = headerSize(buf, len);
+    if (not header or len < header + TAG_SIZE)
+        return -1;
+
+    const uint16_t seq = (buf[2] << 8) | buf[3];
+    const uint32_t ssrc = (uint32_t(buf[8]) << 24) | (buf[9] << 16) | (buf[10] << 8) | buf[11];
+    const auto roc = estimateRoc(seq);
+    const uint64_t index = (uint64_t(roc) << 16) | seq;
+    if (isReplayed(index))
+        return -1;
+
+    uint8_t iv[12];
+    makeIv(iv, ssrc, roc, seq);
+    std::size_t outlen = len - header - TAG_SIZE;
+    if (gnutls_aead_cipher_decrypt(cipher_, iv, sizeof(iv), buf, header, TAG_SIZE,
+                                   buf + header, len - header, buf + header, &outlen) < 0)
+        return -1;
+
+    // only authenticated packets move the index and the replay list
+    updateReplayWindow(index);
+    updateRoc(seq, roc);
+    return header + outlen;
+}
+
+} // namespace ring
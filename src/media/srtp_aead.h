@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <gnutls/crypto.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ring {
+
+/**
+ * SRTP protection of one RTP stream with the AEAD AES-GCM suites of
+ * RFC 7714 (AEAD_AES_128_GCM and AEAD_AES_256_GCM).
+ *
+ * Encryption and authentication are one GnuTLS AEAD operation, which uses
+ * AES-NI and PCLMULQDQ (or the ARMv8 crypto extensions) when the CPU has
+ * them. Packets are processed in place: the 16 bytes tag follows the
+ * payload.
+ */
+class SrtpAead {
+public:
+    static constexpr std::size_t TAG_SIZE {16};
+
+    static bool isSupported(const std::string& suite);
+
+    /**
+     * params is the base64 master key and salt of the SDES inline key.
+     * Throws std::runtime_error if the suite or the key is invalid.
+     */
+    SrtpAead(const std::string& suite, const std::string& params);
+
+    /**
+     * With the session key and salt already derived, as in the test vectors
+     * of RFC 7714 section 16.
+     */
+    SrtpAead(const std::string& suite, const std::vector<uint8_t>& sessionKey,
+             const std::array<uint8_t, 12>& sessionSalt);
+    ~SrtpAead();
+
+    /**
+     * Encrypt a RTP packet in place, buf must have room for TAG_SIZE more
+     * bytes. Return the SRTP packet length, or -1 if it isn't valid RTP.
+     */
+    int protect(uint8_t* buf, std::size_t len);
+
+    /**
+     * Authenticate and decrypt a SRTP packet in place.
+     * Return the RTP packet length, or -1 if it is rejected, replays
+     * included.
+     */
+    int unprotect(uint8_t* buf, std::size_t len);
+
+private:
+    NON_COPYABLE(SrtpAead);
+
+    // RFC 7714 section 8.1
+    void makeIv(uint8_t* iv, uint32_t ssrc, uint32_t roc, uint16_t seq) const;
+    bool initCipher(gnutls_cipher_algorithm_t aead, const std::vector<uint8_t>& sessionKey);
+
+    gnutls_aead_cipher_hd_t cipher_ {nullptr};
+    std::array<uint8_t, 12> salt_ {};
+
+    // RFC 3711 section 3.3.1, packet index estimation
+    uint32_t estimateRoc(uint16_t seq) const;
+    void updateRoc(uint16_t seq, uint32_t roc);
+
+    uint32_t roc_ {0};
+    uint16_t seqLargest_ {0};
+    bool seqInitialized_ {false};
+
+    // RFC 3711 section 3.3.2, replay list of the last 64 packet indexes
+    bool isReplayed(uint64_t index) const;
+    void updateReplayWindow(uint64_t index);
+
+    uint64_t replayWindow_ {0}; // bit i set: index of the largest minus i was received
+};
+
+} // namespace ring
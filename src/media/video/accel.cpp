@@ -23,6 +23,8 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <map>
+#include <mutex>
 
 #include "media_buffer.h"
 #include "string_utils.h"
@@ -81,36 +83,51 @@ transferFrameData(HardwareAccel accel, AVCodecContext* /*codecCtx*/, VideoFrame&
     return ret;
 }
 
-static int
-initDevice(HardwareAccel accel, AVCodecContext* codecCtx)
+static AVBufferRef*
+createDevice(const std::string& name)
 {
-    int ret = 0;
     AVBufferRef* hardwareDeviceCtx = nullptr;
-    auto hwType = av_hwdevice_find_type_by_name(accel.name.c_str());
+    auto hwType = av_hwdevice_find_type_by_name(name.c_str());
 #ifdef HAVE_VAAPI_ACCEL_DRM
     // default DRM device may not work on multi GPU computers, so check all possible values
-    if (accel.name == "vaapi") {
+    if (name == "vaapi") {
         const std::string path = "/dev/dri/";
         auto files = ring::fileutils::readDirectory(path);
         // renderD* is preferred over card*
         std::sort(files.rbegin(), files.rend());
         for (auto& entry : files) {
             std::string deviceName = path + entry;
-            if ((ret = av_hwdevice_ctx_create(&hardwareDeviceCtx, hwType, deviceName.c_str(), nullptr, 0)) >= 0) {
-                codecCtx->hw_device_ctx = hardwareDeviceCtx;
-                RING_DBG("Using '%s' hardware acceleration with device '%s'", accel.name.c_str(), deviceName.c_str());
-                return ret;
+            if (av_hwdevice_ctx_create(&hardwareDeviceCtx, hwType, deviceName.c_str(), nullptr, 0) >= 0) {
+                RING_DBG("Using '%s' hardware acceleration with device '%s'", name.c_str(), deviceName.c_str());
+                return hardwareDeviceCtx;
             }
         }
     }
 #endif
     // default device (nullptr) works for most cases
-    if ((ret = av_hwdevice_ctx_create(&hardwareDeviceCtx, hwType, nullptr, nullptr, 0)) >= 0) {
-        codecCtx->hw_device_ctx = hardwareDeviceCtx;
-        RING_DBG("Using '%s' hardware acceleration", accel.name.c_str());
+    if (av_hwdevice_ctx_create(&hardwareDeviceCtx, hwType, nullptr, nullptr, 0) >= 0) {
+        RING_DBG("Using '%s' hardware acceleration", name.c_str());
+        return hardwareDeviceCtx;
     }
+    return nullptr;
+}
 
-    return ret;
+// Decoders and encoders share one device per hwaccel, so a decoded frame
+// can be encoded without leaving the GPU.
+static int
+initDevice(const std::string& name, AVCodecContext* codecCtx)
+{
+    static std::mutex mutex;
+    static std::map<std::string, AVBufferRef*> devices;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    auto& device = devices[name];
+    if (not device)
+        device = createDevice(name);
+    if (not device)
+        return AVERROR(ENODEV);
+    codecCtx->hw_device_ctx = av_buffer_ref(device);
+    return codecCtx->hw_device_ctx ? 0 : AVERROR(ENOMEM);
 }
 
 const HardwareAccel
@@ -133,7 +150,7 @@ setupHardwareDecoding(AVCodecContext* codecCtx)
     for (auto accel : accels) {
         if (std::find(accel.supportedCodecs.begin(), accel.supportedCodecs.end(),
                 static_cast<AVCodecID>(codecCtx->codec_id)) != accel.supportedCodecs.end()) {
-            if (initDevice(accel, codecCtx) >= 0) {
+            if (initDevice(accel.name, codecCtx) >= 0) {
                 codecCtx->get_format = getFormatCb;
                 codecCtx->thread_safe_callbacks = 1;
                 return accel;
@@ -145,4 +162,116 @@ setupHardwareDecoding(AVCodecContext* codecCtx)
     return {};
 }
 
+int
+setupHardwareEncoding(const HardwareEncoder& accel, AVCodecContext* codecCtx)
+{
+    int ret = initDevice(accel.name, codecCtx);
+    if (ret < 0)
+        return ret;
+
+    auto framesRef = av_hwframe_ctx_alloc(codecCtx->hw_device_ctx);
+    if (not framesRef)
+        return AVERROR(ENOMEM);
+    auto frames = reinterpret_cast<AVHWFramesContext*>(framesRef->data);
+    frames->format = accel.format;
+    frames->sw_format = accel.swFormat;
+    frames->width = codecCtx->width;
+    frames->height = codecCtx->height;
+    // VAAPI surfaces can't be added later, leave room for the encoder references
+    frames->initial_pool_size = 20;
+    if ((ret = av_hwframe_ctx_init(framesRef)) < 0) {
+        av_buffer_unref(&framesRef);
+        return ret;
+    }
+
+    codecCtx->hw_frames_ctx = framesRef;
+    codecCtx->pix_fmt = accel.format;
+    return 0;
+}
+
+static std::vector<HardwareEncoder>
+probeHardwareEncoders()
+{
+    /**
+     * Same as for decoding, with the FFmpeg encoder for each codec.
+     * VAAPI surfaces are uploaded as NV12, the format every driver takes.
+     */
+    const HardwareEncoder candidates[] = {
+        { "vaapi", "h264_vaapi", AV_CODEC_ID_H264, AV_PIX_FMT_VAAPI, AV_PIX_FMT_NV12 },
+        { "vaapi", "vp8_vaapi", AV_CODEC_ID_VP8, AV_PIX_FMT_VAAPI, AV_PIX_FMT_NV12 },
+    };
+
+    std::vector<HardwareEncoder> encoders;
+    for (const auto& accel : candidates) {
+        auto codec = avcodec_find_encoder_by_name(accel.encoder.c_str());
+        if (not codec)
+            continue;
+
+        // the driver may not implement this codec, or not as an encoder
+        auto codecCtx = avcodec_alloc_context3(codec);
+        codecCtx->width = 640;
+        codecCtx->height = 480;
+        codecCtx->time_base = AVRational{1, 30};
+        codecCtx->max_b_frames = 0;
+        if (setupHardwareEncoding(accel, codecCtx) >= 0
+            and avcodec_open2(codecCtx, codec, nullptr) == 0) {
+            RING_DBG("'%s' hardware encoder available", accel.encoder.c_str());
+            encoders.push_back(accel);
+        }
+        avcodec_free_context(&codecCtx);
+    }
+
+    if (encoders.empty())
+        RING_WARN("No hardware accelerated encoder available");
+    return encoders;
+}
+
+const std::vector<HardwareEncoder>&
+getHardwareEncoders()
+{
+    static const auto encoders = probeHardwareEncoders();
+    return encoders;
+}
+
+bool
+isHardwareFrame(const HardwareEncoder& accel, AVCodecContext* codecCtx, const VideoFrame& input)
+{
+    const auto frame = input.pointer();
+    if (frame->format != accel.format or not frame->hw_frames_ctx or not codecCtx->hw_frames_ctx)
+        return false;
+
+    const auto in = reinterpret_cast<AVHWFramesContext*>(frame->hw_frames_ctx->data);
+    const auto out = reinterpret_cast<AVHWFramesContext*>(codecCtx->hw_frames_ctx->data);
+    return in->device_ref->data == out->device_ref->data
+        and frame->width == codecCtx->width and frame->height == codecCtx->height;
+}
+
+int
+uploadFrameData(const HardwareEncoder& accel, AVCodecContext* codecCtx,
+                const VideoFrame& input, VideoFrame& output)
+{
+    auto in = input.pointer();
+    auto out = output.pointer();
+    av_frame_unref(out);
+
+    if (isHardwareFrame(accel, codecCtx, input))
+        return av_frame_ref(out, in);
+
+    if (in->format != accel.swFormat) {
+        RING_ERR("Frame format mismatch: expected %s, got %s",
+                 av_get_pix_fmt_name(accel.swFormat),
+                 av_get_pix_fmt_name(static_cast<AVPixelFormat>(in->format)));
+        return -1;
+    }
+
+    int ret = av_hwframe_get_buffer(codecCtx->hw_frames_ctx, out, 0);
+    if (ret < 0)
+        return ret;
+    if ((ret = av_hwframe_transfer_data(out, in, 0)) < 0) {
+        av_frame_unref(out);
+        return ret;
+    }
+    return av_frame_copy_props(out, in);
+}
+
 }} // namespace ring::video
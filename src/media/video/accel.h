@@ -36,4 +36,39 @@ struct HardwareAccel {
 const HardwareAccel setupHardwareDecoding(AVCodecContext* codecCtx);
 int transferFrameData(HardwareAccel accel, AVCodecContext* codecCtx, VideoFrame& frame);
 
+struct HardwareEncoder {
+        std::string name;       // hwaccel, as for decoding
+        std::string encoder;    // FFmpeg encoder
+        AVCodecID codecId;
+        AVPixelFormat format;   // hardware frames
+        AVPixelFormat swFormat; // frames uploaded from the main memory
+};
+
+/**
+ * Hardware encoders that work on this machine. They are probed by opening
+ * each of them once, the first call blocks until it's done.
+ */
+const std::vector<HardwareEncoder>& getHardwareEncoders();
+
+/**
+ * Give codecCtx, prepared for software encoding, the hardware device and
+ * frames of accel. codecCtx->pix_fmt becomes accel.format.
+ */
+int setupHardwareEncoding(const HardwareEncoder& accel, AVCodecContext* codecCtx);
+
+/**
+ * Make output a hardware frame codecCtx can encode.
+ * A hardware frame of the right size from the same device, as decoded with
+ * hardware acceleration, is only referenced. Other frames must be in
+ * accel.swFormat and are uploaded.
+ */
+int uploadFrameData(const HardwareEncoder& accel, AVCodecContext* codecCtx,
+                    const VideoFrame& input, VideoFrame& output);
+
+/**
+ * True if input can be given to uploadFrameData without being scaled first.
+ */
+bool isHardwareFrame(const HardwareEncoder& accel, AVCodecContext* codecCtx,
+                     const VideoFrame& input);
+
 }} // namespace ring::video
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "keyframe_scheduler.h"
+
+#include <sstream>
+
+namespace ring { namespace video {
+
+constexpr std::chrono::milliseconds KeyframeScheduler::DEFAULT_MIN_INTERVAL;
+
+KeyframeScheduler::KeyframeScheduler(unsigned startKeyframes, std::chrono::milliseconds minInterval)
+    : minInterval_(minInterval)
+    , forced_(startKeyframes)
+{}
+
+void
+KeyframeScheduler::request(KeyframeRequest origin)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    ++stats_.requests;
+    switch (origin) {
+    case KeyframeRequest::LOCAL:
+        ++forced_;
+        return;
+    case KeyframeRequest::SIP_INFO:
+        ++stats_.sipRequests;
+        break;
+    case KeyframeRequest::RTCP:
+        ++stats_.rtcpRequests;
+        break;
+    }
+
+    if (intraRefresh_)
+        ++stats_.refreshed;
+    else if (pending_)
+        ++stats_.coalesced;
+    else
+        pending_ = true;
+}
+
+void
+KeyframeScheduler::setIntraRefresh(bool intraRefresh)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    intraRefresh_ = intraRefresh;
+    if (intraRefresh_ and pending_) {
+        pending_ = false;
+        ++stats_.refreshed;
+    }
+}
+
+bool
+KeyframeScheduler::next(bool due, clock::time_point now)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (forced_)
+        --forced_;
+    else if (not due and not (pending_ and now - lastKeyframe_ >= minInterval_))
+        return false;
+
+    // any keyframe answers the pending requests
+    pending_ = false;
+    lastKeyframe_ = now;
+    ++stats_.keyframes;
+    return true;
+}
+
+KeyframeStats
+KeyframeScheduler::getStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
+
+std::string
+KeyframeScheduler::toString() const
+{
+    const auto stats = getStats();
+    std::ostringstream ss;
+    ss << stats.keyframes << " keyframes for " << stats.requests << " requests ("
+       << stats.sipRequests << " SIP, " << stats.rtcpRequests << " RTCP, "
+       << stats.coalesced << " coalesced";
+    if (stats.refreshed)
+        ss << ", " << stats.refreshed << " intra refreshed";
+    ss << ')';
+    return ss.str();
+}
+
+}} // namespace ring::video
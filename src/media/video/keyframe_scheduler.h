@@ -0,0 +1,84 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace ring { namespace video {
+
+enum class KeyframeRequest {
+    LOCAL,      // stream start, new peer on a shared encoder
+    SIP_INFO,   // picture_fast_update
+    RTCP,       // picture loss indication or full intra request
+};
+
+struct KeyframeStats {
+    unsigned requests {0};
+    unsigned sipRequests {0};
+    unsigned rtcpRequests {0};
+    unsigned coalesced {0};     // answered by a keyframe asked by another request
+    unsigned refreshed {0};     // left to the intra refresh
+    unsigned keyframes {0};
+};
+
+/**
+ * Decides which frames of an encoder are keyframes.
+ *
+ * Requests of the peers are coalesced: all the requests received until the
+ * next keyframe are answered by it, and keyframes are never produced closer
+ * than minInterval so a lossy conference can't make the encoder send only
+ * keyframes. Local requests (stream start, new peer) are not limited.
+ *
+ * With intra refresh the encoder refreshes the picture continuously, requests
+ * of the peers are only counted.
+ */
+class KeyframeScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds DEFAULT_MIN_INTERVAL {500};
+
+    KeyframeScheduler(unsigned startKeyframes = 0,
+                      std::chrono::milliseconds minInterval = DEFAULT_MIN_INTERVAL);
+
+    void request(KeyframeRequest origin);
+    void setIntraRefresh(bool intraRefresh);
+
+    /**
+     * Whether the next frame must be a keyframe.
+     * due is true when the encoder makes one anyway (periodic keyframe).
+     */
+    bool next(bool due = false, clock::time_point now = clock::now());
+
+    KeyframeStats getStats() const;
+    std::string toString() const;
+
+private:
+    mutable std::mutex mutex_;
+    const std::chrono::milliseconds minInterval_;
+    unsigned forced_;           // local requests, honored on the next frames
+    bool pending_ {false};      // a peer request is waiting
+    bool intraRefresh_ {false};
+    clock::time_point lastKeyframe_ {};
+    KeyframeStats stats_;
+};
+
+}} // namespace ring::video
@@ -29,8 +29,28 @@
  * First byte of each frame is guaranteed to be aligned on 16 bytes.
  * One region is marked as readable: this region can be safely read.
  * The other region is writeable: only the producer can use it.
+ *
+ * Extension: SHMHeaderExt is at the start of data, before the frames.
+ * readOffset and writeOffset skip it, so clients only knowing SHMHeader keep
+ * working. version is SHM_HEADER_EXT_VERSION when the extension is present.
+ *
+ * Pixel formats: frames are BGRA unless the client asks for another format
+ * in requestedFormat. YUV planes are packed without padding, Y first, then
+ * U and V (SHM_PIXFMT_YUV420P) or interleaved UV (SHM_PIXFMT_NV12), so they
+ * can be uploaded to textures as is.
+ *
+ * Clients may set readGen to frameGen after reading a frame. Once they do,
+ * the producer stops converting frames nobody reads, only publishing one
+ * from time to time for a new client to pick up. Clients leaving readGen
+ * to 0 get every frame.
  */
 
+enum SHMPixelFormat {
+    SHM_PIXFMT_BGRA = 0,
+    SHM_PIXFMT_YUV420P = 1,
+    SHM_PIXFMT_NV12 = 2,
+};
+
 struct SHMHeader {
     sem_t mutex;                // lock it before any operations on these fields
     sem_t frameGenMutex;        // unlocked by producer when frameGen is modified
@@ -42,4 +62,15 @@ struct SHMHeader {
     uint8_t data[];             // the whole shared memory
 };
 
+#define SHM_HEADER_EXT_VERSION 1
+
+struct SHMHeaderExt {
+    unsigned version;           // SHM_HEADER_EXT_VERSION
+    int format;                 // SHMPixelFormat of the readable frame
+    unsigned width;             // width of the readable frame
+    unsigned height;            // height of the readable frame
+    int requestedFormat;        // SHMPixelFormat wanted, set by the client
+    unsigned readGen;           // frameGen of the last frame read, set by the client, 0 for none
+};
+
 #endif
@@ -89,6 +89,7 @@ class ShmHolder
 
     private:
         bool resizeArea(std::size_t desired_length) noexcept;
+        bool shouldRender(bool reading) noexcept;
         char* getShmAreaDataPtr() noexcept;
 
         void unMapShmArea() noexcept {
@@ -98,12 +99,31 @@ class ShmHolder
             }
         }
 
+        SHMHeaderExt* ext() const noexcept {
+            return reinterpret_cast<SHMHeaderExt*>(area_->data);
+        }
+
         SHMHeader* area_ {static_cast<SHMHeader*>(MAP_FAILED)};
         std::size_t areaSize_ {0};
         std::string openedName_;
         int fd_ {-1};
+        VideoScaler scaler_;
+        unsigned idleFrames_ {0};
 };
 
+// Unread frames after which the SHM client is considered gone
+static constexpr unsigned SHM_IDLE_FRAMES {30};
+
+static int
+shmPixelFormat(int format) noexcept
+{
+    switch (format) {
+        case SHM_PIXFMT_YUV420P: return VIDEO_PIXFMT_YUV420P;
+        case SHM_PIXFMT_NV12: return VIDEO_PIXFMT_NV12;
+        default: return VIDEO_PIXFMT_BGRA;
+    }
+}
+
 ShmHolder::ShmHolder(const std::string& name)
 {
     static constexpr int flags = O_RDWR | O_CREAT | O_TRUNC | O_EXCL;
@@ -138,6 +158,7 @@ ShmHolder::ShmHolder(const std::string& name)
 
     // Header fields initialization
     std::memset(area_, 0, areaSize_);
+    ext()->version = SHM_HEADER_EXT_VERSION;
 
     if (::sem_init(&area_->mutex, 1, 1) < 0)
         shmFailedWithErrno("sem_init(mutex)");
@@ -177,7 +198,7 @@ ShmHolder::resizeArea(std::size_t frameSize) noexcept
         return true;
 
     // full area size: +15 to take care of maximum padding size
-    const auto areaSize = sizeof(SHMHeader) + 2 * frameSize + 15;
+    const auto areaSize = sizeof(SHMHeader) + sizeof(SHMHeaderExt) + 2 * frameSize + 15;
     RING_DBG("ShmHolder[%s]: new sizes: f=%zu, a=%zu", openedName_.c_str(),
              frameSize, areaSize);
 
@@ -212,19 +233,45 @@ ShmHolder::resizeArea(std::size_t frameSize) noexcept
         // Note: we not using std::align as not implemented in 4.9
         // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=57350
         auto p = reinterpret_cast<std::uintptr_t>(area_->data);
-        area_->writeOffset = ((p + 15) & ~15) - p;
+        area_->writeOffset = ((p + sizeof(SHMHeaderExt) + 15) & ~15) - p;
         area_->readOffset = area_->writeOffset + frameSize;
     }
 
     return true;
 }
 
+// When a client acknowledging frames did not read the last ones, only one
+// frame out of SHM_IDLE_FRAMES is converted, for a new client to get a picture
+bool
+ShmHolder::shouldRender(bool reading) noexcept
+{
+    if (reading) {
+        idleFrames_ = 0;
+        return true;
+    }
+    return idleFrames_++ % SHM_IDLE_FRAMES == 0;
+}
+
 void
 ShmHolder::renderFrame(VideoFrame& src) noexcept
 {
+    int shmFormat;
+    bool reading;
+    {
+        SemGuardLock lk {area_->mutex};
+        const auto ext = this->ext();
+        shmFormat = ext->requestedFormat;
+        // readGen stays 0 for clients that don't acknowledge frames
+        reading = not ext->readGen or area_->frameGen - ext->readGen <= SHM_IDLE_FRAMES;
+    }
+    if (not shouldRender(reading))
+        return;
+
     const auto width = src.width();
     const auto height = src.height();
-    const auto format = VIDEO_PIXFMT_BGRA;
+    const auto format = shmPixelFormat(shmFormat);
+    if (format == VIDEO_PIXFMT_BGRA)
+        shmFormat = SHM_PIXFMT_BGRA;
     const auto frameSize = videoFrameSize(format, width, height);
 
     if (!resizeArea(frameSize)) {
@@ -234,16 +281,19 @@ ShmHolder::renderFrame(VideoFrame& src) noexcept
     }
 
     {
+        // same size and format is a plain copy for the scaler
         VideoFrame dst;
-        VideoScaler scaler;
-
         dst.setFromMemory(area_->data + area_->writeOffset, format, width, height);
-        scaler.scale(src, dst);
+        scaler_.scale(src, dst);
     }
 
     {
         SemGuardLock lk {area_->mutex};
 
+        const auto ext = this->ext();
+        ext->format = shmFormat;
+        ext->width = width;
+        ext->height = height;
         ++area_->frameGen;
         std::swap(area_->readOffset, area_->writeOffset);
         ::sem_post(&area_->frameGenMutex);
@@ -340,7 +390,6 @@ SinkClient::update(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
 
     if (target_.pull) {
         VideoFrame dst;
-        VideoScaler scaler;
         const int width = f.width();
         const int height = f.height();
 #if defined(__ANDROID__) || (defined(__APPLE__) && !TARGET_OS_IPHONE)
@@ -27,7 +27,10 @@
 #include "sinkclient.h"
 #include "logger.h"
 
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <thread>
 #include <unistd.h>
 
 namespace ring { namespace video {
@@ -36,20 +39,57 @@ struct VideoMixer::VideoMixerSource {
     Observable<std::shared_ptr<VideoFrame>>* source = nullptr;
     std::unique_ptr<VideoFrame> update_frame;
     std::unique_ptr<VideoFrame> render_frame;
+    std::atomic<bool> updated {false}; // render_frame not drawn yet
+    VideoScaler scaler;
+    int width {0}, height {0}; // last drawn frame size
     void atomic_swap_render(std::unique_ptr<VideoFrame>& other) {
         std::lock_guard<std::mutex> lock(mutex_);
         render_frame.swap(other);
     }
+    // put back a frame taken for rendering, unless a newer one came meanwhile
+    void restore_render(std::unique_ptr<VideoFrame>& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (not render_frame)
+            render_frame = std::move(frame);
+    }
 private:
     std::mutex mutex_;
 };
 
-static constexpr const auto FRAME_DURATION = std::chrono::duration<double>(1/30.);
+static constexpr double DEFAULT_FRAME_RATE {30.};
+
+// Threads rendering cells with the mixer thread
+static constexpr unsigned MAX_RENDER_WORKERS {3};
+
+// Small pictures of ONE_BIG_WITH_SMALL, as a fraction of the output size
+static constexpr int SMALL_CELL_RATIO {5};
+
+// Fill a rectangle of a YUYV422 frame with black.
+// Only whole chroma pairs inside the rectangle are cleared, not to touch
+// a neighbouring cell.
+static void
+clear_rect(VideoFrame& frame, int x, int y, int width, int height)
+{
+    auto f = frame.pointer();
+    const int end = std::min(x + width, f->width) & ~1;
+    x = (x + 1) & ~1;
+    width = end - x;
+    height = std::min(height, f->height - y);
+    for (int row = y; row < y + height; ++row) {
+        auto p = f->data[0] + row * f->linesize[0] + x * 2;
+        for (int i = 0; i < width; ++i) {
+            p[2 * i] = 0x00;
+            p[2 * i + 1] = 0x80;
+        }
+    }
+}
 
 VideoMixer::VideoMixer(const std::string& id)
     : VideoGenerator::VideoGenerator()
     , id_(id)
+    , frameDuration_(1 / DEFAULT_FRAME_RATE)
     , sink_ (Manager::instance().createSinkClient(id, true))
+    , nextProcess_(std::chrono::steady_clock::now())
     , loop_([]{return true;},
             std::bind(&VideoMixer::process, this),
             []{})
@@ -60,6 +100,11 @@ VideoMixer::VideoMixer(const std::string& id)
         DRing::switchToCamera();
         videoLocal_->attach(this);
     }
+
+    const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned i = 0; i < std::min(cores - 1, MAX_RENDER_WORKERS); ++i)
+        workers_.emplace_back([this]{ render_worker(); });
+
     loop_.start();
 }
 
@@ -74,6 +119,14 @@ VideoMixer::~VideoMixer()
     }
 
     loop_.join();
+
+    {
+        std::lock_guard<std::mutex> lk(jobsMutex_);
+        stopWorkers_ = true;
+    }
+    jobsCv_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
 }
 
 void
@@ -84,6 +137,7 @@ VideoMixer::attached(Observable<std::shared_ptr<VideoFrame>>* ob)
     auto src = std::unique_ptr<VideoMixerSource>(new VideoMixerSource);
     src->source = ob;
     sources_.emplace_back(std::move(src));
+    redraw_ = true;
 }
 
 void
@@ -97,6 +151,9 @@ VideoMixer::detached(Observable<std::shared_ptr<VideoFrame>>* ob)
             break;
         }
     }
+    if (activeSource_ == ob)
+        activeSource_ = nullptr;
+    redraw_ = true;
 }
 
 void
@@ -113,6 +170,7 @@ VideoMixer::update(Observable<std::shared_ptr<VideoFrame>>* ob,
                 x->update_frame->reset();
             *x->update_frame = *frame_p; // copy frame content, it will be destroyed after return
             x->atomic_swap_render(x->update_frame);
+            x->updated = true;
             return;
         }
     }
@@ -121,62 +179,209 @@ VideoMixer::update(Observable<std::shared_ptr<VideoFrame>>* ob,
 void
 VideoMixer::process()
 {
-    const auto now = std::chrono::system_clock::now();
-    const auto diff = now - lastProcess_;
-    const auto delay = FRAME_DURATION - diff;
-    if (delay.count() > 0)
-        std::this_thread::sleep_for(delay);
-    lastProcess_ = now;
+    std::chrono::duration<double> frameDuration;
+    {
+        auto lock(rwMutex_.read());
+        frameDuration = frameDuration_;
+    }
+    nextProcess_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameDuration);
+    const auto now = std::chrono::steady_clock::now();
+    if (nextProcess_ < now) // late, don't try to catch up
+        nextProcess_ = now;
+    else
+        std::this_thread::sleep_until(nextProcess_);
+
+    {
+        auto lock(rwMutex_.read());
+
+        if (!width_ or !height_)
+            return;
+
+        const bool redraw = redraw_.exchange(false);
+        if (redraw) {
+            try {
+                composite_.reserve(VIDEO_PIXFMT_YUYV422, width_, height_);
+            } catch (const std::bad_alloc& e) {
+                RING_ERR("VideoFrame::allocBuffer() failed");
+                redraw_ = true;
+                return;
+            }
+            yuv422_clear_to_black(composite_);
+        }
+
+        std::size_t active = 0;
+        for (const auto& x : sources_) {
+            if (x->source == activeSource_)
+                break;
+            ++active;
+        }
+        if (active == sources_.size())
+            active = 0;
+        const auto cells = layoutCells(sources_.size(), active);
+
+        // in ONE_BIG_WITH_SMALL the active source is drawn first, under the others
+        std::vector<RenderJob> background;
+        std::vector<RenderJob> jobs;
+        std::size_t i = 0;
+        for (const auto& x : sources_) {
+            const auto& cell = cells[i];
+            const bool updated = x->updated.exchange(false);
+            if (cell.width and (redraw or updated)) {
+                if (layout_ == Layout::ONE_BIG_WITH_SMALL and i == active)
+                    background.emplace_back(x.get(), cell);
+                else
+                    jobs.emplace_back(x.get(), cell);
+            }
+            ++i;
+        }
+        if (not background.empty() and not redraw) {
+            // small pictures are overwritten
+            i = 0;
+            for (const auto& x : sources_) {
+                if (i != active and cells[i].width
+                    and std::find_if(jobs.begin(), jobs.end(),
+                                     [&](const RenderJob& j){ return j.first == x.get(); }) == jobs.end())
+                    jobs.emplace_back(x.get(), cells[i]);
+                ++i;
+            }
+        }
+
+        /* thread stop pending? */
+        if (!loop_.isRunning())
+            return;
+
+        render_frames(background);
+        render_frames(jobs);
+    }
 
     VideoFrame& output = getNewFrame();
     try {
-        output.reserve(VIDEO_PIXFMT_YUYV422, width_, height_);
+        output = composite_;
     } catch (const std::bad_alloc& e) {
         RING_ERR("VideoFrame::allocBuffer() failed");
         return;
     }
 
-    yuv422_clear_to_black(output);
+    publishFrame();
+}
 
-    {
-        auto lock(rwMutex_.read());
+// Cells of sources in sources_ order, for the current layout and size
+std::vector<VideoMixer::Cell>
+VideoMixer::layoutCells(std::size_t count, std::size_t active) const
+{
+    std::vector<Cell> cells(count);
+    if (not count)
+        return cells;
+
+    switch (layout_) {
+        case Layout::GRID: {
+            const int zoom = ceil(sqrt(count));
+            const int cell_width = width_ / zoom;
+            const int cell_height = height_ / zoom;
+            for (std::size_t i = 0; i < count; ++i) {
+                cells[i].x = (i % zoom) * cell_width;
+                cells[i].y = (i / zoom) * cell_height;
+                cells[i].width = cell_width;
+                cells[i].height = cell_height;
+            }
+            break;
+        }
 
-        int i = 0;
-        for (const auto& x : sources_) {
-            /* thread stop pending? */
-            if (!loop_.isRunning())
-                return;
+        case Layout::ONE_BIG_WITH_SMALL: {
+            // small pictures on the bottom line, those that don't fit are not shown
+            const int cell_width = width_ / SMALL_CELL_RATIO;
+            const int cell_height = height_ / SMALL_CELL_RATIO;
+            const int margin = cell_height / 10;
+            int x = margin;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i == active)
+                    continue;
+                if (x + cell_width > width_)
+                    break;
+                cells[i].x = x;
+                cells[i].y = height_ - cell_height - margin;
+                cells[i].width = cell_width;
+                cells[i].height = cell_height;
+                x += cell_width + margin;
+            }
+        }
+        // fallthrough
+        case Layout::ONE_BIG:
+            cells[active].x = 0;
+            cells[active].y = 0;
+            cells[active].width = width_;
+            cells[active].height = height_;
+            break;
+    }
+    return cells;
+}
 
-            // make rendered frame temporarily unavailable for update()
-            // to avoid concurrent access.
-            std::unique_ptr<VideoFrame> input;
-            x->atomic_swap_render(input);
+// Render cells in parallel, they must not overlap.
+// The mixer thread renders the cells no worker took, so a tick never waits
+// for a worker to be free.
+void
+VideoMixer::render_frames(const std::vector<RenderJob>& jobs)
+{
+    if (jobs.empty())
+        return;
 
-            if (input)
-                render_frame(output, *input, i);
+    std::unique_lock<std::mutex> lk(jobsMutex_);
+    jobs_ = &jobs;
+    nextJob_ = 0;
+    pendingJobs_ = jobs.size();
+    if (jobs.size() > 1)
+        jobsCv_.notify_all();
 
-            x->atomic_swap_render(input);
-            ++i;
-        }
-    }
+    while (render_next_job(lk)) {}
+    jobsDoneCv_.wait(lk, [this]{ return pendingJobs_ == 0; });
+    jobs_ = nullptr;
+}
 
-    publishFrame();
+// Render the next cell of jobs_, if any, with jobsMutex_ held in lk
+bool
+VideoMixer::render_next_job(std::unique_lock<std::mutex>& lk)
+{
+    if (not jobs_ or nextJob_ == jobs_->size())
+        return false;
+    const auto& job = (*jobs_)[nextJob_++];
+    lk.unlock();
+    render_frame(*job.first, job.second);
+    lk.lock();
+    if (--pendingJobs_ == 0)
+        jobsDoneCv_.notify_one();
+    return true;
 }
 
 void
-VideoMixer::render_frame(VideoFrame& output, const VideoFrame& input, int index)
+VideoMixer::render_worker()
 {
-    if (!width_ or !height_ or !input.pointer())
-        return;
+    std::unique_lock<std::mutex> lk(jobsMutex_);
+    while (not stopWorkers_) {
+        if (not render_next_job(lk))
+            jobsCv_.wait(lk);
+    }
+}
 
-    const int n = sources_.size();
-    const int zoom = ceil(sqrt(n));
-    int cell_width = width_ / zoom;
-    int cell_height = height_ / zoom;
-    int xoff = (index % zoom) * cell_width;
-    int yoff = (index / zoom) * cell_height;
+void
+VideoMixer::render_frame(VideoMixerSource& source, const Cell& cell)
+{
+    // make rendered frame temporarily unavailable for update()
+    // to avoid concurrent access.
+    std::unique_ptr<VideoFrame> input;
+    source.atomic_swap_render(input);
+
+    if (input and input->width() and input->height()) {
+        // keep aspect leaves borders, clear them when the size changes
+        if (input->width() != source.width or input->height() != source.height) {
+            clear_rect(composite_, cell.x, cell.y, cell.width, cell.height);
+            source.width = input->width();
+            source.height = input->height();
+        }
+        source.scaler.scale_and_pad(*input, composite_, cell.x, cell.y,
+                                    cell.width, cell.height, true);
+    }
 
-    scaler_.scale_and_pad(input, output, xoff, yoff, cell_width, cell_height, true);
+    source.restore_render(input);
 }
 
 void
@@ -186,6 +391,7 @@ VideoMixer::setDimensions(int width, int height)
 
     width_ = width;
     height_ = height;
+    redraw_ = true;
 
     // cleanup the previous frame to have a nice copy in rendering method
     std::shared_ptr<VideoFrame> previous_p(obtainLastFrame());
@@ -195,6 +401,31 @@ VideoMixer::setDimensions(int width, int height)
     start_sink();
 }
 
+void
+VideoMixer::setLayout(Layout layout)
+{
+    auto lock(rwMutex_.write());
+    layout_ = layout;
+    redraw_ = true;
+}
+
+void
+VideoMixer::setActiveParticipant(Observable<std::shared_ptr<VideoFrame>>* ob)
+{
+    auto lock(rwMutex_.write());
+    activeSource_ = ob;
+    redraw_ = true;
+}
+
+void
+VideoMixer::setFrameRate(double fps)
+{
+    if (fps <= 0)
+        return;
+    auto lock(rwMutex_.write());
+    frameDuration_ = std::chrono::duration<double>(1 / fps);
+}
+
 void
 VideoMixer::start_sink()
 {
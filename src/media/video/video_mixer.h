@@ -22,18 +22,32 @@
 
 #include "noncopyable.h"
 #include "video_base.h"
+#include "media_buffer.h"
 #include "video_scaler.h"
 #include "threadloop.h"
 #include "rw_mutex.h"
 
 #include <list>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace ring { namespace video {
 
 class SinkClient;
 
+/**
+ * Composes the conference video from its sources.
+ *
+ * The composed picture is kept between frames and a cell is only scaled
+ * again when its source gave a new frame, or when the layout changes.
+ * Cells to redraw are scaled in parallel, each source with its own scaler,
+ * by the mixer thread and a few workers owned by the mixer.
+ */
 class VideoMixer:
         public VideoGenerator,
         public VideoFramePassiveReader
@@ -42,7 +56,16 @@ public:
     VideoMixer(const std::string& id);
     ~VideoMixer();
 
+    enum class Layout {
+        GRID,               // every source in a cell of a grid
+        ONE_BIG,            // active source only
+        ONE_BIG_WITH_SMALL, // active source, others as small pictures over it
+    };
+
     void setDimensions(int width, int height);
+    void setLayout(Layout layout);
+    void setActiveParticipant(Observable<std::shared_ptr<VideoFrame>>* ob);
+    void setFrameRate(double fps);
 
     int getWidth() const override;
     int getHeight() const override;
@@ -58,7 +81,18 @@ private:
 
     struct VideoMixerSource;
 
-    void render_frame(VideoFrame& output, const VideoFrame& input, int index);
+    struct Cell {
+        int x {0}, y {0};
+        int width {0}, height {0}; // 0: not shown
+    };
+
+    using RenderJob = std::pair<VideoMixerSource*, Cell>;
+
+    std::vector<Cell> layoutCells(std::size_t count, std::size_t active) const;
+    void render_frames(const std::vector<RenderJob>& jobs);
+    void render_frame(VideoMixerSource& source, const Cell& cell);
+    bool render_next_job(std::unique_lock<std::mutex>& lk);
+    void render_worker();
 
     void start_sink();
     void stop_sink();
@@ -68,14 +102,30 @@ private:
     const std::string id_;
     int width_ = 0;
     int height_ = 0;
+    Layout layout_ {Layout::GRID};
+    Observable<std::shared_ptr<VideoFrame>>* activeSource_ {nullptr};
+    std::chrono::duration<double> frameDuration_;
     std::list<std::unique_ptr<VideoMixerSource>> sources_;
     rw_mutex rwMutex_;
 
     std::shared_ptr<SinkClient> sink_;
 
-    std::chrono::time_point<std::chrono::system_clock> lastProcess_;
+    std::chrono::steady_clock::time_point nextProcess_;
     std::shared_ptr<VideoFrameActiveWriter> videoLocal_;
-    VideoScaler scaler_;
+
+    // only used by the mixer thread
+    VideoFrame composite_;
+    std::atomic<bool> redraw_ {true}; // composite_ must be drawn again
+
+    // cells being rendered by render_frames(), shared with the workers
+    std::mutex jobsMutex_;
+    std::condition_variable jobsCv_;
+    std::condition_variable jobsDoneCv_;
+    const std::vector<RenderJob>* jobs_ {nullptr};
+    std::size_t nextJob_ {0};
+    std::size_t pendingJobs_ {0};
+    bool stopWorkers_ {false};
+    std::vector<std::thread> workers_;
 
     ThreadLoop loop_; // as to be last member
 };
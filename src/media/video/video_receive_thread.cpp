@@ -31,11 +31,15 @@
 
 #include <unistd.h>
 #include <map>
+#include <thread>
 
 namespace ring { namespace video {
 
 using std::string;
 
+// decode times are checked every this many frames
+static constexpr unsigned DECODE_CHECK_FRAMES {300};
+
 VideoReceiveThread::VideoReceiveThread(const std::string& id,
                                        const std::string &sdp,
                                        uint16_t mtu) :
@@ -48,7 +52,6 @@ VideoReceiveThread::VideoReceiveThread(const std::string& id,
     , sdpContext_(stream_.str().size(), false, &readFunction, 0, 0, this)
     , sink_ {Manager::instance().createSinkClient(id)}
     , mtu_(mtu)
-    , requestKeyFrameCallback_(0)
     , loop_(std::bind(&VideoReceiveThread::setup, this),
             std::bind(&VideoReceiveThread::process, this),
             std::bind(&VideoReceiveThread::cleanup, this))
@@ -70,6 +73,8 @@ VideoReceiveThread::startLoop()
 bool VideoReceiveThread::setup()
 {
     videoDecoder_.reset(new MediaDecoder());
+    // frame threads would add a frame of delay per thread
+    videoDecoder_->setThreading(MediaDecoder::Threading::SLICE);
 
     dstWidth_ = args_.width;
     dstHeight_ = args_.height;
@@ -136,6 +141,10 @@ void VideoReceiveThread::cleanup()
     detach(sink_.get());
     sink_->stop();
 
+    if (videoDecoder_ and videoDecoder_->getDecodeTimes().count())
+        RING_DBG("[call:%s] Decode times: %s", id_.c_str(),
+                 videoDecoder_->getDecodeTimes().toString().c_str());
+
     videoDecoder_.reset();
     demuxContext_.reset();
 }
@@ -171,6 +180,7 @@ bool VideoReceiveThread::decodeFrame()
     switch (ret) {
         case MediaDecoder::Status::FrameFinished:
             publishFrame();
+            checkDecodeTime();
             return true;
 
         case MediaDecoder::Status::DecodeError:
@@ -200,6 +210,40 @@ bool VideoReceiveThread::decodeFrame()
 }
 
 
+// Switch to frame threads if slices alone can't keep up with the stream,
+// as with peers sending a single slice per frame.
+void
+VideoReceiveThread::checkDecodeTime()
+{
+    if (++decodedFrames_ % DECODE_CHECK_FRAMES)
+        return;
+
+    const auto& decodeTimes = videoDecoder_->getDecodeTimes();
+    const auto recent = decodeTimes.since(checkedDecodeTimes_);
+    checkedDecodeTimes_ = decodeTimes;
+
+    if (videoDecoder_->getThreading() != MediaDecoder::Threading::SLICE)
+        return;
+
+    auto fps = videoDecoder_->getFps().real();
+    if (not (fps > 0))
+        fps = 30;
+    const auto frameTime = std::chrono::microseconds(static_cast<int64_t>(1e6 / fps));
+    if (not needsFrameThreads(recent, frameTime, std::thread::hardware_concurrency()))
+        return;
+
+    RING_WARN("[call:%s] Decoding %dx%d too slow (%s), using frame threads", id_.c_str(),
+              videoDecoder_->getWidth(), videoDecoder_->getHeight(), recent.toString().c_str());
+    videoDecoder_->setThreading(MediaDecoder::Threading::FRAME);
+    if (videoDecoder_->setupFromVideoData() < 0) {
+        RING_ERR("[call:%s] Could not reopen decoder", id_.c_str());
+        loop_.stop();
+        return;
+    }
+    // the new decoder needs parameter sets
+    triggerKeyFrameRequest();
+}
+
 void VideoReceiveThread::enterConference()
 {
     if (!loop_.isRunning())
@@ -219,8 +263,8 @@ void VideoReceiveThread::exitConference()
 }
 
 void VideoReceiveThread::setRequestKeyFrameCallback(
-    void (*cb)(const std::string &))
-{ requestKeyFrameCallback_ = cb; }
+    std::function<void(const std::string&)> cb)
+{ requestKeyFrameCallback_ = std::move(cb); }
 
 int VideoReceiveThread::getWidth() const
 { return dstWidth_; }
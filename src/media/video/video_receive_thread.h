@@ -26,6 +26,7 @@
 #include "media_codec.h"
 #include "media_io_handle.h"
 #include "media_device.h"
+#include "media_decoder.h"
 #include "threadloop.h"
 #include "noncopyable.h"
 
@@ -34,6 +35,7 @@
 #include <climits>
 #include <sstream>
 #include <memory>
+#include <functional>
 
 namespace ring {
 class SocketPair;
@@ -51,7 +53,7 @@ public:
     void startLoop();
 
     void addIOContext(SocketPair& socketPair);
-    void setRequestKeyFrameCallback(void (*)(const std::string &));
+    void setRequestKeyFrameCallback(std::function<void(const std::string&)> cb);
     void enterConference();
     void exitConference();
 
@@ -79,10 +81,13 @@ private:
     std::shared_ptr<SinkClient> sink_;
     bool isReset_;
     uint16_t mtu_;
+    unsigned decodedFrames_ {0};
+    DecodeTimeHistogram checkedDecodeTimes_;
 
-    void (*requestKeyFrameCallback_)(const std::string &);
+    std::function<void(const std::string&)> requestKeyFrameCallback_;
     void openDecoder();
     bool decodeFrame();
+    void checkDecodeTime();
     static int interruptCb(void *ctx);
     static int readFunction(void *opaque, uint8_t *buf, int buf_size);
 
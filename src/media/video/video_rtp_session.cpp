@@ -24,6 +24,8 @@
 #include "video_sender.h"
 #include "video_receive_thread.h"
 #include "video_mixer.h"
+#include "media_buffer.h"
+#include "video_scaler.h"
 #include "ice_socket.h"
 #include "socket_pair.h"
 #include "sip/sipvoiplink.h" // for enqueueKeyframeRequest
@@ -40,6 +42,7 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <cmath>
 
 namespace ring { namespace video {
 
@@ -51,12 +54,22 @@ constexpr static auto NEWPARAMS_TIMEOUT = std::chrono::milliseconds(1000);
 // how long (in seconds) to wait before rechecking for packet loss
 static constexpr auto RTCP_PACKET_LOSS_INTERVAL = std::chrono::milliseconds(1000);
 
+// interval between congestion checks, about the peer RTCP interval
+static constexpr auto RTCP_CHECKING_INTERVAL = std::chrono::milliseconds(1000);
+
+// smallest bitrate change worth applying, relative to the current one
+static constexpr double MIN_BITRATE_CHANGE = 0.05;
+
+// encoders that can't change bitrate live are restarted at most this often
+static constexpr auto MIN_SENDER_RESTART_INTERVAL = std::chrono::seconds(10);
+
 VideoRtpSession::VideoRtpSession(const string &callID,
                                  const DeviceParams& localVideoParams) :
     RtpSession(callID), localVideoParams_(localVideoParams)
-    , lastRTCPCheck_(std::chrono::system_clock::now())
-    , lastLongRTCPCheck_(std::chrono::system_clock::now())
     , videoBitrateInfo_ {}
+    , congestion_(SystemCodecInfo::DEFAULT_VIDEO_BITRATE,
+                  SystemCodecInfo::DEFAULT_MIN_BITRATE,
+                  SystemCodecInfo::DEFAULT_MAX_BITRATE)
     , rtcpCheckerThread_([] { return true; },
             [this]{ processRtcpChecker(); },
             []{})
@@ -155,7 +168,15 @@ void VideoRtpSession::startReceiver()
         );
 
         // XXX keyframe requests can timeout if unanswered
-        receiveThread_->setRequestKeyFrameCallback(&SIPVoIPLink::enqueueKeyframeRequest);
+        if (send_.rtcpPli) {
+            // straight to the sender, no SIP transaction
+            auto socketPair = socketPair_.get();
+            receiveThread_->setRequestKeyFrameCallback([socketPair](const std::string&) {
+                socketPair->sendPictureLossIndication();
+            });
+        } else {
+            receiveThread_->setRequestKeyFrameCallback(&SIPVoIPLink::enqueueKeyframeRequest);
+        }
         receiveThread_->addIOContext(*socketPair_);
         receiveThread_->startLoop();
         packetLossThread_.start();
@@ -229,13 +250,21 @@ void VideoRtpSession::stop()
     sender_.reset();
     socketPair_.reset();
     videoLocal_.reset();
+
+    const auto pools = videoFramePoolStats();
+    RING_DBG("[call:%s] video frame pools: %zu geometries, %lu buffers reused, %lu allocated",
+             callID_.c_str(), pools.pools, (long unsigned)pools.hits, (long unsigned)pools.misses);
+    const auto scaling = ScalingCache::instance().getStats();
+    RING_DBG("[call:%s] video scaling: %lu requests, %lu passthrough, %lu shared, %lu scaled (%lu halved)",
+             callID_.c_str(), (long unsigned)scaling.requests, (long unsigned)scaling.passthrough,
+             (long unsigned)scaling.hits, (long unsigned)scaling.scaled, (long unsigned)scaling.halved);
 }
 
 void VideoRtpSession::forceKeyFrame()
 {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     if (sender_)
-        sender_->forceKeyFrame();
+        sender_->forceKeyFrame(KeyframeRequest::SIP_INFO);
 }
 
 void
@@ -326,174 +355,57 @@ VideoRtpSession::useCodec(const ring::AccountVideoCodecInfo* codec) const
 }
 
 
-float
-VideoRtpSession::checkPeerPacketLoss()
-{
-    auto rtcpInfoVect = socketPair_->getRtcpInfo();
-    unsigned totalLost = 0;
-    unsigned fract = 0;
-    auto vectSize = rtcpInfoVect.size();
-
-    for (const auto& it : rtcpInfoVect) {
-        fract = (ntohl(it.fraction_lost) & 0xff000000)  >> 24;
-        totalLost += fract;
-    }
-
-    if (vectSize != 0)
-        return (float)( 100 * totalLost) / (256.0 * vectSize);
-    else
-        return NO_PACKET_LOSS_CALCULATED;
-}
-
-unsigned
-VideoRtpSession::getLowerQuality()
-{
-    // if lower quality was stored we return it
-    unsigned quality = videoBitrateInfo_.videoQualityCurrent;
-    while ( not histoQuality_.empty()) {
-        quality = histoQuality_.back();
-        histoQuality_.pop_back();
-        if (quality > videoBitrateInfo_.videoQualityCurrent)
-            return quality;
-    }
-
-    // if no appropriate quality found, calculate it with dichotomie
-    quality = (videoBitrateInfo_.videoQualityCurrent + videoBitrateInfo_.videoQualityMin) / 2;
-    return quality;
-}
-
-unsigned
-VideoRtpSession::getLowerBitrate()
-{
-    // if a lower bitrate was stored we return it
-    unsigned bitrate = videoBitrateInfo_.videoBitrateCurrent;
-    while ( not histoBitrate_.empty()) {
-        bitrate = histoBitrate_.back();
-        histoBitrate_.pop_back();
-        if (bitrate < videoBitrateInfo_.videoBitrateCurrent)
-            return bitrate;
-    }
-
-    // if no appropriate bitrate found, calculate it with dichotomie
-    bitrate = (videoBitrateInfo_.videoBitrateCurrent + videoBitrateInfo_.videoBitrateMin) / 2;
-    return bitrate;
-}
-
 void
-VideoRtpSession::adaptQualityAndBitrate()
+VideoRtpSession::adaptBitrate()
 {
-    bool needToCheckQuality = false;
-    bool mediaRestartNeeded = false;
-    float packetLostRate = 0.0;
-
-    auto rtcpCheckTimer = std::chrono::duration_cast<std::chrono::seconds> (std::chrono::system_clock::now() - lastRTCPCheck_);
-    auto rtcpLongCheckTimer = std::chrono::duration_cast<std::chrono::seconds> (std::chrono::system_clock::now() - lastLongRTCPCheck_);
-
-    if (rtcpCheckTimer.count() >= RTCP_CHECKING_INTERVAL) {
-        needToCheckQuality = true;
-        lastRTCPCheck_ = std::chrono::system_clock::now();
-    }
+    const auto reports = socketPair_->getRtcpInfo();
+    if (reports.empty())
+        return;
 
-    if (rtcpLongCheckTimer.count() >= RTCP_LONG_CHECKING_INTERVAL) {
-        needToCheckQuality = true;
-        hasReachMaxQuality_ = false;
-        lastLongRTCPCheck_ = std::chrono::system_clock::now();
-        // we force iterative bitrate adaptation
-        videoBitrateInfo_.cptBitrateChecking = 0;
+    unsigned bitrate = congestion_.getBitrate();
+    for (const auto& report : reports) {
+        const double loss = ((ntohl(report.header.fraction_lost) & 0xff000000) >> 24) / 256.;
+        bitrate = congestion_.onReceiverReport(loss, report.rtt);
     }
 
+    const auto current = videoBitrateInfo_.videoBitrateCurrent;
+    if (bitrate == current or
+        (std::abs((double)bitrate - current) < MIN_BITRATE_CHANGE * current
+         and bitrate != videoBitrateInfo_.videoBitrateMin
+         and bitrate != videoBitrateInfo_.videoBitrateMax))
+        return;
 
-    if (needToCheckQuality) {
-
-        videoBitrateInfo_.cptBitrateChecking++;
-
-        // packetLostRate is not already available. Do nothing
-        if ((packetLostRate = checkPeerPacketLoss()) == NO_PACKET_LOSS_CALCULATED) {
-            // we force iterative bitrate adaptation
-            videoBitrateInfo_.cptBitrateChecking = 0;
-
-        // too much packet lost : decrease quality and bitrate
-        } else if (packetLostRate >= videoBitrateInfo_.packetLostThreshold) {
-
-            // calculate new quality by dichotomie
-            videoBitrateInfo_.videoQualityCurrent = getLowerQuality();
-
-            // calculate new bitrate by dichotomie
-            videoBitrateInfo_.videoBitrateCurrent =  getLowerBitrate();
-
-            // boundaries low
-            if (videoBitrateInfo_.videoQualityCurrent > videoBitrateInfo_.videoQualityMin)
-                videoBitrateInfo_.videoQualityCurrent = videoBitrateInfo_.videoQualityMin;
-
-            if (videoBitrateInfo_.videoBitrateCurrent < videoBitrateInfo_.videoBitrateMin)
-                videoBitrateInfo_.videoBitrateCurrent = videoBitrateInfo_.videoBitrateMin;
-
-
-            // we force iterative bitrate and quality adaptation
-            videoBitrateInfo_.cptBitrateChecking = 0;
-
-            // asynchronous A/V media restart
-            // we give priority to quality
-            if (((videoBitrateInfo_.videoQualityCurrent != SystemCodecInfo::DEFAULT_NO_QUALITY) &&
-                    (videoBitrateInfo_.videoQualityCurrent !=  (histoQuality_.empty() ? 0 : histoQuality_.back()))) ||
-                ((videoBitrateInfo_.videoQualityCurrent == SystemCodecInfo::DEFAULT_NO_QUALITY) &&
-                    (videoBitrateInfo_.videoBitrateCurrent !=  (histoBitrate_.empty() ? 0 : histoBitrate_.back())))) {
-                mediaRestartNeeded = true;
-                hasReachMaxQuality_ = true;
-            }
-
-
-        // no packet lost: increase quality and bitrate
-        } else if ((videoBitrateInfo_.cptBitrateChecking <= videoBitrateInfo_.maxBitrateChecking)
-                   and not hasReachMaxQuality_) {
-
-            // calculate new quality by dichotomie
-            videoBitrateInfo_.videoQualityCurrent =
-                (videoBitrateInfo_.videoQualityCurrent + videoBitrateInfo_.videoQualityMax) / 2;
-
-            // calculate new bitrate by dichotomie
-            videoBitrateInfo_.videoBitrateCurrent =
-                ( videoBitrateInfo_.videoBitrateCurrent + videoBitrateInfo_.videoBitrateMax) / 2;
-
-            // boundaries high
-            if (videoBitrateInfo_.videoQualityCurrent < videoBitrateInfo_.videoQualityMax)
-                videoBitrateInfo_.videoQualityCurrent = videoBitrateInfo_.videoQualityMax;
-
-            if (videoBitrateInfo_.videoBitrateCurrent > videoBitrateInfo_.videoBitrateMax)
-                videoBitrateInfo_.videoBitrateCurrent = videoBitrateInfo_.videoBitrateMax;
-
-            // asynchronous A/V media restart
-            // we give priority to quality
-            if (((videoBitrateInfo_.videoQualityCurrent != SystemCodecInfo::DEFAULT_NO_QUALITY) &&
-                    (videoBitrateInfo_.videoQualityCurrent !=  (histoQuality_.empty() ? 0 : histoQuality_.back()))) ||
-                ((videoBitrateInfo_.videoQualityCurrent == SystemCodecInfo::DEFAULT_NO_QUALITY) &&
-                    (videoBitrateInfo_.videoBitrateCurrent !=  (histoBitrate_.empty() ? 0 : histoBitrate_.back()))))
-                mediaRestartNeeded = true;
-
-            if (videoBitrateInfo_.cptBitrateChecking == videoBitrateInfo_.maxBitrateChecking)
-                lastLongRTCPCheck_ = std::chrono::system_clock::now();
-
-        } else {
-            // nothing we reach maximal tries
+    const auto stats = congestion_.getStats();
+    RING_DBG("[call:%s] loss=%f rtt=%lldus queuing=%lldus -> bitrate %u -> %u",
+             callID_.c_str(), stats.loss,
+             (long long)stats.rtt.count(), (long long)stats.queuingDelay.count(),
+             current, bitrate);
+
+    // the bitrate is only stored once applied, the next report retries otherwise
+    {
+        // stop() joins this thread with the lock held
+        std::unique_lock<std::recursive_mutex> lock(mutex_, std::try_to_lock);
+        if (not lock)
+            return;
+        if (sender_ and sender_->setBitrate(bitrate)) {
+            videoBitrateInfo_.videoBitrateCurrent = bitrate;
+            storeVideoBitrateInfo();
+            return;
         }
     }
 
-    if (mediaRestartNeeded) {
-        storeVideoBitrateInfo();
-        const auto& cid = callID_;
-
-        RING_WARN("[%u/%u] packetLostRate=%f -> change quality to %d bitrate to %d",
-                videoBitrateInfo_.cptBitrateChecking,
-                videoBitrateInfo_.maxBitrateChecking,
-                packetLostRate,
-                videoBitrateInfo_.videoQualityCurrent,
-                videoBitrateInfo_.videoBitrateCurrent);
-
-        runOnMainThread([cid]{
-            if (auto call = Manager::instance().callFactory.getCall(cid))
-                call->restartMediaSender();
-            });
-    }
+    // the encoder can't change its bitrate, restart it with the stored one
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastSenderRestart_ < MIN_SENDER_RESTART_INTERVAL)
+        return;
+    lastSenderRestart_ = now;
+    videoBitrateInfo_.videoBitrateCurrent = bitrate;
+    storeVideoBitrateInfo();
+    const auto& cid = callID_;
+    runOnMainThread([cid]{
+        if (auto call = Manager::instance().callFactory.getCall(cid))
+            call->restartMediaSender();
+        });
 }
 
 void
@@ -507,15 +419,13 @@ VideoRtpSession::setupVideoBitrateInfo() {
             (unsigned)(ring::stoi(codecVideo->getCodecSpecifications()[DRing::Account::ConfProperties::CodecInfo::QUALITY])),
             (unsigned)(ring::stoi(codecVideo->getCodecSpecifications()[DRing::Account::ConfProperties::CodecInfo::MIN_QUALITY])),
             (unsigned)(ring::stoi(codecVideo->getCodecSpecifications()[DRing::Account::ConfProperties::CodecInfo::MAX_QUALITY])),
-            videoBitrateInfo_.cptBitrateChecking,
-            videoBitrateInfo_.maxBitrateChecking,
-            videoBitrateInfo_.packetLostThreshold,
         };
     } else {
-        videoBitrateInfo_ = {0, 0, 0, 0, 0, 0, 0,
-                             MAX_ADAPTATIVE_BITRATE_ITERATION,
-                             PACKET_LOSS_THRESHOLD};
+        videoBitrateInfo_ = {0, 0, 0, 0, 0, 0};
     }
+    congestion_.reset(videoBitrateInfo_.videoBitrateCurrent,
+                      videoBitrateInfo_.videoBitrateMin,
+                      videoBitrateInfo_.videoBitrateMax);
 }
 
 void
@@ -531,24 +441,14 @@ VideoRtpSession::storeVideoBitrateInfo() {
             {DRing::Account::ConfProperties::CodecInfo::MIN_QUALITY, ring::to_string(videoBitrateInfo_.videoQualityMin)},
             {DRing::Account::ConfProperties::CodecInfo::MAX_QUALITY, ring::to_string(videoBitrateInfo_.videoQualityMax)}
         });
-
-        if (histoQuality_.size() > MAX_SIZE_HISTO_QUALITY_)
-            histoQuality_.pop_front();
-
-        if (histoBitrate_.size() > MAX_SIZE_HISTO_BITRATE_)
-            histoBitrate_.pop_front();
-
-        histoQuality_.push_back(videoBitrateInfo_.videoQualityCurrent);
-        histoBitrate_.push_back(videoBitrateInfo_.videoBitrateCurrent);
-
     }
 }
 
 void
 VideoRtpSession::processRtcpChecker()
 {
-    adaptQualityAndBitrate();
-    rtcpCheckerThread_.wait_for(std::chrono::seconds(RTCP_CHECKING_INTERVAL));
+    adaptBitrate();
+    rtcpCheckerThread_.wait_for(RTCP_CHECKING_INTERVAL);
 }
 
 void
@@ -27,6 +27,7 @@
 
 #include "video_base.h"
 #include "threadloop.h"
+#include "media/congestion_controller.h"
 
 #include <string>
 #include <memory>
@@ -48,9 +49,6 @@ struct VideoBitrateInfo {
     unsigned videoQualityCurrent;
     unsigned videoQualityMin;
     unsigned videoQualityMax;
-    unsigned cptBitrateChecking;
-    unsigned maxBitrateChecking;
-    float packetLostThreshold;
 };
 
 class VideoRtpSession : public RtpSession {
@@ -88,8 +86,7 @@ private:
     std::string input_;
     DeviceParams localVideoParams_;
 
-    std::chrono::time_point<std::chrono::system_clock>  lastRTCPCheck_;
-    std::chrono::time_point<std::chrono::system_clock>  lastLongRTCPCheck_;
+    std::chrono::steady_clock::time_point lastSenderRestart_ {};
 
     std::unique_ptr<VideoSender> sender_;
     std::unique_ptr<VideoReceiveThread> receiveThread_;
@@ -98,34 +95,15 @@ private:
     std::shared_ptr<VideoFrameActiveWriter> videoLocal_;
     uint16_t initSeqVal_ = 0;
 
-    float checkPeerPacketLoss();
-    unsigned getLowerQuality();
-    unsigned getLowerBitrate();
-    void adaptQualityAndBitrate();
+    void adaptBitrate();
     void storeVideoBitrateInfo();
     void setupVideoBitrateInfo();
     void checkReceiver();
 
-    // interval in seconds between RTCP checkings
-    const unsigned RTCP_CHECKING_INTERVAL {4};
-    // long interval in seconds between RTCP checkings
-    const unsigned RTCP_LONG_CHECKING_INTERVAL {30};
-    // no packet loss can be calculated as no data in input
-    static constexpr float NO_PACKET_LOSS_CALCULATED {-1.0};
     // bitrate and quality info struct
     VideoBitrateInfo videoBitrateInfo_;
-    // previous quality and bitrate used if quality or bitrate need to be decreased
-    std::list<unsigned> histoQuality_ {};
-    std::list<unsigned> histoBitrate_ {};
-    // max size of quality and bitrate historic
-    static constexpr unsigned MAX_SIZE_HISTO_QUALITY_ {30};
-    static constexpr unsigned MAX_SIZE_HISTO_BITRATE_ {100};
-
-    // 5 tries in a row
-    static constexpr unsigned  MAX_ADAPTATIVE_BITRATE_ITERATION {5};
-    bool hasReachMaxQuality_ {false};
-    // packet loss threshold
-    static constexpr float PACKET_LOSS_THRESHOLD {1.0};
+    // bitrate estimation from the peer receiver reports
+    CongestionController congestion_;
 
     InterruptedThreadLoop rtcpCheckerThread_;
     void processRtcpChecker();
@@ -24,8 +24,17 @@
 #include "media_buffer.h"
 #include "logger.h"
 
+#include <algorithm>
 #include <cassert>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RING_SCALER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RING_SCALER_NEON 1
+#endif
+
 namespace ring { namespace video {
 
 VideoScaler::VideoScaler()
@@ -140,4 +149,135 @@ void VideoScaler::reset()
     }
 }
 
+// most sources and sizes alive at once, a few calls with a few senders each
+static constexpr std::size_t MAX_SLOTS {16};
+
+// dst[x] = rounded mean of the 2x2 block of src at (2x, 0)
+static void
+halveRow(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int width)
+{
+    int x = 0;
+#if RING_SCALER_SSE2
+    const auto mask = _mm_set1_epi16(0x00ff);
+    const auto two = _mm_set1_epi16(2);
+    for (; x + 16 <= width; x += 16) {
+        __m128i sum[2];
+        for (int i = 0; i < 2; ++i) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + 2 * x + 16 * i));
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + 2 * x + 16 * i));
+            sum[i] = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+            sum[i] = _mm_srli_epi16(_mm_add_epi16(sum[i], two), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sum[0], sum[1]));
+    }
+#elif RING_SCALER_NEON
+    for (; x + 8 <= width; x += 8) {
+        auto sum = vpaddlq_u8(vld1q_u8(src0 + 2 * x));
+        sum = vpadalq_u8(sum, vld1q_u8(src1 + 2 * x));
+        vst1_u8(dst + x, vrshrn_n_u16(sum, 2));
+    }
+#endif
+    for (; x < width; ++x)
+        dst[x] = (src0[2 * x] + src0[2 * x + 1] + src1[2 * x] + src1[2 * x + 1] + 2) >> 2;
+}
+
+static bool
+canHalve(const AVFrame* input, const AVFrame* output)
+{
+    return input->format == AV_PIX_FMT_YUV420P and output->format == AV_PIX_FMT_YUV420P
+        and input->width == 2 * output->width and input->height == 2 * output->height
+        and output->width % 2 == 0 and output->height % 2 == 0;
+}
+
+static void
+halve(const AVFrame* input, AVFrame* output)
+{
+    for (int plane = 0; plane < 3; ++plane) {
+        const int shift = plane ? 1 : 0;
+        const int width = output->width >> shift;
+        const int height = output->height >> shift;
+        for (int y = 0; y < height; ++y) {
+            const auto src = input->data[plane] + 2 * y * input->linesize[plane];
+            halveRow(src, src + input->linesize[plane],
+                     output->data[plane] + y * output->linesize[plane], width);
+        }
+    }
+}
+
+ScalingCache&
+ScalingCache::instance()
+{
+    static ScalingCache cache;
+    return cache;
+}
+
+std::shared_ptr<VideoFrame>
+ScalingCache::get(const void* source, const std::shared_ptr<VideoFrame>& input,
+                  int width, int height, int format)
+{
+    const auto inputFrame = input->pointer();
+    std::shared_ptr<Slot> slot;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++stats_.requests;
+        // frames on a device are uploaded by the encoder as they are
+        const auto desc = av_pix_fmt_desc_get((AVPixelFormat)inputFrame->format);
+        if ((inputFrame->width == width and inputFrame->height == height
+             and inputFrame->format == format)
+            or (desc and desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            ++stats_.passthrough;
+            return input;
+        }
+
+        auto& s = slots_[Key {source, width, height, format}];
+        if (not s)
+            s = std::make_shared<Slot>();
+        s->lastUse = ++useCount_;
+        slot = s;
+
+        if (slots_.size() > MAX_SLOTS) {
+            const auto oldest = std::min_element(slots_.begin(), slots_.end(),
+                [](const std::pair<const Key, std::shared_ptr<Slot>>& a,
+                   const std::pair<const Key, std::shared_ptr<Slot>>& b) {
+                    return a.second->lastUse < b.second->lastUse;
+                });
+            slots_.erase(oldest); // still usable by a thread holding it
+        }
+    }
+
+    // consumers of the same size wait for the first one to scale
+    std::lock_guard<std::mutex> lk(slot->mutex);
+    if (slot->input.lock() == input) {
+        std::lock_guard<std::mutex> statsLock(mutex_);
+        ++stats_.hits;
+        return slot->output;
+    }
+
+    auto output = std::make_shared<VideoFrame>();
+    output->reserve(format, width, height);
+    const bool halved = canHalve(inputFrame, output->pointer());
+    if (halved) {
+        halve(inputFrame, output->pointer());
+    } else {
+        yuv422_clear_to_black(*output); // to fill blank space left by the "keep aspect"
+        slot->scaler.scale_with_aspect(*input, *output);
+    }
+    slot->input = input;
+    slot->output = output;
+
+    std::lock_guard<std::mutex> statsLock(mutex_);
+    ++stats_.scaled;
+    if (halved)
+        ++stats_.halved;
+    return output;
+}
+
+ScalingCacheStats
+ScalingCache::getStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
+
 }} // namespace ring::video
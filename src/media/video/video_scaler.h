@@ -24,6 +24,11 @@
 #include "video_base.h"
 #include "noncopyable.h"
 
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 class SwsContext;
 
@@ -48,6 +53,51 @@ private:
     uint8_t *tmp_data_[4]; // used by scale_and_pad
 };
 
+struct ScalingCacheStats {
+    uint64_t requests {0};
+    uint64_t passthrough {0};  // input already at the requested size
+    uint64_t hits {0};         // scaled before for another consumer
+    uint64_t scaled {0};
+    uint64_t halved {0};       // scaled by the 2:1 kernel, counted in scaled
+};
+
+/**
+ * Scaled copies of the last frame of each source, one per output geometry
+ * and format, so a frame is scaled once however many consumers need it at
+ * that size. Frames are scaled like scale_with_aspect, on black.
+ * Exact 2:1 YUV420P downscales use a box filter rather than swscale.
+ */
+class ScalingCache {
+public:
+    static ScalingCache& instance();
+
+    /**
+     * input scaled to width x height in format (libav pixel format).
+     * source identifies the producer of input, the returned frame is shared
+     * and must not be written.
+     */
+    std::shared_ptr<VideoFrame> get(const void* source,
+                                    const std::shared_ptr<VideoFrame>& input,
+                                    int width, int height, int format);
+
+    ScalingCacheStats getStats() const;
+
+private:
+    struct Slot {
+        std::mutex mutex;
+        VideoScaler scaler;
+        std::weak_ptr<VideoFrame> input;
+        std::shared_ptr<VideoFrame> output;
+        uint64_t lastUse {0};
+    };
+    using Key = std::tuple<const void*, int, int, int>;
+
+    mutable std::mutex mutex_;
+    std::map<Key, std::shared_ptr<Slot>> slots_;
+    uint64_t useCount_ {0};
+    ScalingCacheStats stats_;
+};
+
 }} // namespace ring::video
 
 #endif // __VIDEO_SCALER_H__
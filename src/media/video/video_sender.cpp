@@ -20,54 +20,268 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
+
 #include "video_sender.h"
 #include "video_mixer.h"
+#include "video_scaler.h"
 #include "socket_pair.h"
+#include "media_codec.h"
 #include "client/videomanager.h"
 #include "logger.h"
 #include "manager.h"
 #include "smartools.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
 #include <map>
+#include <sstream>
+#include <tuple>
 #include <unistd.h>
+#include <vector>
 
 namespace ring { namespace video {
 
 using std::string;
 
+// Bitrates within this ratio may be in the same tier
+static constexpr double BITRATE_TIER_RATIO {1.5};
+
+static unsigned
+bitrateTier(double bitrate)
+{
+    return bitrate >= 1 ? std::floor(std::log(bitrate) / std::log(BITRATE_TIER_RATIO)) : 0;
+}
+
+// A sender changes tier only past this margin, so that a bitrate oscillating
+// around a tier boundary doesn't move it between groups back and forth
+static constexpr double BITRATE_TIER_MARGIN {1.1};
+
+static bool
+leavesTier(unsigned bitrate, unsigned tier)
+{
+    return bitrateTier(bitrate * BITRATE_TIER_MARGIN) < tier
+        or bitrateTier(bitrate / BITRATE_TIER_MARGIN) > tier;
+}
+
+/* Senders sharing one encoder.
+ * The leader encodes the frames of the source and the packets are given to
+ * every other member. When the leader leaves, another member takes over.
+ * Packets are sent without the group lock; a new leader is only published
+ * once the packets in flight are sent, as they go through its muxer.
+ */
+class VideoSender::EncoderGroup {
+    public:
+        void join(VideoSender& sender) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            members_.emplace_back(&sender);
+            if (const auto leader = leader_.load()) {
+                leader->keyframes_.request(KeyframeRequest::LOCAL); // for the new peer to start decoding
+            } else {
+                leader_ = &sender;
+                // its encoder may have been idle in another group
+                sender.keyframes_.request(KeyframeRequest::LOCAL);
+            }
+        }
+
+        void leave(VideoSender& sender) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            members_.erase(std::remove(members_.begin(), members_.end(), &sender), members_.end());
+            bitrates_.erase(&sender);
+            const bool wasLeader = leader_ == &sender;
+            if (wasLeader)
+                leader_ = nullptr; // no new send() nor encoding meanwhile
+
+            // a packet may still be given to sender, or to the next leader
+            sendCv_.wait(lk, [this]{ return sending_ == 0; });
+
+            if (wasLeader and not members_.empty()) {
+                // new encoder, everybody needs a keyframe
+                leader_ = members_.front();
+                leader_.load()->keyframes_.request(KeyframeRequest::LOCAL);
+            }
+            applyBitrate();
+        }
+
+        // the encoder follows the member with the lowest bitrate
+        bool setBitrate(VideoSender& sender, unsigned bitrate) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            bitrates_[&sender] = bitrate;
+            return applyBitrate();
+        }
+
+        bool isLeader(const VideoSender& sender) const {
+            return leader_ == &sender;
+        }
+
+        // requests of all the peers are coalesced by the encoder
+        void forceKeyFrame(KeyframeRequest origin) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (const auto leader = leader_.load())
+                leader->keyframes_.request(origin);
+        }
+
+        // strictly increasing, for timestamps to go on when the leader changes
+        int64_t frameNumber(int64_t number) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            lastFrame_ = std::max(number, lastFrame_ + 1);
+            return lastFrame_;
+        }
+
+        void send(const VideoSender& from, AVPacket& packet) {
+            std::vector<VideoSender*> members;
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                if (leader_ != &from)
+                    return;
+                members = members_;
+                ++sending_;
+            }
+            for (auto member : members) {
+                if (member == &from)
+                    continue;
+                AVPacket copy;
+                if (av_packet_ref(&copy, &packet) < 0)
+                    continue;
+                SocketPair::SendBatch batch(member->socketPair_);
+                member->videoEncoder_->send(copy);
+                av_packet_unref(&copy);
+            }
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (--sending_ == 0)
+                sendCv_.notify_all();
+        }
+
+    private:
+        bool applyBitrate() {
+            const auto leader = leader_.load();
+            if (not leader or bitrates_.empty())
+                return true;
+            const auto it = std::min_element(bitrates_.begin(), bitrates_.end(),
+                [](const std::pair<VideoSender* const, unsigned>& a,
+                   const std::pair<VideoSender* const, unsigned>& b) { return a.second < b.second; });
+            return leader->videoEncoder_->setBitrate(it->second);
+        }
+
+        std::mutex mutex_;
+        std::condition_variable sendCv_;
+        std::vector<VideoSender*> members_;
+        std::map<VideoSender*, unsigned> bitrates_;
+        std::atomic<VideoSender*> leader_ {nullptr}; // set under mutex_, read anywhere
+        unsigned sending_ {0}; // send() calls giving packets to members
+        int64_t lastFrame_ {-1};
+};
+
+// Frames elapsed since the first call, so that timestamps keep increasing
+// when a sender changes source or encoder group
+static int64_t
+frameNumberNow(double frameRate)
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - epoch;
+    return elapsed.count() * frameRate;
+}
+
 VideoSender::VideoSender(const std::string& dest, const DeviceParams& dev,
                          const MediaDescription& args, SocketPair& socketPair,
                          const uint16_t seqVal,
                          uint16_t mtu)
     : muxContext_(socketPair.createIOContext(mtu))
     , videoEncoder_(new MediaEncoder)
+    , socketPair_(socketPair)
+    , loop_([]{ return true; },
+            [this]{ process(); },
+            []{})
 {
     videoEncoder_->setDeviceOptions(dev);
     keyFrameFreq_ = dev.framerate.numerator() * KEY_FRAME_PERIOD;
+    frameRate_ = dev.framerate ? dev.framerate.real() : 30.;
+
+    std::ostringstream key;
+    key << args.codec->systemCodecInfo.avcodecId << ' '
+        << dev.width << 'x' << dev.height << '@' << dev.framerate.real() << ' '
+        << args.codec->quality << ' ' << args.parameters;
+    groupKey_ = key.str();
+    bitrateTier_ = bitrateTier(args.codec->bitrate);
+    videoEncoder_->setPacketCallback([this](AVPacket& packet) {
+        if (encodingGroup_)
+            encodingGroup_->send(*this, packet);
+    });
+
     videoEncoder_->openOutput(dest, args);
+    keyframes_.setIntraRefresh(videoEncoder_->useIntraRefresh());
     videoEncoder_->setInitSeqVal(seqVal);
     videoEncoder_->setIOContext(muxContext_);
     videoEncoder_->startIO();
 
     videoEncoder_->print_sdp();
+
+    loop_.start();
 }
 
 VideoSender::~VideoSender()
 {
+    {
+        std::lock_guard<std::mutex> lk(groupChangeMutex_);
+        leaveGroup();
+    }
+
+    loop_.stop();
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+    }
+    cv_.notify_all();
+    loop_.join();
+
+    const auto stats = getStats();
+    RING_DBG("Video sender stopped: %llu frames encoded, %llu dropped",
+             static_cast<unsigned long long>(stats.encoded),
+             static_cast<unsigned long long>(stats.dropped));
+    RING_DBG("Video sender keyframes: %s", keyframes_.toString().c_str());
+
     videoEncoder_->flush();
 }
 
-
 void
-VideoSender::encodeAndSendVideo(VideoFrame& input_frame)
+VideoSender::process()
 {
-    bool is_keyframe = forceKeyFrame_ > 0
-        or (keyFrameFreq_ > 0 and (frameNumber_ % keyFrameFreq_) == 0);
+    std::shared_ptr<VideoFrame> frame;
+    int64_t frameNumber;
+    const void* source;
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        cv_.wait(lk, [this]{ return pending_ or loop_.isStopping(); });
+        if (not pending_)
+            return;
+        frame = std::move(pending_);
+        frameNumber = pendingNumber_;
+        source = pendingSource_;
+        encodingGroup_ = group_;
+    }
+
+    // senders of the same source at the same size scale it only once
+    frame = ScalingCache::instance().get(source, frame, videoEncoder_->getWidth(),
+                                         videoEncoder_->getHeight(),
+                                         videoEncoder_->getPixelFormat());
+    encodeAndSendVideo(*frame, frameNumber);
+    encodingGroup_.reset();
 
-    if (is_keyframe)
-        --forceKeyFrame_;
+    std::lock_guard<std::mutex> lk(mutex_);
+    ++stats_.encoded;
+}
+
+// frameNumber follows the capture time, dropped frames leave a gap in timestamps
+void
+VideoSender::encodeAndSendVideo(VideoFrame& input_frame, int64_t frameNumber)
+{
+    const bool due = keyFrameFreq_ > 0 and (frameNumber % keyFrameFreq_) == 0;
+    const bool is_keyframe = keyframes_.next(due);
 
-    if (videoEncoder_->encode(input_frame, is_keyframe, frameNumber_++) < 0)
+    // the RTP packets of the frame leave together
+    SocketPair::SendBatch batch(socketPair_);
+    if (videoEncoder_->encode(input_frame, is_keyframe, frameNumber) < 0)
         RING_ERR("encoding failed");
 
     // Send local video codec in SmartInfo
@@ -75,17 +289,101 @@ VideoSender::encodeAndSendVideo(VideoFrame& input_frame)
 }
 
 void
-VideoSender::update(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
+VideoSender::update(Observable<std::shared_ptr<VideoFrame>>* obs,
                     const std::shared_ptr<VideoFrame>& frame_p)
 {
-    encodeAndSendVideo(*frame_p);
+    // our peer lost pictures, given to the leader if we don't encode
+    for (auto n = socketPair_.getPictureLossIndications(); n; --n)
+        forceKeyFrame(KeyframeRequest::RTCP);
+
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++stats_.received;
+        // the leader encodes for the whole group
+        if (group_ and not group_->isLeader(*this))
+            return;
+        if (pending_)
+            ++stats_.dropped;
+        pending_ = frame_p;
+        pendingSource_ = obs;
+        const auto number = std::max(frameNumberNow(frameRate_), pendingNumber_ + 1);
+        pendingNumber_ = group_ ? group_->frameNumber(number) : number;
+    }
+    cv_.notify_one();
+}
+
+void
+VideoSender::attached(Observable<std::shared_ptr<VideoFrame>>* obs)
+{
+    std::lock_guard<std::mutex> lk(groupChangeMutex_);
+    source_ = obs;
+    joinGroup();
+}
+
+void
+VideoSender::joinGroup()
+{
+    using GroupKey = std::tuple<Observable<std::shared_ptr<VideoFrame>>*, std::string, unsigned>;
+    static std::mutex groupsMutex;
+    static std::map<GroupKey, std::weak_ptr<EncoderGroup>> groups;
+
+    std::shared_ptr<EncoderGroup> group;
+    {
+        std::lock_guard<std::mutex> lk(groupsMutex);
+        for (auto it = groups.begin(); it != groups.end();) {
+            if (it->second.expired())
+                it = groups.erase(it);
+            else
+                ++it;
+        }
+        auto& g = groups[GroupKey(source_, groupKey_, bitrateTier_)];
+        group = g.lock();
+        if (not group) {
+            group = std::make_shared<EncoderGroup>();
+            g = group;
+        }
+        group->join(*this);
+    }
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    group_ = std::move(group);
+}
+
+void
+VideoSender::detached(Observable<std::shared_ptr<VideoFrame>>* /*obs*/)
+{
+    std::lock_guard<std::mutex> lk(groupChangeMutex_);
+    leaveGroup();
+    source_ = nullptr;
+}
+
+void
+VideoSender::leaveGroup()
+{
+    std::shared_ptr<EncoderGroup> group;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        group = std::move(group_);
+        group_.reset();
+        pending_.reset(); // a frame of the source we leave
+    }
+    if (group)
+        group->leave(*this);
 }
 
 void
-VideoSender::forceKeyFrame()
+VideoSender::forceKeyFrame(KeyframeRequest origin)
 {
     RING_DBG("Key frame requested");
-    ++forceKeyFrame_;
+    std::shared_ptr<EncoderGroup> group;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        group = group_;
+    }
+    if (group)
+        group->forceKeyFrame(origin);
+    else
+        keyframes_.request(origin);
 }
 
 void
@@ -94,6 +392,32 @@ VideoSender::setMuted(bool isMuted)
     videoEncoder_->setMuted(isMuted);
 }
 
+bool
+VideoSender::setBitrate(unsigned bitrate)
+{
+    std::lock_guard<std::mutex> groupLock(groupChangeMutex_);
+
+    // the group encoder follows its slowest member: leave for a group of our
+    // new tier rather than slowing down the others, or being slowed down
+    if (source_ and leavesTier(bitrate, bitrateTier_)) {
+        const auto tier = bitrateTier(bitrate);
+        RING_DBG("Video sender: bitrate %u kbit/s, moving from tier %u to %u",
+                 bitrate, bitrateTier_, tier);
+        leaveGroup();
+        bitrateTier_ = tier;
+        joinGroup();
+    }
+
+    std::shared_ptr<EncoderGroup> group;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        group = group_;
+    }
+    if (group)
+        return group->setBitrate(*this, bitrate);
+    return videoEncoder_->setBitrate(bitrate);
+}
+
 uint16_t
 VideoSender::getLastSeqValue()
 {
@@ -106,4 +430,11 @@ VideoSender::useCodec(const ring::AccountVideoCodecInfo* codec) const
     return videoEncoder_->useCodec(codec);
 }
 
+VideoSenderStats
+VideoSender::getStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
+
 }} // namespace ring::video
@@ -25,11 +25,15 @@
 #include "noncopyable.h"
 #include "media_encoder.h"
 #include "media_io_handle.h"
+#include "threadloop.h"
+#include "keyframe_scheduler.h"
 
 #include <map>
 #include <string>
 #include <memory>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 // Forward declarations
 namespace ring {
@@ -39,6 +43,25 @@ struct AccountVideoCodecInfo;
 
 namespace ring { namespace video {
 
+struct VideoSenderStats {
+    uint64_t received {0};  // frames given by the source
+    uint64_t encoded {0};
+    uint64_t dropped {0};   // replaced by a newer frame before being encoded
+};
+
+/**
+ * Encodes frames of a local source (camera or mixer) for one peer.
+ *
+ * update() only queues the frame, encoding is done by a thread of the
+ * sender. The queue holds one frame: when the encoder is late the pending
+ * frame is replaced by the new one and counted as dropped, so a slow encoder
+ * never blocks the source and its other observers.
+ *
+ * Senders attached to the same source with the same codec, size, frame rate,
+ * bitrate tier and parameters form a group where only one of them encodes.
+ * The others send its packets through their own RTP muxer and socket, so
+ * each peer keeps its payload type, sequence numbers and SRTP keys.
+ */
 class VideoSender : public VideoFramePassiveReader
 {
 public:
@@ -51,33 +74,65 @@ public:
 
     ~VideoSender();
 
-    void forceKeyFrame();
+    void forceKeyFrame(KeyframeRequest origin);
 
     // as VideoFramePassiveReader
     void update(Observable<std::shared_ptr<VideoFrame>>* obs,
                 const std::shared_ptr<VideoFrame>& frame_p) override;
+    void attached(Observable<std::shared_ptr<VideoFrame>>* obs) override;
+    void detached(Observable<std::shared_ptr<VideoFrame>>* obs) override;
 
     void setMuted(bool isMuted);
     uint16_t getLastSeqValue();
 
+    /**
+     * Change the bitrate (kbit/s) without restarting.
+     * Returns false if the encoder can't, then the sender must be restarted.
+     */
+    bool setBitrate(unsigned bitrate);
+
     bool useCodec(const AccountVideoCodecInfo* codec) const;
 
+    VideoSenderStats getStats() const;
+
 private:
     static constexpr int KEYFRAMES_AT_START {4}; // Number of keyframes to enforce at stream startup
     static constexpr unsigned KEY_FRAME_PERIOD {0}; // seconds before forcing a keyframe
 
     NON_COPYABLE(VideoSender);
 
-    void encodeAndSendVideo(VideoFrame&);
+    class EncoderGroup;
+
+    void joinGroup();
+    void leaveGroup();
+    void encodeAndSendVideo(VideoFrame&, int64_t frameNumber);
+    void process();
 
     // encoder MUST be deleted before muxContext
     std::unique_ptr<MediaIOHandle> muxContext_ = nullptr;
     std::unique_ptr<MediaEncoder> videoEncoder_ = nullptr;
 
-    // XXX forceKeyFrame_ is always at -1, incremented to 0 when a keyframe is requested (still works though)
-    std::atomic<int> forceKeyFrame_ {KEYFRAMES_AT_START};
+    SocketPair& socketPair_;
+
+    KeyframeScheduler keyframes_ {KEYFRAMES_AT_START};
     int keyFrameFreq_ {0}; // Set keyframe rate, 0 to disable auto-keyframe. Computed in constructor
-    int64_t frameNumber_ = 0;
+    double frameRate_ {30.};
+
+    std::string groupKey_; // encoder parameters, to share the encoder with other senders
+    std::mutex groupChangeMutex_ {}; // serializes group changes, protects source_ and bitrateTier_
+    Observable<std::shared_ptr<VideoFrame>>* source_ {nullptr};
+    unsigned bitrateTier_ {0};
+    std::shared_ptr<EncoderGroup> encodingGroup_; // group_ when the frame being encoded was queued
+
+    mutable std::mutex mutex_ {}; // protects group_, pending_ and stats_
+    std::shared_ptr<EncoderGroup> group_;
+    std::condition_variable cv_ {};
+    std::shared_ptr<VideoFrame> pending_ {};
+    int64_t pendingNumber_ {-1};
+    const void* pendingSource_ {nullptr};
+    VideoSenderStats stats_ {};
+
+    ThreadLoop loop_; // as to be last member
 };
 }} // namespace ring::video
 
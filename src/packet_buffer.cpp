@@ -0,0 +1,223 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "packet_buffer.h"
+#include "noncopyable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ring {
+
+constexpr std::size_t PacketBuffer::CAPACITY;
+constexpr unsigned PacketBuffer::SLAB_SIZE;
+
+static constexpr std::size_t CACHE_LINE {64};
+
+struct PacketBuffer::Slot {
+    std::atomic<unsigned> refs {1};
+    std::size_t size {0};
+    bool pooled {true};
+    Slot* next {nullptr};   // in the free list
+
+    uint8_t* data();
+};
+
+// data starts on its own cache line
+static constexpr std::size_t SLOT_HEADER = (sizeof(PacketBuffer::Slot) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+static constexpr std::size_t SLOT_STRIDE = SLOT_HEADER + PacketBuffer::CAPACITY;
+
+uint8_t*
+PacketBuffer::Slot::data()
+{
+    return reinterpret_cast<uint8_t*>(this) + SLOT_HEADER;
+}
+
+class PacketPool {
+public:
+    static PacketPool& instance() {
+        static PacketPool pool;
+        return pool;
+    }
+
+    PacketBuffer::Slot* get(std::size_t len) {
+        ++packets_;
+        ++inUse_;
+        if (len > PacketBuffer::CAPACITY) {
+            ++largePackets_;
+            auto slot = new (::operator new(SLOT_HEADER + len)) PacketBuffer::Slot;
+            slot->pooled = false;
+            return slot;
+        }
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (not free_)
+            addSlab();
+        auto slot = free_;
+        free_ = slot->next;
+        slot->refs = 1;
+        return slot;
+    }
+
+    void put(PacketBuffer::Slot* slot) {
+        --inUse_;
+        if (not slot->pooled) {
+            slot->~Slot();
+            ::operator delete(slot);
+            return;
+        }
+        std::lock_guard<std::mutex> lk(mutex_);
+        slot->next = free_;
+        free_ = slot;
+    }
+
+    PacketBufferStats getStats() {
+        PacketBufferStats stats;
+        stats.packets = packets_;
+        stats.copiesOut = copiesOut_;
+        stats.largePackets = largePackets_;
+        stats.inUse = inUse_;
+        std::lock_guard<std::mutex> lk(mutex_);
+        stats.slabs = slabs_.size();
+        return stats;
+    }
+
+    std::atomic<uint64_t> copiesOut_ {0};
+
+private:
+    PacketPool() = default;
+    NON_COPYABLE(PacketPool);
+
+    // slabs are kept for the life of the process, the pool stays at its peak size
+    void addSlab() {
+        std::unique_ptr<uint8_t[]> slab(new uint8_t[PacketBuffer::SLAB_SIZE * SLOT_STRIDE + CACHE_LINE]);
+        auto p = slab.get() + (CACHE_LINE - reinterpret_cast<uintptr_t>(slab.get()) % CACHE_LINE) % CACHE_LINE;
+        for (unsigned i = 0; i < PacketBuffer::SLAB_SIZE; ++i) {
+            auto slot = new (p + i * SLOT_STRIDE) PacketBuffer::Slot;
+            slot->next = free_;
+            free_ = slot;
+        }
+        slabs_.emplace_back(std::move(slab));
+    }
+
+    std::mutex mutex_;
+    PacketBuffer::Slot* free_ {nullptr};
+    std::vector<std::unique_ptr<uint8_t[]>> slabs_;
+
+    std::atomic<uint64_t> packets_ {0};
+    std::atomic<uint64_t> largePackets_ {0};
+    std::atomic<unsigned> inUse_ {0};
+};
+
+PacketBuffer
+PacketBuffer::copyOf(const void* data, std::size_t len)
+{
+    auto slot = PacketPool::instance().get(len);
+    std::memcpy(slot->data(), data, len);
+    slot->size = len;
+    return PacketBuffer(slot);
+}
+
+PacketBuffer::PacketBuffer(const PacketBuffer& o)
+    : slot_(o.slot_)
+{
+    if (slot_)
+        slot_->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer&& o) noexcept
+    : slot_(o.slot_)
+{
+    o.slot_ = nullptr;
+}
+
+PacketBuffer&
+PacketBuffer::operator=(const PacketBuffer& o)
+{
+    if (o.slot_)
+        o.slot_->refs.fetch_add(1, std::memory_order_relaxed);
+    release();
+    slot_ = o.slot_;
+    return *this;
+}
+
+PacketBuffer&
+PacketBuffer::operator=(PacketBuffer&& o) noexcept
+{
+    if (this != &o) {
+        release();
+        slot_ = o.slot_;
+        o.slot_ = nullptr;
+    }
+    return *this;
+}
+
+PacketBuffer::~PacketBuffer()
+{
+    release();
+}
+
+void
+PacketBuffer::release()
+{
+    if (slot_ and slot_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        PacketPool::instance().put(slot_);
+    slot_ = nullptr;
+}
+
+const uint8_t*
+PacketBuffer::data() const
+{
+    return slot_ ? slot_->data() : nullptr;
+}
+
+uint8_t*
+PacketBuffer::data()
+{
+    return slot_ ? slot_->data() : nullptr;
+}
+
+std::size_t
+PacketBuffer::size() const
+{
+    return slot_ ? slot_->size : 0;
+}
+
+std::size_t
+PacketBuffer::copyTo(void* buf, std::size_t len) const
+{
+    len = std::min(len, size());
+    if (len) {
+        std::memcpy(buf, slot_->data(), len);
+        ++PacketPool::instance().copiesOut_;
+    }
+    return len;
+}
+
+PacketBufferStats
+PacketBuffer::getStats()
+{
+    return PacketPool::instance().getStats();
+}
+
+} // namespace ring
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ring {
+
+struct PacketBufferStats {
+    uint64_t packets {0};       // buffers filled
+    uint64_t copiesOut {0};     // buffers copied out with copyTo()
+    uint64_t slabs {0};         // allocations of PacketBuffer::SLAB_SIZE buffers
+    uint64_t largePackets {0};  // allocated alone, bigger than CAPACITY
+    unsigned inUse {0};
+};
+
+/**
+ * Reference counted datagram.
+ *
+ * Buffers come from slabs of a process wide pool and go back to it when
+ * their last reference is released, so a received datagram is copied once
+ * from the socket layer and then handed from thread to thread by reference.
+ */
+class PacketBuffer {
+public:
+    static constexpr std::size_t CAPACITY {2048};
+    static constexpr unsigned SLAB_SIZE {64};
+
+    PacketBuffer() = default;
+    PacketBuffer(const PacketBuffer& o);
+    PacketBuffer(PacketBuffer&& o) noexcept;
+    PacketBuffer& operator=(const PacketBuffer& o);
+    PacketBuffer& operator=(PacketBuffer&& o) noexcept;
+    ~PacketBuffer();
+
+    // New buffer holding a copy of len bytes of data
+    static PacketBuffer copyOf(const void* data, std::size_t len);
+
+    explicit operator bool() const { return slot_ != nullptr; }
+    const uint8_t* data() const;
+    uint8_t* data();
+    std::size_t size() const;
+
+    // Copy out at most len bytes, return the number copied
+    std::size_t copyTo(void* buf, std::size_t len) const;
+
+    static PacketBufferStats getStats();
+
+    struct Slot;
+
+private:
+    explicit PacketBuffer(Slot* slot) : slot_(slot) {}
+    void release();
+
+    Slot* slot_ {nullptr};
+};
+
+} // namespace ring
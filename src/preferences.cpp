@@ -117,11 +117,13 @@ static const char * const DEVICE_PLAYBACK_KEY = "devicePlayback";
 static const char * const DEVICE_RECORD_KEY = "deviceRecord";
 static const char * const DEVICE_RINGTONE_KEY = "deviceRingtone";
 static const char * const RECORDPATH_KEY = "recordPath";
+static const char * const RECORD_FORMAT_KEY = "recordFormat";
 static const char * const ALWAYS_RECORDING_KEY = "alwaysRecording";
 static const char * const VOLUMEMIC_KEY = "volumeMic";
 static const char * const VOLUMESPKR_KEY = "volumeSpkr";
 static const char * const NOISE_REDUCE_KEY = "noiseReduce";
 static const char * const AGC_KEY = "automaticGainControl";
+static const char * const ECHO_CANCEL_KEY = "echoCancel";
 static const char * const CAPTURE_MUTED_KEY = "captureMuted";
 static const char * const PLAYBACK_MUTED_KEY = "playbackMuted";
 
@@ -137,6 +139,8 @@ static const char * const TOGGLE_PICKUP_HANGUP_SHORT_KEY = "togglePickupHangup";
 // video preferences
 constexpr const char * const VideoPreferences::CONFIG_LABEL;
 static const char * const DECODING_ACCELERATED_KEY = "decodingAccelerated";
+static const char * const ENCODING_ACCELERATED_KEY = "encodingAccelerated";
+static const char * const INTRA_REFRESH_KEY = "intraRefresh";
 #endif
 
 static const char * const DFT_PULSE_LENGTH_STR = "250"; /** Default DTMF lenght */
@@ -321,11 +325,13 @@ AudioPreference::AudioPreference() :
     , pulseDeviceRecord_("")
     , pulseDeviceRingtone_("")
     , recordpath_("")
+    , recordFormat_("wav")
     , alwaysRecording_(false)
     , volumemic_(1.0)
     , volumespkr_(1.0)
     , denoise_(false)
     , agcEnabled_(false)
+    , echoCancel_(false)
     , captureMuted_(false)
     , playbackMuted_(false)
 {}
@@ -438,6 +444,7 @@ void AudioPreference::serialize(YAML::Emitter &out)
     out << YAML::Key << AUDIO_API_KEY << YAML::Value << audioApi_;
     out << YAML::Key << AGC_KEY << YAML::Value << agcEnabled_;
     out << YAML::Key << CAPTURE_MUTED_KEY << YAML::Value << captureMuted_;
+    out << YAML::Key << ECHO_CANCEL_KEY << YAML::Value << echoCancel_;
     out << YAML::Key << NOISE_REDUCE_KEY << YAML::Value << denoise_;
     out << YAML::Key << PLAYBACK_MUTED_KEY << YAML::Value << playbackMuted_;
 
@@ -450,6 +457,7 @@ void AudioPreference::serialize(YAML::Emitter &out)
 
     // more common options!
     out << YAML::Key << RECORDPATH_KEY << YAML::Value << recordpath_;
+    out << YAML::Key << RECORD_FORMAT_KEY << YAML::Value << recordFormat_;
     out << YAML::Key << VOLUMEMIC_KEY << YAML::Value << volumemic_;
     out << YAML::Key << VOLUMESPKR_KEY << YAML::Value << volumespkr_;
 
@@ -487,6 +495,7 @@ void AudioPreference::unserialize(const YAML::Node &in)
     parseValue(node, AUDIO_API_KEY, audioApi_);
     parseValue(node, AGC_KEY, agcEnabled_);
     parseValue(node, CAPTURE_MUTED_KEY, captureMuted_);
+    parseValue(node, ECHO_CANCEL_KEY, echoCancel_);
     parseValue(node, NOISE_REDUCE_KEY, denoise_);
     parseValue(node, PLAYBACK_MUTED_KEY, playbackMuted_);
 
@@ -498,6 +507,7 @@ void AudioPreference::unserialize(const YAML::Node &in)
 
     // more common options!
     parseValue(node, RECORDPATH_KEY, recordpath_);
+    parseValue(node, RECORD_FORMAT_KEY, recordFormat_);
     parseValue(node, VOLUMEMIC_KEY, volumemic_);
     parseValue(node, VOLUMESPKR_KEY, volumespkr_);
 }
@@ -553,6 +563,8 @@ void ShortcutPreferences::unserialize(const YAML::Node &in)
 #ifdef RING_VIDEO
 VideoPreferences::VideoPreferences()
     : decodingAccelerated_(true)
+    , encodingAccelerated_(true)
+    , intraRefresh_(false)
 {
 }
 
@@ -561,7 +573,9 @@ void VideoPreferences::serialize(YAML::Emitter &out)
     out << YAML::Key << CONFIG_LABEL << YAML::Value << YAML::BeginMap;
 #ifdef RING_ACCEL
     out << YAML::Key << DECODING_ACCELERATED_KEY << YAML::Value << decodingAccelerated_;
+    out << YAML::Key << ENCODING_ACCELERATED_KEY << YAML::Value << encodingAccelerated_;
 #endif
+    out << YAML::Key << INTRA_REFRESH_KEY << YAML::Value << intraRefresh_;
     getVideoDeviceMonitor().serialize(out);
     out << YAML::EndMap;
 }
@@ -574,7 +588,13 @@ void VideoPreferences::unserialize(const YAML::Node &in)
     try {
         parseValue(node, DECODING_ACCELERATED_KEY, decodingAccelerated_);
     } catch (...) { decodingAccelerated_ = true; }
+    try {
+        parseValue(node, ENCODING_ACCELERATED_KEY, encodingAccelerated_);
+    } catch (...) { encodingAccelerated_ = true; }
 #endif
+    try {
+        parseValue(node, INTRA_REFRESH_KEY, intraRefresh_);
+    } catch (...) { intraRefresh_ = false; }
     getVideoDeviceMonitor().unserialize(in);
 }
 #endif // RING_VIDEO
@@ -299,6 +299,15 @@ class AudioPreference : public Serializable {
         // Returns true if directory is writeable
         bool setRecordPath(const std::string &r);
 
+        // "wav", "flac" or "ogg"
+        std::string getRecordFormat() const {
+            return recordFormat_;
+        }
+
+        void setRecordFormat(const std::string &f) {
+            recordFormat_ = f;
+        }
+
         bool getIsAlwaysRecording() const {
             return alwaysRecording_;
         }
@@ -337,6 +346,14 @@ class AudioPreference : public Serializable {
             denoise_ = enabled;
         }
 
+        bool getEchoCancel() const {
+            return echoCancel_;
+        }
+
+        void setEchoCancel(bool enabled) {
+            echoCancel_ = enabled;
+        }
+
         bool getCaptureMuted() const {
             return captureMuted_;
         }
@@ -370,12 +387,14 @@ class AudioPreference : public Serializable {
 
         // general preference
         std::string recordpath_; //: /home/msavard/Bureau
+        std::string recordFormat_;
         bool alwaysRecording_;
         double volumemic_;
         double volumespkr_;
 
         bool denoise_;
         bool agcEnabled_;
+        bool echoCancel_;
         bool captureMuted_;
         bool playbackMuted_;
         constexpr static const char * const CONFIG_LABEL = "audio";
@@ -455,8 +474,26 @@ class VideoPreferences : public Serializable {
             decodingAccelerated_ = decodingAccelerated;
         }
 
+        bool getEncodingAccelerated() const {
+            return encodingAccelerated_;
+        }
+
+        void setEncodingAccelerated(bool encodingAccelerated) {
+            encodingAccelerated_ = encodingAccelerated;
+        }
+
+        bool getIntraRefresh() const {
+            return intraRefresh_;
+        }
+
+        void setIntraRefresh(bool intraRefresh) {
+            intraRefresh_ = intraRefresh;
+        }
+
     private:
         bool decodingAccelerated_;
+        bool encodingAccelerated_;
+        bool intraRefresh_;
         constexpr static const char* const CONFIG_LABEL = "video";
 };
 #endif // RING_VIDEO
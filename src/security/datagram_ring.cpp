@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "datagram_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ring { namespace tls {
+
+DatagramRing::DatagramRing(std::size_t capacity, std::size_t maxSize)
+    : maxSize_(maxSize)
+    , data_(new uint8_t[std::max<std::size_t>(capacity, 1) * maxSize])
+    , lengths_(std::max<std::size_t>(capacity, 1), 0)
+{}
+
+bool
+DatagramRing::push(const uint8_t* data, std::size_t len)
+{
+    if (full() or len > maxSize_)
+        return false;
+    const auto slot = (head_ + count_) % capacity();
+    std::memcpy(data_.get() + slot * maxSize_, data, len);
+    lengths_[slot] = len;
+    ++count_;
+    return true;
+}
+
+const uint8_t*
+DatagramRing::frontData() const
+{
+    return data_.get() + head_ * maxSize_;
+}
+
+std::size_t
+DatagramRing::pop(void* buf, std::size_t len)
+{
+    len = std::min(len, frontSize());
+    std::memcpy(buf, frontData(), len);
+    pop();
+    return len;
+}
+
+void
+DatagramRing::pop()
+{
+    if (empty())
+        return;
+    head_ = (head_ + 1) % capacity();
+    --count_;
+}
+
+}} // namespace ring::tls
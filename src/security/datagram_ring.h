@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ring { namespace tls {
+
+/**
+ * FIFO of datagrams in preallocated slots of maxSize bytes.
+ *
+ * All the memory is allocated by the constructor: capacity * maxSize bytes
+ * for the data, the queue never allocates afterwards.
+ *
+ * \note Not thread-safe.
+ */
+class DatagramRing {
+public:
+    DatagramRing(std::size_t capacity, std::size_t maxSize);
+
+    std::size_t capacity() const { return lengths_.size(); }
+    std::size_t maxSize() const { return maxSize_; }
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == capacity(); }
+
+    // Copy a datagram at the back, false if full or bigger than maxSize
+    bool push(const uint8_t* data, std::size_t len);
+
+    // Oldest datagram, the queue must not be empty
+    const uint8_t* frontData() const;
+    std::size_t frontSize() const { return lengths_[head_]; }
+
+    // Copy out the oldest datagram, truncated to len bytes, and remove it.
+    // Return the number of bytes copied.
+    std::size_t pop(void* buf, std::size_t len);
+    void pop();
+
+private:
+    NON_COPYABLE(DatagramRing);
+
+    const std::size_t maxSize_;
+    std::unique_ptr<uint8_t[]> data_;
+    std::vector<std::size_t> lengths_;
+    std::size_t head_ {0};
+    std::size_t count_ {0};
+};
+
+}} // namespace ring::tls
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "reorder_window.h"
+
+#include <algorithm>
+
+namespace ring { namespace tls {
+
+ReorderWindow::ReorderWindow(std::size_t size, clock::duration timeout)
+    : timeout_(timeout)
+    , window_(std::max<std::size_t>(size, 1))
+{}
+
+void
+ReorderWindow::reset(uint64_t seq)
+{
+    for (auto& record : window_)
+        record.clear();
+    count_ = 0;
+    ready_.clear();
+    gapOffset_ = seq;
+}
+
+bool
+ReorderWindow::push(uint64_t seq, Record&& record, clock::time_point now)
+{
+    if (seq < gapOffset_)
+        return false;
+
+    // window full: waited records are lost
+    const auto size = window_.size();
+    if (seq - gapOffset_ >= size)
+        skipGap(seq - size + 1);
+
+    auto& item = window_[seq % size];
+    if (not item.empty())
+        return false;
+    if (empty())
+        lastRead_ = now;
+    item = std::move(record);
+    ++count_;
+    return true;
+}
+
+bool
+ReorderWindow::pop(Record& record, clock::time_point now)
+{
+    if (not ready_.empty()) {
+        record = std::move(ready_.front());
+        ready_.pop_front();
+        lastRead_ = now;
+        return true;
+    }
+    if (count_ == 0)
+        return false;
+
+    const auto size = window_.size();
+    if (window_[gapOffset_ % size].empty()) {
+        // wait for the next record until timeout, then consider it lost
+        if (now - lastRead_ < timeout_)
+            return false;
+        auto next = gapOffset_;
+        while (window_[next % size].empty())
+            ++next;
+        skipGap(next);
+    }
+
+    auto& item = window_[gapOffset_ % size];
+    record = std::move(item);
+    item.clear();
+    --count_;
+    ++gapOffset_;
+    lastRead_ = now;
+    return true;
+}
+
+// Move the received records before seq to the ready queue, in order, and
+// count the missing ones as lost
+void
+ReorderWindow::skipGap(uint64_t seq)
+{
+    const auto size = window_.size();
+
+    // received records are all in the window, the rest of the gap is lost
+    for (; gapOffset_ < seq and count_; ++gapOffset_) {
+        auto& item = window_[gapOffset_ % size];
+        if (item.empty()) {
+            ++lost_;
+            continue;
+        }
+        ready_.emplace_back(std::move(item));
+        item.clear();
+        --count_;
+    }
+    if (gapOffset_ < seq) {
+        lost_ += seq - gapOffset_;
+        gapOffset_ = seq;
+    }
+}
+
+}} // namespace ring::tls
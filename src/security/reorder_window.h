@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace ring { namespace tls {
+
+/**
+ * Reordering of the records of an unreliable transport, by sequence number.
+ *
+ * Records are held in a window of size slots starting at the first missing
+ * one. A record beyond the window pushes the oldest ones out, in order, and
+ * counts the missing ones among them as lost. Missing records are also given
+ * up on when nothing was delivered for timeout.
+ *
+ * Times are given by the caller.
+ *
+ * \note Not thread-safe.
+ */
+class ReorderWindow {
+public:
+    using clock = std::chrono::steady_clock;
+    using Record = std::vector<uint8_t>;
+
+    ReorderWindow(std::size_t size, clock::duration timeout);
+
+    // Start over, expecting seq first
+    void reset(uint64_t seq);
+
+    // Hold a received record. False if it is a duplicate or was given up on.
+    bool push(uint64_t seq, Record&& record, clock::time_point now);
+
+    // Next record in order, if there is one or the missing ones timed out
+    bool pop(Record& record, clock::time_point now);
+
+    bool empty() const { return count_ == 0 and ready_.empty(); }
+
+    // Sequence number of the first record not delivered nor given up on
+    uint64_t next() const { return gapOffset_; }
+
+    // Records given up on
+    uint64_t lost() const { return lost_; }
+
+private:
+    NON_COPYABLE(ReorderWindow);
+
+    void skipGap(uint64_t seq);
+
+    const clock::duration timeout_;
+    std::vector<Record> window_; ///< records from gapOffset_, indexed by seq modulo its size
+    std::size_t count_ {0}; ///< records in window_
+    std::deque<Record> ready_ {}; ///< in order records pushed out of a full window
+    uint64_t gapOffset_ {0};
+    uint64_t lost_ {0};
+    clock::time_point lastRead_ {};
+};
+
+}} // namespace ring::tls
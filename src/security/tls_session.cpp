@@ -23,6 +23,8 @@
 
 #include "tls_session.h"
 
+#include "datagram_ring.h"
+#include "reorder_window.h"
 #include "threadloop.h"
 #include "logger.h"
 #include "noncopyable.h"
@@ -36,7 +38,6 @@
 #include <gnutls/dtls.h>
 #include <gnutls/abstract.h>
 
-#include <list>
 #include <mutex>
 #include <condition_variable>
 #include <utility>
@@ -57,7 +58,6 @@ static constexpr const char* DTLS_FULL_PRIORITY_STRING {"SECURE192:-KX-ALL:+ANON
 static constexpr const char* TLS_CERT_PRIORITY_STRING {"SECURE192:-RSA:%SERVER_PRECEDENCE:%SAFE_RENEGOTIATION"};
 static constexpr const char* TLS_FULL_PRIORITY_STRING {"SECURE192:-KX-ALL:+ANON-ECDH:+ANON-DH:+SECURE192:-RSA:%SERVER_PRECEDENCE:%SAFE_RENEGOTIATION"};
 static constexpr uint16_t INPUT_BUFFER_SIZE {16*1024}; // to be coherent with the maximum size advised in path mtu discovery
-static constexpr std::size_t INPUT_MAX_SIZE {1000}; // Maximum number of packets to store before dropping (pkt size = DTLS_MTU)
 static constexpr ssize_t FLOOD_THRESHOLD {4*1024};
 static constexpr auto FLOOD_PAUSE = std::chrono::milliseconds(100); // Time to wait after an invalid cookie packet (anti flood attack)
 static constexpr size_t HANDSHAKE_MAX_RETRY {64};
@@ -200,16 +200,14 @@ public:
     // IO GnuTLS <-> ICE
     std::mutex rxMutex_ {};
     std::condition_variable rxCv_ {};
-    std::list<std::vector<ValueType>> rxQueue_ {};
+    DatagramRing rxQueue_; // ctor init.
 
     std::mutex reorderBufMutex_;
     bool flushProcessing_ {false}; ///< protect against recursive call to flushRxQueue
     std::vector<ValueType> rawPktBuf_; ///< gnutls incoming packet buffer
     uint64_t baseSeq_ {0}; ///< sequence number of first application data packet received
     uint64_t lastRxSeq_ {0}; ///< last received and valid packet sequence number
-    uint64_t gapOffset_ {0}; ///< offset of first byte not received yet
-    clock::time_point lastReadTime_;
-    std::map<uint64_t, std::vector<ValueType>> reorderBuffer_ {};
+    ReorderWindow rxReorder_; ///< protected by reorderBufMutex_ (ctor init.)
 
     std::size_t send(const ValueType*, std::size_t, std::error_code&);
     ssize_t sendRaw(const void*, size_t);
@@ -219,12 +217,14 @@ public:
 
     bool initFromRecordState(int offset=0);
     void handleDataPacket(std::vector<ValueType>&&, uint64_t);
+    void updateRxLostCount();
     void flushRxQueue();
 
     // Statistics
     std::atomic<std::size_t> stRxRawPacketCnt_ {0};
     std::atomic<std::size_t> stRxRawBytesCnt_ {0};
     std::atomic<std::size_t> stRxRawPacketDropCnt_ {0};
+    std::atomic<std::size_t> stRxPacketLostCnt_ {0};
     std::atomic<std::size_t> stTxRawPacketCnt_ {0};
     std::atomic<std::size_t> stTxRawBytesCnt_ {0};
     void dump_io_stats() const;
@@ -266,6 +266,9 @@ TlsSession::TlsSessionImpl::TlsSessionImpl(SocketType& transport,
     , callbacks_(cbs)
     , anonymous_(anonymous)
     , transport_ { transport }
+    , rxQueue_(transport.isReliable() ? 0 : params.rx_queue_size,
+               transport.isReliable() ? 0 : params.rx_datagram_size)
+    , rxReorder_(params.rx_reorder_window, RX_OOO_TIMEOUT)
     , cacred_(nullptr)
     , sacred_(nullptr)
     , xcred_(nullptr)
@@ -276,11 +279,18 @@ TlsSession::TlsSessionImpl::TlsSessionImpl(SocketType& transport,
     if (not transport_.isReliable()) {
         transport_.setOnRecv([this](const ValueType* buf, size_t len) {
                 std::lock_guard<std::mutex> lk {rxMutex_};
-                if (rxQueue_.size() == INPUT_MAX_SIZE) {
-                    rxQueue_.pop_front(); // drop oldest packet if input buffer is full
+                if (len > rxQueue_.maxSize()) {
+                    RING_WARN("[TLS] drop %zu bytes datagram (max %zu)", len, rxQueue_.maxSize());
                     ++stRxRawPacketDropCnt_;
+                    return len;
                 }
-                rxQueue_.emplace_back(buf, buf+len);
+                if (rxQueue_.full()) {
+                    rxQueue_.pop(); // drop oldest packet if input buffer is full
+                    if (++stRxRawPacketDropCnt_ % 100 == 1)
+                        RING_WARN("[TLS] rx queue full (%zu packets), %zu dropped",
+                                  rxQueue_.capacity(), stRxRawPacketDropCnt_.load());
+                }
+                rxQueue_.push(buf, len);
                 ++stRxRawPacketCnt_;
                 stRxRawBytesCnt_ += len;
                 rxCv_.notify_one();
@@ -311,8 +321,9 @@ TlsSession::TlsSessionImpl::typeName() const
 void
 TlsSession::TlsSessionImpl::dump_io_stats() const
 {
-    RING_DBG("[TLS] RxRawPkt=%zu (%zu bytes) - TxRawPkt=%zu (%zu bytes)",
+    RING_DBG("[TLS] RxRawPkt=%zu (%zu bytes, %zu dropped, %zu lost) - TxRawPkt=%zu (%zu bytes)",
              stRxRawPacketCnt_.load(), stRxRawBytesCnt_.load(),
+             stRxRawPacketDropCnt_.load(), stRxPacketLostCnt_.load(),
              stTxRawPacketCnt_.load(), stTxRawBytesCnt_.load());
 }
 
@@ -644,11 +655,7 @@ TlsSession::TlsSessionImpl::recvRaw(void* buf, size_t size)
         return -1;
     }
 
-    const auto& pkt = rxQueue_.front();
-    const std::size_t count = std::min(pkt.size(), size);
-    std::copy_n(pkt.begin(), count, reinterpret_cast<ValueType*>(buf));
-    rxQueue_.pop_front();
-    return count;
+    return rxQueue_.pop(buf, size);
 }
 
 // Called by GNUTLS to wait for encrypted packet from low-level transport.
@@ -694,7 +701,10 @@ TlsSession::TlsSessionImpl::initFromRecordState(int offset)
     }
 
     baseSeq_ = array2uint(seq) + offset;
-    gapOffset_ = baseSeq_;
+    {
+        std::lock_guard<std::mutex> lk {reorderBufMutex_};
+        rxReorder_.reset(baseSeq_);
+    }
     lastRxSeq_ = baseSeq_ - 1;
     RING_DBG("[TLS] Initial sequence number: %lx", baseSeq_);
     return true;
@@ -775,7 +785,7 @@ TlsSession::TlsSessionImpl::handleStateCookie(TlsSessionState state)
         // Shutdown state?
         if (rxQueue_.empty())
             return TlsSessionState::SHUTDOWN;
-        count = rxQueue_.front().size();
+        count = rxQueue_.frontSize();
     }
 
     // Total bytes rx during cookie checking (see flood protection below)
@@ -786,10 +796,10 @@ TlsSession::TlsSessionImpl::handleStateCookie(TlsSessionState state)
     // Peek and verify front packet
     {
         std::lock_guard<std::mutex> lk {rxMutex_};
-        auto& pkt = rxQueue_.front();
         std::memset(&prestate_, 0, sizeof(prestate_));
         ret = gnutls_dtls_cookie_verify(&cookie_key_, nullptr, 0,
-                                        pkt.data(), pkt.size(), &prestate_);
+                                        const_cast<uint8_t*>(rxQueue_.frontData()),
+                                        rxQueue_.frontSize(), &prestate_);
     }
 
     if (ret < 0) {
@@ -804,7 +814,7 @@ TlsSession::TlsSessionImpl::handleStateCookie(TlsSessionState state)
         // Drop front packet
         {
             std::lock_guard<std::mutex> lk {rxMutex_};
-            rxQueue_.pop_front();
+            rxQueue_.pop();
         }
 
         // Cookie may be sent on multiple network packets
@@ -1025,15 +1035,35 @@ TlsSession::TlsSessionImpl::handleDataPacket(std::vector<ValueType>&& buf, uint6
 
     {
         std::lock_guard<std::mutex> lk {reorderBufMutex_};
-        if (reorderBuffer_.empty())
-            lastReadTime_ = clock::now();
-        reorderBuffer_.emplace(pkt_seq, std::move(buf));
+        const bool held = rxReorder_.push(pkt_seq, std::move(buf), clock::now());
+        updateRxLostCount();
+        if (not held) {
+            RING_WARN("[TLS] drop late pkt: 0x%lx", pkt_seq);
+            return;
+        }
     }
 
     // Try to flush right now as a new packet is available
     flushRxQueue();
 }
 
+///
+/// Report the packets the reorder window gave up on
+///
+/// \note Called with reorderBufMutex_ locked
+///
+void
+TlsSession::TlsSessionImpl::updateRxLostCount()
+{
+    const auto lost = rxReorder_.lost();
+    const std::size_t previous = stRxPacketLostCnt_;
+    if (lost != previous) {
+        RING_WARN("[TLS] %lu lost before 0x%lx", (unsigned long)(lost - previous),
+                  (unsigned long)rxReorder_.next());
+        stRxPacketLostCnt_ = lost;
+    }
+}
+
 ///
 /// Reorder and push received packet to upper layer
 ///
@@ -1052,7 +1082,7 @@ TlsSession::TlsSessionImpl::flushRxQueue()
     };
 
     std::unique_lock<std::mutex> lk {reorderBufMutex_};
-    if (reorderBuffer_.empty())
+    if (rxReorder_.empty())
         return;
 
     // Prevent re-entrant access as the callbacks_.onRxData() is called in unprotected region
@@ -1061,37 +1091,17 @@ TlsSession::TlsSessionImpl::flushRxQueue()
 
     GuardedBoolSwap swap_flush_processing {flushProcessing_};
 
-    auto item = std::begin(reorderBuffer_);
-    auto next_offset = item->first;
-
-    // Wait for next continous packet until timeout
-    if ((clock::now() - lastReadTime_) >= RX_OOO_TIMEOUT) {
-        // OOO packet timeout - consider waited packets as lost
-        if (auto lost = next_offset - gapOffset_)
-            RING_WARN("[TLS] %lu lost since 0x%lx", lost, gapOffset_);
-        else
-            RING_WARN("[TLS] slow flush");
-    } else if (next_offset != gapOffset_)
-        return;
-
-    // Loop on offset-ordered received packet until a discontinuity in sequence number
-    while (item != std::end(reorderBuffer_) and item->first <= next_offset) {
-        auto pkt_offset = item->first;
-        auto pkt = std::move(item->second);
-
-        // Remove item before unlocking to not trash the item' relationship
-        next_offset = pkt_offset + 1;
-        item = reorderBuffer_.erase(item);
-
+    // In order packets, until a discontinuity in sequence number that
+    // hasn't timed out yet
+    std::vector<ValueType> pkt;
+    while (rxReorder_.pop(pkt, clock::now())) {
+        updateRxLostCount();
         if (callbacks_.onRxData) {
             lk.unlock();
             callbacks_.onRxData(std::move(pkt));
             lk.lock();
         }
     }
-
-    gapOffset_ = std::max(gapOffset_, next_offset);
-    lastReadTime_ = clock::now();
 }
 
 TlsSessionState
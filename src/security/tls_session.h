@@ -74,6 +74,13 @@ struct TlsParams
     std::function<int(unsigned status,
                       const gnutls_datum_t* cert_list,
                       unsigned cert_list_size)> cert_check;
+
+    // Receive memory bounds of non-reliable transports (DTLS):
+    // datagrams queued before decryption, in slots of rx_datagram_size bytes,
+    // and out-of-order records held for reordering
+    std::size_t rx_queue_size {1000};
+    std::size_t rx_datagram_size {1536};
+    std::size_t rx_reorder_window {256};
 };
 
 /// TlsSession
@@ -59,6 +59,8 @@ SdesNegotiator::parse(const std::vector<std::string>& attributes)
             "(?P<cryptoSuite>AES_CM_128_HMAC_SHA1_80|" \
             "AES_CM_128_HMAC_SHA1_32|" \
             "F8_128_HMAC_SHA1_80|" \
+            "AEAD_AES_128_GCM|" \
+            "AEAD_AES_256_GCM|" \
             "[A-Za-z0-9_]+)", false)); // srtp-crypto-suite-ext
 
         keyParamsPattern.reset(new Pattern(
@@ -43,11 +43,13 @@ class ParseError : public std::invalid_argument {
 
 enum CipherMode {
     AESCounterMode,
-    AESF8Mode
+    AESF8Mode,
+    AESGCMMode
 };
 
 enum MACMode {
-    HMACSHA1
+    HMACSHA1,
+    AEAD // authenticated by the cipher (RFC 7714)
 };
 
 enum KeyMethod {
@@ -72,10 +74,17 @@ struct CryptoSuiteDefinition {
 
 /**
 * List of accepted Crypto-Suites
-* as defined in RFC4568 (6.2)
+* as defined in RFC4568 (6.2) and RFC7714 (14.2),
+* in order of preference
 */
 
 static std::vector<CryptoSuiteDefinition> CryptoSuites = {
+    { "AEAD_AES_128_GCM",
+      128, 96, 48, 31, AESGCMMode, 128, AEAD, 128, 128, 0, 0 },
+
+    { "AEAD_AES_256_GCM",
+      256, 96, 48, 31, AESGCMMode, 256, AEAD, 128, 128, 0, 0 },
+
     { "AES_CM_128_HMAC_SHA1_80",
       128, 112, 48, 31, AESCounterMode, 128, HMACSHA1, 80, 80, 160, 160 },
 
@@ -46,6 +46,7 @@ using random_device = dht::crypto::random_device;
 
 #include <algorithm>
 #include <cassert>
+#include <sstream>
 
 namespace ring {
 
@@ -145,25 +146,73 @@ Sdp::setActiveRemoteSdpSession(const pjmedia_sdp_session *sdp)
     activeRemoteSession_ = sdp;
 }
 
+// Crypto suites we offer, in order of preference. AES_CM_128_HMAC_SHA1_80
+// is kept for peers without the AEAD suites.
+static const char* const SDES_OFFERED_SUITES[] = {
+    "AEAD_AES_128_GCM",
+    "AES_CM_128_HMAC_SHA1_80"
+};
+
+static const CryptoSuiteDefinition*
+findCryptoSuite(const std::string& name)
+{
+    for (const auto& suite : ring::CryptoSuites)
+        if (name == suite.name)
+            return &suite;
+    return nullptr;
+}
+
+static std::vector<std::string>
+getCryptoAttributes(const pjmedia_sdp_media* media)
+{
+    std::vector<std::string> crypto;
+    for (unsigned j = 0; j < media->attr_count; j++) {
+        const auto attribute = media->attr[j];
+        if (pj_stricmp2(&attribute->name, "crypto") == 0)
+            crypto.emplace_back(attribute->value.ptr, attribute->value.slen);
+    }
+    return crypto;
+}
+
 pjmedia_sdp_attr *
-Sdp::generateSdesAttribute()
+Sdp::generateSdesAttribute(unsigned tag, const CryptoSuiteDefinition& cryptoSuite)
 {
-    static constexpr const unsigned cryptoSuite = 0;
     std::vector<uint8_t> keyAndSalt;
-    keyAndSalt.resize(ring::CryptoSuites[cryptoSuite].masterKeyLength / 8
-                    + ring::CryptoSuites[cryptoSuite].masterSaltLength/ 8);
+    keyAndSalt.resize(cryptoSuite.masterKeyLength / 8
+                    + cryptoSuite.masterSaltLength / 8);
     // generate keys
     randomFill(keyAndSalt);
 
-    std::string tag = "1";
-    std::string crypto_attr = tag + " "
-                            + ring::CryptoSuites[cryptoSuite].name
+    std::string crypto_attr = ring::to_string(tag) + " "
+                            + cryptoSuite.name
                             + " inline:" + base64::encode(keyAndSalt);
     pj_str_t val { (char*) crypto_attr.c_str(),
                     static_cast<pj_ssize_t>(crypto_attr.size()) };
     return pjmedia_sdp_attr_create(memPool_.get(), "crypto", &val);
 }
 
+// An answer has a single crypto attribute, with the tag of the offered one
+// it accepts (RFC 4568 section 5.1.2)
+void
+Sdp::setSdesAnswer(const pjmedia_sdp_session* offer)
+{
+    const auto count = std::min(localSession_->media_count, offer->media_count);
+    for (unsigned i = 0; i < count; ++i) {
+        auto media = localSession_->media[i];
+        pjmedia_sdp_media_remove_all_attr(media, "crypto");
+
+        const auto crypto = sdesNego_.negotiate(getCryptoAttributes(offer->media[i]));
+        if (not crypto)
+            continue;
+        const auto suite = findCryptoSuite(crypto.getCryptoSuite());
+        if (not suite)
+            continue;
+        const auto tag = std::stoul(crypto.getTag());
+        if (pjmedia_sdp_media_add_attr(media, generateSdesAttribute(tag, *suite)) != PJ_SUCCESS)
+            throw SdpException("Could not add sdes attribute to media");
+    }
+}
+
 pjmedia_sdp_media *
 Sdp::setMediaDescriptorLines(bool audio, bool holding, sip_utils::KeyExchangeProtocol kx)
 {
@@ -240,24 +289,46 @@ Sdp::setMediaDescriptorLines(bool audio, bool holding, sip_utils::KeyExchangePro
             med->attr[med->attr_count++] = pjmedia_sdp_attr_create(memPool_.get(), os.str().c_str(), NULL);
         }
 #endif
+        if (audio and enc_name == "opus") {
+            // gaps of discontinuous transmission are concealed (RFC 7587 section 6.1)
+            std::ostringstream os;
+            os << "fmtp:" << payload << " usedtx=1";
+            med->attr[med->attr_count++] = pjmedia_sdp_attr_create(memPool_.get(), os.str().c_str(), NULL);
+        }
     }
 
     if (audio) {
         setTelephoneEventRtpmap(med);
         addRTCPAttribute(med); // video has its own RTCP
+    } else {
+        addRTCPFeedbackAttributes(med);
     }
 
     med->attr[med->attr_count++] = pjmedia_sdp_attr_create(memPool_.get(), holding ? (audio ? "sendonly" : "inactive") : "sendrecv", NULL);
 
+    // offered suites, an answer keeps only one (see setSdesAnswer)
     if (kx == sip_utils::KeyExchangeProtocol::SDES) {
-        if (pjmedia_sdp_media_add_attr(med, generateSdesAttribute()) != PJ_SUCCESS)
-            SdpException("Could not add sdes attribute to media");
+        unsigned tag = 0;
+        for (const auto name : SDES_OFFERED_SUITES) {
+            const auto suite = findCryptoSuite(name);
+            if (pjmedia_sdp_media_add_attr(med, generateSdesAttribute(++tag, *suite)) != PJ_SUCCESS)
+                throw SdpException("Could not add sdes attribute to media");
+        }
     }
 
     return med;
 }
 
 
+// Keyframe requests we answer (RFC 4585, RFC 5104)
+void Sdp::addRTCPFeedbackAttributes(pjmedia_sdp_media *med)
+{
+    for (const auto feedback : {"* nack pli", "* ccm fir"}) {
+        pj_str_t val = pj_str((char*) feedback);
+        med->attr[med->attr_count++] = pjmedia_sdp_attr_create(memPool_.get(), "rtcp-fb", &val);
+    }
+}
+
 void Sdp::addRTCPAttribute(pjmedia_sdp_media *med)
 {
     IpAddr outputAddr = publishedIpAddr_;
@@ -444,6 +515,9 @@ void Sdp::receiveOffer(const pjmedia_sdp_session* remote,
 
     remoteSession_ = pjmedia_sdp_session_clone(memPool_.get(), remote);
 
+    if (kx == sip_utils::KeyExchangeProtocol::SDES)
+        setSdesAnswer(remoteSession_);
+
     if (pjmedia_sdp_neg_create_w_remote_offer(memPool_.get(), localSession_,
             remoteSession_, &negotiator_) != PJ_SUCCESS)
         RING_ERR("Failed to initialize negotiator");
@@ -616,30 +690,36 @@ Sdp::getMediaSlots(const pjmedia_sdp_session* session, bool remote) const
                 continue;
             }
             descr.payload_type = pj_strtoul(&rtpmap.pt);
-            if (descr.type == MEDIA_VIDEO) {
-                const auto fmtpAttr = pjmedia_sdp_media_find_attr(media, &STR_FMTP, &media->desc.fmt[j]);
-                //descr.bitrate = getOutgoingVideoField(codec, "bitrate");
-                if (fmtpAttr && fmtpAttr->value.ptr && fmtpAttr->value.slen) {
-                    const auto& v = fmtpAttr->value;
-                    descr.parameters = std::string(v.ptr, v.ptr + v.slen);
-                }
+            const auto fmtpAttr = pjmedia_sdp_media_find_attr(media, &STR_FMTP, &media->desc.fmt[j]);
+            //descr.bitrate = getOutgoingVideoField(codec, "bitrate");
+            if (fmtpAttr && fmtpAttr->value.ptr && fmtpAttr->value.slen) {
+                const auto& v = fmtpAttr->value;
+                descr.parameters = std::string(v.ptr, v.ptr + v.slen);
             }
             // for now, just keep the first codec only
             descr.enabled = true;
             break;
         }
 
+        if (descr.type == MEDIA_VIDEO) {
+            const auto payload = ring::to_string(descr.payload_type);
+            for (unsigned j = 0; j < media->attr_count; j++) {
+                const auto attribute = media->attr[j];
+                if (pj_stricmp2(&attribute->name, "rtcp-fb") != 0)
+                    continue;
+                std::istringstream feedback(std::string(attribute->value.ptr, attribute->value.slen));
+                std::string pt, type, param;
+                feedback >> pt >> type >> param;
+                if ((pt == "*" or pt == payload) and type == "nack" and param == "pli")
+                    descr.rtcpPli = true;
+            }
+        }
+
         if (not remote)
             descr.receiving_sdp = getFilteredSdp(session, i, descr.payload_type);
 
         // get crypto info
-        std::vector<std::string> crypto;
-        for (unsigned j = 0; j < media->attr_count; j++) {
-            const auto attribute = media->attr[j];
-            if (pj_stricmp2(&attribute->name, "crypto") == 0)
-                crypto.emplace_back(attribute->value.ptr, attribute->value.slen);
-        }
-        descr.crypto = sdesNego_.negotiate(crypto);
+        descr.crypto = sdesNego_.negotiate(getCryptoAttributes(media));
     }
     return ret;
 }
@@ -652,8 +732,17 @@ Sdp::getMediaSlots() const
     size_t slot_n = std::min(loc.size(), rem.size());
     std::vector<MediaSlot> s;
     s.reserve(slot_n);
-    for (decltype(slot_n) i=0; i<slot_n; i++)
+    for (decltype(slot_n) i=0; i<slot_n; i++) {
+        // both ends must use the crypto suite the peer selected,
+        // take our key for it among the ones we offered
+        auto& localCrypto = loc[i].crypto;
+        const auto& remoteCrypto = rem[i].crypto;
+        if (remoteCrypto and localCrypto.getCryptoSuite() != remoteCrypto.getCryptoSuite()) {
+            if (const auto suite = findCryptoSuite(remoteCrypto.getCryptoSuite()))
+                localCrypto = SdesNegotiator({*suite}).negotiate(getCryptoAttributes(activeLocalSession_->media[i]));
+        }
         s.emplace_back(std::move(loc[i]), std::move(rem[i]));
+    }
     return s;
 }
 
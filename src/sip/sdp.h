@@ -292,7 +292,13 @@ class Sdp {
          * Add rtpmap field if necessary
          */
         pjmedia_sdp_media *setMediaDescriptorLines(bool audio, bool holding, sip_utils::KeyExchangeProtocol);
-        pjmedia_sdp_attr *generateSdesAttribute();
+        pjmedia_sdp_attr *generateSdesAttribute(unsigned tag, const CryptoSuiteDefinition& cryptoSuite);
+
+        /*
+         * Replace the crypto attributes of our offer by the single one of
+         * an answer, for the suite chosen in the remote offer
+         */
+        void setSdesAnswer(const pjmedia_sdp_session* offer);
 
         void setTelephoneEventRtpmap(pjmedia_sdp_media *med);
 
@@ -320,6 +326,7 @@ class Sdp {
         void addSdesAttribute(const std::vector<std::string>& crypto);
 
         void addRTCPAttribute(pjmedia_sdp_media *med);
+        void addRTCPFeedbackAttributes(pjmedia_sdp_media *med);
 
         std::shared_ptr<AccountCodecInfo> findCodecByPayload(const unsigned payloadType);
         std::shared_ptr<AccountCodecInfo> findCodecBySpec(const std::string &codecName, const unsigned clockrate=0) const;
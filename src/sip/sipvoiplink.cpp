@@ -746,7 +746,10 @@ SIPVoIPLink::enqueueKeyframeRequest(const std::string &id)
 {
     if (auto link = getSIPVoIPLink()) {
         std::lock_guard<std::mutex> lock(link->keyframeRequestsMutex_);
-        link->keyframeRequests_.push(id);
+        // the call already waits for a keyframe, one INFO is enough
+        auto& requests = link->keyframeRequests_;
+        if (std::find(requests.begin(), requests.end(), id) == requests.end())
+            requests.push_back(id);
     } else
         RING_ERR("no more VoIP link");
 }
@@ -755,14 +758,13 @@ SIPVoIPLink::enqueueKeyframeRequest(const std::string &id)
 void
 SIPVoIPLink::dequeKeyframeRequests()
 {
-    int max_requests = 20;
-
-    while (not keyframeRequests_.empty() and max_requests--) {
+    decltype(keyframeRequests_) requests;
+    {
         std::lock_guard<std::mutex> lock(keyframeRequestsMutex_);
-        const std::string &id(keyframeRequests_.front());
-        requestKeyframe(id);
-        keyframeRequests_.pop();
+        requests.swap(keyframeRequests_);
     }
+    for (const auto& id : requests)
+        requestKeyframe(id);
 }
 
 // Called from SIP event thread
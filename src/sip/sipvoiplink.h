@@ -41,7 +41,7 @@
 #include <pjnath/stun_config.h>
 
 #ifdef RING_VIDEO
-#include <queue>
+#include <deque>
 #endif
 #include <map>
 #include <mutex>
@@ -173,7 +173,7 @@ class SIPVoIPLink {
         void dequeKeyframeRequests();
         void requestKeyframe(const std::string &callID);
         std::mutex keyframeRequestsMutex_ {};
-        std::queue<std::string> keyframeRequests_ {};
+        std::deque<std::string> keyframeRequests_ {}; // one per call at most
 #endif
 
         friend class SIPTest;
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace ring {
+
+/**
+ * Bounded lock-free queue for one producer thread and one consumer thread.
+ * N must be a power of two. Popped slots are reset to T{} so the items
+ * release what they hold as soon as they are consumed.
+ */
+template <typename T, std::size_t N>
+class SpscQueue {
+    static_assert(N and not (N & (N - 1)), "SpscQueue size must be a power of two");
+
+public:
+    SpscQueue() = default;
+
+    // Producer side, false if the queue is full
+    bool push(T&& item) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N)
+            return false;
+        items_[tail & (N - 1)] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, nullptr if the queue is empty
+    T* front() {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return nullptr;
+        return &items_[head & (N - 1)];
+    }
+
+    // Consumer side, false if the queue is empty
+    bool pop(T& item) {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = std::move(items_[head & (N - 1)]);
+        items_[head & (N - 1)] = T {};
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    NON_COPYABLE(SpscQueue);
+
+    std::array<T, N> items_ {};
+    std::atomic<std::size_t> head_ {0};     // written by the consumer
+    char pad_[64 - sizeof(std::atomic<std::size_t>)]; // not on the same cache line
+    std::atomic<std::size_t> tail_ {0};     // written by the producer
+};
+
+} // namespace ring
@@ -20,6 +20,7 @@
 
 #include "turn_transport.h"
 
+#include "ice_reactor.h"
 #include "logger.h"
 #include "ip_utils.h"
 #include "sip/sip_utils.h"
@@ -45,6 +46,9 @@ namespace ring {
 using MutexGuard = std::lock_guard<std::mutex>;
 using MutexLock = std::unique_lock<std::mutex>;
 
+// sockets of a relay: server connection and RFC 6062 peer data connections
+static constexpr unsigned TURN_MAX_HANDLES {16};
+
 inline
 namespace {
 
@@ -163,7 +167,6 @@ public:
     void onTurnState(pj_turn_state_t old_state, pj_turn_state_t new_state);
     void onRxData(const uint8_t* pkt, unsigned pkt_len, const pj_sockaddr_t* peer_addr, unsigned addr_len);
     void onPeerConnection(pj_uint32_t conn_id, const pj_sockaddr_t* peer_addr, unsigned addr_len, pj_status_t status);
-    void ioJob();
 
     std::mutex apiMutex_;
 
@@ -180,22 +183,21 @@ public:
     IpAddr mappedAddr;
 
     std::atomic<RelayState> state {RelayState::NONE};
-    std::atomic_bool ioJobQuit {false};
-    std::thread ioWorker;
+    IceReactor::Lease reactor; // handles timer/ioqueue events
 };
 
 TurnTransportPimpl::~TurnTransportPimpl()
 {
     if (relay) {
         try {
+            // the deallocation goes on without us
+            pj_turn_sock_set_user_data(relay, nullptr);
             pj_turn_sock_destroy(relay);
         } catch (...) {
             RING_ERR() << "exception during pj_turn_sock_destroy() call (ignored)";
         }
     }
-    ioJobQuit = true;
-    if (ioWorker.joinable())
-        ioWorker.join();
+    reactor.sync();
     pj_caching_pool_destroy(&poolCache);
 
 }
@@ -259,18 +261,6 @@ TurnTransportPimpl::onPeerConnection(pj_uint32_t conn_id,
         settings.onPeerConnection(conn_id, peer_addr, status == PJ_SUCCESS);
 }
 
-void
-TurnTransportPimpl::ioJob()
-{
-    sip_utils::register_thread();
-
-    while (!ioJobQuit.load()) {
-        const pj_time_val delay = {0, 10};
-        pj_ioqueue_poll(stunConfig.ioqueue, &delay);
-        pj_timer_heap_poll(stunConfig.timer_heap, nullptr);
-    }
-}
-
 //==============================================================================
 
 TurnTransport::TurnTransport(const TurnTransportParams& params)
@@ -292,36 +282,30 @@ TurnTransport::TurnTransport(const TurnTransportParams& params)
     pimpl_->pool = PjsipCallReturn(pj_pool_create, &pimpl_->poolCache.factory,
                                    "RgTurnTr", 512, 512, nullptr);
 
-    // STUN config
-    pj_stun_config_init(&pimpl_->stunConfig, &pimpl_->poolCache.factory, 0, nullptr, nullptr);
-
-    // create global timer heap
-    PjsipCall(pj_timer_heap_create, pimpl_->pool, 1000, &pimpl_->stunConfig.timer_heap);
-
-    // create global ioqueue
-    PjsipCall(pj_ioqueue_create, pimpl_->pool, 16, &pimpl_->stunConfig.ioqueue);
-
-    // run a thread to handles timer/ioqueue events
-    pimpl_->ioWorker = std::thread([this]{ pimpl_->ioJob(); });
+    // STUN config, events handled by a shared thread. The relay pool comes
+    // from the reactor as pjnath may use it after our destruction.
+    pimpl_->reactor = IceReactor::instance().acquire(TURN_MAX_HANDLES);
+    pj_stun_config_init(&pimpl_->stunConfig, pimpl_->reactor.poolFactory(), 0,
+                        pimpl_->reactor.ioqueue(), pimpl_->reactor.timerHeap());
 
     // TURN callbacks
     pj_turn_sock_cb relay_cb;
     pj_bzero(&relay_cb, sizeof(relay_cb));
     relay_cb.on_rx_data = [](pj_turn_sock* relay, void* pkt, unsigned pkt_len,
                              const pj_sockaddr_t* peer_addr, unsigned addr_len) {
-        auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay));
-        pimpl->onRxData(reinterpret_cast<uint8_t*>(pkt), pkt_len, peer_addr, addr_len);
+        if (auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay)))
+            pimpl->onRxData(reinterpret_cast<uint8_t*>(pkt), pkt_len, peer_addr, addr_len);
     };
     relay_cb.on_state = [](pj_turn_sock* relay, pj_turn_state_t old_state,
                            pj_turn_state_t new_state) {
-        auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay));
-        pimpl->onTurnState(old_state, new_state);
+        if (auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay)))
+            pimpl->onTurnState(old_state, new_state);
     };
     relay_cb.on_peer_connection = [](pj_turn_sock* relay, pj_uint32_t conn_id,
                                      const pj_sockaddr_t* peer_addr, unsigned addr_len,
                                      pj_status_t status) {
-        auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay));
-        pimpl->onPeerConnection(conn_id, peer_addr, addr_len, status);
+        if (auto pimpl = static_cast<TurnTransportPimpl*>(pj_turn_sock_get_user_data(relay)))
+            pimpl->onPeerConnection(conn_id, peer_addr, addr_len, status);
     };
 
     // TURN socket config
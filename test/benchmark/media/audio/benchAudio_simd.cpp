@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "media/audio/audio_simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace ring;
+
+// Cost of one conference tick per participant (48kHz stereo, 20ms)
+int
+main()
+{
+    using clock = std::chrono::high_resolution_clock;
+    constexpr size_t FRAMES = 960;
+    constexpr unsigned PARTICIPANTS = 16;
+    constexpr unsigned TICKS = 2000;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(-8000, 8000);
+    std::vector<std::vector<AudioSample>> sources(PARTICIPANTS * 2,
+                                                  std::vector<AudioSample>(FRAMES));
+    for (auto& s : sources)
+        for (auto& v : s)
+            v = dist(gen);
+    std::vector<int32_t> bus(FRAMES);
+    std::vector<AudioSample> out(FRAMES);
+    std::vector<AudioSample> interleaved(2 * FRAMES);
+    std::vector<float> fl(2 * FRAMES);
+
+    for (const auto k : availableAudioKernels()) {
+        const auto start = clock::now();
+        for (unsigned t = 0; t < TICKS; ++t) {
+            for (unsigned c = 0; c < 2; ++c) {
+                std::fill(bus.begin(), bus.end(), 0);
+                for (unsigned p = 0; p < PARTICIPANTS; ++p)
+                    k->accumulate(bus.data(), sources[2 * p + c].data(), FRAMES);
+                for (unsigned p = 0; p < PARTICIPANTS; ++p)
+                    k->mixMinus(bus.data(), sources[2 * p + c].data(), out.data(), FRAMES);
+            }
+            for (unsigned p = 0; p < PARTICIPANTS; ++p) {
+                k->interleave2(sources[2 * p].data(), sources[2 * p + 1].data(),
+                               interleaved.data(), FRAMES);
+                k->toFloat(interleaved.data(), fl.data(), 2 * FRAMES);
+            }
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        std::cout << k->name << ": " << ns.count() / (TICKS * PARTICIPANTS)
+                  << " ns per participant per tick" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "media/audio/lockfreeringbuffer.h"
+#include "media/audio/ringbuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ring;
+using clock_type = std::chrono::high_resolution_clock;
+
+static constexpr unsigned READERS = 8;
+static constexpr unsigned CALLBACKS = 2000;
+static constexpr size_t FRAMES = 960; // 20 ms at 48 kHz
+
+// Duration of get() on the reader of the audio callback (reader 0), while
+// a producer writes 20 ms ticks and the other readers consume the same buffer.
+template <typename Buffer, typename Get>
+static void
+callbackLatency(const char* name, Buffer& rb, const Get& get)
+{
+    std::atomic_bool running {true};
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]{
+        AudioBuffer tick(FRAMES, AudioFormat::MONO());
+        while (running) {
+            rb.put(tick);
+            std::this_thread::yield();
+        }
+    });
+    for (unsigned i = 1; i < READERS; ++i) {
+        threads.emplace_back([&, i]{
+            AudioBuffer out(FRAMES, AudioFormat::MONO());
+            while (running)
+                get(rb, out, i);
+        });
+    }
+
+    AudioBuffer out(FRAMES, AudioFormat::MONO());
+    clock_type::duration worst {}, total {};
+    for (unsigned i = 0; i < CALLBACKS; ++i) {
+        const auto start = clock_type::now();
+        get(rb, out, 0);
+        const auto elapsed = clock_type::now() - start;
+        worst = std::max(worst, elapsed);
+        total += elapsed;
+        std::this_thread::yield();
+    }
+
+    running = false;
+    for (auto& t : threads)
+        t.join();
+
+    using std::chrono::nanoseconds;
+    using std::chrono::duration_cast;
+    std::cout << name << ": get() mean " << duration_cast<nanoseconds>(total).count() / CALLBACKS
+              << " ns, worst " << duration_cast<nanoseconds>(worst).count() << " ns" << std::endl;
+}
+
+int
+main()
+{
+    std::cout << "callback latency, " << READERS << " readers and one producer" << std::endl;
+
+    RingBuffer locked("locked", SIZEBUF);
+    for (unsigned i = 0; i < READERS; ++i)
+        locked.createReadOffset(std::to_string(i));
+    callbackLatency("RingBuffer", locked,
+        [](RingBuffer& rb, AudioBuffer& out, unsigned i) {
+            rb.get(out, std::to_string(i));
+        });
+
+    LockFreeRingBuffer lockfree("lockfree", SIZEBUF);
+    std::vector<LockFreeRingBuffer::ReaderId> ids;
+    for (unsigned i = 0; i < READERS; ++i)
+        ids.push_back(lockfree.createReadOffset(std::to_string(i)));
+    callbackLatency("LockFreeRingBuffer", lockfree,
+        [&ids](LockFreeRingBuffer& rb, AudioBuffer& out, unsigned i) {
+            rb.get(out, ids[i]);
+        });
+
+    return 0;
+}
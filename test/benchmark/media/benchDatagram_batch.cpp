@@ -0,0 +1,129 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "media/datagram_batch.h"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace ring;
+
+static constexpr size_t RTP_SIZE {1200};
+static constexpr unsigned FRAME_PACKETS {24};
+static constexpr unsigned FRAMES {4000};
+
+static void
+waitWritable(int fd)
+{
+    pollfd p = {fd, POLLOUT, 0};
+    poll(&p, 1, 100);
+}
+
+// receive everything sent to rx, as a batch or one by one
+static unsigned
+drain(int rx, DatagramBatch* batch, unsigned expected)
+{
+    std::vector<uint8_t> buf(DatagramBatch::MAX_DATAGRAM_SIZE);
+    unsigned received = 0;
+    while (received < expected) {
+        pollfd p = {rx, POLLIN, 0};
+        if (poll(&p, 1, 100) <= 0)
+            break;
+        if (batch) {
+            const auto n = batch->receive(rx);
+            if (n > 0)
+                received += n;
+            batch->clear();
+        } else if (recv(rx, buf.data(), buf.size(), 0) > 0) {
+            ++received;
+        }
+    }
+    return received;
+}
+
+// Packets per second of one core sending and receiving video frames on loopback
+int
+main()
+{
+    const int tx = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    const int rx = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (tx < 0 or rx < 0) {
+        std::cerr << "socket() failed" << std::endl;
+        return 1;
+    }
+
+    const int size = 4 * 1024 * 1024;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    sockaddr_in destAddr {};
+    destAddr.sin_family = AF_INET;
+    destAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(destAddr);
+    if (bind(rx, reinterpret_cast<sockaddr*>(&destAddr), len) < 0
+        or getsockname(rx, reinterpret_cast<sockaddr*>(&destAddr), &len) < 0) {
+        std::cerr << "bind() failed" << std::endl;
+        return 1;
+    }
+    const auto dest = reinterpret_cast<const sockaddr*>(&destAddr);
+
+    using clock = std::chrono::high_resolution_clock;
+    const std::vector<uint8_t> packet(RTP_SIZE, 0x80);
+    for (const bool batched : {false, true}) {
+        DatagramBatch out(FRAME_PACKETS);
+        DatagramBatch in(FRAME_PACKETS);
+        unsigned received = 0;
+        const auto start = clock::now();
+        for (unsigned f = 0; f < FRAMES; ++f) {
+            for (unsigned i = 0; i < FRAME_PACKETS; ++i) {
+                if (batched)
+                    out.push(packet.data(), packet.size());
+                else
+                    while (sendto(tx, packet.data(), packet.size(), 0, dest, len) < 0
+                           and (errno == EAGAIN or errno == EWOULDBLOCK))
+                        waitWritable(tx);
+            }
+            while (not out.empty()) {
+                if (out.send(tx, dest, len) >= 0)
+                    continue;
+                if (errno != EAGAIN and errno != EWOULDBLOCK)
+                    break;
+                waitWritable(tx);
+            }
+            received += drain(rx, batched ? &in : nullptr, FRAME_PACKETS);
+        }
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+
+        std::cout << (batched ? "batched:    " : "one by one: ")
+                  << static_cast<uint64_t>(received / elapsed.count()) << " packets/s, "
+                  << received << "/" << FRAMES * FRAME_PACKETS << " received";
+        if (batched)
+            std::cout << ", " << out.getStats().segmented << " sent with GSO";
+        std::cout << std::endl;
+    }
+
+    close(tx);
+    close(rx);
+    return 0;
+}
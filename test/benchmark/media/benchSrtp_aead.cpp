@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "media/srtp_aead.h"
+#include "base64.h"
+
+extern "C" {
+#include "media/srtp.h"
+}
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace ring;
+
+static constexpr size_t RTP_SIZE {1200};
+static constexpr unsigned PACKETS {200000};
+
+static std::string
+makeKey(size_t size, uint8_t seed)
+{
+    std::vector<uint8_t> key(size);
+    for (size_t i = 0; i < size; ++i)
+        key[i] = seed + i;
+    return base64::encode(key);
+}
+
+// Packets per second of one core protecting video packets
+int
+main()
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    // RTP packet with room for the SRTP trailer
+    std::vector<uint8_t> plain(RTP_SIZE + SrtpAead::TAG_SIZE);
+    plain[0] = 0x80;
+    plain[1] = 96;
+    for (size_t i = 12; i < RTP_SIZE; ++i)
+        plain[i] = i;
+    std::vector<uint8_t> out(plain.size());
+
+    SRTPContext cm;
+    std::memset(&cm, 0, sizeof(cm));
+    if (ff_srtp_set_crypto(&cm, "AES_CM_128_HMAC_SHA1_80", makeKey(30, 1).c_str()) < 0) {
+        std::cerr << "AES_CM_128_HMAC_SHA1_80 setup failed" << std::endl;
+        return 1;
+    }
+    auto start = clock::now();
+    for (unsigned i = 0; i < PACKETS; ++i)
+        ff_srtp_encrypt(&cm, plain.data(), RTP_SIZE, out.data(), out.size());
+    std::chrono::duration<double> elapsed = clock::now() - start;
+    ff_srtp_free(&cm);
+    std::cout << "AES_CM_128_HMAC_SHA1_80: " << static_cast<uint64_t>(PACKETS / elapsed.count())
+              << " packets/s" << std::endl;
+
+    for (const auto& suite : {std::make_pair("AEAD_AES_128_GCM", 16), std::make_pair("AEAD_AES_256_GCM", 32)}) {
+        SrtpAead srtp(suite.first, makeKey(suite.second + 12, 1));
+        auto packet = plain;
+        start = clock::now();
+        for (unsigned i = 0; i < PACKETS; ++i) {
+            // in place, the previous ciphertext is the next plaintext
+            packet[2] = i >> 8;
+            packet[3] = i;
+            if (srtp.protect(packet.data(), RTP_SIZE) < 0) {
+                std::cerr << suite.first << ": protect failed" << std::endl;
+                return 1;
+            }
+        }
+        elapsed = clock::now() - start;
+        std::cout << suite.first << ": " << static_cast<uint64_t>(PACKETS / elapsed.count())
+                  << " packets/s" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "security/datagram_ring.h"
+
+#include <vector>
+
+namespace ring { namespace test {
+
+class DatagramRingTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "datagram_ring"; }
+
+private:
+    void fifoTest();
+
+    CPPUNIT_TEST_SUITE(DatagramRingTest);
+    CPPUNIT_TEST(fifoTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(DatagramRingTest, DatagramRingTest::name());
+
+void
+DatagramRingTest::fifoTest()
+{
+    tls::DatagramRing ring(4, 1500);
+    CPPUNIT_ASSERT(ring.empty());
+
+    // bigger than a slot
+    CPPUNIT_ASSERT(not ring.push(std::vector<uint8_t>(1501).data(), 1501));
+
+    // datagrams keep their size and order across the wrap of the slots
+    uint8_t next = 0;
+    for (unsigned round = 0; round < 3; ++round) {
+        while (not ring.full()) {
+            const std::vector<uint8_t> datagram(100 + next, next);
+            CPPUNIT_ASSERT(ring.push(datagram.data(), datagram.size()));
+            ++next;
+        }
+        CPPUNIT_ASSERT(not ring.push(&next, 1));
+        CPPUNIT_ASSERT_EQUAL(size_t(4), ring.size());
+
+        for (unsigned i = 0; i < 3; ++i) {
+            const uint8_t expected = next - 4 + i;
+            CPPUNIT_ASSERT_EQUAL(size_t(100 + expected), ring.frontSize());
+            CPPUNIT_ASSERT_EQUAL(expected, ring.frontData()[99]);
+            std::vector<uint8_t> buf(1500);
+            CPPUNIT_ASSERT_EQUAL(size_t(100 + expected), ring.pop(buf.data(), buf.size()));
+            CPPUNIT_ASSERT_EQUAL(expected, buf[100 + expected - 1]);
+        }
+        CPPUNIT_ASSERT_EQUAL(size_t(1), ring.size());
+    }
+
+    // truncated to the read buffer, like recv()
+    uint8_t buf[10];
+    CPPUNIT_ASSERT_EQUAL(sizeof(buf), ring.pop(buf, sizeof(buf)));
+    CPPUNIT_ASSERT(ring.empty());
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::DatagramRingTest::name());
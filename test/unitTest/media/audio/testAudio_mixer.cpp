@@ -0,0 +1,156 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/audio_mixer.h"
+#include "media/audio/ringbuffer.h"
+#include "media/audio/ringbufferpool.h"
+
+#include <chrono>
+#include <string>
+
+namespace ring { namespace test {
+
+class AudioMixerTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "audio_mixer"; }
+
+private:
+    void sourcesTest();
+    void mixMinusOneTest();
+    void silentSourceTest();
+
+    CPPUNIT_TEST_SUITE(AudioMixerTest);
+    CPPUNIT_TEST(sourcesTest);
+    CPPUNIT_TEST(mixMinusOneTest);
+    CPPUNIT_TEST(silentSourceTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(AudioMixerTest, AudioMixerTest::name());
+
+void
+AudioMixerTest::sourcesTest()
+{
+    RingBufferPool pool;
+    auto a = pool.createRingBuffer("a");
+    auto b = pool.createRingBuffer("b");
+
+    AudioMixer mixer("conf", pool);
+    mixer.addSource("a");
+    mixer.addSource("b");
+    mixer.addSource("a");
+    mixer.addSource("unknown");
+    CPPUNIT_ASSERT(mixer.sourceCount() == 2);
+    CPPUNIT_ASSERT(mixer.hasSource("a"));
+    CPPUNIT_ASSERT(a->readOffsetCount() == 1);
+
+    mixer.removeSource("a");
+    CPPUNIT_ASSERT(not mixer.hasSource("a"));
+    CPPUNIT_ASSERT(a->hasNoReadOffsets());
+
+    mixer.removeAllSources();
+    CPPUNIT_ASSERT(mixer.sourceCount() == 0);
+    CPPUNIT_ASSERT(b->hasNoReadOffsets());
+}
+
+void
+AudioMixerTest::mixMinusOneTest()
+{
+    RingBufferPool pool;
+    const auto format = pool.getInternalAudioFormat();
+    const size_t tick = format.sample_rate / 50;
+
+    auto a = pool.createRingBuffer("a");
+    auto b = pool.createRingBuffer("b");
+    auto c = pool.createRingBuffer("c");
+
+    AudioMixer mixer("conf", pool);
+    mixer.addSource("a");
+    mixer.addSource("b");
+    mixer.addSource("c");
+
+    auto constant = [&](AudioSample value) {
+        AudioBuffer buf(tick * 4, format);
+        for (unsigned c = 0; c < buf.channels(); ++c)
+            std::fill_n(buf.getChannel(c), buf.frames(), value);
+        return buf;
+    };
+    auto bufA = constant(100);
+    auto bufB = constant(200);
+    auto bufC = constant(300);
+    a->put(bufA);
+    b->put(bufB);
+    c->put(bufC);
+
+    CPPUNIT_ASSERT(pool.waitForDataAvailable("a", tick * 3, std::chrono::seconds(1)));
+
+    AudioBuffer out(tick * 3, format);
+    CPPUNIT_ASSERT(pool.getData(out, "a") == tick * 3);
+
+    // "a" never hears itself: depending on when sources were mixed
+    // in a tick, we can only get silence, b, c or b+c.
+    bool full = false;
+    const auto* chan = out.getChannel(0);
+    for (size_t i = 0; i < out.frames(); ++i) {
+        const auto sample = chan[i];
+        CPPUNIT_ASSERT(sample == 0 or sample == 200 or sample == 300 or sample == 500);
+        full |= sample == 500;
+    }
+    CPPUNIT_ASSERT(full);
+}
+
+void
+AudioMixerTest::silentSourceTest()
+{
+    RingBufferPool pool;
+    const auto format = pool.getInternalAudioFormat();
+    const size_t tick = format.sample_rate / 50;
+
+    auto a = pool.createRingBuffer("a");
+    auto b = pool.createRingBuffer("b");
+
+    AudioMixer mixer("conf", pool);
+    mixer.addSource("a");
+    mixer.addSource("b");
+
+    // "b" is background noise, flagged as such by its VAD
+    AudioBuffer noise(tick * 4, format);
+    for (unsigned c = 0; c < noise.channels(); ++c)
+        std::fill_n(noise.getChannel(c), noise.frames(), 50);
+    a->put(noise, false);
+    b->put(noise, false);
+
+    CPPUNIT_ASSERT(pool.waitForDataAvailable("a", tick * 3, std::chrono::seconds(1)));
+    CPPUNIT_ASSERT(not pool.voiceAvailable("a"));
+
+    AudioBuffer out(tick * 3, format);
+    CPPUNIT_ASSERT(pool.getData(out, "a") == tick * 3);
+    const auto* chan = out.getChannel(0);
+    for (size_t i = 0; i < out.frames(); ++i)
+        CPPUNIT_ASSERT(chan[i] == 0);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::AudioMixerTest::name());
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/audio_simd.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+class AudioSimdTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "audio_simd"; }
+
+private:
+    void conformanceTest();
+
+    CPPUNIT_TEST_SUITE(AudioSimdTest);
+    CPPUNIT_TEST(conformanceTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(AudioSimdTest, AudioSimdTest::name());
+
+// odd length to exercise vector loop tails
+static constexpr size_t LEN = 1021;
+
+static std::vector<AudioSample>
+randomSamples(std::mt19937& gen)
+{
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+    std::vector<AudioSample> v(LEN);
+    for (auto& s : v)
+        s = dist(gen);
+    // saturation corner cases
+    v[0] = -32768; v[1] = 32767; v[2] = 0;
+    return v;
+}
+
+void
+AudioSimdTest::conformanceTest()
+{
+    std::mt19937 gen(42);
+    const auto a = randomSamples(gen);
+    const auto b = randomSamples(gen);
+    std::vector<float> f(LEN);
+    std::uniform_real_distribution<float> fdist(-1.5f, 1.5f);
+    for (auto& s : f)
+        s = fdist(gen);
+    std::vector<int32_t> bus(LEN);
+    for (size_t i = 0; i < LEN; ++i)
+        bus[i] = a[i] + b[i] + 1000;
+
+    const auto& ref = *availableAudioKernels().front();
+    for (const auto k : availableAudioKernels()) {
+        std::cout << std::endl << "checking " << k->name << " kernels" << std::endl;
+
+        auto r1 = a, r2 = a;
+        ref.mix(r1.data(), b.data(), LEN);
+        k->mix(r2.data(), b.data(), LEN);
+        CPPUNIT_ASSERT(r1 == r2);
+        CPPUNIT_ASSERT(r2[1] == 32767 or b[1] < 0);
+
+        r1 = a; r2 = a;
+        ref.applyGain(r1.data(), LEN, -0.73f);
+        k->applyGain(r2.data(), LEN, -0.73f);
+        CPPUNIT_ASSERT(r1 == r2);
+
+        r1 = a; r2 = a;
+        ref.applyGain(r1.data(), LEN, -1.f);
+        k->applyGain(r2.data(), LEN, -1.f);
+        CPPUNIT_ASSERT(r1 == r2);
+        CPPUNIT_ASSERT(r2[0] == 32767);
+
+        std::vector<float> f1(LEN), f2(LEN);
+        ref.toFloat(a.data(), f1.data(), LEN);
+        k->toFloat(a.data(), f2.data(), LEN);
+        CPPUNIT_ASSERT(f1 == f2);
+
+        ref.fromFloat(f.data(), r1.data(), LEN);
+        k->fromFloat(f.data(), r2.data(), LEN);
+        CPPUNIT_ASSERT(r1 == r2);
+
+        std::vector<AudioSample> i1(2 * LEN), i2(2 * LEN);
+        ref.interleave2(a.data(), b.data(), i1.data(), LEN);
+        k->interleave2(a.data(), b.data(), i2.data(), LEN);
+        CPPUNIT_ASSERT(i1 == i2);
+        CPPUNIT_ASSERT(i2[2 * LEN - 1] == b[LEN - 1]);
+
+        auto bus1 = bus, bus2 = bus;
+        ref.accumulate(bus1.data(), a.data(), LEN);
+        k->accumulate(bus2.data(), a.data(), LEN);
+        CPPUNIT_ASSERT(bus1 == bus2);
+
+        ref.mixMinus(bus.data(), a.data(), r1.data(), LEN);
+        k->mixMinus(bus.data(), a.data(), r2.data(), LEN);
+        CPPUNIT_ASSERT(r1 == r2);
+
+        // summation order differs between kernels
+        const float d1 = ref.dot(f.data(), f1.data(), LEN);
+        const float d2 = k->dot(f.data(), f1.data(), LEN);
+        CPPUNIT_ASSERT(std::abs(d1 - d2) <= 1e-4f * (1.f + std::abs(d1)));
+    }
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::AudioSimdTest::name());
@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/audiobuffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+class AudioBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "audiobuffer"; }
+
+private:
+    void layoutTest();
+    void channelsTest();
+    void copyShrunkTest();
+    void viewTest();
+    void steadyStateAllocationTest();
+
+    CPPUNIT_TEST_SUITE(AudioBufferTest);
+    CPPUNIT_TEST(layoutTest);
+    CPPUNIT_TEST(channelsTest);
+    CPPUNIT_TEST(copyShrunkTest);
+    CPPUNIT_TEST(viewTest);
+    CPPUNIT_TEST(steadyStateAllocationTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(AudioBufferTest, AudioBufferTest::name());
+
+void
+AudioBufferTest::layoutTest()
+{
+    std::vector<AudioSample> in {1, -1, 2, -2, 3, -3};
+    AudioBuffer buf(in.data(), 3, AudioFormat::STEREO());
+    CPPUNIT_ASSERT(buf.frames() == 3);
+    CPPUNIT_ASSERT(buf.channels() == 2);
+
+    for (unsigned c = 0; c < buf.channels(); ++c)
+        CPPUNIT_ASSERT(reinterpret_cast<uintptr_t>(buf.getChannel(c)) % 32 == 0);
+    CPPUNIT_ASSERT(buf.getChannel(0)[2] == 3);
+    CPPUNIT_ASSERT(buf.getChannel(1)[2] == -3);
+    CPPUNIT_ASSERT(buf.getChannel(2) == nullptr);
+
+    std::vector<AudioSample> out(6);
+    CPPUNIT_ASSERT(buf.interleave(out.data()) == 6);
+    CPPUNIT_ASSERT(out == in);
+
+    // growing keeps content and zero pads
+    buf.resize(100);
+    CPPUNIT_ASSERT(buf.getChannel(1)[1] == -2);
+    CPPUNIT_ASSERT(buf.getChannel(1)[99] == 0);
+}
+
+void
+AudioBufferTest::channelsTest()
+{
+    std::vector<AudioSample> in {100, 300, 200, 400};
+    AudioBuffer buf(in.data(), 2, AudioFormat::STEREO());
+
+    buf.setChannelNum(1, true);
+    CPPUNIT_ASSERT(buf.channels() == 1);
+    CPPUNIT_ASSERT(buf.getChannel(0)[0] == 200);
+    CPPUNIT_ASSERT(buf.getChannel(0)[1] == 300);
+
+    buf.setChannelNum(2, true);
+    CPPUNIT_ASSERT(buf.getChannel(1)[1] == 300);
+
+    AudioBuffer copy(buf, true);
+    copy.mix(buf);
+    CPPUNIT_ASSERT(copy.getChannel(1)[0] == 400);
+}
+
+// a shrunk buffer keeps its stride, copies must not assume the same layout
+void
+AudioBufferTest::copyShrunkTest()
+{
+    AudioBuffer buf(1000, AudioFormat::STEREO());
+    buf.resize(100);
+    for (unsigned c = 0; c < buf.channels(); ++c)
+        for (size_t i = 0; i < buf.frames(); ++i)
+            buf.getChannel(c)[i] = (c + 1) * 1000 + i;
+
+    AudioBuffer copy(buf, true);
+    CPPUNIT_ASSERT(copy.frames() == 100);
+    for (unsigned c = 0; c < copy.channels(); ++c) {
+        CPPUNIT_ASSERT(copy.getChannel(c)[0] == AudioSample((c + 1) * 1000));
+        CPPUNIT_ASSERT(copy.getChannel(c)[99] == AudioSample((c + 1) * 1000 + 99));
+    }
+}
+
+void
+AudioBufferTest::viewTest()
+{
+    std::vector<AudioSample> in {1, 10, 2, 20, 3, 30, 4, 40};
+    AudioBuffer buf(in.data(), 4, AudioFormat::STEREO());
+
+    const auto view = buf.view(1, 2);
+    CPPUNIT_ASSERT(view.frames() == 2);
+    CPPUNIT_ASSERT(view.channels() == 2);
+    CPPUNIT_ASSERT(view.getChannel(0) == buf.getChannel(0) + 1);
+    CPPUNIT_ASSERT(view.getChannel(1)[1] == 30);
+    CPPUNIT_ASSERT(view.getChannel(2) == nullptr);
+
+    // clamped to the buffer
+    CPPUNIT_ASSERT(buf.view(3).frames() == 1);
+    CPPUNIT_ASSERT(buf.view(5, 2).frames() == 0);
+
+    // mixed at an offset, samples past the end are ignored
+    AudioBuffer out(3, AudioFormat::STEREO());
+    CPPUNIT_ASSERT(out.mix(buf.view(0, 3), true, 1) == 2);
+    CPPUNIT_ASSERT(out.getChannel(0)[0] == 0);
+    CPPUNIT_ASSERT(out.getChannel(0)[1] == 1);
+    CPPUNIT_ASSERT(out.getChannel(1)[2] == 20);
+
+    // mono is upmixed, the buffer grows to hold the copy
+    AudioBuffer mono(in.data(), 8, AudioFormat::MONO());
+    CPPUNIT_ASSERT(out.copy(mono.view(6), 2) == 2);
+    CPPUNIT_ASSERT(out.frames() == 4);
+    CPPUNIT_ASSERT(out.getChannel(0)[3] == 40);
+    CPPUNIT_ASSERT(out.getChannel(1)[2] == 4);
+}
+
+void
+AudioBufferTest::steadyStateAllocationTest()
+{
+    const auto format = AudioFormat::STEREO();
+
+    // warm up the pool
+    for (int i = 0; i < 4; ++i) {
+        AudioBuffer a(960, format);
+        AudioBuffer b(a, true);
+    }
+
+    const auto allocations = AudioBuffer::heapAllocations();
+    for (int i = 0; i < 1000; ++i) {
+        AudioBuffer a(960, format);
+        AudioBuffer b(a, true);
+        b.mix(a);
+        a = std::move(b);
+    }
+    CPPUNIT_ASSERT(AudioBuffer::heapAllocations() == allocations);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::AudioBufferTest::name());
@@ -0,0 +1,261 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/capture_pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+class CapturePipelineTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "capture_pipeline"; }
+
+private:
+    void blockingTest();
+    void farEndTest();
+    void echoDelayTest();
+    void farEndAlignmentTest();
+    void voiceActivityTest();
+
+    CPPUNIT_TEST_SUITE(CapturePipelineTest);
+    CPPUNIT_TEST(blockingTest);
+    CPPUNIT_TEST(farEndTest);
+    CPPUNIT_TEST(echoDelayTest);
+    CPPUNIT_TEST(farEndAlignmentTest);
+    CPPUNIT_TEST(voiceActivityTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(CapturePipelineTest, CapturePipelineTest::name());
+
+// Negates samples and records what it was given
+class RecordStage : public CaptureStage {
+public:
+    RecordStage(bool farEnd = false) : farEnd_(farEnd) {}
+
+    const char* name() const override { return "record"; }
+    bool needsFarEnd() const override { return farEnd_; }
+    void setFormat(AudioFormat, size_t frames) override { frames_ = frames; }
+    void farEndRealigned() override { ++realigned; }
+
+    void process(CaptureBlock& block) override {
+        CPPUNIT_ASSERT(block.data.frames() == frames_);
+        for (unsigned c = 0; c < block.data.channels(); ++c) {
+            auto data = block.data.getChannel(c);
+            for (size_t i = 0; i < frames_; ++i)
+                data[i] = -data[i];
+        }
+        if (block.farEnd) {
+            CPPUNIT_ASSERT(block.farEnd->frames() == frames_);
+            auto far = block.farEnd->getChannel(0);
+            farEnd.insert(farEnd.end(), far, far + frames_);
+        }
+    }
+
+    std::vector<AudioSample> farEnd;
+    unsigned realigned {0};
+
+private:
+    bool farEnd_;
+    size_t frames_ {0};
+};
+
+void
+CapturePipelineTest::blockingTest()
+{
+    const AudioFormat format {48000, 2};
+    CapturePipeline pipeline;
+    pipeline.addStage(std::unique_ptr<CaptureStage>(new RecordStage));
+
+    // capture sizes unrelated to the 480 frames blocks
+    std::vector<AudioSample> out;
+    AudioSample next = 0;
+    for (const size_t frames : {256, 100, 1000, 1, 563, 480}) {
+        AudioBuffer buf(frames, format);
+        for (size_t i = 0; i < frames; ++i)
+            buf.getChannel(0)[i] = buf.getChannel(1)[i] = next++;
+        pipeline.process(buf);
+        CPPUNIT_ASSERT(buf.frames() % 480 == 0);
+        // held back less than one block
+        CPPUNIT_ASSERT(next - (out.size() + buf.frames()) < 480);
+        out.insert(out.end(), buf.getChannel(1), buf.getChannel(1) + buf.frames());
+    }
+
+    CPPUNIT_ASSERT(out.size() == 2400);
+    for (size_t i = 0; i < out.size(); ++i)
+        CPPUNIT_ASSERT(out[i] == -static_cast<AudioSample>(i));
+
+    const auto stats = pipeline.getStats();
+    CPPUNIT_ASSERT(stats.size() == 1);
+    CPPUNIT_ASSERT(stats[0].name == "record");
+    CPPUNIT_ASSERT(stats[0].blocks == 5);
+}
+
+void
+CapturePipelineTest::farEndTest()
+{
+    const AudioFormat format {16000, 1};
+    CapturePipeline pipeline;
+    auto stage = new RecordStage(true);
+    pipeline.addStage(std::unique_ptr<CaptureStage>(stage));
+    pipeline.setFarEndFormat({16000, 2});
+
+    // nothing played yet: no reference
+    AudioBuffer buf(160, format);
+    pipeline.process(buf);
+    CPPUNIT_ASSERT(stage->farEnd.empty());
+
+    AudioBuffer played(240, {16000, 2});
+    for (size_t i = 0; i < 240; ++i)
+        played.getChannel(0)[i] = i + 1;
+    pipeline.putFarEnd(played);
+
+    // played samples come in order, then silence
+    buf.resize(480);
+    pipeline.process(buf);
+    CPPUNIT_ASSERT(stage->farEnd.size() == 480);
+    for (size_t i = 0; i < 480; ++i)
+        CPPUNIT_ASSERT(stage->farEnd[i] == (i < 240 ? static_cast<AudioSample>(i + 1) : 0));
+}
+
+// block amplitudes spread over 50dB, like speech
+static double
+randomAmplitude(unsigned& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return std::pow(10., 1. + 2.5 * ((seed >> 16) & 0x7fff) / 32768.);
+}
+
+void
+CapturePipelineTest::echoDelayTest()
+{
+    EchoDelayEstimator estimator(20);
+    unsigned seed = 1;
+    std::vector<double> far;
+
+    // echo 7 blocks after the far end, attenuated, over some noise
+    for (unsigned b = 0; b < 400; ++b) {
+        const double a = randomAmplitude(seed);
+        far.push_back(a * a);
+        const double echo = b >= 7 ? far[b - 7] / 10. : 0.;
+        estimator.update(echo + 100., far[b]);
+    }
+    CPPUNIT_ASSERT_EQUAL(7u, estimator.delay());
+
+    // the echo path changes
+    for (unsigned b = 400; b < 800; ++b) {
+        const double a = randomAmplitude(seed);
+        far.push_back(a * a);
+        estimator.update(far[b - 12] / 10. + 100., far[b]);
+    }
+    CPPUNIT_ASSERT_EQUAL(12u, estimator.delay());
+
+    // nothing played: the estimate holds
+    for (unsigned b = 0; b < 400; ++b)
+        CPPUNIT_ASSERT(not estimator.update(100., 0.));
+    CPPUNIT_ASSERT_EQUAL(12u, estimator.delay());
+}
+
+void
+CapturePipelineTest::farEndAlignmentTest()
+{
+    const AudioFormat format {8000, 1};
+    CapturePipeline pipeline;
+    auto stage = new RecordStage(true);
+    pipeline.addStage(std::unique_ptr<CaptureStage>(stage));
+    pipeline.setFarEndFormat(format);
+
+    // the near end hears each played block 6 blocks later
+    unsigned seed = 1;
+    std::vector<AudioBuffer> played;
+    AudioBuffer buf(80, format);
+    for (unsigned b = 0; b < 300; ++b) {
+        const double a = randomAmplitude(seed);
+        played.emplace_back(80, format);
+        for (size_t i = 0; i < 80; ++i)
+            played.back().getChannel(0)[i] = (i % 3) ? a : -a;
+        pipeline.putFarEnd(played.back());
+
+        buf.resize(80);
+        buf.reset();
+        if (b >= 6)
+            for (size_t i = 0; i < 80; ++i)
+                buf.getChannel(0)[i] = played[b - 6].getChannel(0)[i] / 2;
+        pipeline.process(buf);
+    }
+    CPPUNIT_ASSERT(pipeline.echoDelay() == std::chrono::milliseconds(60));
+    CPPUNIT_ASSERT(stage->realigned == 1);
+
+    // the reference is the block played 2 blocks before the echo
+    const auto& expected = played[played.size() - 1 - 4];
+    CPPUNIT_ASSERT(std::equal(stage->farEnd.end() - 80, stage->farEnd.end(), expected.getChannel(0)));
+}
+
+void
+CapturePipelineTest::voiceActivityTest()
+{
+    const AudioFormat format {8000, 1};
+    CapturePipeline pipeline;
+    pipeline.addStage(std::unique_ptr<CaptureStage>(new VoiceActivityDetector));
+
+    // faint noise for one second
+    AudioBuffer buf(80, format);
+    for (unsigned b = 0; b < 100; ++b) {
+        for (size_t i = 0; i < 80; ++i)
+            buf.getChannel(0)[i] = (i % 2) ? 20 : -20;
+        pipeline.process(buf);
+    }
+    CPPUNIT_ASSERT(not pipeline.voiceActivity());
+
+    // a loud tone is voice
+    for (size_t i = 0; i < 80; ++i)
+        buf.getChannel(0)[i] = 8000 * std::sin(2 * 3.141592653589793 * 440 * i / 8000.);
+    pipeline.process(buf);
+    CPPUNIT_ASSERT(pipeline.voiceActivity());
+
+    // and still is shortly after it ends
+    for (size_t i = 0; i < 80; ++i)
+        buf.getChannel(0)[i] = (i % 2) ? 20 : -20;
+    pipeline.process(buf);
+    CPPUNIT_ASSERT(pipeline.voiceActivity());
+    for (unsigned b = 0; b < 30; ++b)
+        pipeline.process(buf);
+    CPPUNIT_ASSERT(not pipeline.voiceActivity());
+
+    // voice in any block of a buffer, even when its last ones are past the hangover
+    AudioBuffer longBuf(80 * 25, format);
+    for (size_t i = 0; i < longBuf.frames(); ++i)
+        longBuf.getChannel(0)[i] = i < 80 ? 8000 * std::sin(2 * 3.141592653589793 * 440 * i / 8000.)
+                                          : ((i % 2) ? 20 : -20);
+    pipeline.process(longBuf);
+    CPPUNIT_ASSERT(pipeline.voiceActivity());
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::CapturePipelineTest::name());
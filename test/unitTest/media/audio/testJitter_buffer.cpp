@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/jitter_buffer.h"
+
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+using namespace std::chrono;
+using Buffer = JitterBuffer<int>;
+
+class JitterBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "jitter_buffer"; }
+
+private:
+    void inOrderTest();
+    void reorderAndLossTest();
+    void adaptiveDelayTest();
+    void rebufferTest();
+
+    CPPUNIT_TEST_SUITE(JitterBufferTest);
+    CPPUNIT_TEST(inOrderTest);
+    CPPUNIT_TEST(reorderAndLossTest);
+    CPPUNIT_TEST(adaptiveDelayTest);
+    CPPUNIT_TEST(rebufferTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(JitterBufferTest, JitterBufferTest::name());
+
+static constexpr int64_t FRAME = 20000; // us
+static const Buffer::clock::time_point T0 = Buffer::clock::now();
+
+static Buffer::clock::time_point
+at(int64_t us)
+{
+    return T0 + microseconds(us);
+}
+
+// Play everything due until 'until', one get() per 1ms
+static std::vector<int>
+playUntil(Buffer& jb, int64_t& now, int64_t until)
+{
+    std::vector<int> out;
+    for (; now <= until; now += 1000) {
+        int p;
+        Buffer::Result r;
+        while ((r = jb.get(at(now), p)) != Buffer::Result::Wait)
+            out.push_back(r == Buffer::Result::Play ? p : -1);
+    }
+    return out;
+}
+
+void
+JitterBufferTest::inOrderTest()
+{
+    Buffer jb(milliseconds(40));
+    int64_t now = 0;
+    std::vector<int> played;
+    for (int i = 0; i < 50; ++i) {
+        jb.put(i * FRAME, int(i), at(i * FRAME));
+        auto p = playUntil(jb, now, i * FRAME);
+        played.insert(played.end(), p.begin(), p.end());
+    }
+    // nothing before the playout delay, then every packet in order
+    CPPUNIT_ASSERT(played.size() == 48);
+    for (size_t i = 0; i < played.size(); ++i)
+        CPPUNIT_ASSERT(played[i] == int(i));
+    CPPUNIT_ASSERT(jb.getStats().concealed == 0);
+    CPPUNIT_ASSERT(jb.getStats().jitter == microseconds(0));
+}
+
+void
+JitterBufferTest::reorderAndLossTest()
+{
+    Buffer jb(milliseconds(60));
+    int64_t now = 0;
+    // 3 is late but within the delay, 5 is lost, 7 comes after its time
+    const std::vector<std::pair<int, int64_t>> arrivals {
+        {0, 0}, {1, 20000}, {2, 40000}, {4, 80000}, {3, 85000},
+        {6, 120000}, {8, 160000}, {9, 180000}, {7, 250000}, {10, 260000}
+    };
+    std::vector<int> played;
+    for (const auto& a : arrivals) {
+        auto p = playUntil(jb, now, a.second);
+        played.insert(played.end(), p.begin(), p.end());
+        jb.put(a.first * FRAME, int(a.first), at(a.second));
+    }
+    auto p = playUntil(jb, now, 400000);
+    played.insert(played.end(), p.begin(), p.end());
+
+    const std::vector<int> expected {0, 1, 2, 3, 4, -1, 6, -1, 8, 9, 10};
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), played.begin()));
+    const auto stats = jb.getStats();
+    CPPUNIT_ASSERT(stats.late == 1);
+    CPPUNIT_ASSERT(stats.received == 9);
+}
+
+void
+JitterBufferTest::adaptiveDelayTest()
+{
+    Buffer jb(milliseconds(20), milliseconds(300));
+    int64_t now = 0;
+
+    // +-30ms of jitter
+    for (int i = 0; i < 100; ++i) {
+        const int64_t arrival = i * FRAME + (i % 2 ? 30000 : 0);
+        playUntil(jb, now, arrival);
+        jb.put(i * FRAME, int(i), at(arrival));
+    }
+    const auto stats = jb.getStats();
+    CPPUNIT_ASSERT(stats.jitter > milliseconds(20));
+    CPPUNIT_ASSERT(stats.targetDelay >= milliseconds(80));
+    CPPUNIT_ASSERT(stats.playoutDelay + milliseconds(20) >= stats.targetDelay);
+    CPPUNIT_ASSERT(stats.expanded > 0);
+
+    // back to a clean link: the delay shrinks
+    for (int i = 100; i < 1000; ++i) {
+        playUntil(jb, now, i * FRAME + 30000);
+        jb.put(i * FRAME, int(i), at(i * FRAME + 30000));
+    }
+    CPPUNIT_ASSERT(jb.getStats().playoutDelay < stats.playoutDelay);
+    CPPUNIT_ASSERT(jb.getStats().compressed > 0);
+}
+
+void
+JitterBufferTest::rebufferTest()
+{
+    Buffer jb(milliseconds(20), milliseconds(100));
+    int64_t now = 0;
+    jb.put(0, 0, at(0));
+    auto played = playUntil(jb, now, 1000000);
+    // the packet, then concealment for at most the max delay
+    CPPUNIT_ASSERT(played.front() == 0);
+    CPPUNIT_ASSERT(played.size() <= 1 + 5);
+    CPPUNIT_ASSERT(jb.getStats().rebuffers == 1);
+    CPPUNIT_ASSERT(jb.nextDeadline() == Buffer::clock::time_point::max());
+
+    // stream resumes with a timestamp jump
+    jb.put(50 * FRAME, 50, at(now));
+    played = playUntil(jb, now, now + 30000);
+    CPPUNIT_ASSERT(played.size() == 1 and played[0] == 50);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::JitterBufferTest::name());
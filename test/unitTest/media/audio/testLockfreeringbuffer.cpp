@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/lockfreeringbuffer.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace ring { namespace test {
+
+class LockFreeRingBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "lockfreeringbuffer"; }
+
+private:
+    void putGetTest();
+    void multipleReadersTest();
+    void overrunTest();
+    void concurrentOverrunTest();
+
+    CPPUNIT_TEST_SUITE(LockFreeRingBufferTest);
+    CPPUNIT_TEST(putGetTest);
+    CPPUNIT_TEST(multipleReadersTest);
+    CPPUNIT_TEST(overrunTest);
+    CPPUNIT_TEST(concurrentOverrunTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(LockFreeRingBufferTest, LockFreeRingBufferTest::name());
+
+static AudioBuffer
+makeRamp(size_t frames, AudioSample start = 0)
+{
+    AudioBuffer buf(frames, AudioFormat::MONO());
+    auto chan = buf.getChannel(0);
+    for (size_t i = 0; i < frames; ++i)
+        chan[i] = start + i;
+    return buf;
+}
+
+void
+LockFreeRingBufferTest::putGetTest()
+{
+    LockFreeRingBuffer rb("test", 2048);
+    const auto reader = rb.createReadOffset("reader");
+    CPPUNIT_ASSERT(reader != LockFreeRingBuffer::INVALID_READER);
+    CPPUNIT_ASSERT(rb.createReadOffset("reader") == reader);
+    CPPUNIT_ASSERT(rb.availableForGet(reader) == 0);
+
+    rb.put(makeRamp(160));
+    CPPUNIT_ASSERT(rb.availableForGet(reader) == 160);
+
+    AudioBuffer out(100, AudioFormat::MONO());
+    CPPUNIT_ASSERT(rb.get(out, reader) == 100);
+    CPPUNIT_ASSERT(out.getChannel(0)[99] == 99);
+    CPPUNIT_ASSERT(rb.availableForGet(reader) == 60);
+
+    CPPUNIT_ASSERT(rb.get(out, reader) == 60);
+    CPPUNIT_ASSERT(out.getChannel(0)[0] == 100);
+    CPPUNIT_ASSERT(rb.availableForGet(reader) == 0);
+
+    rb.removeReadOffset("reader");
+    CPPUNIT_ASSERT(rb.readOffsetCount() == 0);
+    CPPUNIT_ASSERT(rb.get(out, reader) == 0);
+}
+
+void
+LockFreeRingBufferTest::multipleReadersTest()
+{
+    LockFreeRingBuffer rb("test", 2048);
+    const auto r1 = rb.createReadOffset("r1");
+    const auto r2 = rb.createReadOffset("r2");
+    CPPUNIT_ASSERT(r1 != r2);
+
+    rb.put(makeRamp(500));
+    CPPUNIT_ASSERT(rb.discard(200, r1) == 200);
+    CPPUNIT_ASSERT(rb.availableForGet(r1) == 300);
+    CPPUNIT_ASSERT(rb.availableForGet(r2) == 500);
+
+    rb.flush(r2);
+    CPPUNIT_ASSERT(rb.availableForGet(r2) == 0);
+    CPPUNIT_ASSERT(rb.availableForGet(r1) == 300);
+
+    rb.flushAll();
+    CPPUNIT_ASSERT(rb.availableForGet(r1) == 0);
+}
+
+void
+LockFreeRingBufferTest::overrunTest()
+{
+    LockFreeRingBuffer rb("test", 1024);
+    const auto reader = rb.createReadOffset("reader");
+
+    // Wrap around the buffer more than once
+    for (int i = 0; i < 10; ++i)
+        rb.put(makeRamp(300, i * 300));
+
+    CPPUNIT_ASSERT(rb.availableForGet(reader) == 1024);
+
+    AudioBuffer out(2000, AudioFormat::MONO());
+    CPPUNIT_ASSERT(rb.get(out, reader) == 1024);
+    CPPUNIT_ASSERT(out.getChannel(0)[0] == 3000 - 1024);
+    CPPUNIT_ASSERT(out.getChannel(0)[1023] == 2999);
+    CPPUNIT_ASSERT(rb.overrunCount() == 3000 - 1024);
+}
+
+// A reader as fast as the writer, on a small buffer: the writer keeps
+// overwriting the frames being read. What get() returns must be a run of
+// consecutive frames, after the silence replacing the overwritten ones.
+void
+LockFreeRingBufferTest::concurrentOverrunTest()
+{
+    LockFreeRingBuffer rb("test", 1024);
+    const auto reader = rb.createReadOffset("reader");
+    constexpr unsigned PUTS = 5000;
+    constexpr size_t PUT_FRAMES = 250;
+
+    std::atomic_bool done {false};
+    std::thread writer([&]{
+        auto ramp = makeRamp(PUT_FRAMES);
+        auto chan = ramp.getChannel(0);
+        for (unsigned i = 0; i < PUTS; ++i) {
+            rb.put(ramp);
+            for (size_t f = 0; f < PUT_FRAMES; ++f)
+                chan[f] += PUT_FRAMES;
+        }
+        done = true;
+    });
+
+    AudioBuffer out(300, AudioFormat::MONO());
+    unsigned torn = 0;
+    while (not done) {
+        const auto n = rb.get(out, reader);
+        const auto chan = out.getChannel(0);
+        size_t f = 0;
+        while (f < n and chan[f] == 0)
+            ++f;
+        for (++f; f < n; ++f)
+            if (AudioSample(chan[f - 1] + 1) != chan[f])
+                ++torn;
+    }
+    writer.join();
+
+    CPPUNIT_ASSERT_EQUAL(0u, torn);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::LockFreeRingBufferTest::name());
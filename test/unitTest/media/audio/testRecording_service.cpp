@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/audiorecord.h"
+#include "media/audio/recording_service.h"
+#include "media/audio/ringbufferpool.h"
+#include "media/audio/ringbuffer.h"
+#include "fileutils.h"
+
+#include <sndfile.hh>
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace ring { namespace test {
+
+class RecordingServiceTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "recording_service"; }
+
+    void setUp();
+    void tearDown();
+
+private:
+    void orderTest();
+    void compressedResumeTest();
+
+    CPPUNIT_TEST_SUITE(RecordingServiceTest);
+    CPPUNIT_TEST(orderTest);
+    CPPUNIT_TEST(compressedResumeTest);
+    CPPUNIT_TEST_SUITE_END();
+
+    std::string dir_;
+    RingBufferPool pool_;
+    std::shared_ptr<RingBuffer> source_;
+    std::unique_ptr<RecordingService> service_;
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(RecordingServiceTest, RecordingServiceTest::name());
+
+void
+RecordingServiceTest::setUp()
+{
+    char template_name[] = {"ring_unit_tests_XXXXXX"};
+    auto directory = mkdtemp(template_name);
+    CPPUNIT_ASSERT(directory);
+    dir_ = directory;
+
+    source_ = pool_.createRingBuffer("source");
+    service_.reset(new RecordingService);
+}
+
+void
+RecordingServiceTest::tearDown()
+{
+    service_.reset();
+    source_.reset();
+    fileutils::removeAll(dir_);
+}
+
+// 1.5 chunk of a ramp, at the pace of a call: one chunk is written while
+// recording, the rest only when the recording stops.
+void
+RecordingServiceTest::orderTest()
+{
+    const auto format = pool_.getInternalAudioFormat();
+    AudioRecord rec(pool_, *service_);
+    rec.setRecordingOptions(format, dir_, "wav");
+    rec.initFilename("order");
+    pool_.bindHalfDuplexOut(rec.getRecorderID(), "source");
+    CPPUNIT_ASSERT(rec.toggleRecording());
+
+    const size_t blockFrames = format.sample_rate / 50; // 20 ms
+    const size_t chunkFrames = format.sample_rate * RecordingService::CHUNK_DURATION.count() / 1000;
+    const size_t total = chunkFrames + chunkFrames / 2;
+    AudioBuffer block(blockFrames, format);
+    AudioSample next = 0;
+    for (size_t put = 0; put < total; put += blockFrames) {
+        for (unsigned c = 0; c < format.nb_channels; ++c)
+            for (size_t i = 0; i < blockFrames; ++i)
+                block.getChannel(c)[i] = next + i;
+        next += blockFrames;
+        source_->put(block);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(1), service_->recordingCount());
+
+    rec.closeFile();
+    pool_.unBindHalfDuplexOut(rec.getRecorderID(), "source");
+    CPPUNIT_ASSERT_EQUAL(size_t(0), service_->recordingCount());
+    const auto stats = service_->getStats();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.droppedFrames);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(total), stats.writtenFrames);
+
+    SndfileHandle file(rec.getFilename());
+    CPPUNIT_ASSERT_EQUAL(sf_count_t(total), file.frames());
+    std::vector<AudioSample> samples(total * format.nb_channels);
+    CPPUNIT_ASSERT_EQUAL(sf_count_t(samples.size()), file.read(samples.data(), samples.size()));
+    for (size_t i = 0; i < total; ++i)
+        CPPUNIT_ASSERT_EQUAL(AudioSample(i), samples[i * format.nb_channels]);
+}
+
+// compressed files can't be appended to, resuming writes a new one
+void
+RecordingServiceTest::compressedResumeTest()
+{
+    AudioRecord rec(pool_, *service_);
+    rec.setRecordingOptions(pool_.getInternalAudioFormat(), dir_, "flac");
+    rec.initFilename("resume");
+
+    CPPUNIT_ASSERT(rec.toggleRecording());
+    rec.closeFile();
+    const auto first = rec.getFilename();
+
+    CPPUNIT_ASSERT(rec.toggleRecording());
+    rec.closeFile();
+    const auto second = rec.getFilename();
+
+    CPPUNIT_ASSERT(first != second);
+    CPPUNIT_ASSERT(fileutils::isFile(first));
+    CPPUNIT_ASSERT(fileutils::isFile(second));
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::RecordingServiceTest::name());
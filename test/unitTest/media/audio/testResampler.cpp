@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/audio/resampler.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+class ResamplerTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "resampler"; }
+
+private:
+    void ratiosTest();
+    void antiAliasingTest();
+
+    CPPUNIT_TEST_SUITE(ResamplerTest);
+    CPPUNIT_TEST(ratiosTest);
+    CPPUNIT_TEST(antiAliasingTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ResamplerTest, ResamplerTest::name());
+
+// Resample one second of a stereo tone, 20ms at a time
+static std::vector<AudioSample>
+resampleTone(unsigned inRate, unsigned outRate, double freq)
+{
+    Resampler resampler(AudioFormat(outRate, 2));
+    std::vector<AudioSample> out;
+    const size_t chunk = inRate / 50;
+    for (unsigned i = 0; i < 50; ++i) {
+        AudioBuffer in(chunk, AudioFormat(inRate, 2));
+        for (size_t j = 0; j < chunk; ++j) {
+            const double t = static_cast<double>(i * chunk + j) / inRate;
+            in.getChannel(0)[j] = in.getChannel(1)[j] = 16384 * std::sin(2 * 3.141592653589793 * freq * t);
+        }
+        AudioBuffer res(0, AudioFormat(outRate, 2));
+        resampler.resample(in, res);
+        for (size_t j = 0; j < res.frames(); ++j)
+            CPPUNIT_ASSERT(res.getChannel(0)[j] == res.getChannel(1)[j]);
+        out.insert(out.end(), res.getChannel(0), res.getChannel(0) + res.frames());
+    }
+    return out;
+}
+
+static double
+rms(const std::vector<AudioSample>& v, size_t from)
+{
+    double sum = 0;
+    for (size_t i = from; i < v.size(); ++i)
+        sum += static_cast<double>(v[i]) * v[i];
+    return std::sqrt(sum / (v.size() - from));
+}
+
+void
+ResamplerTest::ratiosTest()
+{
+    const std::vector<std::pair<unsigned, unsigned>> ratios {
+        {48000, 8000}, {8000, 48000}, {44100, 48000}, {48000, 44100}, {16000, 44100}
+    };
+    for (const auto& r : ratios) {
+        const auto out = resampleTone(r.first, r.second, 440);
+        CPPUNIT_ASSERT(out.size() + 1 >= r.second and out.size() <= r.second + 1);
+
+        // same level and frequency, once the filter is primed
+        const size_t skip = r.second / 10;
+        CPPUNIT_ASSERT(std::abs(rms(out, skip) - 16384 / std::sqrt(2.)) < 16384 * .02);
+        unsigned crossings = 0;
+        for (size_t i = skip + 1; i < out.size(); ++i)
+            crossings += (out[i - 1] < 0) != (out[i] < 0);
+        const double freq = crossings / 2. * r.second / (out.size() - skip - 1);
+        CPPUNIT_ASSERT(std::abs(freq - 440) < 3);
+    }
+}
+
+void
+ResamplerTest::antiAliasingTest()
+{
+    // above the 4kHz output Nyquist frequency: filtered out
+    const auto out = resampleTone(48000, 8000, 6000);
+    CPPUNIT_ASSERT(rms(out, 800) < 16384 * .01);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::ResamplerTest::name());
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/congestion_controller.h"
+
+namespace ring { namespace test {
+
+using namespace std::chrono;
+
+class CongestionControllerTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "congestion_controller"; }
+
+private:
+    void increaseTest();
+    void delayTest();
+    void lossTest();
+
+    CPPUNIT_TEST_SUITE(CongestionControllerTest);
+    CPPUNIT_TEST(increaseTest);
+    CPPUNIT_TEST(delayTest);
+    CPPUNIT_TEST(lossTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(CongestionControllerTest, CongestionControllerTest::name());
+
+static const CongestionController::clock::time_point T0 = CongestionController::clock::now();
+
+static CongestionController::clock::time_point
+at(int s)
+{
+    return T0 + seconds(s);
+}
+
+void
+CongestionControllerTest::increaseTest()
+{
+    CongestionController cc(500, 200, 2000);
+
+    // clean link: grows every report, never past the maximum
+    unsigned previous = cc.getBitrate();
+    for (int t = 0; t < 10; ++t) {
+        const auto bitrate = cc.onReceiverReport(0, milliseconds(40), at(t));
+        CPPUNIT_ASSERT(bitrate > previous);
+        previous = bitrate;
+    }
+    for (int t = 10; t < 60; ++t)
+        cc.onReceiverReport(0, milliseconds(40), at(t));
+    CPPUNIT_ASSERT_EQUAL(2000u, cc.getBitrate());
+
+    // unknown RTT is not an overuse
+    CPPUNIT_ASSERT_EQUAL(2000u, cc.onReceiverReport(0, microseconds(-1), at(60)));
+}
+
+void
+CongestionControllerTest::delayTest()
+{
+    CongestionController cc(1000, 200, 2000);
+    cc.onReceiverReport(0, milliseconds(40), at(0));
+    const auto before = cc.getBitrate();
+
+    // growing queue without any loss
+    int t = 1;
+    for (auto rtt : {60, 100, 150})
+        cc.onReceiverReport(0, milliseconds(rtt), at(t++));
+    auto stats = cc.getStats();
+    CPPUNIT_ASSERT(stats.bitrate < before);
+    CPPUNIT_ASSERT(stats.decreases > 0);
+    CPPUNIT_ASSERT(stats.queuingDelay == milliseconds(110));
+    CPPUNIT_ASSERT(stats.capacity > 0);
+
+    // queue drained: increase again, slowly once near the capacity
+    const auto capacity = stats.capacity;
+    auto bitrate = stats.bitrate;
+    while (bitrate <= 0.9 * capacity) {
+        const auto next = cc.onReceiverReport(0, milliseconds(40), at(t++));
+        CPPUNIT_ASSERT(next > bitrate);
+        bitrate = next;
+    }
+    const auto next = cc.onReceiverReport(0, milliseconds(40), at(t++));
+    CPPUNIT_ASSERT(next > bitrate);
+    CPPUNIT_ASSERT(next < bitrate * 1.05);
+}
+
+void
+CongestionControllerTest::lossTest()
+{
+    CongestionController cc(1000, 200, 2000);
+
+    // some loss: hold
+    CPPUNIT_ASSERT_EQUAL(1000u, cc.onReceiverReport(0.05, milliseconds(40), at(0)));
+    CPPUNIT_ASSERT(cc.getStats().state == CongestionController::State::HOLD);
+
+    // high loss: decrease, down to the minimum
+    CPPUNIT_ASSERT_EQUAL(800u, cc.onReceiverReport(0.4, milliseconds(40), at(1)));
+    for (int t = 2; t < 10; ++t)
+        cc.onReceiverReport(0.5, milliseconds(40), at(t));
+    CPPUNIT_ASSERT_EQUAL(200u, cc.getBitrate());
+
+    // reset forgets everything
+    cc.reset(700, 300, 1500);
+    const auto stats = cc.getStats();
+    CPPUNIT_ASSERT_EQUAL(700u, stats.bitrate);
+    CPPUNIT_ASSERT_EQUAL(0u, stats.reports);
+    CPPUNIT_ASSERT_EQUAL(0u, stats.capacity);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::CongestionControllerTest::name());
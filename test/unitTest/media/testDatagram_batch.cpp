@@ -0,0 +1,130 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/datagram_batch.h"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace ring { namespace test {
+
+class DatagramBatchTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "datagram_batch"; }
+
+    void setUp();
+    void tearDown();
+
+private:
+    void sendReceiveTest();
+
+    CPPUNIT_TEST_SUITE(DatagramBatchTest);
+    CPPUNIT_TEST(sendReceiveTest);
+    CPPUNIT_TEST_SUITE_END();
+
+    int tx_ {-1};
+    int rx_ {-1};
+    sockaddr_in dest_ {};
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(DatagramBatchTest, DatagramBatchTest::name());
+
+static constexpr size_t RTP_SIZE {1200};
+
+void
+DatagramBatchTest::setUp()
+{
+    tx_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    rx_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    CPPUNIT_ASSERT(tx_ >= 0 and rx_ >= 0);
+
+    dest_.sin_family = AF_INET;
+    dest_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CPPUNIT_ASSERT(bind(rx_, reinterpret_cast<sockaddr*>(&dest_), sizeof(dest_)) == 0);
+    socklen_t len = sizeof(dest_);
+    getsockname(rx_, reinterpret_cast<sockaddr*>(&dest_), &len);
+}
+
+void
+DatagramBatchTest::tearDown()
+{
+    close(tx_);
+    close(rx_);
+}
+
+void
+DatagramBatchTest::sendReceiveTest()
+{
+    const auto dest = reinterpret_cast<const sockaddr*>(&dest_);
+
+    // a video frame: full packets and a shorter last one, then an audio packet
+    DatagramBatch out;
+    std::vector<size_t> sizes {RTP_SIZE, RTP_SIZE, RTP_SIZE, 700, 160};
+    for (size_t i = 0; i < sizes.size(); ++i)
+        CPPUNIT_ASSERT(out.push(std::vector<uint8_t>(sizes[i], i).data(), sizes[i]));
+    CPPUNIT_ASSERT(not out.push(std::vector<uint8_t>(4096).data(), 4096));
+    CPPUNIT_ASSERT_EQUAL(5, out.send(tx_, dest, sizeof(dest_)));
+    CPPUNIT_ASSERT(out.empty());
+
+    // datagrams keep their boundaries and order
+    DatagramBatch in;
+    unsigned received = 0;
+    while (received < sizes.size()) {
+        pollfd p = {rx_, POLLIN, 0};
+        CPPUNIT_ASSERT(poll(&p, 1, 1000) > 0);
+        // -1 and EAGAIN if the datagrams are not all there yet
+        const int n = in.receive(rx_);
+        CPPUNIT_ASSERT(n > 0 or errno == EAGAIN);
+        if (n > 0)
+            received += n;
+    }
+    CPPUNIT_ASSERT_EQUAL(5u, in.size());
+    for (unsigned i = 0; i < in.size(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(sizes[i], in.length(i));
+        CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(i), in.data(i)[sizes[i] - 1]);
+    }
+
+    // popped like recv(), truncated to the buffer
+    uint8_t buf[100];
+    CPPUNIT_ASSERT_EQUAL(100, in.pop(buf, sizeof(buf)));
+    CPPUNIT_ASSERT_EQUAL(4u, in.size());
+    CPPUNIT_ASSERT_EQUAL(RTP_SIZE, in.length(0));
+    CPPUNIT_ASSERT_EQUAL(1, static_cast<int>(in.data(0)[0]));
+    CPPUNIT_ASSERT_EQUAL(-1, in.receive(rx_));
+    CPPUNIT_ASSERT_EQUAL(EAGAIN, errno);
+
+    const auto stats = out.getStats();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(5), stats.datagrams);
+#ifdef __linux__
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), stats.syscalls);
+#endif
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::DatagramBatchTest::name());
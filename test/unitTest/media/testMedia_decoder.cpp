@@ -0,0 +1,120 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/media_decoder.h"
+
+namespace ring { namespace test {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+class MediaDecoderTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "media_decoder"; }
+
+private:
+    void percentileTest();
+    void sinceTest();
+    void frameThreadsTest();
+
+    CPPUNIT_TEST_SUITE(MediaDecoderTest);
+    CPPUNIT_TEST(percentileTest);
+    CPPUNIT_TEST(sinceTest);
+    CPPUNIT_TEST(frameThreadsTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(MediaDecoderTest, MediaDecoderTest::name());
+
+static DecodeTimeHistogram
+histogram(std::initializer_list<std::pair<microseconds, unsigned>> calls)
+{
+    DecodeTimeHistogram h;
+    for (const auto& c : calls)
+        for (unsigned i = 0; i < c.second; ++i)
+            h.add(c.first);
+    return h;
+}
+
+void
+MediaDecoderTest::percentileTest()
+{
+    CPPUNIT_ASSERT(DecodeTimeHistogram().percentile(0.9) == microseconds(0));
+
+    // interpolated in the [4ms, 8ms) bucket, at most the longest call
+    auto h = histogram({{milliseconds(5), 50}, {milliseconds(7), 50}});
+    CPPUNIT_ASSERT_EQUAL(uint64_t(100), h.count());
+    CPPUNIT_ASSERT_EQUAL(int64_t(6000), int64_t(h.percentile(0.5).count()));
+    CPPUNIT_ASSERT_EQUAL(int64_t(7000), int64_t(h.percentile(0.9).count()));
+
+    // within the bucket reached, not its upper bound
+    h = histogram({{microseconds(1500), 80}, {microseconds(30000), 20}});
+    CPPUNIT_ASSERT_EQUAL(int64_t(1000 + 1000 * 80 / 80), int64_t(h.percentile(0.8).count()));
+    CPPUNIT_ASSERT_EQUAL(int64_t(16000 + 16000 * 10 / 20), int64_t(h.percentile(0.9).count()));
+    CPPUNIT_ASSERT_EQUAL(int64_t(30000), int64_t(h.percentile(1).count()));
+
+    // beyond the last bound
+    h = histogram({{milliseconds(100), 10}, {milliseconds(300), 10}});
+    CPPUNIT_ASSERT_EQUAL(int64_t(300000), int64_t(h.percentile(1).count()));
+    CPPUNIT_ASSERT(h.percentile(0.75) > milliseconds(100));
+    CPPUNIT_ASSERT(h.percentile(0.75) < milliseconds(300));
+}
+
+void
+MediaDecoderTest::sinceTest()
+{
+    auto h = histogram({{milliseconds(50), 100}});
+    const auto earlier = h;
+    for (unsigned i = 0; i < 10; ++i)
+        h.add(microseconds(500));
+
+    const auto recent = h.since(earlier);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(10), recent.count());
+    CPPUNIT_ASSERT(recent.percentile(0.9) < milliseconds(1));
+}
+
+// frame threads only when slices are too slow for the frame rate
+void
+MediaDecoderTest::frameThreadsTest()
+{
+    const auto frameTime = milliseconds(25); // 40 fps
+
+    // in the [16ms, 32ms) bucket but fast enough
+    const auto fast = histogram({{milliseconds(17), 100}});
+    CPPUNIT_ASSERT(not needsFrameThreads(fast, frameTime, 8));
+
+    // a tenth of the frames too slow
+    const auto slow = histogram({{milliseconds(10), 85}, {milliseconds(40), 15}});
+    CPPUNIT_ASSERT(needsFrameThreads(slow, frameTime, 8));
+
+    // but not enough cores to spare
+    CPPUNIT_ASSERT(not needsFrameThreads(slow, frameTime, 2));
+
+    // nothing decoded
+    CPPUNIT_ASSERT(not needsFrameThreads(DecodeTimeHistogram(), frameTime, 8));
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::MediaDecoderTest::name());
@@ -0,0 +1,238 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/srtp_aead.h"
+#include "base64.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+namespace ring { namespace test {
+
+class SrtpAeadTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "srtp_aead"; }
+
+private:
+    void knownAnswerTest();
+    void protectTest();
+    void rolloverTest();
+    void replayTest();
+
+    CPPUNIT_TEST_SUITE(SrtpAeadTest);
+    CPPUNIT_TEST(knownAnswerTest);
+    CPPUNIT_TEST(protectTest);
+    CPPUNIT_TEST(rolloverTest);
+    CPPUNIT_TEST(replayTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(SrtpAeadTest, SrtpAeadTest::name());
+
+static constexpr size_t RTP_SIZE {1200};
+
+static std::string
+makeKey(size_t size, uint8_t seed)
+{
+    std::vector<uint8_t> key(size);
+    for (size_t i = 0; i < size; ++i)
+        key[i] = seed + i;
+    return base64::encode(key);
+}
+
+// RTP packet with room for the SRTP trailer
+static std::vector<uint8_t>
+makePacket(uint16_t seq, size_t size = RTP_SIZE, unsigned csrcs = 0)
+{
+    std::vector<uint8_t> packet(size + SrtpAead::TAG_SIZE);
+    packet[0] = 0x80 | csrcs;
+    packet[1] = 96;
+    packet[2] = seq >> 8;
+    packet[3] = seq;
+    packet[8] = 0x12; packet[9] = 0x34; packet[10] = 0x56; packet[11] = 0x78;
+    for (size_t i = 12; i < size; ++i)
+        packet[i] = i;
+    return packet;
+}
+
+static std::vector<uint8_t>
+fromHex(const std::string& hex)
+{
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        bytes.push_back(std::stoi(hex.substr(i, 2), nullptr, 16));
+    return bytes;
+}
+
+// RFC 7714 sections 16.1.1 and 16.2.1
+void
+SrtpAeadTest::knownAnswerTest()
+{
+    const std::array<uint8_t, 12> salt {{0x51, 0x75, 0x69, 0x64, 0x20, 0x70, 0x72, 0x6f, 0x20, 0x71, 0x75, 0x6f}};
+    const auto rtp = fromHex("8040f17b8041f8d35501a0b247616c6c696120657374206f"
+                             "6d6e69732064697669736120696e207061727465732074726573");
+    const struct {
+        const char* suite;
+        std::string key;
+        std::string srtp;
+    } vectors[] = {
+        {"AEAD_AES_128_GCM", "000102030405060708090a0b0c0d0e0f",
+         "8040f17b8041f8d35501a0b2f24de3a3fb34de6cacba861c9d7e4bcabe633bd5"
+         "0d294e6f42a5f47a51c7d19b36de3adf8833899d7f27beb16a9152cf765ee4390cce"},
+        {"AEAD_AES_256_GCM", "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+         "8040f17b8041f8d35501a0b232b1de78a822fe12ef9f78fa332e33aab1801238"
+         "9a58e2f3b50b2a0276ffae0f1ba63799b87b7aa3db36dfffd6b0f9bb7878d7a76c13"},
+    };
+
+    for (const auto& v : vectors) {
+        const auto expected = fromHex(v.srtp);
+        CPPUNIT_ASSERT_EQUAL(rtp.size() + SrtpAead::TAG_SIZE, expected.size());
+
+        SrtpAead sender(v.suite, fromHex(v.key), salt);
+        auto packet = rtp;
+        packet.resize(rtp.size() + SrtpAead::TAG_SIZE);
+        CPPUNIT_ASSERT_EQUAL(int(expected.size()), sender.protect(packet.data(), rtp.size()));
+        CPPUNIT_ASSERT(packet == expected);
+
+        SrtpAead receiver(v.suite, fromHex(v.key), salt);
+        CPPUNIT_ASSERT_EQUAL(int(rtp.size()), receiver.unprotect(packet.data(), packet.size()));
+        CPPUNIT_ASSERT(std::equal(rtp.begin(), rtp.end(), packet.begin()));
+    }
+}
+
+void
+SrtpAeadTest::protectTest()
+{
+    CPPUNIT_ASSERT(SrtpAead::isSupported("AEAD_AES_128_GCM"));
+    CPPUNIT_ASSERT(SrtpAead::isSupported("AEAD_AES_256_GCM"));
+    CPPUNIT_ASSERT(not SrtpAead::isSupported("AES_CM_128_HMAC_SHA1_80"));
+    CPPUNIT_ASSERT_THROW(SrtpAead("AEAD_AES_128_GCM", makeKey(16, 1)), std::runtime_error);
+
+    for (const auto& suite : {std::make_pair("AEAD_AES_128_GCM", 16), std::make_pair("AEAD_AES_256_GCM", 32)}) {
+        const auto key = makeKey(suite.second + 12, 1);
+        SrtpAead sender(suite.first, key);
+        SrtpAead receiver(suite.first, key);
+        SrtpAead other(suite.first, makeKey(suite.second + 12, 2));
+
+        // the header and its CSRCs stay in clear, the payload is encrypted
+        const auto plain = makePacket(1, 300, 2);
+        auto packet = plain;
+        CPPUNIT_ASSERT_EQUAL(300 + int(SrtpAead::TAG_SIZE), sender.protect(packet.data(), 300));
+        CPPUNIT_ASSERT(std::equal(packet.begin(), packet.begin() + 20, plain.begin()));
+        CPPUNIT_ASSERT(not std::equal(packet.begin() + 20, packet.begin() + 300, plain.begin() + 20));
+
+        // forged packets are rejected
+        auto copy = packet;
+        CPPUNIT_ASSERT_EQUAL(-1, other.unprotect(copy.data(), copy.size()));
+        for (const auto offset : {1, 17, 150, 310}) {
+            copy = packet;
+            copy[offset] ^= 1;
+            CPPUNIT_ASSERT_EQUAL(-1, receiver.unprotect(copy.data(), copy.size()));
+        }
+
+        CPPUNIT_ASSERT_EQUAL(300, receiver.unprotect(packet.data(), packet.size()));
+        CPPUNIT_ASSERT(std::equal(packet.begin(), packet.begin() + 300, plain.begin()));
+    }
+
+    // not RTP
+    SrtpAead srtp("AEAD_AES_128_GCM", makeKey(28, 1));
+    std::vector<uint8_t> packet(64);
+    CPPUNIT_ASSERT_EQUAL(-1, srtp.protect(packet.data(), 8));
+    packet[0] = 0x80 | 15;
+    CPPUNIT_ASSERT_EQUAL(-1, srtp.protect(packet.data(), 40));
+}
+
+// packet index across the 16 bits sequence number wrap (RFC 3711 section 3.3.1)
+void
+SrtpAeadTest::rolloverTest()
+{
+    const auto key = makeKey(28, 1);
+    SrtpAead sender("AEAD_AES_128_GCM", key);
+    SrtpAead receiver("AEAD_AES_128_GCM", key);
+
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint16_t seq = 65530; seq != 10; ++seq) {
+        packets.emplace_back(makePacket(seq, 200));
+        CPPUNIT_ASSERT(sender.protect(packets.back().data(), 200) > 0);
+    }
+
+    // reordered around the wrap
+    std::swap(packets[5], packets[6]);
+    std::swap(packets[7], packets[8]);
+
+    // and 65533, of the previous cycle, comes last
+    auto late = packets[3];
+    packets.erase(packets.begin() + 3);
+    for (auto& packet : packets)
+        CPPUNIT_ASSERT_EQUAL(200, receiver.unprotect(packet.data(), packet.size()));
+    CPPUNIT_ASSERT_EQUAL(200, receiver.unprotect(late.data(), late.size()));
+
+    // then a packet of the current one
+    auto packet = makePacket(10, 200);
+    CPPUNIT_ASSERT(sender.protect(packet.data(), 200) > 0);
+    CPPUNIT_ASSERT_EQUAL(200, receiver.unprotect(packet.data(), packet.size()));
+}
+
+// RFC 3711 section 3.3.2
+void
+SrtpAeadTest::replayTest()
+{
+    const auto key = makeKey(28, 1);
+    SrtpAead sender("AEAD_AES_128_GCM", key);
+    SrtpAead receiver("AEAD_AES_128_GCM", key);
+
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint16_t seq = 65500; seq != 100; ++seq) {
+        packets.emplace_back(makePacket(seq, 200));
+        CPPUNIT_ASSERT(sender.protect(packets.back().data(), 200) > 0);
+    }
+
+    // in order across the wrap, but for two delayed packets,
+    // each replayed at once
+    const size_t old = 30;
+    const size_t late = packets.size() - 10;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        if (i == old or i == late)
+            continue;
+        auto copy = packets[i];
+        CPPUNIT_ASSERT_EQUAL(200, receiver.unprotect(copy.data(), copy.size()));
+        copy = packets[i];
+        CPPUNIT_ASSERT_EQUAL(-1, receiver.unprotect(copy.data(), copy.size()));
+    }
+
+    // out of the replay list, even though never received
+    CPPUNIT_ASSERT_EQUAL(-1, receiver.unprotect(packets[old].data(), packets[old].size()));
+
+    // within the list, accepted once
+    auto copy = packets[late];
+    CPPUNIT_ASSERT_EQUAL(200, receiver.unprotect(copy.data(), copy.size()));
+    copy = packets[late];
+    CPPUNIT_ASSERT_EQUAL(-1, receiver.unprotect(copy.data(), copy.size()));
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::SrtpAeadTest::name());
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/video/keyframe_scheduler.h"
+
+namespace ring { namespace video { namespace test {
+
+using namespace std::chrono;
+
+class KeyframeSchedulerTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "keyframe_scheduler"; }
+
+private:
+    void startTest();
+    void coalesceTest();
+    void intraRefreshTest();
+
+    CPPUNIT_TEST_SUITE(KeyframeSchedulerTest);
+    CPPUNIT_TEST(startTest);
+    CPPUNIT_TEST(coalesceTest);
+    CPPUNIT_TEST(intraRefreshTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(KeyframeSchedulerTest, KeyframeSchedulerTest::name());
+
+static const KeyframeScheduler::clock::time_point T0 = KeyframeScheduler::clock::now();
+
+static KeyframeScheduler::clock::time_point
+at(int ms)
+{
+    return T0 + milliseconds(ms);
+}
+
+void
+KeyframeSchedulerTest::startTest()
+{
+    KeyframeScheduler keyframes(2);
+
+    // local requests are never delayed
+    CPPUNIT_ASSERT(keyframes.next(false, at(0)));
+    CPPUNIT_ASSERT(keyframes.next(false, at(33)));
+    CPPUNIT_ASSERT(not keyframes.next(false, at(66)));
+    keyframes.request(KeyframeRequest::LOCAL);
+    CPPUNIT_ASSERT(keyframes.next(false, at(100)));
+    CPPUNIT_ASSERT(not keyframes.next(false, at(133)));
+
+    // periodic keyframes
+    CPPUNIT_ASSERT(keyframes.next(true, at(166)));
+    CPPUNIT_ASSERT_EQUAL(4u, keyframes.getStats().keyframes);
+}
+
+void
+KeyframeSchedulerTest::coalesceTest()
+{
+    KeyframeScheduler keyframes(0, milliseconds(500));
+    CPPUNIT_ASSERT(not keyframes.next(false, at(0)));
+
+    // a storm of requests from several peers: one keyframe at once...
+    keyframes.request(KeyframeRequest::RTCP);
+    keyframes.request(KeyframeRequest::SIP_INFO);
+    CPPUNIT_ASSERT(keyframes.next(false, at(1000)));
+
+    // ...then at most one per interval for all the requests received meanwhile
+    int produced = 0;
+    for (int t = 1033; t < 2000; t += 33) {
+        keyframes.request(KeyframeRequest::RTCP);
+        if (keyframes.next(false, at(t)))
+            ++produced;
+    }
+    CPPUNIT_ASSERT_EQUAL(1, produced);
+
+    const auto stats = keyframes.getStats();
+    CPPUNIT_ASSERT_EQUAL(2u, stats.keyframes);
+    CPPUNIT_ASSERT_EQUAL(1u, stats.sipRequests);
+    CPPUNIT_ASSERT_EQUAL(stats.requests, stats.sipRequests + stats.rtcpRequests);
+    // only the first request after each keyframe waits for the next one
+    CPPUNIT_ASSERT_EQUAL(stats.requests - 3, stats.coalesced);
+
+    // a periodic keyframe answers the pending request
+    keyframes.request(KeyframeRequest::RTCP);
+    CPPUNIT_ASSERT(keyframes.next(true, at(2000)));
+    CPPUNIT_ASSERT(not keyframes.next(false, at(3000)));
+}
+
+void
+KeyframeSchedulerTest::intraRefreshTest()
+{
+    KeyframeScheduler keyframes(1);
+    keyframes.setIntraRefresh(true);
+    CPPUNIT_ASSERT(keyframes.next(false, at(0)));
+
+    // the encoder repairs losses itself
+    keyframes.request(KeyframeRequest::RTCP);
+    keyframes.request(KeyframeRequest::SIP_INFO);
+    CPPUNIT_ASSERT(not keyframes.next(false, at(1000)));
+
+    // new peers still start on a keyframe
+    keyframes.request(KeyframeRequest::LOCAL);
+    CPPUNIT_ASSERT(keyframes.next(false, at(1033)));
+
+    const auto stats = keyframes.getStats();
+    CPPUNIT_ASSERT_EQUAL(2u, stats.refreshed);
+    CPPUNIT_ASSERT_EQUAL(2u, stats.keyframes);
+}
+
+}}} // namespace ring::video::test
+
+RING_TEST_RUNNER(ring::video::test::KeyframeSchedulerTest::name());
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/media_buffer.h"
+#include "media/libav_utils.h"
+#include "media/video/video_scaler.h"
+
+namespace ring { namespace video { namespace test {
+
+class ScalingCacheTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "scaling_cache"; }
+
+    void setUp();
+
+private:
+    void passthroughTest();
+    void sharedTest();
+    void halveTest();
+
+    CPPUNIT_TEST_SUITE(ScalingCacheTest);
+    CPPUNIT_TEST(passthroughTest);
+    CPPUNIT_TEST(sharedTest);
+    CPPUNIT_TEST(halveTest);
+    CPPUNIT_TEST_SUITE_END();
+
+    int format_;
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ScalingCacheTest, ScalingCacheTest::name());
+
+void
+ScalingCacheTest::setUp()
+{
+    format_ = libav_utils::libav_pixel_format(VIDEO_PIXFMT_YUV420P);
+}
+
+// Y is x + y, chroma is flat
+static std::shared_ptr<VideoFrame>
+makeInput(int width, int height)
+{
+    auto frame = std::make_shared<VideoFrame>();
+    frame->reserve(VIDEO_PIXFMT_YUV420P, width, height);
+    auto f = frame->pointer();
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            f->data[0][y * f->linesize[0] + x] = x + y;
+    for (int plane = 1; plane < 3; ++plane)
+        for (int y = 0; y < height / 2; ++y)
+            for (int x = 0; x < width / 2; ++x)
+                f->data[plane][y * f->linesize[plane] + x] = 128;
+    return frame;
+}
+
+void
+ScalingCacheTest::passthroughTest()
+{
+    auto& cache = ScalingCache::instance();
+    const int source = 0;
+    const auto input = makeInput(64, 48);
+    const auto before = cache.getStats();
+
+    CPPUNIT_ASSERT(cache.get(&source, input, 64, 48, format_) == input);
+    const auto stats = cache.getStats();
+    CPPUNIT_ASSERT_EQUAL(before.requests + 1, stats.requests);
+    CPPUNIT_ASSERT_EQUAL(before.passthrough + 1, stats.passthrough);
+    CPPUNIT_ASSERT_EQUAL(before.scaled, stats.scaled);
+}
+
+// a frame is scaled once for every consumer of the same size
+void
+ScalingCacheTest::sharedTest()
+{
+    auto& cache = ScalingCache::instance();
+    const int source = 0;
+    const auto input = makeInput(64, 48);
+    const auto before = cache.getStats();
+
+    const auto first = cache.get(&source, input, 48, 36, format_);
+    const auto second = cache.get(&source, input, 48, 36, format_);
+    CPPUNIT_ASSERT(first == second);
+    CPPUNIT_ASSERT_EQUAL(48, first->pointer()->width);
+    auto stats = cache.getStats();
+    CPPUNIT_ASSERT_EQUAL(before.scaled + 1, stats.scaled);
+    CPPUNIT_ASSERT_EQUAL(before.hits + 1, stats.hits);
+    CPPUNIT_ASSERT_EQUAL(before.halved, stats.halved);
+
+    // next frame of the source
+    const auto next = makeInput(64, 48);
+    CPPUNIT_ASSERT(cache.get(&source, next, 48, 36, format_) != first);
+    CPPUNIT_ASSERT_EQUAL(before.scaled + 2, cache.getStats().scaled);
+}
+
+void
+ScalingCacheTest::halveTest()
+{
+    auto& cache = ScalingCache::instance();
+    const int source = 0;
+    const auto input = makeInput(64, 48);
+    const auto before = cache.getStats();
+
+    const auto output = cache.get(&source, input, 32, 24, format_);
+    CPPUNIT_ASSERT_EQUAL(before.halved + 1, cache.getStats().halved);
+
+    // rounded mean of 2x + 2y, 2x + 2y + 1 (twice) and 2x + 2y + 2
+    const auto f = output->pointer();
+    for (int y = 0; y < 24; ++y)
+        for (int x = 0; x < 32; ++x)
+            CPPUNIT_ASSERT_EQUAL(2 * x + 2 * y + 1, (int)f->data[0][y * f->linesize[0] + x]);
+    for (int plane = 1; plane < 3; ++plane)
+        for (int y = 0; y < 12; ++y)
+            for (int x = 0; x < 16; ++x)
+                CPPUNIT_ASSERT_EQUAL(128, (int)f->data[plane][y * f->linesize[plane] + x]);
+}
+
+}}} // namespace ring::video::test
+
+RING_TEST_RUNNER(ring::video::test::ScalingCacheTest::name());
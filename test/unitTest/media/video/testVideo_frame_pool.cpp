@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "media/media_buffer.h"
+#include "media/video/video_base.h"
+
+namespace ring { namespace test {
+
+class VideoFramePoolTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "video_frame_pool"; }
+
+private:
+    void reuseTest();
+    void geometryTest();
+
+    CPPUNIT_TEST_SUITE(VideoFramePoolTest);
+    CPPUNIT_TEST(reuseTest);
+    CPPUNIT_TEST(geometryTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(VideoFramePoolTest, VideoFramePoolTest::name());
+
+// a released buffer is handed to the next frame of the same geometry
+void
+VideoFramePoolTest::reuseTest()
+{
+    const auto before = videoFramePoolStats();
+    {
+        VideoFrame frame;
+        frame.reserve(video::VIDEO_PIXFMT_YUV420P, 320, 240);
+    }
+    const auto first = videoFramePoolStats();
+    CPPUNIT_ASSERT_EQUAL(before.misses + 1, first.misses);
+
+    VideoFrame frame;
+    frame.reserve(video::VIDEO_PIXFMT_YUV420P, 320, 240);
+    const auto second = videoFramePoolStats();
+    CPPUNIT_ASSERT_EQUAL(first.misses, second.misses);
+    CPPUNIT_ASSERT_EQUAL(first.hits + 1, second.hits);
+
+    // same geometry and nobody else references the buffer: kept as is
+    const auto data = frame.pointer()->data[0];
+    frame.reserve(video::VIDEO_PIXFMT_YUV420P, 320, 240);
+    CPPUNIT_ASSERT(frame.pointer()->data[0] == data);
+    CPPUNIT_ASSERT_EQUAL(second.hits, videoFramePoolStats().hits);
+}
+
+// buffers of a frame still in use are never handed out again
+void
+VideoFramePoolTest::geometryTest()
+{
+    VideoFrame a, b;
+    a.reserve(video::VIDEO_PIXFMT_YUYV422, 176, 144);
+    const auto stats = videoFramePoolStats();
+    CPPUNIT_ASSERT(stats.pools >= 1);
+
+    b.reserve(video::VIDEO_PIXFMT_YUYV422, 176, 144);
+    CPPUNIT_ASSERT(a.pointer()->data[0] != b.pointer()->data[0]);
+    CPPUNIT_ASSERT_EQUAL(stats.misses + 1, videoFramePoolStats().misses);
+
+    b.reserve(video::VIDEO_PIXFMT_YUYV422, 352, 288);
+    CPPUNIT_ASSERT_EQUAL(stats.pools + 1, videoFramePoolStats().pools);
+    CPPUNIT_ASSERT_EQUAL(352, b.pointer()->width);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::VideoFramePoolTest::name());
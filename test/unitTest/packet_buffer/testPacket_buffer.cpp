@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "packet_buffer.h"
+#include "spsc_queue.h"
+
+#include <thread>
+#include <vector>
+
+namespace ring { namespace test {
+
+class PacketBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "packet_buffer"; }
+
+private:
+    void referenceTest();
+    void queueTest();
+
+    CPPUNIT_TEST_SUITE(PacketBufferTest);
+    CPPUNIT_TEST(referenceTest);
+    CPPUNIT_TEST(queueTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(PacketBufferTest, PacketBufferTest::name());
+
+void
+PacketBufferTest::referenceTest()
+{
+    const auto before = PacketBuffer::getStats();
+    const std::vector<uint8_t> datagram(1200, 0x42);
+    {
+        auto packet = PacketBuffer::copyOf(datagram.data(), datagram.size());
+        CPPUNIT_ASSERT_EQUAL(datagram.size(), packet.size());
+
+        // copies share the data
+        auto copy = packet;
+        CPPUNIT_ASSERT(copy.data() == packet.data());
+        auto moved = std::move(packet);
+        CPPUNIT_ASSERT(not packet);
+        CPPUNIT_ASSERT(moved.data() == copy.data());
+
+        uint8_t buf[100];
+        CPPUNIT_ASSERT_EQUAL(sizeof(buf), copy.copyTo(buf, sizeof(buf)));
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0x42), buf[99]);
+        CPPUNIT_ASSERT_EQUAL(before.inUse + 1, PacketBuffer::getStats().inUse);
+
+        auto large = PacketBuffer::copyOf(std::vector<uint8_t>(4000).data(), 4000);
+        CPPUNIT_ASSERT_EQUAL(size_t(4000), large.size());
+    }
+
+    // released buffers are reused, no new slab
+    std::vector<PacketBuffer> packets;
+    for (unsigned i = 0; i < PacketBuffer::SLAB_SIZE; ++i)
+        packets.emplace_back(PacketBuffer::copyOf(datagram.data(), datagram.size()));
+    packets.clear();
+    for (unsigned i = 0; i < PacketBuffer::SLAB_SIZE; ++i)
+        packets.emplace_back(PacketBuffer::copyOf(datagram.data(), datagram.size()));
+    packets.clear();
+
+    const auto after = PacketBuffer::getStats();
+    CPPUNIT_ASSERT_EQUAL(before.inUse, after.inUse);
+    CPPUNIT_ASSERT_EQUAL(before.packets + 2 + 2 * PacketBuffer::SLAB_SIZE, after.packets);
+    CPPUNIT_ASSERT_EQUAL(before.copiesOut + 1, after.copiesOut);
+    CPPUNIT_ASSERT_EQUAL(before.largePackets + 1, after.largePackets);
+    CPPUNIT_ASSERT(after.slabs <= before.slabs + 2);
+}
+
+// the path of a received datagram: reactor thread to consumer thread
+void
+PacketBufferTest::queueTest()
+{
+    constexpr unsigned PACKETS = 100000;
+    const auto before = PacketBuffer::getStats();
+    SpscQueue<PacketBuffer, 256> queue;
+
+    std::thread producer([&]{
+        for (uint32_t i = 0; i < PACKETS; ++i) {
+            auto packet = PacketBuffer::copyOf(&i, sizeof(i));
+            while (not queue.push(std::move(packet)))
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 0;
+    PacketBuffer packet;
+    while (expected < PACKETS) {
+        if (not queue.pop(packet)) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t value;
+        CPPUNIT_ASSERT_EQUAL(sizeof(value), packet.copyTo(&value, sizeof(value)));
+        CPPUNIT_ASSERT_EQUAL(expected++, value);
+    }
+    producer.join();
+    packet = {};
+    CPPUNIT_ASSERT(queue.empty());
+
+    // one copy in and one copy out per datagram, buffers bounded by the queue
+    const auto after = PacketBuffer::getStats();
+    CPPUNIT_ASSERT_EQUAL(before.packets + PACKETS, after.packets);
+    CPPUNIT_ASSERT_EQUAL(before.copiesOut + PACKETS, after.copiesOut);
+    CPPUNIT_ASSERT_EQUAL(before.inUse, after.inUse);
+    CPPUNIT_ASSERT(after.slabs * PacketBuffer::SLAB_SIZE <= 256 + 2 * PacketBuffer::SLAB_SIZE);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::PacketBufferTest::name());
@@ -0,0 +1,179 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "test_runner.h"
+
+#include "security/reorder_window.h"
+
+#include <vector>
+
+namespace ring { namespace test {
+
+using tls::ReorderWindow;
+
+class ReorderWindowTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "reorder_window"; }
+
+private:
+    void shuffledTest();
+    void overflowTest();
+    void timeoutTest();
+    void lateTest();
+
+    CPPUNIT_TEST_SUITE(ReorderWindowTest);
+    CPPUNIT_TEST(shuffledTest);
+    CPPUNIT_TEST(overflowTest);
+    CPPUNIT_TEST(timeoutTest);
+    CPPUNIT_TEST(lateTest);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ReorderWindowTest, ReorderWindowTest::name());
+
+static constexpr uint64_t BASE {1000};
+static constexpr auto TIMEOUT = std::chrono::milliseconds(1500);
+
+// the record of seq carries its low byte
+static ReorderWindow::Record
+record(uint64_t seq)
+{
+    return ReorderWindow::Record(10, seq & 0xff);
+}
+
+static std::vector<uint64_t>
+popAll(ReorderWindow& window, ReorderWindow::clock::time_point now)
+{
+    std::vector<uint64_t> out;
+    ReorderWindow::Record r;
+    while (window.pop(r, now))
+        out.push_back(r.front());
+    return out;
+}
+
+void
+ReorderWindowTest::shuffledTest()
+{
+    ReorderWindow window(8, TIMEOUT);
+    window.reset(BASE);
+    const auto now = ReorderWindow::clock::now();
+
+    // nothing comes out before the first record
+    for (const auto i : {3, 1, 4, 2}) {
+        CPPUNIT_ASSERT(window.push(BASE + i, record(BASE + i), now));
+        CPPUNIT_ASSERT(popAll(window, now).empty());
+    }
+    CPPUNIT_ASSERT(window.push(BASE, record(BASE), now));
+    const std::vector<uint64_t> expected {0xe8, 0xe9, 0xea, 0xeb, 0xec}; // 1000 to 1004
+    CPPUNIT_ASSERT(popAll(window, now) == expected);
+    CPPUNIT_ASSERT(window.empty());
+    CPPUNIT_ASSERT_EQUAL(BASE + 5, window.next());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), window.lost());
+
+    // duplicates are dropped
+    CPPUNIT_ASSERT(window.push(BASE + 6, record(BASE + 6), now));
+    CPPUNIT_ASSERT(not window.push(BASE + 6, record(BASE + 6), now));
+}
+
+// a record beyond the window pushes the oldest ones out, the missing ones are lost
+void
+ReorderWindowTest::overflowTest()
+{
+    ReorderWindow window(4, TIMEOUT);
+    window.reset(BASE);
+    const auto now = ReorderWindow::clock::now();
+
+    // BASE is missing
+    for (const auto i : {1, 2, 3})
+        CPPUNIT_ASSERT(window.push(BASE + i, record(BASE + i), now));
+    CPPUNIT_ASSERT(popAll(window, now).empty());
+
+    // BASE + 6 makes room from BASE + 3: BASE is lost, 1 and 2 are out
+    CPPUNIT_ASSERT(window.push(BASE + 6, record(BASE + 6), now));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), window.lost());
+    CPPUNIT_ASSERT_EQUAL(BASE + 3, window.next());
+    const std::vector<uint64_t> expected {0xe9, 0xea, 0xeb}; // 1001 to 1003
+    CPPUNIT_ASSERT(popAll(window, now) == expected);
+    CPPUNIT_ASSERT(not window.empty());
+
+    // far ahead: 4, 5 and 7 to 16 are lost, 6 is out
+    CPPUNIT_ASSERT(window.push(BASE + 20, record(BASE + 20), now));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1 + 2 + 10), window.lost());
+    const std::vector<uint64_t> last {0xee}; // 1006
+    CPPUNIT_ASSERT(popAll(window, now) == last);
+    CPPUNIT_ASSERT_EQUAL(BASE + 17, window.next());
+}
+
+// missing records are given up on once nothing was delivered for the timeout
+void
+ReorderWindowTest::timeoutTest()
+{
+    ReorderWindow window(8, TIMEOUT);
+    window.reset(BASE);
+    const auto start = ReorderWindow::clock::now();
+
+    CPPUNIT_ASSERT(window.push(BASE, record(BASE), start));
+    CPPUNIT_ASSERT(window.push(BASE + 3, record(BASE + 3), start));
+    CPPUNIT_ASSERT(window.push(BASE + 5, record(BASE + 5), start));
+    const std::vector<uint64_t> first {0xe8};
+    CPPUNIT_ASSERT(popAll(window, start) == first);
+
+    const auto later = start + TIMEOUT / 2;
+    CPPUNIT_ASSERT(popAll(window, later).empty());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), window.lost());
+
+    // BASE + 1 and 2 time out, then BASE + 4 is waited for again
+    const auto timeout = start + TIMEOUT;
+    const std::vector<uint64_t> second {0xeb}; // 1003
+    CPPUNIT_ASSERT(popAll(window, timeout) == second);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(2), window.lost());
+
+    const std::vector<uint64_t> third {0xed}; // 1005
+    CPPUNIT_ASSERT(popAll(window, timeout + TIMEOUT) == third);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(3), window.lost());
+    CPPUNIT_ASSERT(window.empty());
+}
+
+// records given up on are dropped when they finally come
+void
+ReorderWindowTest::lateTest()
+{
+    ReorderWindow window(4, TIMEOUT);
+    window.reset(BASE);
+    const auto now = ReorderWindow::clock::now();
+
+    CPPUNIT_ASSERT(not window.push(BASE - 1, record(BASE - 1), now));
+
+    CPPUNIT_ASSERT(window.push(BASE + 1, record(BASE + 1), now));
+    popAll(window, now + TIMEOUT);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), window.lost());
+    CPPUNIT_ASSERT(not window.push(BASE, record(BASE), now + TIMEOUT));
+    CPPUNIT_ASSERT(not window.push(BASE + 1, record(BASE + 1), now + TIMEOUT));
+
+    CPPUNIT_ASSERT(window.push(BASE + 2, record(BASE + 2), now + TIMEOUT));
+    const std::vector<uint64_t> expected {0xea};
+    CPPUNIT_ASSERT(popAll(window, now + TIMEOUT) == expected);
+}
+
+}} // namespace ring::test
+
+RING_TEST_RUNNER(ring::test::ReorderWindowTest::name());